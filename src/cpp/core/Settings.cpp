@@ -17,20 +17,57 @@
 
 #include <core/Log.hpp>
 #include <core/FilePath.hpp>
+#include <core/FileUtils.hpp>
 #include <core/SafeConvert.hpp>
 #include <core/FileSerializer.hpp>
 
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// give a file the permissions of another (which it's about to replace)
+Error copyPermissions(const FilePath& sourcePath, const FilePath& targetPath)
+{
+   boost::system::error_code ec;
+   boost::filesystem::file_status status =
+         boost::filesystem::status(sourcePath.absolutePathNative(), ec);
+   if (!ec)
+      boost::filesystem::permissions(targetPath.absolutePathNative(),
+                                     status.permissions(),
+                                     ec);
+   if (ec)
+   {
+      Error error(ec, ERROR_LOCATION);
+      error.addProperty("path", targetPath);
+      return error;
+   }
+   return Success();
+}
+
+} // anonymous namespace
+
 Settings::Settings()
    : updatePending_(false),
-     isDirty_(false)
+     isDirty_(false),
+     writeBehind_(false),
+     pendingChanges_(0),
+     writesAvoided_(0)
 {
 }
 
 Settings::~Settings()
 {
+   try
+   {
+      flush();
+   }
+   catch(...)
+   {
+   }
 }
 
 Error Settings::initialize(const FilePath& filePath) 
@@ -57,6 +94,19 @@ void Settings::set(const std::string& name, const std::string& value)
    if (value != settingsMap_[name])
    {
       settingsMap_[name] = value ;
+
+      if (writeBehind_ && !updatePending_)
+      {
+         if (!isDirty_)
+            dirtySince_ = boost::posix_time::microsec_clock::universal_time();
+         isDirty_ = true;
+         pendingChanges_++;
+
+         if (isStale())
+            writeSettings();
+         return;
+      }
+
       isDirty_ = true;
       
       if (!updatePending_)
@@ -142,16 +192,78 @@ void Settings::beginUpdate()
 void Settings::endUpdate()
 {
    updatePending_ = false ;
-   if (isDirty_)
+   if (!isDirty_)
+      return;
+
+   if (writeBehind_)
+   {
+      // defer the update's changes as though they were a single change
+      if (dirtySince_.is_not_a_date_time())
+         dirtySince_ = boost::posix_time::microsec_clock::universal_time();
+      pendingChanges_++;
+
+      if (!isStale())
+         return;
+   }
+
+   writeSettings();
+}
+
+void Settings::setWriteBehind(
+                  const boost::posix_time::time_duration& maxStaleness)
+{
+   writeBehind_ = true;
+   maxStaleness_ = maxStaleness;
+}
+
+void Settings::flush()
+{
+   if (isDirty_ && !updatePending_)
       writeSettings();
 }
 
+void Settings::flushIfStale()
+{
+   if (isStale())
+      flush();
+}
+
+bool Settings::isStale() const
+{
+   if (!isDirty_ || dirtySince_.is_not_a_date_time())
+      return false;
+
+   return boost::posix_time::microsec_clock::universal_time() - dirtySince_ >=
+                                                                maxStaleness_;
+}
+
 void Settings::writeSettings() 
 {
+   if (pendingChanges_ > 1)
+      writesAvoided_ += pendingChanges_ - 1;
+   pendingChanges_ = 0;
+   dirtySince_ = boost::posix_time::ptime();
    isDirty_ = false;
-   Error error = core::writeStringMapToFile(settingsFile_, settingsMap_) ; 
+
+   if (settingsFile_.empty())
+      return;
+
+   // write to a temporary file and move it into place, so the settings
+   // file is always complete (even if we're interrupted while writing). the
+   // temporary file is unique, as other processes may write the same file
+   FilePath tempFile = file_utils::uniqueFilePath(
+                                 settingsFile_.parent(),
+                                 settingsFile_.filename() + ".tmp-");
+   Error error = core::writeStringMapToFile(tempFile, settingsMap_) ;
+   if (!error && settingsFile_.exists())
+      error = copyPermissions(settingsFile_, tempFile);
+   if (!error)
+      error = tempFile.move(settingsFile_, FilePath::MoveDirect);
    if (error)
-     LOG_ERROR(error);
+   {
+      LOG_ERROR(error);
+      tempFile.removeIfExists();
+   }
 }
 
 
@@ -0,0 +1,150 @@
+/*
+ * SettingsTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <map>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Settings.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+std::string readSetting(const FilePath& filePath, const std::string& name)
+{
+   std::map<std::string, std::string> settingsMap;
+   Error error = readStringMapFromFile(filePath, &settingsMap);
+   if (error)
+      return std::string();
+   return settingsMap[name];
+}
+
+} // anonymous namespace
+
+TEST_CASE("settings")
+{
+   FilePath settingsPath;
+   REQUIRE(!FilePath::tempFilePath(&settingsPath));
+
+   SECTION("changes are written immediately by default")
+   {
+      Settings settings;
+      REQUIRE(!settings.initialize(settingsPath));
+
+      settings.set("a", std::string("1"));
+      CHECK(readSetting(settingsPath, "a") == "1");
+      CHECK(settings.writesAvoided() == 0);
+   }
+
+   SECTION("write-behind coalesces changes until flushed")
+   {
+      Settings settings;
+      REQUIRE(!settings.initialize(settingsPath));
+      settings.setWriteBehind(boost::posix_time::hours(1));
+
+      settings.set("a", std::string("1"));
+      settings.set("a", std::string("2"));
+      settings.set("b", 3);
+      CHECK(!settingsPath.exists());
+
+      settings.flush();
+      CHECK(readSetting(settingsPath, "a") == "2");
+      CHECK(readSetting(settingsPath, "b") == "3");
+      CHECK(settings.writesAvoided() == 2);
+
+      Settings reread;
+      REQUIRE(!reread.initialize(settingsPath));
+      CHECK(reread.get("a") == "2");
+   }
+
+   SECTION("write-behind bounds staleness")
+   {
+      Settings settings;
+      REQUIRE(!settings.initialize(settingsPath));
+      settings.setWriteBehind(boost::posix_time::milliseconds(0));
+
+      settings.set("a", std::string("1"));
+      CHECK(readSetting(settingsPath, "a") == "1");
+
+      settings.setWriteBehind(boost::posix_time::milliseconds(10));
+      settings.set("a", std::string("2"));
+      settings.flushIfStale();
+      CHECK(readSetting(settingsPath, "a") == "1");
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+      settings.flushIfStale();
+      CHECK(readSetting(settingsPath, "a") == "2");
+   }
+
+   SECTION("pending changes are written when settings are destroyed")
+   {
+      {
+         Settings settings;
+         REQUIRE(!settings.initialize(settingsPath));
+         settings.setWriteBehind(boost::posix_time::hours(1));
+         settings.set("a", std::string("1"));
+      }
+      CHECK(readSetting(settingsPath, "a") == "1");
+   }
+
+   SECTION("rewrites keep the file's permissions")
+   {
+      namespace fs = boost::filesystem;
+
+      Settings settings;
+      REQUIRE(!settings.initialize(settingsPath));
+      settings.set("a", std::string("1"));
+
+      fs::perms perms = fs::owner_read | fs::owner_write | fs::group_read;
+      fs::permissions(settingsPath.absolutePathNative(), perms);
+      settings.set("a", std::string("2"));
+      CHECK(readSetting(settingsPath, "a") == "2");
+      CHECK(fs::status(settingsPath.absolutePathNative()).permissions() == perms);
+
+      // and don't disturb another writer's temporary file
+      FilePath otherTemp(settingsPath.absolutePath() + ".tmp");
+      REQUIRE(!writeStringToFile(otherTemp, "a=3\n"));
+      settings.set("a", std::string("4"));
+      CHECK(readSetting(settingsPath, "a") == "4");
+      CHECK(readSetting(otherTemp, "a") == "3");
+      otherTemp.removeIfExists();
+
+      std::vector<FilePath> children;
+      REQUIRE(!settingsPath.parent().children(&children));
+      std::size_t tempFiles = 0;
+      for (std::size_t i = 0; i < children.size(); i++)
+      {
+         if (children[i].filename().find(settingsPath.filename() + ".tmp") == 0)
+            tempFiles++;
+      }
+      CHECK(tempFiles == 0);
+   }
+
+   settingsPath.removeIfExists();
+}
+
+} // end namespace tests
+} // end namespace core
+} // end namespace rstudio
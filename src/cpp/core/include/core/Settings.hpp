@@ -21,6 +21,7 @@
 
 #include <boost/utility.hpp>
 #include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include <core/FilePath.hpp>
 
@@ -57,14 +58,37 @@ public:
    void beginUpdate();
    void endUpdate();
 
+   // write-behind: rather than writing the file each time a value changes,
+   // changes are coalesced in memory and written by flush. changes are
+   // never left unwritten for longer than maxStaleness as long as flush
+   // or flushIfStale is called (a change made once that has passed also
+   // writes the file)
+   void setWriteBehind(const boost::posix_time::time_duration& maxStaleness);
+   bool writeBehind() const { return writeBehind_; }
+
+   // write any pending changes
+   void flush();
+
+   // write pending changes if they are older than maxStaleness
+   void flushIfStale();
+
+   // number of file writes avoided by coalescing changes
+   int writesAvoided() const { return writesAvoided_; }
+
 private:
    void writeSettings() ;
+   bool isStale() const;
 
 private:
    FilePath settingsFile_ ;
    std::map<std::string, std::string> settingsMap_ ;
    bool updatePending_ ;
    bool isDirty_;
+   bool writeBehind_;
+   boost::posix_time::time_duration maxStaleness_;
+   boost::posix_time::ptime dirtySince_;
+   int pendingChanges_;
+   int writesAvoided_;
 };
 
 }
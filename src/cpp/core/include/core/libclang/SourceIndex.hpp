@@ -22,8 +22,11 @@
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include <core/BoostThread.hpp>
 #include <core/FilePath.hpp>
+#include <core/Thread.hpp>
 
 #include "clang-c/Index.h"
 
@@ -62,7 +65,26 @@ public:
 
    int verbose() const { return verbose_; }
 
+   // parse translation units on a pool of background worker threads
+   // (without workers, which is the case unless this is called, they're
+   // parsed synchronously on the calling thread). units parsed by a worker
+   // are also reparsed and disposed on that worker, since it owns the index
+   // they belong to. should be called once, before the index is used
+   void startWorkers(std::size_t numWorkers);
+
+   // maximum time the calling thread will wait for an in-flight background
+   // parse of a requested translation unit before giving up (and parsing it
+   // itself)
+   void setParseTimeout(const boost::posix_time::time_duration& timeout);
+
+   // approximate memory budget for all indexed translation units; the least
+   // recently used units are evicted when it is exceeded (0 is unbounded).
+   // usage is checked after every few stores/reparses, so it can briefly be
+   // exceeded
+   void setMemoryBudget(std::size_t bytes);
+
    // functions used to keep the index "hot" based on recent user edits
+   // (when workers are running, first time parses happen in the background)
    void primeEditorTranslationUnit(const std::string& filename);
    void reprimeEditorTranslationUnit(const std::string& filename);
 
@@ -80,6 +102,30 @@ public:
 
    Cursor referencedCursorForFileLocation(const FileLocation& loc);
 
+private:
+
+   struct ParseJob;
+   struct Worker;
+
+   void enqueueParse(const std::string& filename);
+   void enqueueReparse(const std::string& filename);
+   void collectCompletedParses();
+   bool awaitPendingParse(const std::string& filename);
+   void cancelPendingParse(const std::string& filename);
+   void cancelAllPendingParses();
+   void storeTranslationUnit(const std::string& filename,
+                             const std::vector<std::string>& compileArgs,
+                             std::time_t lastWriteTime,
+                             CXTranslationUnit tu,
+                             int worker);
+   void disposeTranslationUnit(const std::string& filename);
+   void disposeTranslationUnit(CXTranslationUnit tu, int worker);
+   void touchTranslationUnit(const std::string& filename);
+   void enforceMemoryBudget(const std::string& keepFilename,
+                            bool force = false);
+   void workerMain(boost::shared_ptr<Worker> pWorker);
+   void stopWorkers();
+
 private:
 
    UnsavedFiles unsavedFiles_;
@@ -88,20 +134,47 @@ private:
 
    struct StoredTranslationUnit
    {
-      StoredTranslationUnit() : lastWriteTime(0), tu(NULL) {}
+      StoredTranslationUnit()
+         : lastWriteTime(0), tu(NULL), worker(-1), memoryBytes(0),
+           lastAccess(0)
+      {
+      }
       StoredTranslationUnit(const std::vector<std::string>& compileArgs,
                             std::time_t lastWriteTime,
-                            CXTranslationUnit tu)
-         : compileArgs(compileArgs), lastWriteTime(lastWriteTime), tu(tu)
+                            CXTranslationUnit tu,
+                            int worker)
+         : compileArgs(compileArgs), lastWriteTime(lastWriteTime), tu(tu),
+           worker(worker), memoryBytes(0), lastAccess(0)
       {
       }
       std::vector<std::string> compileArgs;
       std::time_t lastWriteTime;
       CXTranslationUnit tu;
+      int worker; // worker whose index owns the unit (-1 for index_)
+      std::size_t memoryBytes;
+      uint64_t lastAccess;
    };
    typedef std::map<std::string,StoredTranslationUnit> TranslationUnits;
    TranslationUnits translationUnits_;
 
+   // LRU bookkeeping (translation units are only ever stored, accessed,
+   // and disposed on the thread which owns the index)
+   uint64_t accessCounter_;
+   std::size_t memoryBudget_;
+   std::size_t updatesSinceMemoryCheck_;
+
+   // background parsing: each worker has its own CXIndex and queue of
+   // jobs. results are handed back to the owning thread, which installs them
+   // in translationUnits_. a unit being reparsed by its worker is taken out
+   // of translationUnits_ until the reparse is collected
+   typedef std::map<std::string, boost::shared_ptr<ParseJob> > ParseJobs;
+   ParseJobs pendingParses_;
+   std::vector<boost::shared_ptr<Worker> > workers_;
+   std::size_t nextWorker_;
+   boost::thread_group workerThreads_;
+   core::thread::ThreadsafeValue<bool> stopWorkers_;
+   boost::posix_time::time_duration parseTimeout_;
+
    CompilationDatabase compilationDB_;
 
    int verbose_;
@@ -18,6 +18,7 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
@@ -58,6 +59,10 @@ public:
 
    bool includesFile(const std::string& filename) const;
 
+   // the files included by the main file and the (non-system) headers it
+   // includes
+   std::vector<std::string> getIncludedFiles() const;
+
    CXFile getFile(const std::string& filename = std::string()) const;
 
    CXResult findReferencesInFile(Cursor cursor,
@@ -17,6 +17,9 @@
 #ifndef CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 #define CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 
+#include <ctime>
+#include <map>
+
 #include <boost/noncopyable.hpp>
 
 #include <core/Error.hpp>
@@ -33,27 +36,44 @@ namespace rstudio {
 namespace core {
 namespace r_util {
 
+typedef std::map<std::string, std::string> ActiveSessionProperties;
+
+// An active session's properties are kept together in a single small file
+// in its scratch path (replaced as a whole when a property changes), and
+// are cached in memory for as long as the file's write time shows that it
+// hasn't changed. Writers (which may be in different processes) hold a
+// lock on a file next to it while they read, update and replace the file.
+//
+// On NFS a file's write time comes from the client's attribute cache, so
+// it can miss another host's write for as long as the attributes are
+// cached; there the properties are read from the file each time instead.
 class ActiveSession : boost::noncopyable
 {
 private:
    friend class ActiveSessions;
-   ActiveSession() {}
+   ActiveSession()
+      : propertiesWriteTime_(0), propertiesReadTime_(0), cacheProperties_(false)
+   {
+   }
 
-   explicit ActiveSession(const std::string& id) : id_(id) 
+   explicit ActiveSession(const std::string& id)
+      : id_(id), propertiesWriteTime_(0), propertiesReadTime_(0),
+        cacheProperties_(false)
    {
    }
 
    explicit ActiveSession(const std::string& id, const FilePath& scratchPath)
-      : id_(id), scratchPath_(scratchPath)
+      : id_(id), scratchPath_(scratchPath),
+        propertiesWriteTime_(0), propertiesReadTime_(0), cacheProperties_(false)
    {
       core::Error error = scratchPath_.ensureDirectory();
       if (error)
          LOG_ERROR(error);
 
-      propertiesPath_ = scratchPath_.childPath("properites");
-      error = propertiesPath_.ensureDirectory();
-      if (error)
-         LOG_ERROR(error);
+      propertiesPath_ = scratchPath_.childPath("properties");
+      propertiesLockPath_ = scratchPath_.childPath("properties.lock");
+      cacheProperties_ = canCacheProperties();
+      migrateProperties();
    }
 
 public:
@@ -140,9 +160,7 @@ public:
    {
       if (!empty())
       {
-         double now = date_time::millisecondsSinceEpoch();
-         std::string value = safe_convert::numberToString(now);
-         writeProperty("last-used", value);
+         writeProperty("last-used", lastUsedNow());
       }
    }
 
@@ -237,9 +255,11 @@ public:
    {
       if (!empty())
       {
-         writeProperty("r-version", rVersion);
-         writeProperty("r-version-home", rVersionHome);
-         writeProperty("r-version-label", rVersionLabel);
+         ActiveSessionProperties properties;
+         properties["r-version"] = rVersion;
+         properties["r-version-home"] = rVersionHome;
+         properties["r-version-label"] = rVersionLabel;
+         writeProperties(properties);
       }
    }
 
@@ -261,16 +281,37 @@ public:
                      const std::string& rVersionHome,
                      const std::string& rVersionLabel = "")
    {
-      setLastUsed();
-      setRunning(true);
-      setRVersion(rVersion, rVersionHome, rVersionLabel);
+      if (!empty())
+      {
+         ActiveSessionProperties properties;
+         properties["last-used"] = lastUsedNow();
+         properties["running"] = safe_convert::numberToString(true);
+         properties["r-version"] = rVersion;
+         properties["r-version-home"] = rVersionHome;
+         properties["r-version-label"] = rVersionLabel;
+         writeProperties(properties);
+      }
    }
 
    void endSession()
    {
-      setLastUsed();
-      setRunning(false);
-      setExecuting(false);
+      if (!empty())
+      {
+         ActiveSessionProperties properties;
+         properties["last-used"] = lastUsedNow();
+         properties["running"] = safe_convert::numberToString(false);
+         properties["executing"] = safe_convert::numberToString(false);
+         writeProperties(properties);
+      }
+   }
+
+   // all of the session's properties (read at once)
+   ActiveSessionProperties properties() const
+   {
+      if (!empty())
+         return readProperties();
+      else
+         return ActiveSessionProperties();
    }
 
    uintmax_t suspendSize()
@@ -293,16 +334,20 @@ public:
    bool validate(const FilePath& userHomePath,
                  bool projectSharingEnabled) const
    {
-      // ensure the scratch path and properties paths exist
-      if (!scratchPath_.exists() || !propertiesPath_.exists())
+      // ensure the scratch path exists
+      if (!scratchPath_.exists())
          return false;
 
       // ensure the properties are there
-      if (project().empty() || workingDir().empty() || (lastUsed() == 0))
+      ActiveSessionProperties properties = readProperties();
+      std::string theProject = properties["project"];
+      double lastUsed = safe_convert::stringTo<double>(properties["last-used"],
+                                                       0);
+      if (theProject.empty() || properties["working-dir"].empty() ||
+          (lastUsed == 0))
           return false;
 
       // for projects validate that the base directory still exists
-      std::string theProject = project();
       if (theProject != kProjectNone)
       {
          FilePath projectDir = FilePath::resolveAliasedPath(theProject,
@@ -337,13 +382,35 @@ private:
       }
    }
 
+   static std::string lastUsedNow()
+   {
+      double now = date_time::millisecondsSinceEpoch();
+      return safe_convert::numberToString(now);
+   }
+
    void writeProperty(const std::string& name, const std::string& value) const;
    std::string readProperty(const std::string& name) const;
 
+   // update the given properties (leaving the others as they are)
+   void writeProperties(const ActiveSessionProperties& properties) const;
+   const ActiveSessionProperties& readProperties() const;
+
+   // can the write time of the properties file be trusted to show whether
+   // it's changed? (not on NFS)
+   bool canCacheProperties() const;
+
+   // move properties from the one file per property layout
+   void migrateProperties();
+
 private:
    std::string id_;
    FilePath scratchPath_;
    FilePath propertiesPath_;
+   FilePath propertiesLockPath_;
+   mutable ActiveSessionProperties properties_;
+   mutable std::time_t propertiesWriteTime_;
+   mutable std::time_t propertiesReadTime_;
+   bool cacheProperties_;
 };
 
 
@@ -379,6 +446,10 @@ public:
 
    boost::shared_ptr<ActiveSession> get(const std::string& id) const;
 
+   // the properties of all sessions, keyed by session id (each session's
+   // properties are read once)
+   std::map<std::string, ActiveSessionProperties> listProperties() const;
+
    FilePath storagePath() const { return storagePath_; }
 
    static boost::shared_ptr<ActiveSession> emptySession(const std::string& id);
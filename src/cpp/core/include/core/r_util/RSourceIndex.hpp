@@ -22,6 +22,9 @@
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/utility.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/range/iterator_range.hpp>
 #include <boost/regex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/range/adaptors.hpp>
@@ -39,6 +42,139 @@ namespace rstudio {
 namespace core {
 namespace r_util {
 
+// Process-wide pool of interned strings used by source index items. Each
+// distinct file path, symbol name, and S4 type is stored once (along with
+// its lower-cased form, for case-insensitive searches) in a single
+// contiguous arena, and items refer to it by a 32-bit id. Strings are
+// reference counted (see RSourceString) and released when no item refers to
+// them any longer; the arena is compacted once at least half of it is
+// released. Compaction moves string data, so the ranges returned by range()
+// and lowerRange() are only valid until the next release. As with the other
+// static state shared by source indexes, the pool should only be accessed
+// from the main thread.
+class RSourceStringPool : boost::noncopyable
+{
+public:
+   typedef uint32_t Id;
+   typedef boost::iterator_range<const char*> Range;
+
+   static RSourceStringPool& instance();
+
+   // id of the empty string (always interned, and never released)
+   static const Id kEmptyId = 0;
+
+   // intern a string, adding a reference to it
+   Id intern(const std::string& value);
+
+   // add or remove a reference to an interned string
+   void retain(Id id);
+   void release(Id id);
+
+   // the id of an interned string (kEmptyId if it isn't interned)
+   Id find(const std::string& value) const;
+
+   std::string string(Id id) const
+   {
+      return std::string(range(id).begin(), range(id).end());
+   }
+
+   Range range(Id id) const
+   {
+      const Entry& entry = entries_[id];
+      const char* begin = arena_.data() + entry.offset;
+      return Range(begin, begin + entry.length);
+   }
+
+   Range lowerRange(Id id) const
+   {
+      const Entry& entry = entries_[id];
+      const char* begin = arena_.data() + entry.offset + entry.length;
+      return Range(begin, begin + entry.length);
+   }
+
+   // number of interned strings
+   std::size_t size() const { return entries_.size() - freeIds_.size(); }
+
+   // bytes used by the arena (including released strings not yet compacted)
+   std::size_t arenaSize() const { return arena_.size(); }
+
+private:
+   RSourceStringPool();
+
+   void compact();
+
+   struct Entry
+   {
+      uint32_t offset;
+      uint32_t length;
+      uint32_t refCount;
+      std::size_t hash;
+   };
+
+   // each string is followed by its lower-cased form
+   std::vector<char> arena_;
+   std::size_t releasedBytes_;
+   std::vector<Entry> entries_;
+   std::vector<Id> freeIds_;
+
+   // ids by hash of their string (the strings themselves live in the arena)
+   boost::unordered_multimap<std::size_t, Id> ids_;
+};
+
+// Reference to a string in the RSourceStringPool; the string is released
+// when the last reference to it is destroyed
+class RSourceString
+{
+public:
+   RSourceString() : id_(RSourceStringPool::kEmptyId) {}
+
+   explicit RSourceString(const std::string& value)
+      : id_(RSourceStringPool::instance().intern(value))
+   {
+   }
+
+   RSourceString(const RSourceString& other) : id_(other.id_)
+   {
+      RSourceStringPool::instance().retain(id_);
+   }
+
+   RSourceString& operator=(const RSourceString& other)
+   {
+      if (other.id_ != id_)
+      {
+         RSourceStringPool::instance().retain(other.id_);
+         RSourceStringPool::instance().release(id_);
+         id_ = other.id_;
+      }
+      return *this;
+   }
+
+   ~RSourceString()
+   {
+      RSourceStringPool::instance().release(id_);
+   }
+
+   RSourceStringPool::Id id() const { return id_; }
+
+   std::string str() const
+   {
+      return RSourceStringPool::instance().string(id_);
+   }
+
+   RSourceStringPool::Range range() const
+   {
+      return RSourceStringPool::instance().range(id_);
+   }
+
+   RSourceStringPool::Range lowerRange() const
+   {
+      return RSourceStringPool::instance().lowerRange(id_);
+   }
+
+private:
+   RSourceStringPool::Id id_;
+};
+
 class RS4MethodParam
 {
 public:
@@ -54,12 +190,12 @@ public:
 
    // COPYING: via compiler / concrete-type
 
-   const std::string& name() const { return name_; }
-   const std::string& type() const { return type_; }
+   std::string name() const { return name_.str(); }
+   std::string type() const { return type_.str(); }
 
 private:
-   std::string name_;
-   std::string type_;
+   RSourceString name_;
+   RSourceString type_;
 };
 
 
@@ -76,7 +212,11 @@ public:
    };
 
 public:
-   RSourceItem() : type_(None), braceLevel_(0), line_(0), column_(0)
+   RSourceItem()
+      : type_(None),
+        braceLevel_(0),
+        line_(0),
+        column_(0)
    {
    }
 
@@ -100,9 +240,9 @@ public:
    // COPYING: via compiler (copyable members)
 
 private:
-   RSourceItem(const std::string& context,
+   RSourceItem(const RSourceString& context,
                int type,
-               const std::string& name,
+               const RSourceString& name,
                const std::vector<RS4MethodParam>& signature,
                int braceLevel,
                std::size_t line,
@@ -124,8 +264,8 @@ public:
    bool isMethod() const { return type_ == Method; }
    bool isClass() const { return type_ == Class; }
    bool isVariable() const { return type_ == Variable; }
-   const std::string& context() const { return context_; }
-   const std::string& name() const { return name_; }
+   std::string context() const { return context_.str(); }
+   std::string name() const { return name_.str(); }
    const std::vector<RS4MethodParam>& signature() const { return signature_; }
    const int braceLevel() const { return braceLevel_; }
    int line() const { return core::safe_convert::numberTo<std::size_t, int>(line_,0); }
@@ -136,32 +276,54 @@ public:
    bool nameStartsWith(const std::string& term, bool caseSensitive) const
    {
       if (caseSensitive)
-         return boost::algorithm::starts_with(name_, term);
+         return boost::algorithm::starts_with(name_.range(), term);
       else
-         return boost::algorithm::istarts_with(name_, term);
+         return nameStartsWithLower(string_utils::toLower(term));
    }
 
    bool nameIsSubsequence(const std::string& term, bool caseSensitive) const
    {
-      return string_utils::isSubsequence(name_, term, !caseSensitive);
+      if (caseSensitive)
+         return isSubsequence(name_.range(), term);
+      else
+         return nameIsSubsequenceLower(string_utils::toLower(term));
+   }
+
+   // variants of the above for callers that have already lower-cased the
+   // search term (these compare against the interned lower-case name, which
+   // avoids per-character locale conversions during large searches)
+
+   bool nameStartsWithLower(const std::string& lowerTerm) const
+   {
+      return boost::algorithm::starts_with(name_.lowerRange(), lowerTerm);
+   }
+
+   bool nameIsSubsequenceLower(const std::string& lowerTerm) const
+   {
+      return isSubsequence(name_.lowerRange(), lowerTerm);
    }
 
    bool nameContains(const std::string& term, bool caseSensitive) const
    {
       if (caseSensitive)
-         return boost::algorithm::contains(name_, term);
+         return boost::algorithm::contains(name_.range(), term);
       else
-         return boost::algorithm::icontains(name_, term);
+         return boost::algorithm::icontains(name_.range(), term);
    }
 
    bool nameMatches(const boost::regex& regex,
                     bool prefixOnly,
                     bool caseSensitive) const
    {
-      return regex_utils::textMatches(name_, regex, prefixOnly, caseSensitive);
+      return regex_utils::textMatches(name(), regex, prefixOnly, caseSensitive);
    }
 
    RSourceItem withContext(const std::string& context) const
+   {
+      return withContext(RSourceString(context));
+   }
+
+   RSourceItem withContext(const RSourceString& context) const
    {
       return RSourceItem(context,
                          type_,
@@ -173,9 +335,23 @@ public:
    }
 
 private:
-   std::string context_;
+   static bool isSubsequence(const RSourceStringPool::Range& self,
+                             const std::string& other)
+   {
+      std::string::const_iterator otherIt = other.begin();
+      for (const char* it = self.begin();
+           it != self.end() && otherIt != other.end();
+           ++it)
+      {
+         if (*it == *otherIt)
+            ++otherIt;
+      }
+      return otherIt == other.end();
+   }
+
+   RSourceString context_;
    int type_;
-   std::string name_;
+   RSourceString name_;
    std::vector<RS4MethodParam> signature_;
    int braceLevel_;
    std::size_t line_;
@@ -204,13 +380,17 @@ public:
                   const boost::function<bool(const RSourceItem&)> predicate,
                   OutputIterator out) const
    {
-      // perform the copy and transform to include context
+      // perform the copy and transform to include context (the context is
+      // interned once up front so each matched item only copies an id)
+      RSourceString context(newContext);
+      RSourceItem (RSourceItem::*withContext)(const RSourceString&) const =
+                                                   &RSourceItem::withContext;
       core::algorithm::copy_transformed_if(
                 items_.begin(),
                 items_.end(),
                 out,
                 predicate,
-                boost::bind(&RSourceItem::withContext, _1, newContext));
+                boost::bind(withContext, _1, context));
 
       // return the output iterator
       return out;
@@ -247,14 +427,25 @@ public:
                                     prefixOnly,
                                     caseSensitive);
       }
-      else
+      else if (caseSensitive)
       {
          if (prefixOnly)
             predicate = boost::bind(&RSourceItem::nameStartsWith,
-                                       _1, term, caseSensitive);
+                                       _1, term, true);
          else
             predicate = boost::bind(&RSourceItem::nameIsSubsequence,
-                                       _1, term, caseSensitive);
+                                       _1, term, true);
+      }
+      else
+      {
+         // lower-case the term once rather than once per item
+         std::string lowerTerm = string_utils::toLower(term);
+         if (prefixOnly)
+            predicate = boost::bind(&RSourceItem::nameStartsWithLower,
+                                       _1, lowerTerm);
+         else
+            predicate = boost::bind(&RSourceItem::nameIsSubsequenceLower,
+                                       _1, lowerTerm);
       }
 
       return search(newContext, predicate, out);
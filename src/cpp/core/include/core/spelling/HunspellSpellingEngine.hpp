@@ -36,6 +36,9 @@ typedef boost::function<core::Error(const std::string&,
                                     bool,
                                     std::string*)> IconvstrFunction;
 
+// how long to wait for the background threads to check a batch of words
+const int kDefaultCheckTimeoutMs = 500;
+
 class HunspellSpellingEngine : public SpellingEngine
 {
 public:
@@ -43,13 +46,25 @@ public:
                           const HunspellDictionaryManager& dictionaryManager,
                           const IconvstrFunction& iconvstrFunction);
 
+   virtual ~HunspellSpellingEngine();
+
 public:
 
+   // check batches of words using this many background threads (each
+   // holding its own copy of the dictionary), checking a batch on the
+   // calling thread instead if they take longer than the timeout; takes
+   // effect the next time a dictionary is loaded
+   void setWorkerThreads(std::size_t numWorkers,
+                         int checkTimeoutMs = kDefaultCheckTimeoutMs);
+
    void useDictionary(const std::string& langId);
 
    Error checkSpelling(const std::string& word,
                        bool *pCorrect);
 
+   Error checkSpelling(const std::vector<std::string>& words,
+                       std::vector<bool>* pCorrect);
+
    Error suggestionList(const std::string& word,
                         std::vector<std::string>* pSugs);
 
@@ -38,6 +38,10 @@ public:
    virtual Error checkSpelling(const std::string& word,
                                bool *pCorrect) = 0;
 
+   // words which can't be checked are reported as correct
+   virtual Error checkSpelling(const std::vector<std::string>& words,
+                               std::vector<bool>* pCorrect) = 0;
+
    virtual Error suggestionList(const std::string& word,
                                 std::vector<std::string>* pSugs) = 0;
 
@@ -218,6 +218,23 @@ public:
    // has it exited?
    virtual bool exited();
 
+   // call onContinue without reading output (terminating the process if it
+   // returns false). used to give children which aren't being polled
+   // periodic attention
+   void callOnContinue();
+
+   // does the process need to be polled even when none of its output
+   // descriptors are readable (e.g. to check for subprocesses)?
+   bool needsPeriodicPoll() const;
+
+   // output descriptors which haven't yet reached end of file (used to
+   // watch for output rather than polling for it)
+   std::vector<int> openOutputFds() const;
+
+   // was reading output skipped by the last poll (see
+   // ProcessCallbacks::isOutputPaused)?
+   bool outputPaused() const;
+
    // override of terminate (allow special handling for unix pty termination)
    virtual Error terminate();
 
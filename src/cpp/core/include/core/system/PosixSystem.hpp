@@ -208,6 +208,17 @@ Error runProcess(const std::string& path,
                  ProcessConfig& config,
                  ProcessConfigFilter configFilter);
 
+// prepares the current process exactly as runProcess would prepare the
+// process it runs (switching user, applying limits and replacing the
+// environment) but without exec'ing; instead the arguments the process would
+// have been run with are returned. used by processes which are started ahead
+// of time and handed their configuration when they are needed
+Error specializeProcess(const std::string& path,
+                        const std::string& runAsUser,
+                        ProcessConfig& config,
+                        ProcessConfigFilter configFilter,
+                        std::vector<std::string>* pArgs);
+
 // get this processes' child processes
 Error getChildProcesses(std::vector<rstudio::core::system::ProcessInfo> *pOutProcesses);
 
@@ -264,6 +264,14 @@ Error runCommand(const std::string& command,
 // the poll() method must be called periodically (e.g. during standard event
 // pumping / idle time) in  order to check for output & status of children.
 //
+// Where supported (Linux) children are watched for output and exit from a
+// background thread, so poll() only services children which have events
+// pending (or which need periodic attention, e.g. to check for
+// subprocesses); other children just have onContinue called at a coarse
+// interval (see kContinueInterval and continueSoon). Owners can also
+// provide an activity handler to be told when to poll rather than relying
+// on a polling interval.
+//
 // If you want to pair a call to runProgam or runCommand with an object which
 // will live for the lifetime of the child process you should create a
 // shared_ptr to that object and then bind the applicable members to the
@@ -307,12 +315,19 @@ struct ProcessCallbacks
    // be used for writing initial standard input to the child
    boost::function<void(ProcessOperations&)> onStarted;
 
-   // Called periodically (at whatever interval poll is called) during the
-   // lifetime of the child process (will not be called until after the
-   // first call to onStarted). If it returns false then the child process
-   // is terminated.
+   // Called periodically during the lifetime of the child process (will not
+   // be called until after the first call to onStarted). This is whenever
+   // the child is polled, or every ProcessSupervisor::kContinueInterval for
+   // children which are otherwise idle. If it returns false then the child
+   // process is terminated.
    boost::function<bool(ProcessOperations&)> onContinue;
 
+   // Called (after onContinue) before output is read. If it returns true
+   // the output is left unread, so that a child producing output faster
+   // than it can be consumed blocks writing it. The child isn't checked for
+   // exit while its output is paused (so none of its output is lost)
+   boost::function<bool()> isOutputPaused;
+
    // Streaming callback for standard output
    boost::function<void(ProcessOperations&, const std::string&)> onStdout;
 
@@ -413,6 +428,19 @@ public:
    // are still children being supervised after the poll
    bool poll();
 
+   // Set a function to be called when children have output or exit events
+   // pending (so that poll() can be scheduled). Note that this is called
+   // on a background thread.
+   void setActivityHandler(const boost::function<void()>& onActivity);
+
+   // Interval at which onContinue is called for children which otherwise
+   // don't need polling
+   static const boost::posix_time::time_duration kContinueInterval;
+
+   // Have the next poll() call onContinue for every child (e.g. because work
+   // has been queued which a child's onContinue dispatches)
+   void continueSoon();
+
    // Terminate all running children
    void terminateAll();
 
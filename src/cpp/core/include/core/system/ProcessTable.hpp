@@ -0,0 +1,110 @@
+/*
+ * ProcessTable.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_PROCESS_TABLE_HPP
+#define CORE_SYSTEM_PROCESS_TABLE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+
+namespace system {
+
+// Snapshot of the system process table (read from /proc) indexed by parent
+// process, so that the children of any number of processes can be found
+// from a single scan.
+class ProcessTable : boost::noncopyable
+{
+public:
+   ProcessTable() {}
+
+   // re-read the process table
+   Error refresh();
+
+   // when the snapshot was last refreshed
+   boost::posix_time::ptime refreshed() const { return refreshed_; }
+
+   // immediate children / all descendants of the given process
+   std::vector<SubprocInfo> children(PidType pid) const;
+   std::vector<SubprocInfo> descendants(PidType pid) const;
+
+   // executable name of the given process (empty if not in the snapshot)
+   std::string exe(PidType pid) const;
+
+   // current working directory of the given process (read on first request
+   // and then remembered until the next refresh)
+   FilePath cwd(PidType pid);
+
+private:
+   struct Entry
+   {
+      PidType pid;
+      PidType ppid;
+      std::string exe;
+   };
+
+   SubprocInfo subprocInfo(std::size_t index) const;
+
+   std::vector<Entry> entries_;
+   boost::unordered_map<PidType, std::size_t> pidIndexes_;
+   boost::unordered_map<PidType, std::vector<std::size_t> > childIndexes_;
+   std::map<PidType, FilePath> cwds_;
+   boost::posix_time::ptime refreshed_;
+};
+
+// Process table snapshot shared by everything which tracks subprocesses
+// (e.g. each terminal checking whether its shell is busy). The snapshot is
+// refreshed on demand but at most once per refresh interval, no matter how
+// many callers there are. Safe to call from any thread.
+class ProcessTableService : boost::noncopyable
+{
+public:
+   ProcessTableService();
+
+   void setRefreshInterval(const boost::posix_time::time_duration& interval);
+
+   std::vector<SubprocInfo> children(PidType pid);
+   std::vector<SubprocInfo> descendants(PidType pid);
+   std::string exe(PidType pid);
+   FilePath cwd(PidType pid);
+
+private:
+   bool refreshIfNecessary();
+
+   boost::mutex mutex_;
+   boost::posix_time::time_duration refreshInterval_;
+   ProcessTable table_;
+};
+
+ProcessTableService& processTableService();
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_PROCESS_TABLE_HPP
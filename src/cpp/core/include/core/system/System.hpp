@@ -279,6 +279,21 @@ void log(LogLevel level, const std::string& message) ;
 bool isHiddenFile(const FilePath& filePath) ;
 bool isHiddenFile(const FileInfo& fileInfo) ;
 bool isReadOnly(const FilePath& filePath);
+
+// create a copy of a file which shares its data with the original until
+// either is written (fails if the filesystem doesn't support this)
+Error cloneFile(const FilePath& sourcePath, const FilePath& targetPath);
+
+// create a hard link to a file
+Error linkFile(const FilePath& sourcePath, const FilePath& targetPath);
+
+// number of hard links to a file
+Error linkCount(const FilePath& filePath, std::size_t* pCount);
+
+// copy a file, sharing its data with the original where we can: as a clone,
+// or failing that as a hard link (so only for files which are replaced
+// rather than written in place)
+Error shareFile(const FilePath& sourcePath, const FilePath& targetPath);
    
 // terminals
 bool stderrIsTerminal();
@@ -0,0 +1,207 @@
+/*
+ * TermScreen.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef TERM_SCREEN_HPP
+#define TERM_SCREEN_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+// A headless model of a (vt100/xterm) terminal's screen and scrollback.
+//
+// Output written to the terminal is interpreted the way a terminal emulator
+// would: text is placed on a grid of cells, cursor movement, erase and
+// scrolling sequences are applied, and lines scrolled off the top of the
+// screen are kept (up to a limit) as scrollback. Everything else (titles,
+// modes we don't model, etc.) is ignored.
+//
+// render() produces output which, written to an empty terminal of the same
+// size, recreates the scrollback, the screen, the cursor position and the
+// current text attributes. Its size depends on what the terminal is showing
+// rather than on how much output produced it, so it's what to send when a
+// client needs to redraw a terminal.
+//
+// Escape sequences and UTF-8 characters may span calls to write(). Wide
+// (e.g. CJK) characters occupy two cells, and combining characters join the
+// character before them, as wcwidth() would have it.
+//
+// Alt-buffer output isn't modelled; remove it first (see
+// stripSecondaryBuffer).
+class TermScreen
+{
+public:
+   TermScreen(int cols, int rows, int maxScrollbackLines);
+
+   // interpret terminal output
+   void write(const std::string& output);
+
+   // change the size of the screen; rows which no longer fit move into the
+   // scrollback and lines which are too long are kept intact
+   void resize(int cols, int rows);
+
+   // forget everything which has been written
+   void reset();
+
+   // output which recreates the terminal
+   std::string render() const;
+
+   int cols() const { return cols_; }
+   int rows() const { return rows_; }
+   int cursorRow() const { return cursorRow_; }
+   int cursorCol() const { return cursorCol_; }
+   std::size_t scrollbackLines() const { return scrollback_.size(); }
+
+   // the text (without attributes) of a line; scrollback lines are numbered
+   // from the oldest and are followed by the screen rows
+   std::string lineText(std::size_t line) const;
+
+public:
+   // colors are -1 (default), 0-255 (palette) or kRgbColor | 0xRRGGBB
+   static const boost::int32_t kRgbColor = 0x1000000;
+
+   struct Attributes
+   {
+      Attributes() : fg(-1), bg(-1), flags(0) {}
+
+      bool operator==(const Attributes& other) const
+      {
+         return fg == other.fg && bg == other.bg && flags == other.flags;
+      }
+      bool operator!=(const Attributes& other) const
+      {
+         return !(*this == other);
+      }
+
+      boost::int32_t fg;
+      boost::int32_t bg;
+      boost::uint16_t flags;
+   };
+
+private:
+   struct Cell
+   {
+      Cell() : length(1) { bytes[0] = ' '; }
+
+      bool isBlank() const
+      {
+         return length == 1 && bytes[0] == ' ' && attr == Attributes();
+      }
+
+      // the second cell of a wide character
+      bool isContinuation() const { return length == 0; }
+
+      // the UTF-8 encoded character, followed by any combining characters
+      // (which are dropped once it's full)
+      static const std::size_t kMaxBytes = 16;
+      char bytes[kMaxBytes];
+      boost::uint8_t length;
+      Attributes attr;
+   };
+
+   struct Line
+   {
+      Line() : wrapped(false) {}
+
+      std::vector<Cell> cells;
+
+      // did the text continue onto the following line because it reached
+      // the right margin?
+      bool wrapped;
+   };
+
+   enum ParseState
+   {
+      Ground,
+      Escape,        // found ESC
+      EscapeCharset, // found ESC followed by a charset designator
+      Csi,           // found ESC [
+      String,        // within OSC, DCS, etc.
+      StringEscape   // found ESC within a string (start of ST?)
+   };
+
+   void print(const char* bytes, std::size_t length);
+   void combine(const char* bytes, std::size_t length);
+   void clearWideCharacters(Line& line, int from, int to);
+   void control(char ch);
+   void escape(char ch);
+   void csi(char final);
+   void sgr();
+
+   void lineFeed();
+   void reverseLineFeed();
+   void scrollUp(int top, int count, bool saveLines = true);
+   void scrollDown(int top, int count);
+   void eraseCells(Line& line, int from, int to);
+   void eraseDisplay(int mode);
+   void eraseLine(int mode);
+   void moveCursor(int row, int col);
+   void setPrivateMode(int mode, bool set);
+   void pushScrollback(const Line& line);
+
+   int param(std::size_t index, int defaultValue) const;
+
+   void renderLine(const Line& line, bool trim, Attributes* pAttr,
+                   std::string* pOutput) const;
+
+private:
+   int cols_;
+   int rows_;
+   std::size_t maxScrollbackLines_;
+
+   std::deque<Line> scrollback_;
+   std::vector<Line> screen_;
+
+   int cursorRow_;
+   int cursorCol_;
+   bool wrapPending_;
+   Attributes attr_;
+
+   // scrolling region (inclusive)
+   int scrollTop_;
+   int scrollBottom_;
+
+   // saved by DECSC
+   int savedRow_;
+   int savedCol_;
+   Attributes savedAttr_;
+
+   // DEC private modes which affect how the client behaves
+   bool autowrap_;
+   bool cursorVisible_;
+   bool appCursorKeys_;
+   bool bracketedPaste_;
+
+   // parser state
+   ParseState state_;
+   std::string params_;
+   std::vector<int> parsedParams_;
+   char csiPrefix_;
+   bool csiIntermediate_;
+   std::string utf8_;
+   std::size_t utf8Length_;
+};
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
+
+#endif // TERM_SCREEN_HPP
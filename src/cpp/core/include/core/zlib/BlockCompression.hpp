@@ -0,0 +1,132 @@
+/*
+ * BlockCompression.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_ZLIB_BLOCK_COMPRESSION_HPP
+#define CORE_ZLIB_BLOCK_COMPRESSION_HPP
+
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/Error.hpp>
+
+namespace rstudio {
+namespace core {
+namespace zlib {
+
+// Block compression writes data as a series of gzip members, each holding
+// an independently compressed block of the input. The blocks are
+// compressed in parallel, and since concatenated gzip members are
+// themselves a valid gzip file the output can be read by anything which
+// reads gzip (including R's gzfile, and so load and readRDS).
+//
+// Each member's header carries an extra field recording the member's
+// size and the size of its block, so the block index of a file can be
+// read by stepping from header to header, and any block can then be read
+// without decompressing those before it.
+
+struct BlockIndexEntry
+{
+   BlockIndexEntry()
+      : offset(0), compressedSize(0), uncompressedOffset(0), uncompressedSize(0)
+   {
+   }
+
+   boost::uint64_t offset;
+   boost::uint32_t compressedSize;
+   boost::uint64_t uncompressedOffset;
+   boost::uint32_t uncompressedSize;
+};
+
+class BlockCompressor : boost::noncopyable
+{
+public:
+   static const std::size_t kDefaultBlockSize;
+   static const std::size_t kDefaultMaxThreads;
+   static const std::size_t kDefaultMaxPendingBytes;
+
+   // compress to the output stream with the given zlib compression level.
+   // threads of 0 uses one per core, up to kDefaultMaxThreads. at most
+   // maxPendingBytes of blocks (and at least one block) are held waiting
+   // to be compressed or written
+   BlockCompressor(std::ostream& output,
+                   int level,
+                   std::size_t blockSize = kDefaultBlockSize,
+                   std::size_t threads = 0,
+                   std::size_t maxPendingBytes = kDefaultMaxPendingBytes);
+   ~BlockCompressor();
+
+   core::Error write(const char* data, std::size_t size);
+
+   // compress and write any remaining input (no more can be written after)
+   core::Error finish();
+
+private:
+   struct Block
+   {
+      Block() : done(false) {}
+      std::string input;
+      std::string output;
+      bool done;
+      core::Error error;
+   };
+
+   void submitBlock();
+   core::Error writeBlocks(std::size_t maxPending);
+   void compressBlocks();
+   void stop();
+
+private:
+   std::ostream& output_;
+   int level_;
+   std::size_t blockSize_;
+   std::size_t maxPending_;
+
+   boost::shared_ptr<Block> pCurrent_;
+
+   // blocks in output order, and blocks waiting for a thread
+   std::deque<boost::shared_ptr<Block> > pending_;
+   std::deque<boost::shared_ptr<Block> > queue_;
+
+   boost::mutex mutex_;
+   boost::condition_variable queued_;
+   boost::condition_variable compressed_;
+   bool stopping_;
+   boost::thread_group threads_;
+   bool finished_;
+};
+
+// read the block index of a block compressed stream
+core::Error readBlockIndex(std::istream& input,
+                           std::vector<BlockIndexEntry>* pIndex);
+
+// read one block of a block compressed stream
+core::Error readBlock(std::istream& input,
+                      const BlockIndexEntry& entry,
+                      std::string* pData);
+
+} // namespace zlib
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_ZLIB_BLOCK_COMPRESSION_HPP
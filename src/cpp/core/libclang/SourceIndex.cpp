@@ -15,9 +15,12 @@
 
 #include <core/libclang/SourceIndex.hpp>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <core/FilePath.hpp>
+#include <core/Macros.hpp>
 #include <core/PerformanceTimer.hpp>
 
 #include <core/system/ProcessArgs.hpp>
@@ -37,13 +40,203 @@ inline unsigned applyTranslationUnitOptions(unsigned defaultOptions)
    return defaultOptions;
 }
 
+// number of translation unit stores/reparses between memory budget checks
+const std::size_t kMemoryCheckInterval = 8;
+
 bool isHeaderExtension(const std::string& ex)
 {
    return ex == ".h" || ex == ".hh" || ex == ".hpp";
 }
 
+std::size_t translationUnitMemoryBytes(CXTranslationUnit tu)
+{
+   CXTUResourceUsage usage = clang().getCXTUResourceUsage(tu);
+
+   std::size_t totalBytes = 0;
+   for (unsigned i = 0; i < usage.numEntries; i++)
+   {
+      CXTUResourceUsageEntry entry = usage.entries[i];
+      if (entry.kind >= CXTUResourceUsage_MEMORY_IN_BYTES_BEGIN &&
+          entry.kind <= CXTUResourceUsage_MEMORY_IN_BYTES_END)
+      {
+         totalBytes += entry.amount;
+      }
+   }
+
+   clang().disposeCXTUResourceUsage(usage);
+   return totalBytes;
+}
+
+// take a private copy of the unsaved files so that a background parse
+// isn't affected by subsequent edits made on the main thread
+boost::shared_ptr<UnsavedFiles> snapshotUnsavedFiles(UnsavedFiles& unsavedFiles)
+{
+   boost::shared_ptr<UnsavedFiles> pSnapshot(new UnsavedFiles());
+   CXUnsavedFile* pFiles = unsavedFiles.unsavedFilesArray();
+   for (unsigned i = 0; i < unsavedFiles.numUnsavedFiles(); i++)
+   {
+      pSnapshot->update(pFiles[i].Filename,
+                        std::string(pFiles[i].Contents, pFiles[i].Length),
+                        true);
+   }
+   return pSnapshot;
+}
+
 } // anonymous namespace
 
+// a translation unit parse, reparse or disposal queued for a background
+// worker. the worker fills in the result of a parse or reparse and signals
+// completion; the owning thread collects it
+struct SourceIndex::ParseJob : boost::noncopyable
+{
+   enum Action
+   {
+      Parse,
+      Reparse,
+      Dispose
+   };
+
+   ParseJob(Action action,
+            const std::string& filename,
+            const std::vector<std::string>& compileArgs,
+            std::time_t lastWriteTime,
+            boost::shared_ptr<UnsavedFiles> pUnsavedFiles,
+            int worker,
+            CXTranslationUnit existingTu = NULL)
+      : action(action),
+        filename(filename),
+        compileArgs(compileArgs),
+        lastWriteTime(lastWriteTime),
+        pUnsavedFiles(pUnsavedFiles),
+        worker(worker),
+        existingTu(existingTu),
+        complete(false),
+        cancelled(false),
+        tu(NULL)
+   {
+   }
+
+   bool waitForCompletion(const boost::posix_time::time_duration& timeout)
+   {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      boost::system_time timeoutTime = boost::get_system_time() + timeout;
+      while (!complete)
+      {
+         if (!condition.timed_wait(lock, timeoutTime))
+            return complete;
+      }
+      return true;
+   }
+
+   // (called on the worker)
+   void run(CXIndex index)
+   {
+      if (action == Dispose)
+      {
+         clang().disposeTranslationUnit(existingTu);
+         return;
+      }
+
+      // skip jobs which were superseded while queued
+      {
+         boost::lock_guard<boost::mutex> lock(mutex);
+         if (cancelled)
+         {
+            abandon();
+            return;
+         }
+      }
+
+      CXTranslationUnit result = NULL;
+      if (action == Reparse)
+      {
+         unsigned options = applyTranslationUnitOptions(
+                                 clang().defaultReparseOptions(existingTu));
+         int ret = clang().reparseTranslationUnit(
+                                 existingTu,
+                                 pUnsavedFiles->numUnsavedFiles(),
+                                 pUnsavedFiles->unsavedFilesArray(),
+                                 options);
+
+         // a unit which failed to reparse can only be disposed
+         if (ret == 0)
+            result = existingTu;
+         else
+            clang().disposeTranslationUnit(existingTu);
+      }
+      else
+      {
+         core::system::ProcessArgs argsArray(compileArgs);
+         unsigned options = applyTranslationUnitOptions(
+                              clang().defaultEditingTranslationUnitOptions());
+         result = clang().parseTranslationUnit(
+                               index,
+                               filename.c_str(),
+                               argsArray.args(),
+                               static_cast<int>(argsArray.argCount()),
+                               pUnsavedFiles->unsavedFilesArray(),
+                               pUnsavedFiles->numUnsavedFiles(),
+                               options);
+      }
+
+      // publish the result (or discard it if nobody wants it anymore)
+      bool discard = false;
+      {
+         boost::lock_guard<boost::mutex> lock(mutex);
+         if (cancelled)
+            discard = true;
+         else
+            tu = result;
+         complete = true;
+         pUnsavedFiles.reset();
+      }
+      condition.notify_all();
+
+      if (discard && result != NULL)
+         clang().disposeTranslationUnit(result);
+   }
+
+   // dispose the unit the job was given without running it (called on the
+   // worker)
+   void abandon()
+   {
+      if (action != Parse)
+         clang().disposeTranslationUnit(existingTu);
+   }
+
+   // immutable once queued
+   const Action action;
+   const std::string filename;
+   const std::vector<std::string> compileArgs;
+   const std::time_t lastWriteTime;
+   boost::shared_ptr<UnsavedFiles> pUnsavedFiles;
+   const int worker;
+
+   // unit to reparse or dispose (owned by the job once queued)
+   const CXTranslationUnit existingTu;
+
+   // guarded by mutex
+   boost::mutex mutex;
+   boost::condition_variable condition;
+   bool complete;
+   bool cancelled;
+   CXTranslationUnit tu;
+};
+
+// a background worker. libclang only allows an index (and its translation
+// units) to be used from one thread at a time, so each worker has its own
+// index, and everything done to the units parsed into it is queued for it
+struct SourceIndex::Worker : boost::noncopyable
+{
+   explicit Worker(CXIndex index)
+      : index(index)
+   {
+   }
+
+   const CXIndex index;
+   core::thread::ThreadsafeQueue<boost::shared_ptr<ParseJob> > jobs;
+};
+
 bool SourceIndex::isSourceFile(const FilePath& filePath)
 {
    std::string ex = filePath.extensionLowerCase();
@@ -63,6 +256,12 @@ bool SourceIndex::isHeaderFile(const FilePath& filePath)
 }
 
 SourceIndex::SourceIndex(CompilationDatabase compilationDB, int verbose)
+   : accessCounter_(0),
+     memoryBudget_(0),
+     updatesSinceMemoryCheck_(0),
+     nextWorker_(0),
+     stopWorkers_(false),
+     parseTimeout_(boost::posix_time::seconds(2))
 {
    verbose_ = verbose;
    index_ = clang().createIndex(0, (verbose_ > 0) ? 1 : 0);
@@ -73,10 +272,17 @@ SourceIndex::~SourceIndex()
 {
    try
    {
-      // remove all
+      // remove all (units parsed by workers are queued for them to dispose)
       removeAllTranslationUnits();
 
-      // dispose the index
+      // stop background parsing (waits for in-flight parses and disposals)
+      stopWorkers();
+
+      // dispose the indexes
+      BOOST_FOREACH(const boost::shared_ptr<Worker>& pWorker, workers_)
+      {
+         clang().disposeIndex(pWorker->index);
+      }
       if (index_ != NULL)
          clang().disposeIndex(index_);
    }
@@ -85,6 +291,289 @@ SourceIndex::~SourceIndex()
    }
 }
 
+void SourceIndex::startWorkers(std::size_t numWorkers)
+{
+   if (!workers_.empty())
+      return;
+
+   for (std::size_t i = 0; i < numWorkers; i++)
+   {
+      CXIndex index = clang().createIndex(0, (verbose_ > 0) ? 1 : 0);
+      if (index == NULL)
+         continue;
+
+      boost::shared_ptr<Worker> pWorker(new Worker(index));
+      boost::thread workerThread;
+      core::thread::safeLaunchThread(
+               boost::bind(&SourceIndex::workerMain, this, pWorker),
+               &workerThread);
+
+      if (workerThread.joinable())
+      {
+         workers_.push_back(pWorker);
+         workerThreads_.add_thread(new boost::thread(MOVE_THREAD(workerThread)));
+      }
+      else
+      {
+         clang().disposeIndex(index);
+      }
+   }
+}
+
+void SourceIndex::stopWorkers()
+{
+   if (workers_.empty())
+      return;
+
+   stopWorkers_.set(true);
+   cancelAllPendingParses();
+   workerThreads_.join_all();
+}
+
+void SourceIndex::setParseTimeout(const boost::posix_time::time_duration& timeout)
+{
+   parseTimeout_ = timeout;
+}
+
+void SourceIndex::setMemoryBudget(std::size_t bytes)
+{
+   memoryBudget_ = bytes;
+   enforceMemoryBudget(std::string(), true);
+}
+
+void SourceIndex::workerMain(boost::shared_ptr<Worker> pWorker)
+{
+   try
+   {
+      boost::shared_ptr<ParseJob> pJob;
+      while (!stopWorkers_.get())
+      {
+         if (pWorker->jobs.deque(&pJob, boost::posix_time::milliseconds(500)))
+            pJob->run(pWorker->index);
+      }
+
+      // units queued for reparse or disposal when we were stopped are still
+      // ours to dispose
+      while (pWorker->jobs.deque(&pJob))
+      {
+         pJob->abandon();
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void SourceIndex::enqueueParse(const std::string& filename)
+{
+   // compilation args are resolved here, on the owning thread, since the
+   // compilation database isn't safe to call from the workers
+   std::vector<std::string> args;
+   if (compilationDB_.compileArgsForTranslationUnit)
+   {
+      args = compilationDB_.compileArgsForTranslationUnit(filename, true);
+      if (args.empty())
+         return;
+   }
+   if (verbose_ >= 2)
+     args.push_back("-v");
+
+   // supersede any parse of this file which is already queued or running
+   cancelPendingParse(filename);
+
+   if (verbose_ > 0)
+      std::cerr << "CLANG QUEUE INDEX: " << filename << std::endl;
+
+   // spread new units across the workers
+   int worker = static_cast<int>(nextWorker_++ % workers_.size());
+   boost::shared_ptr<ParseJob> pJob(new ParseJob(
+                                       ParseJob::Parse,
+                                       filename,
+                                       args,
+                                       FilePath(filename).lastWriteTime(),
+                                       snapshotUnsavedFiles(unsavedFiles_),
+                                       worker));
+   pendingParses_[filename] = pJob;
+   workers_[worker]->jobs.enque(pJob);
+}
+
+void SourceIndex::enqueueReparse(const std::string& filename)
+{
+   TranslationUnits::iterator it = translationUnits_.find(filename);
+   if (it == translationUnits_.end() || it->second.worker < 0)
+      return;
+
+   if (verbose_ > 0)
+      std::cerr << "CLANG QUEUE REPARSE: " << filename << std::endl;
+
+   // the unit belongs to the job until the reparse is collected
+   StoredTranslationUnit stored = it->second;
+   translationUnits_.erase(it);
+
+   boost::shared_ptr<ParseJob> pJob(new ParseJob(
+                                       ParseJob::Reparse,
+                                       filename,
+                                       stored.compileArgs,
+                                       FilePath(filename).lastWriteTime(),
+                                       snapshotUnsavedFiles(unsavedFiles_),
+                                       stored.worker,
+                                       stored.tu));
+   pendingParses_[filename] = pJob;
+   workers_[stored.worker]->jobs.enque(pJob);
+}
+
+void SourceIndex::collectCompletedParses()
+{
+   for (ParseJobs::iterator it = pendingParses_.begin();
+        it != pendingParses_.end(); )
+   {
+      boost::shared_ptr<ParseJob> pJob = it->second;
+
+      CXTranslationUnit tu = NULL;
+      {
+         boost::lock_guard<boost::mutex> lock(pJob->mutex);
+         if (!pJob->complete)
+         {
+            ++it;
+            continue;
+         }
+         tu = pJob->tu;
+         pJob->tu = NULL;
+      }
+
+      pendingParses_.erase(it++);
+
+      if (tu != NULL)
+      {
+         if (verbose_ > 0)
+            std::cerr << "CLANG INSTALL INDEX: " << pJob->filename << std::endl;
+         storeTranslationUnit(pJob->filename,
+                              pJob->compileArgs,
+                              pJob->lastWriteTime,
+                              tu,
+                              pJob->worker);
+      }
+      else
+      {
+         LOG_ERROR_MESSAGE("Error parsing translation unit " + pJob->filename);
+      }
+   }
+}
+
+bool SourceIndex::awaitPendingParse(const std::string& filename)
+{
+   ParseJobs::iterator it = pendingParses_.find(filename);
+   if (it == pendingParses_.end())
+      return true;
+
+   boost::scoped_ptr<core::PerformanceTimer> pTimer;
+   if (verbose_ > 0)
+      pTimer.reset(new core::PerformanceTimer("CLANG WAIT: " + filename));
+
+   if (!it->second->waitForCompletion(parseTimeout_))
+      return false;
+
+   collectCompletedParses();
+   return true;
+}
+
+void SourceIndex::cancelPendingParse(const std::string& filename)
+{
+   ParseJobs::iterator it = pendingParses_.find(filename);
+   if (it == pendingParses_.end())
+      return;
+
+   boost::shared_ptr<ParseJob> pJob = it->second;
+   pendingParses_.erase(it);
+
+   CXTranslationUnit tu = NULL;
+   {
+      boost::lock_guard<boost::mutex> lock(pJob->mutex);
+      pJob->cancelled = true;
+      tu = pJob->tu;
+      pJob->tu = NULL;
+   }
+
+   // dispose any result which completed but was never collected (results
+   // which complete later are disposed by the worker)
+   if (tu != NULL)
+      disposeTranslationUnit(tu, pJob->worker);
+}
+
+void SourceIndex::cancelAllPendingParses()
+{
+   while (!pendingParses_.empty())
+      cancelPendingParse(pendingParses_.begin()->first);
+}
+
+void SourceIndex::storeTranslationUnit(const std::string& filename,
+                                       const std::vector<std::string>& compileArgs,
+                                       std::time_t lastWriteTime,
+                                       CXTranslationUnit tu,
+                                       int worker)
+{
+   disposeTranslationUnit(filename);
+
+   StoredTranslationUnit stored(compileArgs, lastWriteTime, tu, worker);
+   stored.lastAccess = ++accessCounter_;
+   translationUnits_[filename] = stored;
+
+   enforceMemoryBudget(filename);
+}
+
+void SourceIndex::touchTranslationUnit(const std::string& filename)
+{
+   TranslationUnits::iterator it = translationUnits_.find(filename);
+   if (it != translationUnits_.end())
+      it->second.lastAccess = ++accessCounter_;
+}
+
+void SourceIndex::enforceMemoryBudget(const std::string& keepFilename,
+                                      bool force)
+{
+   if (memoryBudget_ == 0)
+      return;
+
+   // measuring memory usage means asking libclang about every unit, so
+   // only do it every few stores/reparses
+   if (!force && ++updatesSinceMemoryCheck_ < kMemoryCheckInterval)
+      return;
+   updatesSinceMemoryCheck_ = 0;
+
+   std::size_t totalBytes = 0;
+   BOOST_FOREACH(TranslationUnits::value_type& t, translationUnits_)
+   {
+      // reparses change memory usage so refresh it here
+      t.second.memoryBytes = translationUnitMemoryBytes(t.second.tu);
+      totalBytes += t.second.memoryBytes;
+   }
+
+   while (totalBytes > memoryBudget_)
+   {
+      // find the least recently used unit (never the one being returned)
+      TranslationUnits::iterator lru = translationUnits_.end();
+      for (TranslationUnits::iterator it = translationUnits_.begin();
+           it != translationUnits_.end(); ++it)
+      {
+         if (it->first == keepFilename)
+            continue;
+         if (lru == translationUnits_.end() ||
+             it->second.lastAccess < lru->second.lastAccess)
+         {
+            lru = it;
+         }
+      }
+
+      if (lru == translationUnits_.end())
+         break;
+
+      if (verbose_ > 0)
+         std::cerr << "CLANG EVICT INDEX: " << lru->first << std::endl;
+
+      totalBytes -= lru->second.memoryBytes;
+      std::string filename = lru->first;
+      disposeTranslationUnit(filename);
+   }
+}
+
 unsigned SourceIndex::getGlobalOptions() const
 {
    return clang().CXIndex_getGlobalOptions(index_);
@@ -96,26 +585,56 @@ void SourceIndex::setGlobalOptions(unsigned options)
 }
 
 void SourceIndex::removeTranslationUnit(const std::string& filename)
+{
+   cancelPendingParse(filename);
+   disposeTranslationUnit(filename);
+}
+
+void SourceIndex::disposeTranslationUnit(const std::string& filename)
 {
    TranslationUnits::iterator it = translationUnits_.find(filename);
    if (it != translationUnits_.end())
    {
       if (verbose_ > 0)
          std::cerr << "CLANG REMOVE INDEX: " << it->first << std::endl;
-      clang().disposeTranslationUnit(it->second.tu);
+      disposeTranslationUnit(it->second.tu, it->second.worker);
       translationUnits_.erase(it->first);
    }
 }
 
+void SourceIndex::disposeTranslationUnit(CXTranslationUnit tu, int worker)
+{
+   // units parsed by a worker are disposed by it (once the workers have
+   // stopped there's nothing for the disposal to race with)
+   if (worker >= 0 && !stopWorkers_.get())
+   {
+      boost::shared_ptr<ParseJob> pJob(new ParseJob(
+                                          ParseJob::Dispose,
+                                          std::string(),
+                                          std::vector<std::string>(),
+                                          0,
+                                          boost::shared_ptr<UnsavedFiles>(),
+                                          worker,
+                                          tu));
+      workers_[worker]->jobs.enque(pJob);
+   }
+   else
+   {
+      clang().disposeTranslationUnit(tu);
+   }
+}
+
 void SourceIndex::removeAllTranslationUnits()
 {
+   cancelAllPendingParses();
+
    for(TranslationUnits::const_iterator it = translationUnits_.begin();
        it != translationUnits_.end(); ++it)
    {
       if (verbose_ > 0)
          std::cerr << "CLANG REMOVE INDEX: " << it->first << std::endl;
 
-      clang().disposeTranslationUnit(it->second.tu);
+      disposeTranslationUnit(it->second.tu, it->second.worker);
    }
 
    translationUnits_.clear();
@@ -124,22 +643,41 @@ void SourceIndex::removeAllTranslationUnits()
 
 void SourceIndex::primeEditorTranslationUnit(const std::string& filename)
 {
+   collectCompletedParses();
+
    // if we have no record of this translation unit then do a first pass
    if (translationUnits_.find(filename) == translationUnits_.end())
-      getTranslationUnit(filename);
+   {
+      if (workers_.empty())
+         getTranslationUnit(filename);
+      else if (pendingParses_.find(filename) == pendingParses_.end())
+         enqueueParse(filename);
+   }
 }
 
 void SourceIndex::reprimeEditorTranslationUnit(const std::string& filename)
 {
+   collectCompletedParses();
+
    // if we have already indexed this translation unit then re-index it
-   if (translationUnits_.find(filename) != translationUnits_.end())
+   TranslationUnits::iterator it = translationUnits_.find(filename);
+   if (it == translationUnits_.end())
+      return;
+
+   // units parsed by a worker are reparsed by it, in the background, once
+   // they're out of date
+   if (it->second.worker < 0)
       getTranslationUnit(filename);
+   else if (FilePath(filename).lastWriteTime() != it->second.lastWriteTime)
+      enqueueReparse(filename);
 }
 
 
 std::map<std::string,TranslationUnit>
                            SourceIndex::getIndexedTranslationUnits()
 {
+   collectCompletedParses();
+
    std::map<std::string,TranslationUnit> units;
    BOOST_FOREACH(TranslationUnits::value_type& t, translationUnits_)
    {
@@ -154,6 +692,18 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
 {
    FilePath filePath(filename);
 
+   // pick up any background parse results, waiting (for a bounded time)
+   // if this unit is currently being parsed. if the parse doesn't finish in
+   // time, abandon it and parse here instead
+   collectCompletedParses();
+   if (!awaitPendingParse(filename))
+   {
+      if (verbose_ > 0)
+         std::cerr << "CLANG INDEXING: " << filename
+                   << " (Timed out waiting for background parse)" << std::endl;
+      cancelPendingParse(filename);
+   }
+
    boost::scoped_ptr<core::PerformanceTimer> pTimer;
    if (verbose_ > 0)
    {
@@ -187,6 +737,7 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
       {
          if (verbose_ > 0)
             std::cerr << "  (Index already up to date)" << std::endl;
+         touchTranslationUnit(filename);
          return TranslationUnit(filename, stored.tu, &unsavedFiles_);
       }
 
@@ -202,25 +753,49 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
             std::cerr << "  " << reason << std::endl;
          }
 
-         unsigned options = applyTranslationUnitOptions(
-                                    clang().defaultReparseOptions(stored.tu));
-         int ret = clang().reparseTranslationUnit(
-                                stored.tu,
-                                unsavedFiles().numUnsavedFiles(),
-                                unsavedFiles().unsavedFilesArray(),
-                                options);
-
-         if (ret == 0)
+         // units parsed by a worker are reparsed by it; wait (for a bounded
+         // time) for the result and parse here instead if it isn't ready
+         if (stored.worker >= 0)
          {
-            // update last write time
-            stored.lastWriteTime = lastWriteTime;
-
-            // return it
-            return TranslationUnit(filename, stored.tu, &unsavedFiles_);
+            enqueueReparse(filename);
+            if (awaitPendingParse(filename))
+            {
+               it = translationUnits_.find(filename);
+               if (it != translationUnits_.end())
+                  return TranslationUnit(filename, it->second.tu, &unsavedFiles_);
+            }
+            else
+            {
+               if (verbose_ > 0)
+                  std::cerr << "  (Timed out waiting for background reparse)"
+                            << std::endl;
+               cancelPendingParse(filename);
+            }
          }
          else
          {
-            LOG_ERROR_MESSAGE("Error re-parsing translation unit " + filename);
+            unsigned options = applyTranslationUnitOptions(
+                                    clang().defaultReparseOptions(stored.tu));
+            int ret = clang().reparseTranslationUnit(
+                                   stored.tu,
+                                   unsavedFiles().numUnsavedFiles(),
+                                   unsavedFiles().unsavedFilesArray(),
+                                   options);
+
+            if (ret == 0)
+            {
+               // update last write time
+               stored.lastWriteTime = lastWriteTime;
+               touchTranslationUnit(filename);
+               enforceMemoryBudget(filename);
+
+               // return it
+               return TranslationUnit(filename, stored.tu, &unsavedFiles_);
+            }
+            else
+            {
+               LOG_ERROR_MESSAGE("Error re-parsing translation unit " + filename);
+            }
          }
       }
    }
@@ -228,7 +803,7 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
    // if we got this far then there either was no existing translation
    // unit or we require a full rebuild. in all cases remove any existing
    // translation unit we have
-   removeTranslationUnit(filename);
+   disposeTranslationUnit(filename);
 
    // add verbose output if requested
    if (verbose_ >= 2)
@@ -256,9 +831,7 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
    // save and return it if we succeeded
    if (tu != NULL)
    {
-      translationUnits_[filename] = StoredTranslationUnit(args,
-                                                          lastWriteTime,
-                                                          tu);
+      storeTranslationUnit(filename, args, lastWriteTime, tu, -1);
 
       TranslationUnit unit(filename, tu, &unsavedFiles_);
       if (verbose_ > 0)
@@ -0,0 +1,360 @@
+/*
+ * SourceIndexTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/libclang/LibClang.hpp>
+
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace libclang {
+namespace tests {
+
+namespace {
+
+// libclang isn't loaded by the tests, so its entry points are replaced with
+// fakes which record which thread each translation unit is used on
+
+const std::size_t kUnitBytes = 1000;
+
+struct FakeUnit
+{
+   boost::thread::id thread;
+   int reparses;
+};
+
+boost::mutex s_mutex;
+boost::thread::id s_mainThread;
+boost::posix_time::time_duration s_workerParseDelay;
+int s_units = 0;
+int s_wrongThreadUses = 0;
+
+FakeUnit* fakeUnit(CXTranslationUnit tu)
+{
+   return reinterpret_cast<FakeUnit*>(tu);
+}
+
+void useUnit(CXTranslationUnit tu)
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      if (fakeUnit(tu)->thread != boost::this_thread::get_id())
+         s_wrongThreadUses++;
+   }
+   END_LOCK_MUTEX
+}
+
+CXIndex createIndex(int, int)
+{
+   return new int(0);
+}
+
+void disposeIndex(CXIndex index)
+{
+   delete static_cast<int*>(index);
+}
+
+unsigned defaultOptions()
+{
+   return 0;
+}
+
+unsigned defaultReparseOptions(CXTranslationUnit)
+{
+   return 0;
+}
+
+CXTranslationUnit parseTranslationUnit(CXIndex,
+                                       const char*,
+                                       const char* const*,
+                                       int,
+                                       struct CXUnsavedFile*,
+                                       unsigned,
+                                       unsigned)
+{
+   if (boost::this_thread::get_id() != s_mainThread)
+      boost::this_thread::sleep(s_workerParseDelay);
+
+   FakeUnit* pUnit = new FakeUnit();
+   pUnit->thread = boost::this_thread::get_id();
+   pUnit->reparses = 0;
+
+   LOCK_MUTEX(s_mutex)
+   {
+      s_units++;
+   }
+   END_LOCK_MUTEX
+
+   return reinterpret_cast<CXTranslationUnit>(pUnit);
+}
+
+int reparseTranslationUnit(CXTranslationUnit tu,
+                           unsigned,
+                           struct CXUnsavedFile*,
+                           unsigned)
+{
+   useUnit(tu);
+   fakeUnit(tu)->reparses++;
+   return 0;
+}
+
+void disposeTranslationUnit(CXTranslationUnit tu)
+{
+   useUnit(tu);
+   delete fakeUnit(tu);
+
+   LOCK_MUTEX(s_mutex)
+   {
+      s_units--;
+   }
+   END_LOCK_MUTEX
+}
+
+CXTUResourceUsage getCXTUResourceUsage(CXTranslationUnit)
+{
+   CXTUResourceUsage usage;
+   usage.data = NULL;
+   usage.numEntries = 1;
+   usage.entries = new CXTUResourceUsageEntry[1];
+   usage.entries[0].kind = CXTUResourceUsage_AST;
+   usage.entries[0].amount = kUnitBytes;
+   return usage;
+}
+
+void disposeCXTUResourceUsage(CXTUResourceUsage usage)
+{
+   delete [] usage.entries;
+}
+
+void installFakeLibClang()
+{
+   s_mainThread = boost::this_thread::get_id();
+   s_workerParseDelay = boost::posix_time::milliseconds(0);
+   s_wrongThreadUses = 0;
+
+   clang().createIndex = createIndex;
+   clang().disposeIndex = disposeIndex;
+   clang().defaultEditingTranslationUnitOptions = defaultOptions;
+   clang().defaultReparseOptions = defaultReparseOptions;
+   clang().parseTranslationUnit = parseTranslationUnit;
+   clang().reparseTranslationUnit = reparseTranslationUnit;
+   clang().disposeTranslationUnit = disposeTranslationUnit;
+   clang().getCXTUResourceUsage = getCXTUResourceUsage;
+   clang().disposeCXTUResourceUsage = disposeCXTUResourceUsage;
+}
+
+class TempSourceDir
+{
+public:
+   TempSourceDir()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempSourceDir()
+   {
+      dir_.removeIfExists();
+   }
+
+   std::string file(const std::string& name) const
+   {
+      FilePath filePath = dir_.complete(name);
+      if (!filePath.exists())
+         writeStringToFile(filePath, "int " + filePath.stem() + ";\n");
+      return filePath.absolutePath();
+   }
+
+private:
+   FilePath dir_;
+};
+
+FakeUnit* unitFor(SourceIndex* pIndex, const std::string& filename)
+{
+   TranslationUnit unit = pIndex->getTranslationUnit(filename);
+   REQUIRE_FALSE(unit.empty());
+   return fakeUnit(unit.getCXTranslationUnit());
+}
+
+std::set<std::string> indexedFiles(SourceIndex* pIndex)
+{
+   std::set<std::string> files;
+   typedef std::map<std::string,TranslationUnit>::value_type Unit;
+   BOOST_FOREACH(const Unit& unit, pIndex->getIndexedTranslationUnits())
+   {
+      files.insert(unit.first);
+   }
+   return files;
+}
+
+int liveUnits()
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      return s_units;
+   }
+   END_LOCK_MUTEX
+   return 0;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Source Index")
+{
+   installFakeLibClang();
+   TempSourceDir dir;
+
+   SECTION("Units are parsed, reparsed and disposed by their worker")
+   {
+      {
+         SourceIndex index;
+         index.startWorkers(2);
+
+         std::vector<std::string> files;
+         for (int i = 0; i < 4; i++)
+         {
+            files.push_back(dir.file("unit" + std::string(1, 'a' + i) + ".cpp"));
+            index.primeEditorTranslationUnit(files.back());
+         }
+
+         std::set<boost::thread::id> threads;
+         BOOST_FOREACH(const std::string& file, files)
+         {
+            FakeUnit* pUnit = unitFor(&index, file);
+            CHECK(pUnit->thread != s_mainThread);
+            threads.insert(pUnit->thread);
+         }
+         CHECK(threads.size() == 2);
+
+         // a changed file is reparsed in the background by its worker
+         FilePath(files[0]).setLastWriteTime(::time(NULL) + 10);
+         index.reprimeEditorTranslationUnit(files[0]);
+         FakeUnit* pUnit = unitFor(&index, files[0]);
+         CHECK(pUnit->reparses == 1);
+
+         // as is a unit which is reparsed on request
+         pUnit = unitFor(&index, files[1]);
+         TranslationUnit unit = index.getTranslationUnit(files[1], true);
+         CHECK(fakeUnit(unit.getCXTranslationUnit()) == pUnit);
+         CHECK(pUnit->reparses == 1);
+
+         index.removeTranslationUnit(files[2]);
+         CHECK(indexedFiles(&index).size() == 3);
+      }
+
+      CHECK(liveUnits() == 0);
+      CHECK(s_wrongThreadUses == 0);
+   }
+
+   SECTION("Units are parsed on the calling thread without workers")
+   {
+      {
+         SourceIndex index;
+         std::string file = dir.file("unit.cpp");
+         index.primeEditorTranslationUnit(file);
+         CHECK(indexedFiles(&index).count(file) == 1);
+
+         FakeUnit* pUnit = unitFor(&index, file);
+         CHECK(pUnit->thread == s_mainThread);
+
+         FilePath(file).setLastWriteTime(::time(NULL) + 10);
+         index.reprimeEditorTranslationUnit(file);
+         CHECK(pUnit->reparses == 1);
+      }
+
+      CHECK(liveUnits() == 0);
+      CHECK(s_wrongThreadUses == 0);
+   }
+
+   SECTION("Slow background parses are abandoned after the timeout")
+   {
+      {
+         SourceIndex index;
+         index.startWorkers(1);
+         index.setParseTimeout(boost::posix_time::milliseconds(50));
+         s_workerParseDelay = boost::posix_time::milliseconds(500);
+
+         std::string file = dir.file("unit.cpp");
+         index.primeEditorTranslationUnit(file);
+
+         boost::posix_time::ptime start = boost::get_system_time();
+         FakeUnit* pUnit = unitFor(&index, file);
+         CHECK(boost::get_system_time() - start <
+               boost::posix_time::milliseconds(400));
+         CHECK(pUnit->thread == s_mainThread);
+
+         // the unit parsed here is kept (the background result is discarded)
+         boost::this_thread::sleep(boost::posix_time::milliseconds(600));
+         CHECK(unitFor(&index, file) == pUnit);
+         CHECK(liveUnits() == 1);
+      }
+
+      CHECK(liveUnits() == 0);
+      CHECK(s_wrongThreadUses == 0);
+   }
+
+   SECTION("The least recently used units are evicted over the budget")
+   {
+      {
+         SourceIndex index;
+         std::string a = dir.file("a.cpp");
+         std::string b = dir.file("b.cpp");
+         std::string c = dir.file("c.cpp");
+         unitFor(&index, a);
+         unitFor(&index, b);
+         unitFor(&index, c);
+         unitFor(&index, a);
+
+         index.setMemoryBudget(2 * kUnitBytes + kUnitBytes / 2);
+         std::set<std::string> expected;
+         expected.insert(a);
+         expected.insert(c);
+         CHECK(indexedFiles(&index) == expected);
+
+         // the budget is checked every few units, keeping the most recently
+         // used ones
+         std::string last;
+         std::string previous;
+         for (int i = 0; i < 8; i++)
+         {
+            previous = last;
+            last = dir.file("unit" + std::string(1, 'a' + i) + ".cpp");
+            unitFor(&index, last);
+         }
+         expected.clear();
+         expected.insert(previous);
+         expected.insert(last);
+         CHECK(indexedFiles(&index) == expected);
+         CHECK(liveUnits() == 2);
+      }
+
+      CHECK(liveUnits() == 0);
+   }
+}
+
+} // namespace tests
+} // namespace libclang
+} // namespace core
+} // namespace rstudio
@@ -48,6 +48,24 @@ std::string formatBytes(double value)
    }
 }
 
+void collectInclusion(CXFile includedFile,
+                      CXSourceLocation* pInclusionStack,
+                      unsigned includeLength,
+                      CXClientData clientData)
+{
+   // (the main file has no inclusion stack, and we skip the files which
+   // system headers include)
+   if (includeLength == 0 ||
+       clang().Location_isInSystemHeader(pInclusionStack[0]))
+   {
+      return;
+   }
+
+   std::vector<std::string>* pFiles =
+                     static_cast<std::vector<std::string>*>(clientData);
+   pFiles->push_back(toStdString(clang().getFileName(includedFile)));
+}
+
 } // anonymous namespace
 
 std::string TranslationUnit::getSpelling() const
@@ -60,6 +78,13 @@ bool TranslationUnit::includesFile(const std::string& filename) const
    return clang().getFile(tu_, filename.c_str()) != NULL;
 }
 
+std::vector<std::string> TranslationUnit::getIncludedFiles() const
+{
+   std::vector<std::string> files;
+   clang().getInclusions(tu_, collectInclusion, &files);
+   return files;
+}
+
 CXFile TranslationUnit::getFile(const std::string& filename) const
 {
    std::string targetFile = filename;
@@ -15,12 +15,22 @@
 
 #include <core/r_util/RActiveSessions.hpp>
 
+#ifdef __APPLE__
+#include <sys/param.h>
+#include <sys/mount.h>
+#include <cstring>
+#elif !defined(_WIN32)
+#include <sys/vfs.h>
+#endif
+
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <core/FileLock.hpp>
 #include <core/StringUtils.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
 
 #include <core/system/System.hpp>
 #include <core/system/FileMonitor.hpp>
@@ -35,6 +45,55 @@ namespace r_util {
 
 namespace {
 
+// directory which held one file per property
+const char * const kLegacyPropertiesDir = "properites";
+
+// attempts to take the lock on a session's properties before writing without it
+const int kPropertiesLockAttempts = 20;
+
+// file locks are held by a process (not a thread), so writers within a
+// process are serialized by this mutex
+boost::mutex s_propertiesMutex;
+
+// locks a session's properties (until the returned lock is destroyed). the
+// lock is waited for briefly while another process writes; if it still can't
+// be taken the properties are written without it, rather than not at all
+boost::shared_ptr<ScopedFileLock> lockProperties(const FilePath& lockFilePath)
+{
+   boost::shared_ptr<ScopedFileLock> pLock;
+   for (int attempt = 1; ; attempt++)
+   {
+      pLock.reset(new ScopedFileLock(FileLock::createDefault(), lockFilePath));
+      if (!pLock->error() || attempt == kPropertiesLockAttempts)
+         break;
+      boost::this_thread::sleep(boost::posix_time::milliseconds(25));
+   }
+
+   if (pLock->error())
+      LOG_ERROR(pLock->error());
+   return pLock;
+}
+
+bool isOnNfs(const FilePath& path)
+{
+#ifdef _WIN32
+   return false;
+#else
+   struct statfs info;
+   if (::statfs(path.absolutePath().c_str(), &info) == -1)
+   {
+      // (assume the worst; reading the file each time is always correct)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      return true;
+   }
+#ifdef __APPLE__
+   return std::strcmp(info.f_fstypename, "nfs") == 0;
+#else
+   // (NFS_SUPER_MAGIC)
+   return info.f_type == 0x6969;
+#endif
+#endif
+}
 
 } // anonymous namespace
 
@@ -42,30 +101,140 @@ namespace {
 void ActiveSession::writeProperty(const std::string& name,
                                  const std::string& value) const
 {
-   FilePath propertyFile = propertiesPath_.childPath(name);
-   Error error = core::writeStringToFile(propertyFile, value);
-   if (error)
-      LOG_ERROR(error);
+   ActiveSessionProperties properties;
+   properties[name] = value;
+   writeProperties(properties);
 }
 
 std::string ActiveSession::readProperty(const std::string& name) const
 {
-   using namespace rstudio::core;
-   FilePath readPath = propertiesPath_.childPath(name);
-   if (readPath.exists())
+   const ActiveSessionProperties& properties = readProperties();
+   ActiveSessionProperties::const_iterator it = properties.find(name);
+   if (it != properties.end())
+      return it->second;
+   else
+      return std::string();
+}
+
+void ActiveSession::writeProperties(
+                        const ActiveSessionProperties& properties) const
+{
+   LOCK_MUTEX(s_propertiesMutex)
+   {
+      // hold the lock from reading the current properties until the updated
+      // file is in place, so a concurrent write (perhaps by another process)
+      // isn't lost
+      boost::shared_ptr<ScopedFileLock> pLock =
+                                          lockProperties(propertiesLockPath_);
+
+      // (read the file itself; the cache may not show a write made in the
+      // same second)
+      ActiveSessionProperties updated;
+      if (propertiesPath_.exists())
+      {
+         Error error = core::readStringMapFromFile(propertiesPath_, &updated);
+         if (error && error.code() != boost::system::errc::no_such_file_or_directory)
+            LOG_ERROR(error);
+      }
+
+      for (ActiveSessionProperties::const_iterator it = properties.begin();
+           it != properties.end(); ++it)
+      {
+         updated[it->first] = it->second;
+      }
+
+      // write to a temporary file and move it into place, so that readers
+      // (which may be other sessions listing this one) never see a partially
+      // written file
+      FilePath tempPath(propertiesPath_.absolutePath() + ".tmp-" +
+                  safe_convert::numberToString(core::system::currentProcessId()));
+      Error error = core::writeStringMapToFile(tempPath, updated);
+      if (!error)
+         error = tempPath.move(propertiesPath_, FilePath::MoveDirect);
+      if (error)
+      {
+         LOG_ERROR(error);
+         tempPath.removeIfExists();
+         return;
+      }
+
+      propertiesReadTime_ = std::time(NULL);
+      propertiesWriteTime_ = propertiesPath_.lastWriteTime();
+      properties_ = updated;
+   }
+   END_LOCK_MUTEX
+}
+
+const ActiveSessionProperties& ActiveSession::readProperties() const
+{
+   // the cached properties are current if the file hasn't been written
+   // since they were read. write times only have a resolution of a second,
+   // so a write in the same second as the read can't be detected; we don't
+   // use the cache until a later second
+   std::time_t now = std::time(NULL);
+   std::time_t writeTime = propertiesPath_.lastWriteTime();
+   if (cacheProperties_ &&
+       writeTime != 0 &&
+       writeTime == propertiesWriteTime_ &&
+       writeTime < propertiesReadTime_)
+   {
+      return properties_;
+   }
+
+   properties_.clear();
+   propertiesReadTime_ = now;
+   propertiesWriteTime_ = writeTime;
+   if (writeTime == 0)
+      return properties_;
+
+   Error error = core::readStringMapFromFile(propertiesPath_, &properties_);
+   if (error && error.code() != boost::system::errc::no_such_file_or_directory)
+      LOG_ERROR(error);
+
+   return properties_;
+}
+
+bool ActiveSession::canCacheProperties() const
+{
+   return !isOnNfs(scratchPath_);
+}
+
+void ActiveSession::migrateProperties()
+{
+   if (propertiesPath_.exists())
+      return;
+
+   FilePath legacyPath = scratchPath_.childPath(kLegacyPropertiesDir);
+   if (!legacyPath.exists())
+      return;
+
+   std::vector<FilePath> propertyFiles;
+   Error error = legacyPath.children(&propertyFiles);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   ActiveSessionProperties properties;
+   BOOST_FOREACH(const FilePath& propertyFile, propertyFiles)
    {
       std::string value;
-      Error error = core::readStringFromFile(readPath, &value);
+      error = core::readStringFromFile(propertyFile, &value);
       if (error)
       {
          LOG_ERROR(error);
-         return std::string();
+         return;
       }
-      return boost::algorithm::trim_copy(value);
+      properties[propertyFile.filename()] = boost::algorithm::trim_copy(value);
    }
-   else
+
+   writeProperties(properties);
+   if (propertiesPath_.exists())
    {
-      return std::string();
+      error = legacyPath.remove();
+      if (error)
+         LOG_ERROR(error);
    }
 }
 
@@ -92,11 +261,13 @@ Error ActiveSessions::create(const std::string& project,
 
    // write initial settings
    ActiveSession activeSession(id, dir);
-   activeSession.setProject(project);
-   activeSession.setWorkingDir(workingDir);
-   activeSession.setInitial(initial);
-   activeSession.setLastUsed();
-   activeSession.setRunning(false);
+   ActiveSessionProperties properties;
+   properties["project"] = project;
+   properties["working-dir"] = workingDir;
+   properties["initial"] = safe_convert::numberToString(initial);
+   properties["last-used"] = ActiveSession::lastUsedNow();
+   properties["running"] = safe_convert::numberToString(false);
+   activeSession.writeProperties(properties);
 
    // return the id
    *pId = id;
@@ -105,30 +276,48 @@ Error ActiveSessions::create(const std::string& project,
 
 namespace {
 
-bool compareActivityLevel(boost::shared_ptr<ActiveSession> a,
-                          boost::shared_ptr<ActiveSession> b)
+// activity level of a session (read once so that sorting doesn't re-read
+// the session's properties)
+struct ActivityLevel
+{
+   explicit ActivityLevel(boost::shared_ptr<ActiveSession> pSession)
+      : pSession(pSession)
+   {
+      ActiveSessionProperties properties = pSession->properties();
+      executing = safe_convert::stringTo<bool>(properties["executing"], false);
+      running = safe_convert::stringTo<bool>(properties["running"], false);
+      lastUsed = safe_convert::stringTo<double>(properties["last-used"], 0);
+   }
+
+   boost::shared_ptr<ActiveSession> pSession;
+   bool executing;
+   bool running;
+   double lastUsed;
+};
+
+bool compareActivityLevel(const ActivityLevel& a, const ActivityLevel& b)
 {
-   if (a->executing() == b->executing())
+   if (a.executing == b.executing)
    {
-      if (a->running() == b->running())
+      if (a.running == b.running)
       {
-         if (a->lastUsed() == b->lastUsed())
+         if (a.lastUsed == b.lastUsed)
          {
-            return a->id() > b->id();
+            return a.pSession->id() > b.pSession->id();
          }
          else
          {
-            return a->lastUsed() > b->lastUsed();
+            return a.lastUsed > b.lastUsed;
          }
       }
       else
       {
-         return a->running();
+         return a.running;
       }
    }
    else
    {
-      return a->executing();
+      return a.executing;
    }
 }
 
@@ -140,6 +329,7 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
 {
    // list to return
    std::vector<boost::shared_ptr<ActiveSession> > sessions;
+   std::vector<ActivityLevel> activityLevels;
 
    // enumerate children and check for sessions
    std::vector<FilePath> children;
@@ -160,7 +350,7 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
          {
             if (pSession->validate(userHomePath, projectSharingEnabled))
             {
-               sessions.push_back(pSession);
+               activityLevels.push_back(ActivityLevel(pSession));
             }
             else
             {
@@ -178,7 +368,11 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
    }
 
    // sort by activity level (most active sessions first)
-   std::sort(sessions.begin(), sessions.end(), compareActivityLevel);
+   std::sort(activityLevels.begin(), activityLevels.end(), compareActivityLevel);
+   BOOST_FOREACH(const ActivityLevel& activityLevel, activityLevels)
+   {
+      sessions.push_back(activityLevel.pSession);
+   }
 
    // return
    return sessions;
@@ -201,6 +395,33 @@ boost::shared_ptr<ActiveSession> ActiveSessions::get(const std::string& id) cons
 }
 
 
+std::map<std::string, ActiveSessionProperties>
+ActiveSessions::listProperties() const
+{
+   std::map<std::string, ActiveSessionProperties> properties;
+
+   std::vector<FilePath> children;
+   Error error = storagePath_.children(&children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return properties;
+   }
+
+   std::string prefix = kSessionDirPrefix;
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      if (boost::algorithm::starts_with(child.filename(), prefix))
+      {
+         std::string id = child.filename().substr(prefix.length());
+         ActiveSession session(id, child);
+         properties[id] = session.properties();
+      }
+   }
+
+   return properties;
+}
+
 boost::shared_ptr<ActiveSession> ActiveSessions::emptySession(
       const std::string& id)
 {
@@ -0,0 +1,136 @@
+/*
+ * RActiveSessionsTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <core/FileSerializer.hpp>
+#include <core/r_util/RActiveSessions.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+using namespace core::r_util;
+
+context("Active Sessions")
+{
+   FilePath storagePath;
+   REQUIRE(!FilePath::tempFilePath(&storagePath));
+   ActiveSessions sessions(storagePath);
+
+   test_that("Session properties are stored together")
+   {
+      std::string id;
+      REQUIRE(!sessions.create("~/project", "~/project", &id));
+
+      boost::shared_ptr<ActiveSession> pSession = sessions.get(id);
+      expect_false(pSession->empty());
+      expect_true(pSession->project() == "~/project");
+      expect_true(pSession->workingDir() == "~/project");
+      expect_true(pSession->initial());
+      expect_true(pSession->lastUsed() > 0);
+
+      pSession->setLabel("label");
+      expect_true(sessions.get(id)->label() == "label");
+
+      std::map<std::string, ActiveSessionProperties> properties =
+                                                   sessions.listProperties();
+      expect_true(properties.size() == 1);
+      expect_true(properties[id]["label"] == "label");
+      expect_true(properties[id]["working-dir"] == "~/project");
+   }
+
+   test_that("Properties written by another process are read")
+   {
+      std::string id;
+      REQUIRE(!sessions.create("~/project", "~/project", &id));
+
+      boost::shared_ptr<ActiveSession> pSession = sessions.get(id);
+      expect_true(pSession->label().empty());
+
+      sessions.get(id)->setLabel("label");
+      expect_true(pSession->label() == "label");
+   }
+
+   test_that("Properties are migrated from the file per property layout")
+   {
+      FilePath sessionPath = sessions.storagePath().childPath("session-legacy");
+      FilePath legacyPath = sessionPath.childPath("properites");
+      REQUIRE(!legacyPath.ensureDirectory());
+      REQUIRE(!writeStringToFile(legacyPath.childPath("project"), "none\n"));
+      REQUIRE(!writeStringToFile(legacyPath.childPath("running"), "1"));
+
+      boost::shared_ptr<ActiveSession> pSession = sessions.get("legacy");
+      expect_true(pSession->project() == "none");
+      expect_true(pSession->running());
+      expect_false(legacyPath.exists());
+   }
+
+#ifndef _WIN32
+   test_that("Concurrent writes by other processes aren't lost")
+   {
+      std::string id;
+      REQUIRE(!sessions.create("~/project", "~/project", &id));
+
+      // each process repeatedly updates a different property
+      const int kWrites = 50;
+      std::vector<pid_t> children;
+      for (int child = 0; child < 2; child++)
+      {
+         pid_t pid = ::fork();
+         REQUIRE(pid != -1);
+         if (pid == 0)
+         {
+            ActiveSessions childSessions(storagePath);
+            boost::shared_ptr<ActiveSession> pSession = childSessions.get(id);
+            for (int i = 1; i <= kWrites; i++)
+            {
+               std::string value = safe_convert::numberToString(i);
+               if (child == 0)
+                  pSession->setLabel("label-" + value);
+               else
+                  pSession->setWorkingDir("dir-" + value);
+            }
+            ::_exit(0);
+         }
+         children.push_back(pid);
+      }
+
+      for (std::size_t i = 0; i < children.size(); i++)
+      {
+         int status = 0;
+         REQUIRE(::waitpid(children[i], &status, 0) == children[i]);
+         expect_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      }
+
+      ActiveSessionProperties properties = sessions.get(id)->properties();
+      expect_true(properties["label"] == "label-50");
+      expect_true(properties["working-dir"] == "dir-50");
+      expect_true(properties["project"] == "~/project");
+   }
+#endif
+
+   storagePath.removeIfExists();
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
@@ -27,6 +27,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/functional/hash.hpp>
 
 namespace rstudio {
 namespace core {
@@ -42,6 +43,144 @@ RSourceIndex::ImportFromMap RSourceIndex::s_importFromDirectives_;
 std::map<std::string, PackageInformation> RSourceIndex::s_packageInformation_;
 FunctionInformation RSourceIndex::s_noSuchFunction_;
 
+RSourceStringPool& RSourceStringPool::instance()
+{
+   static RSourceStringPool* pInstance = new RSourceStringPool();
+   return *pInstance;
+}
+
+namespace {
+
+// don't bother compacting the string pool arena below this size
+const std::size_t kMinCompactBytes = 64 * 1024;
+
+} // anonymous namespace
+
+RSourceStringPool::RSourceStringPool()
+   : releasedBytes_(0)
+{
+   // reserve id 0 for the empty string
+   Entry entry = { 0, 0, 1, boost::hash<std::string>()(std::string()) };
+   entries_.push_back(entry);
+}
+
+RSourceStringPool::Id RSourceStringPool::find(const std::string& value) const
+{
+   std::size_t hash = boost::hash<std::string>()(value);
+   typedef boost::unordered_multimap<std::size_t, Id>::const_iterator Iterator;
+   std::pair<Iterator, Iterator> range = ids_.equal_range(hash);
+   for (Iterator it = range.first; it != range.second; ++it)
+   {
+      Range candidate = this->range(it->second);
+      if (candidate.size() == static_cast<std::ptrdiff_t>(value.size()) &&
+          std::equal(candidate.begin(), candidate.end(), value.begin()))
+      {
+         return it->second;
+      }
+   }
+   return kEmptyId;
+}
+
+RSourceStringPool::Id RSourceStringPool::intern(const std::string& value)
+{
+   if (value.empty())
+      return kEmptyId;
+
+   Id id = find(value);
+   if (id != kEmptyId)
+   {
+      entries_[id].refCount++;
+      return id;
+   }
+
+   Entry entry;
+   entry.offset = static_cast<uint32_t>(arena_.size());
+   entry.length = static_cast<uint32_t>(value.size());
+   entry.refCount = 1;
+   entry.hash = boost::hash<std::string>()(value);
+
+   std::string lower = string_utils::toLower(value);
+   arena_.insert(arena_.end(), value.begin(), value.end());
+   arena_.insert(arena_.end(), lower.begin(), lower.end());
+
+   if (freeIds_.empty())
+   {
+      id = static_cast<Id>(entries_.size());
+      entries_.push_back(entry);
+   }
+   else
+   {
+      id = freeIds_.back();
+      freeIds_.pop_back();
+      entries_[id] = entry;
+   }
+
+   ids_.insert(std::make_pair(entry.hash, id));
+   return id;
+}
+
+void RSourceStringPool::retain(Id id)
+{
+   if (id != kEmptyId)
+      entries_[id].refCount++;
+}
+
+void RSourceStringPool::release(Id id)
+{
+   if (id == kEmptyId)
+      return;
+
+   Entry& entry = entries_[id];
+   if (--entry.refCount > 0)
+      return;
+
+   typedef boost::unordered_multimap<std::size_t, Id>::iterator Iterator;
+   std::pair<Iterator, Iterator> range = ids_.equal_range(entry.hash);
+   for (Iterator it = range.first; it != range.second; ++it)
+   {
+      if (it->second == id)
+      {
+         ids_.erase(it);
+         break;
+      }
+   }
+
+   releasedBytes_ += entry.length * 2;
+   entry.length = 0;
+   freeIds_.push_back(id);
+
+   if (releasedBytes_ >= kMinCompactBytes &&
+       releasedBytes_ * 2 >= arena_.size())
+   {
+      compact();
+   }
+}
+
+void RSourceStringPool::compact()
+{
+   std::vector<char> arena;
+   arena.reserve(arena_.size() - releasedBytes_);
+   for (std::vector<Entry>::iterator it = entries_.begin();
+        it != entries_.end();
+        ++it)
+   {
+      if (it->refCount == 0)
+      {
+         it->offset = 0;
+         continue;
+      }
+
+      uint32_t offset = static_cast<uint32_t>(arena.size());
+      arena.insert(arena.end(),
+                   arena_.begin() + it->offset,
+                   arena_.begin() + it->offset + it->length * 2);
+      it->offset = offset;
+   }
+
+   arena_.swap(arena);
+   releasedBytes_ = 0;
+}
+
 namespace {
 
 bool isValidRPackageName(const std::string& pkgName)
@@ -0,0 +1,141 @@
+/*
+ * RSourceIndexTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// NOTE: included before TestThat.hpp, whose 'context' macro would otherwise
+// collide with RSourceItem::context
+#include <core/r_util/RSourceIndex.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+using namespace core::r_util;
+
+context("RSourceIndex")
+{
+   test_that("Interned strings can be looked up")
+   {
+      RSourceStringPool& pool = RSourceStringPool::instance();
+      RSourceStringPool::Id id = pool.intern("~/project/R/utils.R");
+
+      expect_true(id != RSourceStringPool::kEmptyId);
+      expect_true(pool.find("~/project/R/utils.R") == id);
+      expect_true(pool.find("~/project/R/other.R") == RSourceStringPool::kEmptyId);
+      expect_true(pool.string(id) == "~/project/R/utils.R");
+      expect_true(std::string(pool.lowerRange(id).begin(),
+                              pool.lowerRange(id).end()) == "~/project/r/utils.r");
+      expect_true(pool.string(RSourceStringPool::kEmptyId).empty());
+
+      pool.release(id);
+   }
+
+   test_that("Interned strings are released with their last reference")
+   {
+      RSourceStringPool& pool = RSourceStringPool::instance();
+      std::size_t size = pool.size();
+
+      RSourceStringPool::Id first = pool.intern("fooBar");
+      RSourceStringPool::Id second = pool.intern("fooBar");
+      expect_true(first == second);
+      expect_true(pool.size() == size + 1);
+
+      pool.release(first);
+      expect_true(pool.find("fooBar") == first);
+
+      pool.release(second);
+      expect_true(pool.find("fooBar") == RSourceStringPool::kEmptyId);
+      expect_true(pool.size() == size);
+   }
+
+   test_that("Source string handles hold references")
+   {
+      RSourceStringPool& pool = RSourceStringPool::instance();
+      std::size_t size = pool.size();
+      {
+         RSourceString name("quux");
+         RSourceString copy = name;
+         {
+            RSourceString other("other");
+            other = copy;
+            expect_true(pool.find("other") == RSourceStringPool::kEmptyId);
+         }
+         expect_true(copy.str() == "quux");
+         expect_true(pool.size() == size + 1);
+      }
+      expect_true(pool.size() == size);
+   }
+
+   test_that("Strings are released when their index is destroyed")
+   {
+      RSourceStringPool& pool = RSourceStringPool::instance();
+      std::size_t size = pool.size();
+      {
+         RSourceIndex index("indexed.R", "indexedFunction <- function() {}\n");
+         expect_true(pool.find("indexedFunction") != RSourceStringPool::kEmptyId);
+      }
+      expect_true(pool.find("indexedFunction") == RSourceStringPool::kEmptyId);
+      expect_true(pool.find("indexed.R") == RSourceStringPool::kEmptyId);
+      expect_true(pool.size() == size);
+   }
+
+   test_that("The arena is compacted as strings are released")
+   {
+      RSourceStringPool& pool = RSourceStringPool::instance();
+      RSourceString kept("keptName");
+
+      std::vector<RSourceStringPool::Id> ids;
+      for (int i = 0; i < 10000; i++)
+         ids.push_back(pool.intern("name" + safe_convert::numberToString(i)));
+      std::size_t arenaSize = pool.arenaSize();
+
+      BOOST_FOREACH(RSourceStringPool::Id id, ids)
+      {
+         pool.release(id);
+      }
+
+      expect_true(pool.arenaSize() < arenaSize / 2);
+      expect_true(kept.str() == "keptName");
+      expect_true(pool.find("keptName") == kept.id());
+      expect_true(pool.find("name1") == RSourceStringPool::kEmptyId);
+   }
+
+   test_that("Indexed items can be searched by interned name")
+   {
+      RSourceIndex index("utils.R", "fooBar <- function() {}\nfooBaz <- 1\n");
+      expect_true(index.items().size() == 2);
+
+      std::vector<RSourceItem> items;
+      index.search("foob", "other.R", true, false, std::back_inserter(items));
+      expect_true(items.size() == 2);
+      expect_true(items[0].name() == "fooBar");
+      expect_true(items[0].isFunction());
+      expect_true(items[1].isVariable());
+
+      items.clear();
+      index.search("fbz", "utils.R", false, false, std::back_inserter(items));
+      expect_true(items.size() == 1);
+      expect_true(items[0].name() == "fooBaz");
+
+      items.clear();
+      index.search("foob", "utils.R", true, true, std::back_inserter(items));
+      expect_true(items.empty());
+   }
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
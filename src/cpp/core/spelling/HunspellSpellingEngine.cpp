@@ -15,13 +15,22 @@
 
 #include <core/spelling/HunspellSpellingEngine.hpp>
 
+#include <list>
+#include <deque>
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
 #include <core/StringUtils.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Macros.hpp>
+#include <core/Thread.hpp>
 
 #include <core/spelling/HunspellDictionaryManager.hpp>
 
@@ -112,6 +121,8 @@ class SpellChecker : boost::noncopyable
 public:
    virtual ~SpellChecker() {}
    virtual Error checkSpelling(const std::string& word, bool *pCorrect) = 0;
+   virtual Error checkSpelling(const std::vector<std::string>& words,
+                               std::vector<bool>* pCorrect) = 0;
    virtual Error suggestionList(const std::string& word,
                                 std::vector<std::string>* pSugs) = 0;
    virtual Error wordChars(std::wstring* pWordChars) = 0;
@@ -126,6 +137,13 @@ public:
       return Success();
    }
 
+   Error checkSpelling(const std::vector<std::string>& words,
+                       std::vector<bool>* pCorrect)
+   {
+      pCorrect->assign(words.size(), true);
+      return Success();
+   }
+
    Error suggestionList(const std::string& word,
                         std::vector<std::string>* pSugs)
    {
@@ -138,6 +156,412 @@ public:
    }
 };
 
+// Hunspell instances share a reference counted unicode table which is
+// created and freed without synchronization, so instances must not be
+// created or destroyed (or have dictionaries added) concurrently
+boost::mutex s_hunspellMutex;
+
+void destroyHunspell(Hunspell* pHunspell)
+{
+   LOCK_MUTEX(s_hunspellMutex)
+   {
+      delete pHunspell;
+   }
+   END_LOCK_MUTEX
+}
+
+// words checked at once below which we don't bother with the workers
+const std::size_t kMinParallelWords = 64;
+
+// maximum number of checked words to remember per dictionary
+const std::size_t kMaxCachedWords = 20000;
+
+// maximum number of suggestion lists computed ahead of being requested
+const std::size_t kMaxPrecomputedSuggestions = 500;
+
+// a word (in dictionary encoding) to be added to a Hunspell instance, along
+// with an example word whose affixes it should share (if any)
+struct DictionaryWord
+{
+   DictionaryWord(const std::string& word, const std::string& example)
+      : word(word), example(example)
+   {
+   }
+   std::string word;
+   std::string example;
+};
+
+// everything needed to load an identical Hunspell instance on another
+// thread. all strings are already in the system / dictionary encoding
+// since the iconv function we are given can only be called on the main
+// thread
+struct HunspellSource
+{
+   std::string affPath;
+   std::string dicPath;
+   std::vector<DictionaryWord> words;
+   std::vector<std::pair<std::string, std::string> > dictionaries;
+
+   boost::shared_ptr<Hunspell> load() const
+   {
+      boost::shared_ptr<Hunspell> pHunspell;
+      LOCK_MUTEX(s_hunspellMutex)
+      {
+         pHunspell.reset(new Hunspell(affPath.c_str(), dicPath.c_str()),
+                         destroyHunspell);
+         typedef std::pair<std::string, std::string> Dictionary;
+         BOOST_FOREACH(const Dictionary& dict, dictionaries)
+         {
+            pHunspell->add_dic(dict.first.c_str(), dict.second.c_str());
+         }
+      }
+      END_LOCK_MUTEX
+
+      BOOST_FOREACH(const DictionaryWord& word, words)
+      {
+         if (word.example.empty())
+            pHunspell->add(word.word.c_str());
+         else
+            pHunspell->add_with_affix(word.word.c_str(), word.example.c_str());
+      }
+
+      return pHunspell;
+   }
+};
+
+void copyAndFreeHunspellVector(Hunspell* pHunspell,
+                               std::vector<std::string>* pVec,
+                               char **wlst,
+                               int len)
+{
+   for (int i=0; i < len; i++)
+   {
+      pVec->push_back(wlst[i]);
+   }
+   pHunspell->free_list(&wlst, len);
+}
+
+// Background threads, each with their own Hunspell instance, which check
+// batches of words in parallel and compute suggestion lists ahead of time
+// for words known to be misspelled. Words are passed to and from the
+// workers in dictionary encoding.
+class HunspellWorkers : boost::noncopyable
+{
+public:
+   HunspellWorkers(const HunspellSource& source,
+                   const boost::posix_time::time_duration& checkTimeout)
+      : source_(source), checkTimeout_(checkTimeout), numReady_(0), stop_(false)
+   {
+   }
+
+   ~HunspellWorkers()
+   {
+      try
+      {
+         stop();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   void start(std::size_t numWorkers)
+   {
+      for (std::size_t i = 0; i < numWorkers; i++)
+      {
+         boost::thread workerThread;
+         core::thread::safeLaunchThread(
+                  boost::bind(&HunspellWorkers::workerMain, this),
+                  &workerThread);
+         if (workerThread.joinable())
+            threads_.add_thread(new boost::thread(MOVE_THREAD(workerThread)));
+      }
+   }
+
+   void stop()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         stop_ = true;
+      }
+      END_LOCK_MUTEX
+      condition_.notify_all();
+      threads_.join_all();
+   }
+
+   // have any of the workers finished loading their dictionary?
+   bool ready()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         return numReady_ > 0;
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+   // check the words, waiting for the workers for at most the check
+   // timeout. returns false if they didn't finish in time (or failed), in
+   // which case the caller should check the words itself
+   bool check(const std::vector<std::string>& words, std::vector<char>* pCorrect)
+   {
+      boost::shared_ptr<CheckBatch> pBatch(new CheckBatch(words));
+      LOCK_MUTEX(mutex_)
+      {
+         // split the words evenly between the workers which are ready
+         std::size_t workers = std::max<std::size_t>(numReady_, 1);
+         std::size_t chunk = (words.size() / workers) + 1;
+         for (std::size_t i = 0; i < words.size(); i += chunk)
+         {
+            Task task;
+            task.pBatch = pBatch;
+            task.begin = i;
+            task.end = std::min(i + chunk, words.size());
+            checkTasks_.push_back(task);
+            pBatch->remaining++;
+         }
+      }
+      END_LOCK_MUTEX
+      condition_.notify_all();
+
+      bool complete = false;
+      {
+         boost::unique_lock<boost::mutex> lock(pBatch->mutex);
+         boost::system_time timeoutTime = boost::get_system_time() +
+                                          checkTimeout_;
+         while (pBatch->remaining > 0)
+         {
+            if (!pBatch->condition.timed_wait(lock, timeoutTime))
+               break;
+         }
+         complete = (pBatch->remaining == 0 && !pBatch->failed);
+      }
+
+      if (!complete)
+      {
+         // take back the parts of the batch no worker has started (the
+         // batch is shared so parts in progress can finish harmlessly)
+         LOCK_MUTEX(mutex_)
+         {
+            checkTasks_.erase(std::remove_if(checkTasks_.begin(),
+                                             checkTasks_.end(),
+                                             boost::bind(isTaskForBatch,
+                                                         _1,
+                                                         pBatch.get())),
+                              checkTasks_.end());
+         }
+         END_LOCK_MUTEX
+         return false;
+      }
+
+      pCorrect->swap(pBatch->correct);
+      return true;
+   }
+
+   // compute suggestions for the words when the workers are otherwise idle
+   void queueSuggestions(const std::vector<std::string>& words)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         BOOST_FOREACH(const std::string& word, words)
+         {
+            if (suggestions_.size() + queuedSuggestions_.size() >=
+                kMaxPrecomputedSuggestions)
+            {
+               break;
+            }
+
+            if (suggestions_.count(word) || queuedSuggestions_.count(word))
+               continue;
+
+            queuedSuggestions_.insert(word);
+            Task task;
+            task.word = word;
+            suggestTasks_.push_back(task);
+         }
+      }
+      END_LOCK_MUTEX
+      condition_.notify_all();
+   }
+
+   // take the precomputed suggestions for a word (if we have them)
+   bool takeSuggestions(const std::string& word, std::vector<std::string>* pSugs)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         SuggestionMap::iterator it = suggestions_.find(word);
+         if (it == suggestions_.end())
+            return false;
+
+         *pSugs = it->second;
+         suggestions_.erase(it);
+         return true;
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+private:
+   struct CheckBatch
+   {
+      explicit CheckBatch(const std::vector<std::string>& words)
+         : words(words), correct(words.size(), 1), remaining(0), failed(false)
+      {
+      }
+
+      // copied so that workers can outlive a caller which gave up waiting
+      const std::vector<std::string> words;
+      std::vector<char> correct;
+
+      boost::mutex mutex;
+      boost::condition_variable condition;
+      std::size_t remaining;
+      bool failed;
+   };
+
+   struct Task
+   {
+      Task() : begin(0), end(0) {}
+
+      // check a range of words within a batch
+      boost::shared_ptr<CheckBatch> pBatch;
+      std::size_t begin;
+      std::size_t end;
+
+      // or compute suggestions for a word
+      std::string word;
+   };
+
+   typedef boost::unordered_map<std::string, std::vector<std::string> >
+                                                               SuggestionMap;
+
+   static bool isTaskForBatch(const Task& task, const CheckBatch* pBatch)
+   {
+      return task.pBatch.get() == pBatch;
+   }
+
+   void workerMain()
+   {
+      try
+      {
+         boost::shared_ptr<Hunspell> pHunspell = source_.load();
+
+         LOCK_MUTEX(mutex_)
+         {
+            numReady_++;
+         }
+         END_LOCK_MUTEX
+
+         while (true)
+         {
+            Task task;
+            {
+               boost::unique_lock<boost::mutex> lock(mutex_);
+               while (!stop_ && checkTasks_.empty() && suggestTasks_.empty())
+                  condition_.wait(lock);
+
+               if (stop_)
+                  break;
+
+               // batches being checked always come before suggestions
+               if (!checkTasks_.empty())
+               {
+                  task = checkTasks_.front();
+                  checkTasks_.pop_front();
+               }
+               else
+               {
+                  task = suggestTasks_.front();
+                  suggestTasks_.pop_front();
+               }
+            }
+
+            // a task which fails mustn't take the worker down with it (or
+            // leave its batch incomplete)
+            bool succeeded = false;
+            try
+            {
+               if (task.pBatch)
+                  checkWords(pHunspell.get(), task);
+               else
+                  suggestWord(pHunspell.get(), task.word);
+               succeeded = true;
+            }
+            CATCH_UNEXPECTED_EXCEPTION
+
+            if (task.pBatch)
+               completeTask(task, succeeded);
+            else if (!succeeded)
+               abandonSuggestion(task.word);
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   void checkWords(Hunspell* pHunspell, const Task& task)
+   {
+      CheckBatch& batch = *task.pBatch;
+      for (std::size_t i = task.begin; i < task.end; i++)
+         batch.correct[i] = pHunspell->spell(batch.words[i].c_str()) ? 1 : 0;
+   }
+
+   void completeTask(const Task& task, bool succeeded)
+   {
+      CheckBatch& batch = *task.pBatch;
+      bool complete = false;
+      LOCK_MUTEX(batch.mutex)
+      {
+         if (!succeeded)
+            batch.failed = true;
+         complete = (--batch.remaining == 0);
+      }
+      END_LOCK_MUTEX
+
+      if (complete)
+         batch.condition.notify_all();
+   }
+
+   void suggestWord(Hunspell* pHunspell, const std::string& word)
+   {
+      std::vector<std::string> sugs;
+      char ** wlst;
+      int ns = pHunspell->suggest(&wlst, word.c_str());
+      copyAndFreeHunspellVector(pHunspell, &sugs, wlst, ns);
+
+      LOCK_MUTEX(mutex_)
+      {
+         queuedSuggestions_.erase(word);
+         suggestions_[word] = sugs;
+      }
+      END_LOCK_MUTEX
+   }
+
+   void abandonSuggestion(const std::string& word)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         queuedSuggestions_.erase(word);
+      }
+      END_LOCK_MUTEX
+   }
+
+private:
+   const HunspellSource source_;
+   const boost::posix_time::time_duration checkTimeout_;
+   boost::thread_group threads_;
+
+   boost::mutex mutex_;
+   boost::condition_variable condition_;
+   std::size_t numReady_;
+   bool stop_;
+   std::deque<Task> checkTasks_;
+   std::deque<Task> suggestTasks_;
+   boost::unordered_set<std::string> queuedSuggestions_;
+   SuggestionMap suggestions_;
+};
+
 class HunspellSpellChecker : public SpellChecker
 {
 public:
@@ -149,6 +573,8 @@ public:
    {
       try
       {
+         // stop the workers before the instance they were loaded from
+         pWorkers_.reset();
          pHunspell_.reset();
       }
       catch(...)
@@ -166,14 +592,13 @@ public:
          return core::fileNotFoundError(dictionary.dicPath(), ERROR_LOCATION);
 
       // convert paths to system encoding before sending to external API
-      std::string systemAffPath = string_utils::utf8ToSystem(
+      source_.affPath = string_utils::utf8ToSystem(
                                     dictionary.affPath().absolutePath());
-      std::string systemDicPath = string_utils::utf8ToSystem(
+      source_.dicPath = string_utils::utf8ToSystem(
                                     dictionary.dicPath().absolutePath());
 
       // initialize hunspell, iconvstrFunc_, and encoding_
-      pHunspell_.reset(new Hunspell(systemAffPath.c_str(),
-                                    systemDicPath.c_str()));
+      pHunspell_ = source_.load();
       iconvstrFunc_ = iconvstrFunc;
       encoding_ = pHunspell_->get_dic_encoding();
 
@@ -192,6 +617,18 @@ public:
       return Success();
    }
 
+   // start background workers (each loads its own copy of the dictionary,
+   // so this should be called after all words and dictionaries are added)
+   void startWorkers(std::size_t numWorkers,
+                     const boost::posix_time::time_duration& checkTimeout)
+   {
+      if (numWorkers == 0 || pWorkers_)
+         return;
+
+      pWorkers_.reset(new HunspellWorkers(source_, checkTimeout));
+      pWorkers_->start(numWorkers);
+   }
+
    Error wordChars(std::wstring *pWordChars)
    {
       int len;
@@ -206,17 +643,6 @@ public:
 private:
 
    // helpers
-   void copyAndFreeHunspellVector(std::vector<std::string>* pVec,
-                                    char **wlst,
-                                    int len)
-   {
-      for (int i=0; i < len; i++)
-      {
-         pVec->push_back(wlst[i]);
-      }
-      pHunspell_->free_list(&wlst, len);
-   }
-
    Error mergeDicDeltaFile(const FilePath& dicDeltaPath)
    {
       // determine whether we are going to support affixes -- we do this for
@@ -266,44 +692,204 @@ private:
       return Success();
    }
 
+   struct CachedWord
+   {
+      CachedWord()
+         : correct(true), haveSuggestions(false), suggestionsEncoded(false)
+      {
+      }
+
+      bool correct;
+      bool haveSuggestions;
+      bool suggestionsEncoded;
+      std::vector<std::string> suggestions;
+      std::list<std::string>::iterator lruPos;
+   };
+
+   typedef boost::unordered_map<std::string, CachedWord> WordCache;
+
+   CachedWord* cachedWord(const std::string& word)
+   {
+      WordCache::iterator it = cache_.find(word);
+      if (it == cache_.end())
+         return NULL;
+
+      // move to the front of the lru list
+      lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+      return &(it->second);
+   }
+
+   CachedWord& cacheWord(const std::string& word, bool correct)
+   {
+      // evict the least recently used word if we're full
+      if (cache_.size() >= kMaxCachedWords && !lru_.empty())
+      {
+         cache_.erase(lru_.back());
+         lru_.pop_back();
+      }
+
+      lru_.push_front(word);
+      CachedWord& cached = cache_[word];
+      cached.correct = correct;
+      cached.lruPos = lru_.begin();
+      return cached;
+   }
+
+   Error encode(const std::string& word, std::string* pEncoded)
+   {
+      return iconvstrFunc_(word, "UTF-8", encoding_, false, pEncoded);
+   }
 
 public:
    Error checkSpelling(const std::string& word, bool *pCorrect)
    {
-      std::string encoded;
-      Error error = iconvstrFunc_(word,"UTF-8",encoding_,false,&encoded);
+      std::vector<bool> correct;
+      Error error = checkSpelling(std::vector<std::string>(1, word), &correct);
       if (error)
          return error;
 
-      *pCorrect = pHunspell_->spell(encoded.c_str());
+      *pCorrect = correct[0];
       return Success();
    }
 
-   Error suggestionList(const std::string& word, std::vector<std::string>* pSug)
+   Error checkSpelling(const std::vector<std::string>& words,
+                       std::vector<bool>* pCorrect)
    {
-      std::string encoded;
-      Error error = iconvstrFunc_(word,"UTF-8",encoding_,false,&encoded);
-      if (error)
-         return error;
+      pCorrect->assign(words.size(), true);
+
+      // answer what we can from the cache, and encode each distinct word
+      // we haven't seen before (once)
+      std::vector<std::string> encodedWords;
+      std::vector<std::string> uncheckedWords;
+      boost::unordered_map<std::string, std::size_t> uncheckedIndexes;
+      std::vector<std::size_t> wordIndexes(words.size(), words.size());
+      for (std::size_t i = 0; i < words.size(); i++)
+      {
+         const std::string& word = words[i];
 
-      char ** wlst;
-      int ns = pHunspell_->suggest(&wlst,encoded.c_str());
-      copyAndFreeHunspellVector(pSug,wlst,ns);
+         CachedWord* pCached = cachedWord(word);
+         if (pCached)
+         {
+            (*pCorrect)[i] = pCached->correct;
+            continue;
+         }
+
+         boost::unordered_map<std::string, std::size_t>::iterator it =
+                                                   uncheckedIndexes.find(word);
+         if (it != uncheckedIndexes.end())
+         {
+            wordIndexes[i] = it->second;
+            continue;
+         }
+
+         // if we can't encode a word then we just can't check it (some
+         // combinations of platform, non-ASCII characters, and locale are
+         // known to fail in iconv) so leave it marked as correct
+         std::string encoded;
+         Error error = encode(word, &encoded);
+         if (error)
+         {
+            LOG_ERROR(error);
+            continue;
+         }
+
+         wordIndexes[i] = encodedWords.size();
+         uncheckedIndexes[word] = encodedWords.size();
+         encodedWords.push_back(encoded);
+         uncheckedWords.push_back(word);
+      }
+
+      if (encodedWords.empty())
+         return Success();
+
+      // check the new words (on the workers if there are enough of them)
+      // (checking them here if the workers don't answer in time)
+      std::vector<char> correct;
+      bool checked = pWorkers_ &&
+                     encodedWords.size() >= kMinParallelWords &&
+                     pWorkers_->ready() &&
+                     pWorkers_->check(encodedWords, &correct);
+      if (!checked)
+      {
+         correct.reserve(encodedWords.size());
+         BOOST_FOREACH(const std::string& encoded, encodedWords)
+         {
+            correct.push_back(pHunspell_->spell(encoded.c_str()) ? 1 : 0);
+         }
+      }
+
+      // remember the results and precompute suggestions for misspellings
+      std::vector<std::string> misspelled;
+      for (std::size_t i = 0; i < uncheckedWords.size(); i++)
+      {
+         cacheWord(uncheckedWords[i], correct[i] != 0);
+         if (!correct[i])
+            misspelled.push_back(encodedWords[i]);
+      }
+      if (pWorkers_ && !misspelled.empty())
+         pWorkers_->queueSuggestions(misspelled);
 
-      BOOST_FOREACH(std::string& sug, *pSug)
+      for (std::size_t i = 0; i < words.size(); i++)
       {
-         error = iconvstrFunc_(sug, encoding_, "UTF-8", true, &sug);
+         if (wordIndexes[i] < correct.size())
+            (*pCorrect)[i] = correct[wordIndexes[i]] != 0;
+      }
+
+      return Success();
+   }
+
+   Error suggestionList(const std::string& word, std::vector<std::string>* pSug)
+   {
+      CachedWord* pCached = cachedWord(word);
+      if (!pCached || !pCached->haveSuggestions)
+      {
+         std::string encoded;
+         Error error = encode(word, &encoded);
          if (error)
             return error;
+
+         // use the suggestions computed in the background if we have them
+         std::vector<std::string> sugs;
+         if (!pWorkers_ || !pWorkers_->takeSuggestions(encoded, &sugs))
+         {
+            char ** wlst;
+            int ns = pHunspell_->suggest(&wlst,encoded.c_str());
+            copyAndFreeHunspellVector(pHunspell_.get(), &sugs, wlst, ns);
+         }
+
+         if (!pCached)
+            pCached = &cacheWord(word, pHunspell_->spell(encoded.c_str()) != 0);
+         pCached->haveSuggestions = true;
+         pCached->suggestionsEncoded = true;
+         pCached->suggestions = sugs;
+      }
+
+      // suggestions are kept in dictionary encoding until they're needed (and
+      // stay that way unless all of them convert)
+      if (pCached->suggestionsEncoded)
+      {
+         std::vector<std::string> converted;
+         converted.reserve(pCached->suggestions.size());
+         BOOST_FOREACH(const std::string& sug, pCached->suggestions)
+         {
+            std::string utf8;
+            Error error = iconvstrFunc_(sug, encoding_, "UTF-8", true, &utf8);
+            if (error)
+               return error;
+            converted.push_back(utf8);
+         }
+         pCached->suggestions.swap(converted);
+         pCached->suggestionsEncoded = false;
       }
 
+      *pSug = pCached->suggestions;
       return Success();
    }
 
    Error addWord(const std::string& word, bool *pAdded)
    {
       std::string encoded;
-      Error error = iconvstrFunc_(word,"UTF-8",encoding_,false,&encoded);
+      Error error = encode(word, &encoded);
       if (error)
          return error;
 
@@ -311,6 +897,7 @@ public:
       // it seems the return value is always 0, meaning there's really no
       // error ever thrown if the method fails.
       *pAdded = (pHunspell_->add(encoded.c_str()) == 0);
+      source_.words.push_back(DictionaryWord(encoded, std::string()));
       return Success();
    }
 
@@ -319,25 +906,18 @@ public:
                           bool *pAdded)
    {
       std::string wordEncoded;
-      Error error = iconvstrFunc_(word,
-                                  "UTF-8",
-                                  encoding_,
-                                  false,
-                                  &wordEncoded);
+      Error error = encode(word, &wordEncoded);
       if (error)
          return error;
 
       std::string exampleEncoded;
-      error = iconvstrFunc_(example,
-                            "UTF-8",
-                            encoding_,
-                            false,
-                            &exampleEncoded);
+      error = encode(example, &exampleEncoded);
       if (error)
          return error;
 
       *pAdded = (pHunspell_->add_with_affix(wordEncoded.c_str(),
                                             exampleEncoded.c_str()) == 0);
+      source_.words.push_back(DictionaryWord(wordEncoded, exampleEncoded));
       return Success();
    }
 
@@ -360,14 +940,26 @@ public:
 
       // Convert path to system encoding before sending to external api
       std::string systemDicPath = string_utils::utf8ToSystem(dicPath.absolutePath());
-      *pAdded = (pHunspell_->add_dic(systemDicPath.c_str(),key.c_str()) == 0);
+      LOCK_MUTEX(s_hunspellMutex)
+      {
+         *pAdded = (pHunspell_->add_dic(systemDicPath.c_str(),key.c_str()) == 0);
+      }
+      END_LOCK_MUTEX
+      source_.dictionaries.push_back(std::make_pair(systemDicPath, key));
       return Success();
    }
 
 private:
-   boost::scoped_ptr<Hunspell> pHunspell_;
+   HunspellSource source_;
+   boost::shared_ptr<Hunspell> pHunspell_;
    IconvstrFunction iconvstrFunc_;
    std::string encoding_;
+
+   // checked words (in UTF-8), most recently used first
+   WordCache cache_;
+   std::list<std::string> lru_;
+
+   boost::scoped_ptr<HunspellWorkers> pWorkers_;
 };
 
 } // anonymous namespace
@@ -379,8 +971,16 @@ struct HunspellSpellingEngine::Impl
         const IconvstrFunction& iconvstrFunction)
       : currentLangId_(langId),
         dictManager_(dictionaryManager),
-        iconvstrFunction_(iconvstrFunction)
+        iconvstrFunction_(iconvstrFunction),
+        numWorkers_(0),
+        checkTimeout_(boost::posix_time::milliseconds(kDefaultCheckTimeoutMs))
+   {
+   }
+
+   void setWorkerThreads(std::size_t numWorkers, int checkTimeoutMs)
    {
+      numWorkers_ = numWorkers;
+      checkTimeout_ = boost::posix_time::milliseconds(checkTimeoutMs);
    }
 
    void useDictionary(const std::string& langId)
@@ -427,6 +1027,8 @@ private:
                if (error)
                   LOG_ERROR(error);
             }
+
+            pHunspell->startWorkers(numWorkers_, checkTimeout_);
          }
          else
          {
@@ -448,6 +1050,8 @@ private:
    std::vector<std::string> currentCustomDicts_;
    HunspellDictionaryManager dictManager_;
    IconvstrFunction iconvstrFunction_;
+   std::size_t numWorkers_;
+   boost::posix_time::time_duration checkTimeout_;
    boost::shared_ptr<SpellChecker> pSpellChecker_;
 };
 
@@ -460,6 +1064,16 @@ HunspellSpellingEngine::HunspellSpellingEngine(
 {
 }
 
+HunspellSpellingEngine::~HunspellSpellingEngine()
+{
+}
+
+
+void HunspellSpellingEngine::setWorkerThreads(std::size_t numWorkers,
+                                              int checkTimeoutMs)
+{
+   pImpl_->setWorkerThreads(numWorkers, checkTimeoutMs);
+}
 
 void HunspellSpellingEngine::useDictionary(const std::string& langId)
 {
@@ -472,6 +1086,12 @@ Error HunspellSpellingEngine::checkSpelling(const std::string& word,
    return pImpl_->spellChecker().checkSpelling(word, pCorrect);
 }
 
+Error HunspellSpellingEngine::checkSpelling(const std::vector<std::string>& words,
+                                            std::vector<bool>* pCorrect)
+{
+   return pImpl_->spellChecker().checkSpelling(words, pCorrect);
+}
+
 Error HunspellSpellingEngine::suggestionList(const std::string& word,
                                              std::vector<std::string>* pSugs)
 {
@@ -0,0 +1,199 @@
+/*
+ * HunspellSpellingEngineTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/spelling/HunspellSpellingEngine.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <boost/thread.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace spelling {
+namespace tests {
+
+namespace {
+
+// the dictionaries are in UTF-8 so there's nothing to convert
+Error noConversion(const std::string& value,
+                   const std::string&,
+                   const std::string&,
+                   bool,
+                   std::string* pResult)
+{
+   *pResult = value;
+   return Success();
+}
+
+// converts as above, but can be made to fail decoding "word5" (suggestions
+// are decoded with substitution allowed)
+bool s_failDecoding = false;
+int s_decoded = 0;
+
+Error failingConversion(const std::string& value,
+                        const std::string&,
+                        const std::string&,
+                        bool allowSubstitution,
+                        std::string* pResult)
+{
+   if (allowSubstitution)
+   {
+      if (s_failDecoding && value == "word5")
+         return systemError(boost::system::errc::illegal_byte_sequence,
+                            ERROR_LOCATION);
+      s_decoded++;
+   }
+
+   *pResult = value;
+   return Success();
+}
+
+class TestDictionary
+{
+public:
+   TestDictionary()
+   {
+      FilePath::tempFilePath(&userDir_);
+      FilePath langsDir = userDir_.complete("languages-user");
+      langsDir.ensureDirectory();
+
+      writeStringToFile(langsDir.complete("xx_TEST.aff"),
+                        "SET UTF-8\nTRY abcdefghijklmnopqrstuvwxyz\n");
+
+      // known words are "word0" through "word99"
+      std::string dic = "100\n";
+      for (int i = 0; i < 100; i++)
+         dic += "word" + safe_convert::numberToString(i) + "\n";
+      writeStringToFile(langsDir.complete("xx_TEST.dic"), dic);
+   }
+
+   ~TestDictionary()
+   {
+      userDir_.removeIfExists();
+   }
+
+   HunspellDictionaryManager manager() const
+   {
+      return HunspellDictionaryManager(userDir_.complete("languages-core"),
+                                       userDir_);
+   }
+
+private:
+   FilePath userDir_;
+};
+
+// a batch of words, every other one misspelled (distinct for each batch so
+// that none of them are answered from the checked word cache)
+std::vector<std::string> batch(int number)
+{
+   std::vector<std::string> words;
+   for (int i = 0; i < 100; i++)
+   {
+      if (i % 2 == 0)
+         words.push_back("word" + safe_convert::numberToString(i));
+      else
+         words.push_back("wrd" + safe_convert::numberToString(number * 100 + i));
+   }
+   return words;
+}
+
+void checkBatches(HunspellSpellingEngine* pEngine)
+{
+   for (int n = 0; n < 20; n++)
+   {
+      std::vector<bool> correct;
+      REQUIRE(!pEngine->checkSpelling(batch(n), &correct));
+      REQUIRE(correct.size() == 100);
+      for (std::size_t i = 0; i < correct.size(); i++)
+         CHECK(correct[i] == (i % 2 == 0));
+
+      // give the workers a chance to load their dictionaries
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+   }
+}
+
+} // anonymous namespace
+
+TEST_CASE("Hunspell Spelling Engine")
+{
+   TestDictionary dictionary;
+
+   SECTION("Words are checked without workers")
+   {
+      HunspellSpellingEngine engine("xx_TEST", dictionary.manager(), noConversion);
+      checkBatches(&engine);
+
+      bool correct = true;
+      REQUIRE(!engine.checkSpelling("wordd5", &correct));
+      CHECK_FALSE(correct);
+
+      std::vector<std::string> sugs;
+      REQUIRE(!engine.suggestionList("wordd5", &sugs));
+      CHECK(std::find(sugs.begin(), sugs.end(), "word5") != sugs.end());
+   }
+
+   SECTION("Suggestions stay encoded unless they all convert")
+   {
+      HunspellSpellingEngine engine("xx_TEST", dictionary.manager(),
+                                    failingConversion);
+
+      std::vector<std::string> sugs;
+      s_failDecoding = true;
+      CHECK(engine.suggestionList("wordd5", &sugs));
+      CHECK(sugs.empty());
+
+      s_failDecoding = false;
+      s_decoded = 0;
+      REQUIRE(!engine.suggestionList("wordd5", &sugs));
+      CHECK(std::find(sugs.begin(), sugs.end(), "word5") != sugs.end());
+      CHECK(s_decoded == static_cast<int>(sugs.size()));
+
+      // once converted they're cached
+      std::vector<std::string> cached;
+      REQUIRE(!engine.suggestionList("wordd5", &cached));
+      CHECK(cached == sugs);
+      CHECK(s_decoded == static_cast<int>(sugs.size()));
+   }
+
+   SECTION("Batches of words are checked by the workers")
+   {
+      HunspellSpellingEngine engine("xx_TEST", dictionary.manager(), noConversion);
+      engine.setWorkerThreads(2);
+      checkBatches(&engine);
+
+      // suggestions are computed ahead of time for the misspellings
+      std::vector<std::string> sugs;
+      REQUIRE(!engine.suggestionList("wrd1", &sugs));
+      CHECK(std::find(sugs.begin(), sugs.end(), "word1") != sugs.end());
+   }
+
+   SECTION("Words are checked directly when the workers time out")
+   {
+      HunspellSpellingEngine engine("xx_TEST", dictionary.manager(), noConversion);
+      engine.setWorkerThreads(2, 0);
+      checkBatches(&engine);
+   }
+}
+
+} // namespace tests
+} // namespace spelling
+} // namespace core
+} // namespace rstudio
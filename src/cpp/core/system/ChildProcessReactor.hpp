@@ -0,0 +1,115 @@
+/*
+ * ChildProcessReactor.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
+#define CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+
+namespace system {
+
+class AsyncChildProcess;
+
+// Watches the output pipes of child processes (and, where the kernel
+// supports pidfds, their exit) from a dedicated thread using epoll, so
+// that the ProcessSupervisor only needs to service children which actually
+// have something to report.
+//
+// Descriptors are registered one-shot: once a descriptor has reported
+// activity it is not watched again until rearm() is called (after the
+// owning thread has drained it). Activity is accumulated in a set which
+// the owning thread takes with takeReady(); the activity handler (which is
+// called on the reactor thread) is invoked whenever that set goes from
+// empty to non-empty so the owner can schedule a poll.
+class ChildProcessReactor : boost::noncopyable
+{
+public:
+   typedef const AsyncChildProcess* Child;
+
+   ChildProcessReactor();
+   virtual ~ChildProcessReactor();
+
+   Error start(const boost::function<void()>& onActivity);
+   void stop();
+
+   // watch a child's output descriptors and exit. pWatchesExit indicates
+   // whether exit notification is available (if it isn't the child must
+   // still be polled periodically to detect exit)
+   Error add(Child child,
+             PidType pid,
+             const std::vector<int>& fds,
+             bool* pWatchesExit);
+
+   // watch a child's (still open) output descriptors again
+   void rearm(Child child, const std::vector<int>& fds);
+
+   // stop watching a child
+   void remove(Child child);
+
+   // take the children which have reported activity since the last call
+   void takeReady(std::set<Child>* pReady);
+
+private:
+   struct Registration
+   {
+      Registration() : child(NULL), fd(-1), isPidFd(false) {}
+      Registration(Child child, int fd, bool isPidFd)
+         : child(child), fd(fd), isPidFd(isPidFd)
+      {
+      }
+      Child child;
+      int fd;
+      bool isPidFd;
+   };
+
+   Error watch(Child child, int fd, bool isPidFd);
+   void reactorMain();
+
+private:
+   int epollFd_;
+   int wakeFd_;
+   boost::thread thread_;
+   boost::function<void()> onActivity_;
+
+   // registrations are identified by token (rather than descriptor) since
+   // a closed descriptor number may be reused before we hear about it
+   boost::mutex mutex_;
+   boost::uint64_t nextToken_;
+   std::map<boost::uint64_t, Registration> registrations_;
+   std::map<Child, std::map<int, boost::uint64_t> > childTokens_;
+   std::set<Child> ready_;
+   bool stop_;
+};
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
@@ -0,0 +1,316 @@
+/*
+ * LinuxChildProcessReactor.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ChildProcessReactor.hpp"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Macros.hpp>
+#include <core/Thread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+// token reserved for the descriptor used to wake the reactor thread
+const boost::uint64_t kWakeToken = 0;
+
+int openPidFd(PidType pid)
+{
+#ifdef SYS_pidfd_open
+   return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+   errno = ENOSYS;
+   return -1;
+#endif
+}
+
+void closeFd(int fd)
+{
+   if (fd != -1)
+      ::close(fd);
+}
+
+} // anonymous namespace
+
+ChildProcessReactor::ChildProcessReactor()
+   : epollFd_(-1), wakeFd_(-1), nextToken_(kWakeToken + 1), stop_(false)
+{
+}
+
+ChildProcessReactor::~ChildProcessReactor()
+{
+   try
+   {
+      stop();
+
+      typedef std::pair<const boost::uint64_t, Registration> TokenRegistration;
+      BOOST_FOREACH(const TokenRegistration& reg, registrations_)
+      {
+         if (reg.second.isPidFd)
+            closeFd(reg.second.fd);
+      }
+
+      closeFd(wakeFd_);
+      closeFd(epollFd_);
+   }
+   catch(...)
+   {
+   }
+}
+
+Error ChildProcessReactor::start(const boost::function<void()>& onActivity)
+{
+   onActivity_ = onActivity;
+
+   epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd_ == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (wakeFd_ == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   struct epoll_event event;
+   event.events = EPOLLIN;
+   event.data.u64 = kWakeToken;
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event) == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   core::thread::safeLaunchThread(
+            boost::bind(&ChildProcessReactor::reactorMain, this),
+            &thread_);
+   if (!thread_.joinable())
+      return systemError(boost::system::errc::resource_unavailable_try_again,
+                         ERROR_LOCATION);
+
+   return Success();
+}
+
+void ChildProcessReactor::stop()
+{
+   if (!thread_.joinable())
+      return;
+
+   LOCK_MUTEX(mutex_)
+   {
+      stop_ = true;
+   }
+   END_LOCK_MUTEX
+
+   boost::uint64_t value = 1;
+   if (::write(wakeFd_, &value, sizeof(value)) == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+
+   thread_.join();
+}
+
+Error ChildProcessReactor::watch(Child child, int fd, bool isPidFd)
+{
+   boost::uint64_t token = 0;
+   LOCK_MUTEX(mutex_)
+   {
+      token = nextToken_++;
+      registrations_[token] = Registration(child, fd, isPidFd);
+      childTokens_[child][fd] = token;
+   }
+   END_LOCK_MUTEX
+
+   struct epoll_event event;
+   event.events = EPOLLIN | EPOLLONESHOT;
+   event.data.u64 = token;
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      LOCK_MUTEX(mutex_)
+      {
+         registrations_.erase(token);
+         childTokens_[child].erase(fd);
+      }
+      END_LOCK_MUTEX
+      return error;
+   }
+
+   return Success();
+}
+
+Error ChildProcessReactor::add(Child child,
+                               PidType pid,
+                               const std::vector<int>& fds,
+                               bool* pWatchesExit)
+{
+   BOOST_FOREACH(int fd, fds)
+   {
+      Error error = watch(child, fd, false);
+      if (error)
+      {
+         remove(child);
+         return error;
+      }
+   }
+
+   // pidfds (linux 5.3+) become readable when the process exits; without
+   // them the caller needs to keep checking for exit itself
+   *pWatchesExit = false;
+   int pidFd = openPidFd(pid);
+   if (pidFd != -1)
+   {
+      Error error = watch(child, pidFd, true);
+      if (!error)
+         *pWatchesExit = true;
+      else
+         closeFd(pidFd);
+   }
+
+   return Success();
+}
+
+void ChildProcessReactor::rearm(Child child, const std::vector<int>& fds)
+{
+   std::vector<std::pair<int, boost::uint64_t> > tokens;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<Child, std::map<int, boost::uint64_t> >::const_iterator it =
+                                                      childTokens_.find(child);
+      if (it == childTokens_.end())
+         return;
+
+      BOOST_FOREACH(int fd, fds)
+      {
+         std::map<int, boost::uint64_t>::const_iterator tokenIt =
+                                                         it->second.find(fd);
+         if (tokenIt != it->second.end())
+            tokens.push_back(*tokenIt);
+      }
+   }
+   END_LOCK_MUTEX
+
+   typedef std::pair<int, boost::uint64_t> FdToken;
+   BOOST_FOREACH(const FdToken& fdToken, tokens)
+   {
+      struct epoll_event event;
+      event.events = EPOLLIN | EPOLLONESHOT;
+      event.data.u64 = fdToken.second;
+      if (::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fdToken.first, &event) == -1)
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+   }
+}
+
+void ChildProcessReactor::remove(Child child)
+{
+   std::vector<int> pidFds;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<Child, std::map<int, boost::uint64_t> >::iterator it =
+                                                      childTokens_.find(child);
+      if (it != childTokens_.end())
+      {
+         typedef std::pair<const int, boost::uint64_t> FdToken;
+         BOOST_FOREACH(const FdToken& fdToken, it->second)
+         {
+            if (registrations_[fdToken.second].isPidFd)
+               pidFds.push_back(fdToken.first);
+            registrations_.erase(fdToken.second);
+         }
+         childTokens_.erase(it);
+      }
+      ready_.erase(child);
+   }
+   END_LOCK_MUTEX
+
+   // output descriptors have already been closed by the child (which
+   // removes them from the epoll set) and as their numbers may since have
+   // been reused we leave them alone; the pidfds are ours to close
+   BOOST_FOREACH(int pidFd, pidFds)
+   {
+      ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, pidFd, NULL);
+      closeFd(pidFd);
+   }
+}
+
+void ChildProcessReactor::takeReady(std::set<Child>* pReady)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      pReady->swap(ready_);
+      ready_.clear();
+   }
+   END_LOCK_MUTEX
+}
+
+void ChildProcessReactor::reactorMain()
+{
+   try
+   {
+      const int kMaxEvents = 64;
+      struct epoll_event events[kMaxEvents];
+
+      while (true)
+      {
+         int count = ::epoll_wait(epollFd_, events, kMaxEvents, -1);
+         if (count == -1)
+         {
+            if (errno == EINTR)
+               continue;
+
+            LOG_ERROR(systemError(errno, ERROR_LOCATION));
+            return;
+         }
+
+         bool notify = false;
+         LOCK_MUTEX(mutex_)
+         {
+            if (stop_)
+               return;
+
+            bool wasEmpty = ready_.empty();
+            for (int i = 0; i < count; i++)
+            {
+               boost::uint64_t token = events[i].data.u64;
+               if (token == kWakeToken)
+                  continue;
+
+               // registrations of removed children are ignored
+               std::map<boost::uint64_t, Registration>::const_iterator it =
+                                                   registrations_.find(token);
+               if (it != registrations_.end())
+                  ready_.insert(it->second.child);
+            }
+            notify = wasEmpty && !ready_.empty();
+         }
+         END_LOCK_MUTEX
+
+         if (notify && onActivity_)
+            onActivity_();
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
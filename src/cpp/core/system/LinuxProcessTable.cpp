@@ -0,0 +1,351 @@
+/*
+ * LinuxProcessTable.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/system/ProcessTable.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+#include <core/system/PosixSystem.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+// large enough for everything in a stat file up to (and well past) the
+// parent pid, which is all we need
+const std::size_t kStatBufferSize = 512;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+bool isPidName(const char* name)
+{
+   if (*name == '\0')
+      return false;
+
+   for (const char* p = name; *p != '\0'; p++)
+   {
+      if (*p < '0' || *p > '9')
+         return false;
+   }
+   return true;
+}
+
+// The first field of /proc/<pid>/stat is the pid, the second is the
+// executable name enclosed in parenthesis, the third is a single character
+// (the state) and the fourth is the parent pid. The executable name can
+// contain arbitrary text including whitespace and parenthesis, so we look
+// for the last closing parenthesis (nothing after it can contain one).
+// An example:
+//    4075 (My )(great Program) S 4074 ....
+bool parseStat(const char* buffer,
+               std::size_t size,
+               PidType* pPid,
+               PidType* pPpid,
+               std::string* pExe)
+{
+   const char* begin = buffer;
+   const char* end = buffer + size;
+
+   const char* openParen = std::find(begin, end, '(');
+   if (openParen == end || openParen - begin < 2) // at a minimum, "# (foo)"
+      return false;
+
+   const char* closeParen = end;
+   for (const char* p = end; p != openParen; p--)
+   {
+      if (*(p - 1) == ')')
+      {
+         closeParen = p - 1;
+         break;
+      }
+   }
+   if (closeParen == end)
+      return false;
+
+   char* pidEnd = NULL;
+   long pid = ::strtol(begin, &pidEnd, 10);
+   if (pidEnd == begin || pid <= 0)
+      return false;
+
+   // skip the state field then read the parent pid
+   const char* p = closeParen + 1;
+   while (p < end && *p == ' ')
+      p++;
+   while (p < end && *p != ' ')
+      p++;
+   if (p == end)
+      return false;
+
+   char* ppidEnd = NULL;
+   long ppid = ::strtol(p, &ppidEnd, 10);
+   if (ppidEnd == p)
+      return false;
+
+   *pPid = static_cast<PidType>(pid);
+   *pPpid = static_cast<PidType>(ppid);
+   pExe->assign(openParen + 1, closeParen);
+   return true;
+}
+
+} // anonymous namespace
+
+Error ProcessTable::refresh()
+{
+   DIR* pDir = ::opendir("/proc");
+   if (pDir == NULL)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", "/proc");
+      return error;
+   }
+
+   entries_.clear();
+   pidIndexes_.clear();
+   childIndexes_.clear();
+   cwds_.clear();
+
+   int procFd = ::dirfd(pDir);
+   char path[64];
+   char buffer[kStatBufferSize];
+   Entry entry;
+
+   struct dirent* pEntry;
+   while ((pEntry = ::readdir(pDir)) != NULL)
+   {
+      // only interested in the numeric directories (pid)
+      if (!isPidName(pEntry->d_name))
+         continue;
+
+      ::snprintf(path, sizeof(path), "%s/stat", pEntry->d_name);
+      int fd = ::openat(procFd, path, O_RDONLY | O_CLOEXEC);
+      if (fd == -1)
+         continue; // process has exited
+
+      ssize_t bytesRead = ::read(fd, buffer, sizeof(buffer));
+      ::close(fd);
+      if (bytesRead <= 0)
+         continue;
+
+      if (!parseStat(buffer, bytesRead, &entry.pid, &entry.ppid, &entry.exe))
+      {
+         LOG_ERROR_MESSAGE("Unable to parse /proc/" +
+                           std::string(pEntry->d_name) + "/stat");
+         continue;
+      }
+
+      std::size_t index = entries_.size();
+      entries_.push_back(entry);
+      pidIndexes_[entry.pid] = index;
+      childIndexes_[entry.ppid].push_back(index);
+   }
+
+   ::closedir(pDir);
+   refreshed_ = now();
+   return Success();
+}
+
+SubprocInfo ProcessTable::subprocInfo(std::size_t index) const
+{
+   SubprocInfo info;
+   info.pid = entries_[index].pid;
+   info.exe = entries_[index].exe;
+   return info;
+}
+
+std::vector<SubprocInfo> ProcessTable::children(PidType pid) const
+{
+   std::vector<SubprocInfo> subprocs;
+
+   boost::unordered_map<PidType, std::vector<std::size_t> >::const_iterator it =
+                                                      childIndexes_.find(pid);
+   if (it != childIndexes_.end())
+   {
+      BOOST_FOREACH(std::size_t index, it->second)
+      {
+         subprocs.push_back(subprocInfo(index));
+      }
+   }
+
+   return subprocs;
+}
+
+std::vector<SubprocInfo> ProcessTable::descendants(PidType pid) const
+{
+   std::vector<SubprocInfo> subprocs;
+
+   std::deque<PidType> parents(1, pid);
+   while (!parents.empty())
+   {
+      boost::unordered_map<PidType, std::vector<std::size_t> >::const_iterator it =
+                                             childIndexes_.find(parents.front());
+      parents.pop_front();
+      if (it == childIndexes_.end())
+         continue;
+
+      BOOST_FOREACH(std::size_t index, it->second)
+      {
+         // guard against a process being listed as its own parent
+         if (entries_[index].pid == pid)
+            continue;
+
+         subprocs.push_back(subprocInfo(index));
+         parents.push_back(entries_[index].pid);
+      }
+   }
+
+   return subprocs;
+}
+
+std::string ProcessTable::exe(PidType pid) const
+{
+   boost::unordered_map<PidType, std::size_t>::const_iterator it =
+                                                         pidIndexes_.find(pid);
+   if (it == pidIndexes_.end())
+      return std::string();
+
+   return entries_[it->second].exe;
+}
+
+FilePath ProcessTable::cwd(PidType pid)
+{
+   std::map<PidType, FilePath>::const_iterator it = cwds_.find(pid);
+   if (it != cwds_.end())
+      return it->second;
+
+   // /proc/PID/cwd is a symbolic link to the process' current working directory
+   char path[64];
+   ::snprintf(path, sizeof(path), "/proc/%ld/cwd", static_cast<long>(pid));
+
+   FilePath cwdPath;
+   char buffer[PATH_MAX];
+   ssize_t len = ::readlink(path, buffer, sizeof(buffer));
+   if (len > 0 && static_cast<std::size_t>(len) < sizeof(buffer))
+      cwdPath = FilePath(std::string(buffer, len));
+
+   cwds_[pid] = cwdPath;
+   return cwdPath;
+}
+
+ProcessTableService::ProcessTableService()
+   : refreshInterval_(boost::posix_time::milliseconds(200))
+{
+}
+
+void ProcessTableService::setRefreshInterval(
+                           const boost::posix_time::time_duration& interval)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      refreshInterval_ = interval;
+   }
+   END_LOCK_MUTEX
+}
+
+// requires that mutex_ is held
+bool ProcessTableService::refreshIfNecessary()
+{
+   if (!table_.refreshed().is_not_a_date_time() &&
+       now() - table_.refreshed() < refreshInterval_)
+   {
+      return true;
+   }
+
+   Error error = table_.refresh();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   return true;
+}
+
+std::vector<SubprocInfo> ProcessTableService::children(PidType pid)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (refreshIfNecessary())
+         return table_.children(pid);
+   }
+   END_LOCK_MUTEX
+
+   // no procfs
+   return getSubprocessesViaPgrep(pid);
+}
+
+std::vector<SubprocInfo> ProcessTableService::descendants(PidType pid)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (refreshIfNecessary())
+         return table_.descendants(pid);
+   }
+   END_LOCK_MUTEX
+
+   return std::vector<SubprocInfo>();
+}
+
+std::string ProcessTableService::exe(PidType pid)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (refreshIfNecessary())
+         return table_.exe(pid);
+   }
+   END_LOCK_MUTEX
+
+   return std::string();
+}
+
+FilePath ProcessTableService::cwd(PidType pid)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (refreshIfNecessary())
+         return table_.cwd(pid);
+   }
+   END_LOCK_MUTEX
+
+   // no procfs
+   return currentWorkingDirViaLsof(pid);
+}
+
+ProcessTableService& processTableService()
+{
+   static ProcessTableService instance;
+   return instance;
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
@@ -18,6 +18,7 @@
 #include <atomic>
 #include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 
 #ifdef __APPLE__
@@ -41,11 +42,14 @@
 #include <core/system/PosixSystem.hpp>
 #include <core/system/PosixUser.hpp>
 #include <core/system/ProcessArgs.hpp>
+#include <core/system/ProcessTable.hpp>
 #include <core/system/ShellUtils.hpp>
 #include <core/Thread.hpp>
 
 #include <core/PerformanceTimer.hpp>
 
+#include "config.h"
+
 namespace rstudio {
 namespace core {
 namespace system {
@@ -70,6 +74,37 @@ const boost::posix_time::milliseconds kCheckSubprocDelay =
 const boost::posix_time::milliseconds kCheckCwdDelay =
                                          boost::posix_time::milliseconds(2000);
 
+#ifdef __APPLE__
+
+boost::function<std::vector<SubprocInfo>(PidType)> subprocessesFunction()
+{
+   return core::system::getSubprocesses;
+}
+
+boost::function<FilePath(PidType)> currentWorkingDirFunction()
+{
+   return core::system::currentWorkingDir;
+}
+
+#else
+
+// every terminal checks for subprocesses and its working directory, so
+// answer from a process table snapshot shared between them all (refreshed
+// no more often than terminals check)
+boost::function<std::vector<SubprocInfo>(PidType)> subprocessesFunction()
+{
+   ProcessTableService& service = processTableService();
+   service.setRefreshInterval(kCheckSubprocDelay);
+   return boost::bind(&ProcessTableService::children, &service, _1);
+}
+
+boost::function<FilePath(PidType)> currentWorkingDirFunction()
+{
+   return boost::bind(&ProcessTableService::cwd, &processTableService(), _1);
+}
+
+#endif
+
 // exit code for when a thread-safe spawn fails - chosen to be something "unique" enough to identify
 // since thread-safe forks cannot actually log effectively
 const int kThreadSafeForkErrorExit = 153;
@@ -151,6 +186,150 @@ Error readPipe(int pipeFd, std::string* pOutput, bool *pEOF = NULL)
    return Success();
 }
 
+#if defined(HAVE_POSIX_SPAWN_CLOSEFROM) && defined(HAVE_POSIX_SPAWN_CHDIR)
+
+// can the child be launched with posix_spawn? glibc implements posix_spawn
+// with clone(CLONE_VM|CLONE_VFORK), so unlike fork its cost does not grow
+// with the size of the parent (which matters for sessions holding large R
+// heaps). anything which needs code to run in the child between fork and
+// exec (changing user, onAfterFork, pseudoterminals) still has to fork
+bool canSpawnChildProcess(const ProcessOptions& options,
+                          const int* fdInput,
+                          const int* fdOutput,
+                          const int* fdError)
+{
+   if (options.pseudoterminal ||
+       !options.runAsUser.empty() ||
+       options.onAfterFork)
+   {
+      return false;
+   }
+
+   // a working directory which can't be entered is logged and ignored by
+   // the fork path; let it handle that case rather than failing the spawn
+   if (!options.workingDir.empty() && !options.workingDir.isDirectory())
+      return false;
+
+   // the file actions below assume no pipe landed on a standard stream
+   // (possible only when the parent has closed its own)
+   const int* pipes[] = { fdInput, fdOutput, fdError };
+   for (std::size_t i = 0; i < 3; i++)
+   {
+      if (pipes[i][READ] <= STDERR_FILENO || pipes[i][WRITE] <= STDERR_FILENO)
+         return false;
+   }
+
+   return true;
+}
+
+// launch the child with posix_spawn, reproducing the stream redirection,
+// session/process group, signal mask and file descriptor cleanup done by
+// the fork path. on failure no child exists and the pipes are untouched
+Error spawnChildProcess(const std::string& exe,
+                        const ProcessArgs& args,
+                        const ProcessArgs* pEnvironment,
+                        const ProcessOptions& options,
+                        const int* fdInput,
+                        const int* fdOutput,
+                        const int* fdError,
+                        PidType* pPid)
+{
+   posix_spawn_file_actions_t actions;
+   int result = ::posix_spawn_file_actions_init(&actions);
+   if (result != 0)
+      return systemError(result, ERROR_LOCATION);
+
+   posix_spawnattr_t attr;
+   result = ::posix_spawnattr_init(&attr);
+   if (result != 0)
+   {
+      ::posix_spawn_file_actions_destroy(&actions);
+      return systemError(result, ERROR_LOCATION);
+   }
+
+   // wire standard streams, then close everything else (including the
+   // original pipe descriptors) in the child
+   int stdErrFd = options.redirectStdErrToStdOut ? fdOutput[WRITE]
+                                                 : fdError[WRITE];
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions, fdInput[READ], STDIN_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions, fdOutput[WRITE], STDOUT_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions, stdErrFd, STDERR_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO+1);
+
+   if (result == 0 && !options.workingDir.empty())
+   {
+      result = ::posix_spawn_file_actions_addchdir_np(
+               &actions, options.workingDir.absolutePath().c_str());
+   }
+
+   // detach / obtain a new process group, and clear the signal mask
+   short flags = POSIX_SPAWN_SETSIGMASK;
+   if (options.detachSession)
+      flags |= POSIX_SPAWN_SETSID;
+   else if (options.terminateChildren)
+      flags |= POSIX_SPAWN_SETPGROUP;
+
+   sigset_t blockNoneMask;
+   sigemptyset(&blockNoneMask);
+   if (result == 0)
+      result = ::posix_spawnattr_setsigmask(&attr, &blockNoneMask);
+   if (result == 0)
+      result = ::posix_spawnattr_setpgroup(&attr, 0);
+   if (result == 0)
+      result = ::posix_spawnattr_setflags(&attr, flags);
+
+   if (result == 0)
+   {
+      char* emptyEnvironment[] = { NULL };
+      char** envp = ::environ;
+      if (pEnvironment)
+         envp = !pEnvironment->empty() ? pEnvironment->args() : emptyEnvironment;
+
+      PidType pid = -1;
+      result = ::posix_spawn(&pid, exe.c_str(), &actions, &attr, args.args(), envp);
+      if (result == 0)
+         *pPid = pid;
+   }
+
+   ::posix_spawnattr_destroy(&attr);
+   ::posix_spawn_file_actions_destroy(&actions);
+
+   if (result != 0)
+   {
+      Error error = systemError(result, ERROR_LOCATION);
+      error.addProperty("exe", exe);
+      return error;
+   }
+
+   return Success();
+}
+
+#else
+
+bool canSpawnChildProcess(const ProcessOptions&, const int*, const int*, const int*)
+{
+   return false;
+}
+
+Error spawnChildProcess(const std::string&,
+                        const ProcessArgs&,
+                        const ProcessArgs*,
+                        const ProcessOptions&,
+                        const int*,
+                        const int*,
+                        const int*,
+                        PidType*)
+{
+   return systemError(boost::system::errc::operation_not_supported,
+                      ERROR_LOCATION);
+}
+
+#endif
+
 } // anonymous namespace
 
 
@@ -437,6 +616,7 @@ Error ChildProcess::run()
    int fdError[2] = {0,0};
    int fdCloseFd[2] = {0,0};
    int fdMaster = 0;
+   bool spawned = false;
 
    // build args (on heap so they stay around after exec)
    // create set of args to pass (needs to include the cmd)
@@ -533,8 +713,18 @@ Error ChildProcess::run()
          return error;
       }
 
+      // launch with posix_spawn where we can. if that fails (e.g. the
+      // executable doesn't exist) fall through to fork so that the failure
+      // is reported exactly as it always has been (via the child's exit)
+      if (canSpawnChildProcess(options_, fdInput, fdOutput, fdError))
+      {
+         error = spawnChildProcess(exe_, *pProcessArgs, pEnvironment, options_,
+                                   fdInput, fdOutput, fdError, &pid);
+         spawned = !error;
+      }
+
       // close fd communication channel - only used in threadsafe mode
-      if (options_.threadSafe)
+      if (options_.threadSafe && !spawned)
       {
          error = posixCall<int>(boost::bind(::pipe, fdCloseFd), ERROR_LOCATION);
          if (error)
@@ -547,7 +737,8 @@ Error ChildProcess::run()
       }
 
       // fork
-      error = posixCall<PidType>(::fork, ERROR_LOCATION, &pid);
+      if (!spawned)
+         error = posixCall<PidType>(::fork, ERROR_LOCATION, &pid);
       if (error)
       {
          closePipe(fdInput, ERROR_LOCATION);
@@ -826,7 +1017,7 @@ Error ChildProcess::run()
          closePipe(fdOutput[WRITE], ERROR_LOCATION);
          closePipe(fdError[WRITE], ERROR_LOCATION);
 
-         if (options_.threadSafe)
+         if (options_.threadSafe && !spawned)
          {
             closePipe(fdCloseFd[READ], ERROR_LOCATION);
          }
@@ -837,7 +1028,7 @@ Error ChildProcess::run()
 
       delete pProcessArgs;
 
-      if (options_.threadSafe)
+      if (options_.threadSafe && !spawned)
       {
          // send the list of the child proc's fds to the child so
          // it can properly close its unneeded fds in a fast manner
@@ -902,13 +1093,15 @@ struct AsyncChildProcess::AsyncImpl
       : calledOnStarted_(false),
         finishedStdout_(false),
         finishedStderr_(false),
-        exited_(false)
+        exited_(false),
+        outputPaused_(false)
    {
    }
    bool calledOnStarted_;
    bool finishedStdout_;
    bool finishedStderr_;
    bool exited_;
+   bool outputPaused_;
    boost::scoped_ptr<ChildProcessSubprocPoll> pSubprocPoll_;
 };
 
@@ -1013,25 +1206,23 @@ void AsyncChildProcess::poll()
       pAsyncImpl_->pSubprocPoll_.reset(new ChildProcessSubprocPoll(
          pImpl_->pid,
          kResetRecentDelay, kCheckSubprocDelay, kCheckCwdDelay,
-         options().reportHasSubprocs ? core::system::getSubprocesses : NULL,
+         options().reportHasSubprocs ? subprocessesFunction() : NULL,
          options().subprocWhitelist,
-         options().trackCwd ? core::system::currentWorkingDir : NULL));
+         options().trackCwd ? currentWorkingDirFunction() : NULL));
 
       if (callbacks_.onStarted)
          callbacks_.onStarted(*this);
       pAsyncImpl_->calledOnStarted_ = true;
    }
+
    // call onContinue
-   if (callbacks_.onContinue)
-   {
-      if (!callbacks_.onContinue(*this))
-      {
-         // terminate the proces
-         Error error = terminate();
-         if (error)
-            LOG_ERROR(error);
-      }
-   }
+   callOnContinue();
+
+   // leave output in the pipe if the consumer has fallen behind
+   pAsyncImpl_->outputPaused_ =
+         callbacks_.isOutputPaused && callbacks_.isOutputPaused();
+   if (pAsyncImpl_->outputPaused_)
+      return;
 
    bool hasRecentOutput = false;
 
@@ -1143,6 +1334,60 @@ bool AsyncChildProcess::exited()
    return pAsyncImpl_->exited_;
 }
 
+void AsyncChildProcess::callOnContinue()
+{
+   // onContinue is never called before onStarted
+   if (!pAsyncImpl_->calledOnStarted_ || !callbacks_.onContinue)
+      return;
+
+   if (!callbacks_.onContinue(*this))
+   {
+      // terminate the proces
+      Error error = terminate();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+bool AsyncChildProcess::needsPeriodicPoll() const
+{
+   // onStarted hasn't been called yet
+   if (!pAsyncImpl_->calledOnStarted_)
+      return true;
+
+   // output left unread isn't watched for until it's read
+   if (pAsyncImpl_->outputPaused_)
+      return true;
+
+   // periodic subprocess and cwd checks (terminals)
+   if (options().reportHasSubprocs || options().trackCwd)
+      return true;
+
+   // recent output is only forgotten while polling
+   return hasRecentOutput();
+}
+
+std::vector<int> AsyncChildProcess::openOutputFds() const
+{
+   std::vector<int> fds;
+   if (pAsyncImpl_->exited_)
+      return fds;
+
+   if (!pAsyncImpl_->finishedStdout_ && pImpl_->fdStdout != -1)
+      fds.push_back(pImpl_->fdStdout);
+   if (!pAsyncImpl_->finishedStderr_ && pImpl_->fdStderr != -1 &&
+       !options().pseudoterminal)
+   {
+      fds.push_back(pImpl_->fdStderr);
+   }
+   return fds;
+}
+
+bool AsyncChildProcess::outputPaused() const
+{
+   return pAsyncImpl_->outputPaused_;
+}
+
 struct AsioAsyncChildProcess::Impl : public boost::enable_shared_from_this<AsioAsyncChildProcess::Impl>
 {
    Impl(AsioAsyncChildProcess* parent,
@@ -50,6 +50,8 @@
 #include <sys/prctl.h>
 #include <sys/sysinfo.h>
 #include <linux/kernel.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <dirent.h>
 #endif
 
@@ -84,6 +86,10 @@
 #include <core/system/Process.hpp>
 #include <core/system/ShellUtils.hpp>
 
+#ifndef __APPLE__
+#include <core/system/ProcessTable.hpp>
+#endif
+
 #include "config.h"
 
 namespace rstudio {
@@ -861,6 +867,87 @@ bool isReadOnly(const FilePath& filePath)
    }
 }
    
+Error cloneFile(const FilePath& sourcePath, const FilePath& targetPath)
+{
+#ifdef FICLONE
+   int sourceFd = ::open(sourcePath.absolutePath().c_str(), O_RDONLY);
+   if (sourceFd == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", sourcePath);
+      return error;
+   }
+
+   struct stat st;
+   if (::fstat(sourceFd, &st) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", sourcePath);
+      ::close(sourceFd);
+      return error;
+   }
+
+   int targetFd = ::open(targetPath.absolutePath().c_str(),
+                         O_WRONLY | O_CREAT | O_EXCL,
+                         st.st_mode & 0777);
+   if (targetFd == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", targetPath);
+      ::close(sourceFd);
+      return error;
+   }
+
+   // share the source's extents (fails if the filesystem can't, or the
+   // files are on different filesystems)
+   Error error;
+   if (::ioctl(targetFd, FICLONE, sourceFd) == -1)
+   {
+      error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", sourcePath);
+      error.addProperty("target-path", targetPath);
+   }
+
+   ::close(targetFd);
+   ::close(sourceFd);
+
+   if (error)
+      ::unlink(targetPath.absolutePath().c_str());
+
+   return error;
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
+Error linkFile(const FilePath& sourcePath, const FilePath& targetPath)
+{
+   if (::link(sourcePath.absolutePath().c_str(),
+              targetPath.absolutePath().c_str()) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", sourcePath);
+      error.addProperty("target-path", targetPath);
+      return error;
+   }
+
+   return Success();
+}
+
+Error linkCount(const FilePath& filePath, std::size_t* pCount)
+{
+   struct stat st;
+   if (::stat(filePath.absolutePath().c_str(), &st) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", filePath);
+      return error;
+   }
+
+   *pCount = st.st_nlink;
+   return Success();
+}
+
 bool stderrIsTerminal()
 {
    return ::isatty(STDERR_FILENO) == 1;
@@ -1077,127 +1164,23 @@ std::vector<SubprocInfo> getSubprocessesMac(PidType pid)
 
 std::vector<SubprocInfo> getSubprocessesViaProcFs(PidType pid)
 {
-   std::vector<SubprocInfo> subprocs;
-
    core::FilePath procFsPath("/proc");
    if (!procFsPath.exists())
    {
       return getSubprocessesViaPgrep(pid);
    }
 
-   // We iterate all /proc/###/stat files, where ### is a process id.
-   //
-   // The parent pid is the fourth field (whitespace separated) in the
-   // single-line of the stat file. The first field is an int, second field
-   // is a string enclosed in parenthesis (...), the third is a single
-   // character, and the fourth is the parent pid (int). There are numerous
-   // fields after that, all ints of varying sizes.
-   //
-   // The trick is that the third field can contain arbitrary text,
-   // including whitespace and more parenthesis, inside its surrounding
-   // parenthesis. The safe way to parse this is to search the file
-   // in reverse for the closing parenthesis, then seek forward until we
-   // reach the first integer character.
-   //
-   // An example:
-   //    4075 (My )(great Program) S 4074 ....
-
-   std::vector<FilePath> children;
-   Error error = procFsPath.children(&children);
+   // read a fresh snapshot of the process table (callers which check
+   // often should use the shared processTableService() instead)
+   ProcessTable table;
+   Error error = table.refresh();
    if (error)
    {
       LOG_ERROR(error);
-      return subprocs;
-   }
-
-   BOOST_FOREACH(const FilePath& child, children)
-   {
-      // only interested in the numeric directories (pid)
-      std::string filename = child.filename();
-      bool isNumber = true;
-      for (std::string::const_iterator k = filename.begin(); k != filename.end(); ++k)
-      {
-         if (!isdigit(*k))
-         {
-            isNumber = false;
-            break;
-         }
-      }
-
-      if (!isNumber)
-         continue;
-
-      // load the stat file
-      std::string contents;
-      FilePath statFile(child.complete("stat"));
-      Error error = rstudio::core::readStringFromFile(statFile, &contents);
-      if (error)
-      {
-         continue;
-      }
-
-      size_t closingParen = contents.find_last_of(')');
-      if (closingParen == std::string::npos)
-      {
-         LOG_ERROR_MESSAGE("no closing parenthesis");
-         continue;
-      }
-
-      size_t i = contents.find_first_of("0123456789", closingParen);
-      if (i == std::string::npos)
-      {
-         LOG_ERROR_MESSAGE("no integer after closing parenthesis");
-         continue;
-      }
-
-      size_t j = contents.find_first_not_of("0123456789", i);
-      if (j == std::string::npos)
-      {
-         LOG_ERROR_MESSAGE("no non-int after first int");
-         continue;
-      }
-
-      size_t ppidLen = j - i;
-      PidType ppid = safe_convert::stringTo<PidType>(contents.substr(i, ppidLen), -1);
-      if (ppid == -1)
-      {
-         LOG_ERROR_MESSAGE("unrecognized parent process id");
-         continue;
-      }
-      if (ppid != pid)
-      {
-         continue;
-      }
-
-      size_t openParen = contents.find_first_of('(');
-      if (openParen == std::string::npos)
-      {
-         LOG_ERROR_MESSAGE("no opening parenthesis");
-         continue;
-      }
-      if (openParen < 2) // at a minimum, "# (foo)"
-      {
-         LOG_ERROR_MESSAGE("no pid before exe name");
-         continue;
-      }
-      if (closingParen < openParen)
-      {
-         LOG_ERROR_MESSAGE("closing paren before open paren");
-         continue;
-      }
-
-      SubprocInfo info;
-      info.exe = contents.substr(openParen + 1, closingParen - openParen - 1);
-      info.pid = safe_convert::stringTo<PidType>(contents.substr(0, openParen - 1), -1);
-      if (info.pid == -1)
-      {
-         LOG_ERROR_MESSAGE("unrecognized child process id");
-         continue;
-      }
-      subprocs.push_back(info);
+      return std::vector<SubprocInfo>();
    }
 
-   return subprocs;
+   return table.children(pid);
 }
 #endif // !__APPLE__
 
@@ -2169,10 +2152,16 @@ Error launchChildProcess(std::string path,
    return Success() ;
 }
 
-Error runProcess(const std::string& path,
-                 const std::string& runAsUser,
-                 ProcessConfig& config,
-                 ProcessConfigFilter configFilter)
+namespace {
+
+// does everything needed to run a process as the given user short of
+// exec'ing it, providing the process's environment and arguments
+Error prepareProcess(const std::string& path,
+                     const std::string& runAsUser,
+                     ProcessConfig& config,
+                     ProcessConfigFilter configFilter,
+                     core::system::Options* pEnvironment,
+                     std::vector<std::string>* pArgs)
 {
    // change user here if requested
    if (!runAsUser.empty())
@@ -2228,7 +2217,7 @@ Error runProcess(const std::string& path,
    }
 
    // setup environment
-   core::system::Options env;
+   core::system::Options& env = *pEnvironment;
    copyEnvironmentVar("PATH", &env);
    copyEnvironmentVar("MANPATH", &env);
    copyEnvironmentVar("LANG", &env);
@@ -2252,6 +2241,35 @@ Error runProcess(const std::string& path,
    // NOTE: this implemenentation ignores the config.stdInput field (that
    // was put in for another consumer)
 
+   // build process args
+   std::vector<std::string>& argVector = *pArgs;
+   argVector.push_back(path);
+   for (core::system::Options::const_iterator it = config.args.begin();
+        it != config.args.end();
+        ++it)
+   {
+      argVector.push_back(it->first);
+      if (!it->second.empty())
+         argVector.push_back(it->second);
+   }
+
+   return Success();
+}
+
+} // anonymous namespace
+
+Error runProcess(const std::string& path,
+                 const std::string& runAsUser,
+                 ProcessConfig& config,
+                 ProcessConfigFilter configFilter)
+{
+   core::system::Options env;
+   std::vector<std::string> argVector;
+   Error error = prepareProcess(path, runAsUser, config, configFilter,
+                                &env, &argVector);
+   if (error)
+      return error;
+
    // format as ProcessArgs expects
    boost::format fmt("%1%=%2%");
    std::vector<std::string> envVars;
@@ -2267,18 +2285,6 @@ Error runProcess(const std::string& path,
    core::system::ProcessArgs* pEnvironment = new core::system::ProcessArgs(
                                                                     envVars);
 
-   // build process args
-   std::vector<std::string> argVector;
-   argVector.push_back(path);
-   for (core::system::Options::const_iterator it = config.args.begin();
-        it != config.args.end();
-        ++it)
-   {
-      argVector.push_back(it->first);
-      if (!it->second.empty())
-         argVector.push_back(it->second);
-   }
-
    // allocate ProcessArgs on heap so memory stays around after we exec
    // (some systems including OSX seem to require this)
    core::system::ProcessArgs* pProcessArgs = new core::system::ProcessArgs(
@@ -2295,6 +2301,37 @@ Error runProcess(const std::string& path,
    return error;
 }
 
+Error specializeProcess(const std::string& path,
+                        const std::string& runAsUser,
+                        ProcessConfig& config,
+                        ProcessConfigFilter configFilter,
+                        std::vector<std::string>* pArgs)
+{
+   core::system::Options env;
+   Error error = prepareProcess(path, runAsUser, config, configFilter,
+                                &env, pArgs);
+   if (error)
+      return error;
+
+   // replace our environment with the one the process would have had
+   core::system::Options currentEnv;
+   core::system::environment(&currentEnv);
+   for (core::system::Options::const_iterator it = currentEnv.begin();
+        it != currentEnv.end();
+        ++it)
+   {
+      core::system::unsetenv(it->first);
+   }
+   for (core::system::Options::const_iterator it = env.begin();
+        it != env.end();
+        ++it)
+   {
+      core::system::setenv(it->first, it->second);
+   }
+
+   return Success();
+}
+
 // simple cass to encapsulate parent-child
 // relationship of processes
 struct ProcessTreeNode
@@ -15,10 +15,16 @@
 
 #ifndef _WIN32
 
+#include <set>
+
 #include <boost/foreach.hpp>
 
+#include <core/FileSerializer.hpp>
+#include <core/system/Environment.hpp>
 #include <core/system/PosixSystem.hpp>
+#include <core/system/ProcessTable.hpp>
 #include <signal.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <tests/TestThat.hpp>
@@ -28,6 +34,32 @@ namespace core {
 namespace system {
 namespace tests {
 
+namespace {
+
+std::size_t links(const FilePath& filePath)
+{
+   std::size_t count = 0;
+   Error error = linkCount(filePath, &count);
+   return error ? 0 : count;
+}
+
+std::string contents(const FilePath& filePath)
+{
+   std::string contents;
+   Error error = readStringFromFile(filePath, &contents);
+   return error ? std::string() : contents;
+}
+
+dev_t deviceOf(const FilePath& filePath)
+{
+   struct stat st;
+   if (::stat(filePath.absolutePath().c_str(), &st) == -1)
+      return 0;
+   return st.st_dev;
+}
+
+} // anonymous namespace
+
 context("PosixSystemTests")
 {
    test_that("Empty subprocess list returned correctly with pgrep method")
@@ -242,6 +274,58 @@ context("PosixSystemTests")
          ::waitpid(pid, NULL, 0);
       }
    }
+
+   test_that("Process table snapshot finds children and descendants")
+   {
+      int fds[2];
+      expect_true(::pipe(fds) == 0);
+
+      pid_t pid = fork();
+      expect_false(pid == -1);
+
+      if (pid == 0)
+      {
+         // start a grandchild and report its pid
+         pid_t grandchild = fork();
+         if (grandchild == 0)
+         {
+            ::sleep(10);
+            _exit(0);
+         }
+         ::write(fds[1], &grandchild, sizeof(grandchild));
+         ::sleep(10);
+         _exit(0);
+      }
+      else
+      {
+         pid_t grandchild = -1;
+         expect_true(::read(fds[0], &grandchild, sizeof(grandchild)) ==
+                     sizeof(grandchild));
+
+         ProcessTable table;
+         Error error = table.refresh();
+         expect_false(error);
+
+         std::set<PidType> children, descendants;
+         BOOST_FOREACH(const SubprocInfo& info, table.children(getpid()))
+            children.insert(info.pid);
+         BOOST_FOREACH(const SubprocInfo& info, table.descendants(getpid()))
+            descendants.insert(info.pid);
+
+         expect_true(children.count(pid));
+         expect_false(children.count(grandchild));
+         expect_true(descendants.count(pid));
+         expect_true(descendants.count(grandchild));
+         expect_false(table.exe(pid).empty());
+
+         ::kill(grandchild, SIGKILL);
+         ::kill(pid, SIGKILL);
+         ::waitpid(pid, NULL, 0);
+      }
+
+      ::close(fds[0]);
+      ::close(fds[1]);
+   }
 #endif // !__APPLE__
 
    test_that("Empty list of subprocesses returned correctly with generic method")
@@ -342,6 +426,147 @@ context("PosixSystemTests")
       }
    }
 #endif // !__APPLE__
+
+   test_that("Specialized process takes on the configured environment and arguments")
+   {
+      pid_t pid = fork();
+      REQUIRE(pid != -1);
+
+      if (pid == 0)
+      {
+         ProcessConfig config;
+         config.args.push_back(std::make_pair("--flag", "value"));
+         config.args.push_back(std::make_pair("--switch", ""));
+         config.environment.push_back(std::make_pair("SPECIALIZED", "1"));
+         core::system::setenv("UNSPECIALIZED", "1");
+
+         std::vector<std::string> args;
+         Error error = specializeProcess("/bin/prog", "", config,
+                                        ProcessConfigFilter(), &args);
+
+         bool ok = !error &&
+               args.size() == 4 &&
+               args[0] == "/bin/prog" &&
+               args[1] == "--flag" && args[2] == "value" &&
+               args[3] == "--switch" &&
+               core::system::getenv("SPECIALIZED") == "1" &&
+               core::system::getenv("UNSPECIALIZED").empty() &&
+               !core::system::getenv("HOME").empty();
+         ::_exit(ok ? 0 : 1);
+      }
+      else
+      {
+         int status = 0;
+         ::waitpid(pid, &status, 0);
+         expect_true(WIFEXITED(status));
+         expect_true(WEXITSTATUS(status) == 0);
+      }
+   }
+   test_that("Linked files count their links")
+   {
+      FilePath dir;
+      REQUIRE(!FilePath::tempFilePath(&dir));
+      REQUIRE(!dir.ensureDirectory());
+      FilePath source = dir.complete("source");
+      FilePath target = dir.complete("target");
+      REQUIRE(!writeStringToFile(source, "contents"));
+      expect_true(links(source) == 1);
+
+      REQUIRE(!linkFile(source, target));
+      expect_true(links(source) == 2);
+      expect_true(links(target) == 2);
+      expect_true(contents(target) == "contents");
+
+      // linking over an existing file fails
+      expect_true(linkFile(source, target));
+
+      REQUIRE(!target.remove());
+      expect_true(links(source) == 1);
+
+      std::size_t count = 0;
+      expect_true(linkCount(target, &count));
+
+      dir.removeIfExists();
+   }
+
+   test_that("A failed clone leaves no target")
+   {
+      FilePath dir;
+      REQUIRE(!FilePath::tempFilePath(&dir));
+      REQUIRE(!dir.ensureDirectory());
+      FilePath source = dir.complete("source");
+      FilePath target = dir.complete("target");
+      REQUIRE(!writeStringToFile(source, "contents"));
+
+      // (cloning depends on the filesystem)
+      Error error = cloneFile(source, target);
+      if (error)
+      {
+         expect_false(target.exists());
+      }
+      else
+      {
+         expect_true(contents(target) == "contents");
+         expect_true(links(source) == 1);
+      }
+
+      dir.removeIfExists();
+   }
+
+   test_that("Shared files are cloned or linked, replacing the target")
+   {
+      FilePath dir;
+      REQUIRE(!FilePath::tempFilePath(&dir));
+      REQUIRE(!dir.ensureDirectory());
+      FilePath source = dir.complete("source");
+      FilePath target = dir.complete("target");
+      REQUIRE(!writeStringToFile(source, "contents"));
+      REQUIRE(!writeStringToFile(target, "old contents"));
+
+      REQUIRE(!shareFile(source, target));
+      expect_true(contents(target) == "contents");
+
+      // linked unless it could be cloned
+      FilePath clone = dir.complete("clone");
+      if (cloneFile(source, clone))
+         expect_true(links(source) == 2);
+      else
+         expect_true(links(source) == 1);
+
+      dir.removeIfExists();
+   }
+
+   test_that("Files which can't be linked are shared as copies")
+   {
+      // files can't be linked across filesystems, so this needs a temporary
+      // directory on another one (which files can be copied to: some
+      // versions of boost fail to copy between some filesystems)
+      FilePath dir;
+      REQUIRE(!FilePath::tempFilePath(&dir));
+      REQUIRE(!dir.ensureDirectory());
+      FilePath source = dir.complete("source");
+      REQUIRE(!writeStringToFile(source, "contents"));
+
+      FilePath otherDir("/dev/shm");
+      FilePath target = otherDir.complete(dir.filename() + "-target");
+      if (otherDir.exists() &&
+          deviceOf(otherDir) != deviceOf(dir) &&
+          !source.copy(target) &&
+          !target.remove())
+      {
+         expect_true(linkFile(source, target));
+         expect_false(target.exists());
+
+         REQUIRE(!shareFile(source, target));
+         expect_true(contents(target) == "contents");
+         expect_true(links(source) == 1);
+         expect_true(links(target) == 1);
+
+         target.removeIfExists();
+      }
+
+      dir.removeIfExists();
+   }
 }
 
 } // end namespace tests
@@ -16,6 +16,7 @@
 #include <core/system/Process.hpp>
 
 #include <iostream>
+#include <set>
 
 #include <boost/algorithm/cxx11/any_of.hpp>
 #include <boost/bind.hpp>
@@ -25,10 +26,15 @@
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/BoostThread.hpp>
+#include <core/Thread.hpp>
 
 #include <core/PerformanceTimer.hpp>
 #include <core/system/ChildProcess.hpp>
 
+#ifdef __linux__
+#include "ChildProcessReactor.hpp"
+#endif
+
 namespace rstudio {
 namespace core {
 namespace system {
@@ -69,11 +75,164 @@ Error runCommand(const std::string& command,
 
 struct ProcessSupervisor::Impl
 {
-   Impl() : isPolling(false) {}
+   Impl() : isPolling(false), continueRequested(false), reactorFailed(false) {}
    bool isPolling;
    std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+
+   boost::mutex activityMutex;
+   boost::function<void()> onActivity;
+   bool continueRequested;
+
+   // when onContinue was last called for every child
+   boost::posix_time::ptime lastContinueTime;
+
+   void notifyActivity()
+   {
+      boost::function<void()> handler;
+      LOCK_MUTEX(activityMutex)
+      {
+         handler = onActivity;
+      }
+      END_LOCK_MUTEX
+
+      if (handler)
+         handler();
+   }
+
+   // is onContinue due for children which otherwise don't need polling?
+   bool takeContinueDue()
+   {
+      bool requested = false;
+      LOCK_MUTEX(activityMutex)
+      {
+         requested = continueRequested;
+         continueRequested = false;
+      }
+      END_LOCK_MUTEX
+
+      using namespace boost::posix_time;
+      ptime now = microsec_clock::universal_time();
+      if (!requested &&
+          !lastContinueTime.is_not_a_date_time() &&
+          now - lastContinueTime < ProcessSupervisor::kContinueInterval)
+      {
+         return false;
+      }
+
+      lastContinueTime = now;
+      return true;
+   }
+
+   // start watching a newly launched child
+   void watchChild(const boost::shared_ptr<AsyncChildProcess>& pChild)
+   {
+#ifdef __linux__
+      if (!startReactor())
+         return;
+
+      bool watchesExit = false;
+      Error error = pReactor->add(pChild.get(),
+                                  pChild->getPid(),
+                                  pChild->openOutputFds(),
+                                  &watchesExit);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return;
+      }
+
+      // if we can't be told about exit we need to poll anyway
+      if (watchesExit)
+         watchedChildren.insert(pChild.get());
+      else
+         pReactor->remove(pChild.get());
+#endif
+   }
+
+   // take the set of children with pending output or exit events
+   void takeReadyChildren()
+   {
+#ifdef __linux__
+      readyChildren.clear();
+      if (pReactor)
+         pReactor->takeReady(&readyChildren);
+#endif
+   }
+
+   bool needsPoll(const AsyncChildProcess& child)
+   {
+#ifdef __linux__
+      return !watchedChildren.count(&child) ||
+             readyChildren.count(&child) ||
+             child.needsPeriodicPoll();
+#else
+      return true;
+#endif
+   }
+
+   // watch for output again once a child has been polled. a child whose
+   // output is paused still has unread output, so it isn't watched again
+   // until a poll reads it (paused children are polled periodically)
+   void rearmChild(AsyncChildProcess& child)
+   {
+#ifdef __linux__
+      if (!readyChildren.count(&child) && !disarmedChildren.count(&child))
+         return;
+      if (child.exited())
+         return;
+
+      if (child.outputPaused())
+      {
+         disarmedChildren.insert(&child);
+         return;
+      }
+
+      disarmedChildren.erase(&child);
+      pReactor->rearm(&child, child.openOutputFds());
+#endif
+   }
+
+   void unwatchChild(const AsyncChildProcess& child)
+   {
+#ifdef __linux__
+      disarmedChildren.erase(&child);
+      if (watchedChildren.erase(&child))
+         pReactor->remove(&child);
+#endif
+   }
+
+#ifdef __linux__
+   bool startReactor()
+   {
+      if (pReactor)
+         return true;
+      if (reactorFailed)
+         return false;
+
+      pReactor.reset(new ChildProcessReactor());
+      Error error = pReactor->start(boost::bind(&Impl::notifyActivity, this));
+      if (error)
+      {
+         // fall back to polling every child
+         LOG_ERROR(error);
+         pReactor.reset();
+         reactorFailed = true;
+         return false;
+      }
+      return true;
+   }
+
+   boost::scoped_ptr<ChildProcessReactor> pReactor;
+   std::set<ChildProcessReactor::Child> watchedChildren;
+   std::set<ChildProcessReactor::Child> readyChildren;
+   std::set<ChildProcessReactor::Child> disarmedChildren;
+#endif
+   bool reactorFailed;
 };
 
+const boost::posix_time::time_duration ProcessSupervisor::kContinueInterval =
+      boost::posix_time::milliseconds(500);
+
 ProcessSupervisor::ProcessSupervisor()
    : pImpl_(new Impl())
 {
@@ -115,7 +274,10 @@ Error ProcessSupervisor::runProgram(const std::string& executable,
                                                        options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), callbacks);
+   Error error = runChild(pChild, &(pImpl_->children), callbacks);
+   if (!error)
+      pImpl_->watchChild(pChild);
+   return error;
 }
 
 Error ProcessSupervisor::runCommand(const std::string& command,
@@ -127,7 +289,10 @@ Error ProcessSupervisor::runCommand(const std::string& command,
                                  new AsyncChildProcess(command, options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), callbacks);
+   Error error = runChild(pChild, &(pImpl_->children), callbacks);
+   if (!error)
+      pImpl_->watchChild(pChild);
+   return error;
 }
 
 Error ProcessSupervisor::runTerminal(const ProcessOptions& options,
@@ -138,7 +303,10 @@ Error ProcessSupervisor::runTerminal(const ProcessOptions& options,
                                  new AsyncChildProcess(options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), callbacks);
+   Error error = runChild(pChild, &(pImpl_->children), callbacks);
+   if (!error)
+      pImpl_->watchChild(pChild);
+   return error;
 }
 
 namespace {
@@ -324,15 +492,37 @@ bool ProcessSupervisor::poll()
    // runProgram or runCommand. This would then result in a push_back on
    // the children vector and if this requried a realloc would invalidate
    // all of the iterators currently pointing into the container
+   //
+   // children which are being watched for events in the background are
+   // only polled if they have events pending or need periodic attention;
+   // the rest just have onContinue called every kContinueInterval (or
+   // sooner when requested via continueSoon)
+   pImpl_->takeReadyChildren();
+   bool continueDue = pImpl_->takeContinueDue();
    std::vector<boost::shared_ptr<AsyncChildProcess> > children = pImpl_->children;
-   std::for_each(children.begin(),
-                 children.end(),
-                 boost::bind(&AsyncChildProcess::poll, _1));
+   BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild, children)
+   {
+      if (!pImpl_->needsPoll(*pChild))
+      {
+         if (continueDue)
+            pChild->callOnContinue();
+         continue;
+      }
+
+      pChild->poll();
+      pImpl_->rearmChild(*pChild);
+   }
 
    // remove any children who have exited from our list. note that it's safe
    // in this case to use pImpl_->children directly because the call to
    // AsyncChildProcess::exited just checks a member variable rather than
    // executing code that could cause re-entry
+   BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild,
+                 pImpl_->children)
+   {
+      if (pChild->exited())
+         pImpl_->unwatchChild(*pChild);
+   }
    pImpl_->children.erase(std::remove_if(
                              pImpl_->children.begin(),
                              pImpl_->children.end(),
@@ -343,6 +533,25 @@ bool ProcessSupervisor::poll()
    return hasRunningChildren();
 }
 
+void ProcessSupervisor::setActivityHandler(
+                                 const boost::function<void()>& onActivity)
+{
+   LOCK_MUTEX(pImpl_->activityMutex)
+   {
+      pImpl_->onActivity = onActivity;
+   }
+   END_LOCK_MUTEX
+}
+
+void ProcessSupervisor::continueSoon()
+{
+   LOCK_MUTEX(pImpl_->activityMutex)
+   {
+      pImpl_->continueRequested = true;
+   }
+   END_LOCK_MUTEX
+}
+
 void ProcessSupervisor::terminateAll()
 {
    // call terminate on all of our children
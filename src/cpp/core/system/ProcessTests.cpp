@@ -22,6 +22,7 @@
 #include <boost/thread.hpp>
 
 #include <core/SafeConvert.hpp>
+#include <core/system/Environment.hpp>
 #include <core/system/PosixProcess.hpp>
 #include <core/system/PosixChildProcess.hpp>
 #include <core/system/PosixSystem.hpp>
@@ -378,6 +379,275 @@ context("ProcessTests")
          CHECK(outputs[i] == "Hello, " + safe_convert::numberToString(i) + "\n");
       }
    }
+
+   test_that("ProcessSupervisor notifies when children have output or exit")
+   {
+      ProcessSupervisor supervisor;
+
+      boost::mutex mutex;
+      boost::condition_variable activity;
+      bool hasActivity = false;
+      supervisor.setActivityHandler([&]() {
+         LOCK_MUTEX(mutex)
+         {
+            hasActivity = true;
+         }
+         END_LOCK_MUTEX
+         activity.notify_all();
+      });
+
+      const int numProcs = 10;
+      int exitCodes[numProcs];
+      std::string outputs[numProcs];
+      for (int i = 0; i < numProcs; ++i)
+      {
+         exitCodes[i] = -1;
+
+         std::vector<std::string> args;
+         args.push_back("-c");
+         args.push_back("sleep 0.2; echo Hello, " + safe_convert::numberToString(i));
+
+         ProcessCallbacks callbacks;
+         callbacks.onExit = boost::bind(&checkExitCode, _1, exitCodes + i);
+         callbacks.onStdout = boost::bind(&appendOutput, _2, outputs + i);
+
+         Error error = supervisor.runProgram("/bin/sh", args, ProcessOptions(), callbacks);
+         REQUIRE_FALSE(error);
+      }
+
+      // poll only when told to (with a generous fallback for platforms
+      // where children can't be watched)
+      boost::posix_time::ptime timeout =
+            boost::get_system_time() + boost::posix_time::seconds(10);
+      while (supervisor.poll() && boost::get_system_time() < timeout)
+      {
+         boost::unique_lock<boost::mutex> lock(mutex);
+         if (!hasActivity)
+            activity.timed_wait(lock, boost::posix_time::milliseconds(1000));
+         hasActivity = false;
+      }
+
+      CHECK_FALSE(supervisor.hasRunningChildren());
+      for (int i = 0; i < numProcs; ++i)
+      {
+         CHECK(exitCodes[i] == 0);
+         CHECK(outputs[i] == "Hello, " + safe_convert::numberToString(i) + "\n");
+      }
+   }
+
+   test_that("ProcessSupervisor leaves paused output unread")
+   {
+      ProcessSupervisor supervisor;
+
+      // more output than a pipe holds, so the child blocks until it's read
+      std::vector<std::string> args;
+      args.push_back("-c");
+      args.push_back("head -c 200000 /dev/zero | tr '\\0' x");
+
+      bool paused = true;
+      int exitCode = -1;
+      std::string output;
+      ProcessCallbacks callbacks;
+      callbacks.isOutputPaused = [&]() { return paused; };
+      callbacks.onExit = boost::bind(&checkExitCode, _1, &exitCode);
+      callbacks.onStdout = boost::bind(&appendOutput, _2, &output);
+
+      Error error = supervisor.runProgram("/bin/sh", args, ProcessOptions(), callbacks);
+      REQUIRE_FALSE(error);
+
+      for (int i = 0; i < 20; ++i)
+      {
+         CHECK(supervisor.poll());
+         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      }
+      CHECK(output.empty());
+      CHECK(exitCode == -1);
+
+      paused = false;
+      boost::posix_time::ptime timeout =
+            boost::get_system_time() + boost::posix_time::seconds(10);
+      while (supervisor.poll() && boost::get_system_time() < timeout)
+         boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
+      CHECK(exitCode == 0);
+      CHECK(output == std::string(200000, 'x'));
+   }
+
+#ifdef __linux__
+   test_that("ProcessSupervisor calls onContinue for idle children at an interval")
+   {
+      ProcessSupervisor supervisor;
+
+      std::vector<std::string> args;
+      args.push_back("-c");
+      args.push_back("sleep 5");
+
+      int continues = 0;
+      ProcessCallbacks callbacks;
+      callbacks.onContinue = [&](ProcessOperations&) { ++continues; return true; };
+
+      Error error = supervisor.runProgram("/bin/sh", args, ProcessOptions(), callbacks);
+      REQUIRE_FALSE(error);
+
+      // poll often, first until the child no longer counts as recently
+      // active (which keeps it polled) and then while it's idle
+      int polls = 0;
+      for (int i = 0; i < 2; ++i)
+      {
+         continues = 0;
+         polls = 0;
+         boost::posix_time::ptime start = boost::get_system_time();
+         while (boost::get_system_time() - start < boost::posix_time::milliseconds(1200))
+         {
+            CHECK(supervisor.poll());
+            ++polls;
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+         }
+      }
+
+      // the idle child only had onContinue called every kContinueInterval
+      CHECK(polls > 50);
+      CHECK(continues >= 2);
+      CHECK(continues <= 3);
+
+      // unless it's asked for
+      int before = continues;
+      supervisor.continueSoon();
+      CHECK(supervisor.poll());
+      CHECK(continues == before + 1);
+      CHECK(supervisor.poll());
+      CHECK(continues == before + 1);
+
+      supervisor.terminateAll();
+      CHECK(supervisor.wait(boost::posix_time::milliseconds(10),
+                            boost::posix_time::seconds(10)));
+   }
+
+   test_that("ProcessSupervisor terminates idle children when onContinue returns false")
+   {
+      ProcessSupervisor supervisor;
+
+      std::vector<std::string> args;
+      args.push_back("-c");
+      args.push_back("sleep 30");
+
+      bool stop = false;
+      int exitCode = 0;
+      ProcessCallbacks callbacks;
+      callbacks.onContinue = [&](ProcessOperations&) { return !stop; };
+      callbacks.onExit = boost::bind(&checkExitCode, _1, &exitCode);
+
+      Error error = supervisor.runProgram("/bin/sh", args, ProcessOptions(), callbacks);
+      REQUIRE_FALSE(error);
+      CHECK(supervisor.poll());
+
+      stop = true;
+      boost::posix_time::ptime timeout =
+            boost::get_system_time() + boost::posix_time::seconds(10);
+      while (supervisor.poll() && boost::get_system_time() < timeout)
+         boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+
+      CHECK_FALSE(supervisor.hasRunningChildren());
+      CHECK(exitCode != 0);
+   }
+#endif
+
+   test_that("Spawned and forked children honor the same process options")
+   {
+      std::vector<std::string> args;
+      args.push_back("-c");
+      args.push_back("pwd; echo $FOO; echo error 1>&2; "
+                     "test \"$(cut -d' ' -f5 /proc/$$/stat)\" = $$ && echo leader");
+
+      // setting onAfterFork forces the fork path
+      for (int i = 0; i < 2; ++i)
+      {
+         ProcessOptions options;
+         options.workingDir = FilePath("/");
+         options.redirectStdErrToStdOut = true;
+         options.terminateChildren = true;
+         if (i == 1)
+            options.onAfterFork = [](){};
+
+         Options environment;
+         core::system::setenv(&environment, "FOO", "bar");
+         core::system::setenv(&environment, "PATH", core::system::getenv("PATH"));
+         options.environment = environment;
+
+         ProcessResult result;
+         Error error = runProgram("/bin/sh", args, "", options, &result);
+         REQUIRE_FALSE(error);
+         CHECK(result.exitStatus == 0);
+         CHECK(result.stdOut == "/\nbar\nerror\nleader\n");
+
+         // a missing executable is reported through the child's exit status
+         error = runProgram("/does/not/exist", std::vector<std::string>(), "",
+                            options, &result);
+         REQUIRE_FALSE(error);
+         CHECK(result.exitStatus != 0);
+      }
+   }
+
+   test_that("Children launch while the parent has a large resident set")
+   {
+      std::vector<char> ballast(16 * 1024 * 1024, 1);
+      for (int fork = 0; fork < 2; ++fork)
+      {
+         ProcessOptions options;
+         if (fork)
+            options.onAfterFork = [](){};
+
+         for (int i = 0; i < 3; ++i)
+         {
+            ProcessResult result;
+            Error error = runProgram("/bin/true", std::vector<std::string>(), "",
+                                     options, &result);
+            REQUIRE_FALSE(error);
+            CHECK(result.exitStatus == 0);
+         }
+      }
+   }
+
+   // launch latency against parent size is only measured on request, as it
+   // is slow and needs a lot of memory
+   if (!core::system::getenv("RSTUDIO_BENCHMARK_CHILD_LAUNCH").empty())
+   {
+      test_that("Benchmark child launch latency against parent size")
+      {
+         const int kLaunches = 20;
+         const std::size_t kSizes[] = { 0, 64, 512 };
+         for (std::size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i)
+         {
+            // grow the parent's resident set by touching every page
+            std::vector<char> ballast(kSizes[i] * 1024 * 1024, 1);
+
+            for (int fork = 0; fork < 2; ++fork)
+            {
+               ProcessOptions options;
+               if (fork)
+                  options.onAfterFork = [](){};
+
+               boost::posix_time::ptime start =
+                     boost::posix_time::microsec_clock::universal_time();
+               for (int j = 0; j < kLaunches; ++j)
+               {
+                  ProcessResult result;
+                  Error error = runProgram("/bin/true", std::vector<std::string>(), "",
+                                           options, &result);
+                  REQUIRE_FALSE(error);
+                  CHECK(result.exitStatus == 0);
+               }
+               boost::posix_time::time_duration elapsed =
+                     boost::posix_time::microsec_clock::universal_time() - start;
+
+               std::cout << (fork ? "fork " : "spawn") << " with " << kSizes[i]
+                         << "MB resident: "
+                         << elapsed.total_microseconds() / kLaunches
+                         << "us per launch" << std::endl;
+            }
+         }
+      }
+   }
 }
 
 } // end namespace tests
@@ -89,6 +89,23 @@ std::string generateShortenedUuid()
    return core::hash::crc32HexHash(uuid);
 }
 
+Error shareFile(const FilePath& sourcePath, const FilePath& targetPath)
+{
+   Error error = targetPath.removeIfExists();
+   if (error)
+      return error;
+
+   error = cloneFile(sourcePath, targetPath);
+   if (!error)
+      return Success();
+
+   error = linkFile(sourcePath, targetPath);
+   if (!error)
+      return Success();
+
+   return sourcePath.copy(targetPath);
+}
+
 
 } // namespace system
 } // namespace core
@@ -15,6 +15,7 @@
 
 #include <core/system/System.hpp>
 #include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <tests/TestThat.hpp>
@@ -26,6 +27,33 @@ namespace tests {
 
 context("SystemTests")
 {
+   test_that("Hard links to a file are counted")
+   {
+      FilePath dir;
+      REQUIRE(!FilePath::tempFilePath(&dir));
+      REQUIRE(!dir.ensureDirectory());
+      FilePath file = dir.complete("file");
+      FilePath link = dir.complete("link");
+      REQUIRE(!writeStringToFile(file, "contents"));
+
+      std::size_t count = 0;
+      REQUIRE(!linkCount(file, &count));
+      expect_true(count == 1);
+
+      REQUIRE(!linkFile(file, link));
+      REQUIRE(!linkCount(file, &count));
+      expect_true(count == 2);
+      REQUIRE(!linkCount(link, &count));
+      expect_true(count == 2);
+
+      REQUIRE(!link.remove());
+      REQUIRE(!linkCount(file, &count));
+      expect_true(count == 1);
+
+      expect_true(linkCount(link, &count));
+
+      dir.removeIfExists();
+   }
 }
 
 } // end namespace tests
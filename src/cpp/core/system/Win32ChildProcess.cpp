@@ -606,12 +606,14 @@ struct AsyncChildProcess::AsyncImpl
 {
    AsyncImpl()
       : calledOnStarted_(false),
-        exited_(false)
+        exited_(false),
+        outputPaused_(false)
    {
    }
 
    bool calledOnStarted_;
    bool exited_;
+   bool outputPaused_;
    boost::scoped_ptr<ChildProcessSubprocPoll> pSubprocPoll_;
  };
 
@@ -697,17 +699,13 @@ void AsyncChildProcess::poll()
    }
 
    // call onContinue
-   if (callbacks_.onContinue)
-   {
-      if (!callbacks_.onContinue(*this) && !pImpl_->terminated)
-      {
-         // terminate the process
-         Error error = terminate();
-         if (error)
-            LOG_ERROR(error);
-         pImpl_->terminated = true;
-      }
-   }
+   callOnContinue();
+
+   // leave output in the pipe if the consumer has fallen behind
+   pAsyncImpl_->outputPaused_ =
+         callbacks_.isOutputPaused && callbacks_.isOutputPaused();
+   if (pAsyncImpl_->outputPaused_)
+      return;
 
    bool hasRecentOutput = false;
 
@@ -807,6 +805,37 @@ bool AsyncChildProcess::exited()
    return pImpl_->hProcess == NULL;
 }
 
+bool AsyncChildProcess::outputPaused() const
+{
+   return pAsyncImpl_->outputPaused_;
+}
+
+void AsyncChildProcess::callOnContinue()
+{
+   // onContinue is never called before onStarted
+   if (!pAsyncImpl_->calledOnStarted_ || !callbacks_.onContinue)
+      return;
+
+   if (!callbacks_.onContinue(*this) && !pImpl_->terminated)
+   {
+      // terminate the process
+      Error error = terminate();
+      if (error)
+         LOG_ERROR(error);
+      pImpl_->terminated = true;
+   }
+}
+
+bool AsyncChildProcess::needsPeriodicPoll() const
+{
+   return true;
+}
+
+std::vector<int> AsyncChildProcess::openOutputFds() const
+{
+   return std::vector<int>();
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
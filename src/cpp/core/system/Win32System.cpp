@@ -615,6 +615,56 @@ bool isReadOnly(const FilePath& filePath)
    return false;
 }
 
+Error cloneFile(const FilePath& sourcePath, const FilePath& targetPath)
+{
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+}
+
+Error linkFile(const FilePath& sourcePath, const FilePath& targetPath)
+{
+   if (!::CreateHardLinkW(targetPath.absolutePathW().c_str(),
+                          sourcePath.absolutePathW().c_str(),
+                          NULL))
+   {
+      Error error = LAST_SYSTEM_ERROR();
+      error.addProperty("path", sourcePath);
+      error.addProperty("target-path", targetPath);
+      return error;
+   }
+
+   return Success();
+}
+
+Error linkCount(const FilePath& filePath, std::size_t* pCount)
+{
+   HANDLE hFile = ::CreateFileW(filePath.absolutePathW().c_str(),
+                                0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                   FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS,
+                                NULL);
+   if (hFile == INVALID_HANDLE_VALUE)
+   {
+      Error error = LAST_SYSTEM_ERROR();
+      error.addProperty("path", filePath);
+      return error;
+   }
+   CloseHandleOnExitScope closeFile(&hFile, ERROR_LOCATION);
+
+   BY_HANDLE_FILE_INFORMATION info;
+   if (!::GetFileInformationByHandle(hFile, &info))
+   {
+      Error error = LAST_SYSTEM_ERROR();
+      error.addProperty("path", filePath);
+      return error;
+   }
+
+   *pCount = info.nNumberOfLinks;
+   return Success();
+}
+
 Error makeFileHidden(const FilePath& path)
 {
    std::wstring filePath = path.absolutePathW();
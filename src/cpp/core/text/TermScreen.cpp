@@ -0,0 +1,1058 @@
+/*
+ * TermScreen.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/text/TermScreen.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include <boost/lexical_cast.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+namespace {
+
+const char kEsc = '\x1b';
+const char* const kCsi = "\x1b[";
+
+// attribute flags, in the same order as the SGR codes which set them
+enum AttributeFlag
+{
+   kBold       = 1 << 0,
+   kDim        = 1 << 1,
+   kItalic     = 1 << 2,
+   kUnderline  = 1 << 3,
+   kBlink      = 1 << 4,
+   kInverse    = 1 << 5,
+   kInvisible  = 1 << 6,
+   kStrike     = 1 << 7
+};
+
+const int kFlagCodes[] = { 1, 2, 3, 4, 5, 7, 8, 9 };
+const std::size_t kFlagCount = sizeof(kFlagCodes) / sizeof(kFlagCodes[0]);
+
+const int kTabWidth = 8;
+
+struct CodePointRange
+{
+   boost::uint32_t first;
+   boost::uint32_t last;
+};
+
+// characters which take no space of their own (combining marks, zero width
+// spaces and joiners, variation selectors, etc.)
+const CodePointRange kZeroWidth[] = {
+   { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD },
+   { 0x05BF, 0x05BF }, { 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 },
+   { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }, { 0x064B, 0x065F },
+   { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 },
+   { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 },
+   { 0x0730, 0x074A }, { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 },
+   { 0x0900, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C },
+   { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 },
+   { 0x0962, 0x0963 }, { 0x0981, 0x0981 }, { 0x09BC, 0x09BC },
+   { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 },
+   { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E },
+   { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECD },
+   { 0x1160, 0x11FF }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF },
+   { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 },
+   { 0x20D0, 0x20F0 }, { 0x302A, 0x302D }, { 0x3099, 0x309A },
+   { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF },
+   { 0xE0100, 0xE01EF }
+};
+
+// characters which take two cells (East Asian wide and full width
+// characters, and emoji)
+const CodePointRange kWide[] = {
+   { 0x1100, 0x115F }, { 0x2329, 0x232A }, { 0x2E80, 0x303E },
+   { 0x3040, 0xA4CF }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF },
+   { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 },
+   { 0xFFE0, 0xFFE6 }, { 0x1F300, 0x1F64F }, { 0x1F680, 0x1F6FF },
+   { 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD }
+};
+
+template <std::size_t N>
+bool inRanges(boost::uint32_t codePoint, const CodePointRange (&ranges)[N])
+{
+   for (std::size_t i = 0; i < N; i++)
+   {
+      if (codePoint >= ranges[i].first && codePoint <= ranges[i].last)
+         return true;
+   }
+   return false;
+}
+
+// the number of cells taken by a UTF-8 encoded character
+int charWidth(const char* bytes, std::size_t length)
+{
+   if (length < 2)
+      return 1;
+
+   // (the parser only passes on well-formed sequences)
+   unsigned char lead = static_cast<unsigned char>(bytes[0]);
+   boost::uint32_t codePoint = length == 2 ? (lead & 0x1F) :
+                               length == 3 ? (lead & 0x0F) : (lead & 0x07);
+   for (std::size_t i = 1; i < length; i++)
+      codePoint = (codePoint << 6) | (static_cast<unsigned char>(bytes[i]) & 0x3F);
+
+   if (inRanges(codePoint, kZeroWidth))
+      return 0;
+   else if (inRanges(codePoint, kWide))
+      return 2;
+   else
+      return 1;
+}
+
+std::string toString(int value)
+{
+   return boost::lexical_cast<std::string>(value);
+}
+
+void appendColor(boost::int32_t color,
+                 int base,
+                 int brightBase,
+                 std::string* pOutput)
+{
+   if (color < 0)
+      return;
+
+   if (color & TermScreen::kRgbColor)
+   {
+      *pOutput += ';' + toString(base + 8) + ";2;" +
+                  toString((color >> 16) & 0xFF) + ';' +
+                  toString((color >> 8) & 0xFF) + ';' +
+                  toString(color & 0xFF);
+   }
+   else if (color < 8)
+      *pOutput += ';' + toString(base + color);
+   else if (color < 16)
+      *pOutput += ';' + toString(brightBase + color - 8);
+   else
+      *pOutput += ';' + toString(base + 8) + ";5;" + toString(color);
+}
+
+// the SGR sequence which selects exactly the given attributes
+std::string renderAttributes(const TermScreen::Attributes& attr)
+{
+   std::string sgr(kCsi);
+   sgr += '0';
+   for (std::size_t i = 0; i < kFlagCount; i++)
+   {
+      if (attr.flags & (1 << i))
+         sgr += ';' + toString(kFlagCodes[i]);
+   }
+   appendColor(attr.fg, 30, 90, &sgr);
+   appendColor(attr.bg, 40, 100, &sgr);
+   sgr += 'm';
+   return sgr;
+}
+
+} // anonymous namespace
+
+TermScreen::TermScreen(int cols, int rows, int maxScrollbackLines)
+   : cols_(std::max(1, cols)),
+     rows_(std::max(1, rows)),
+     maxScrollbackLines_(static_cast<std::size_t>(std::max(0, maxScrollbackLines)))
+{
+   reset();
+}
+
+void TermScreen::reset()
+{
+   scrollback_.clear();
+   screen_.assign(rows_, Line());
+
+   cursorRow_ = 0;
+   cursorCol_ = 0;
+   wrapPending_ = false;
+   attr_ = Attributes();
+
+   scrollTop_ = 0;
+   scrollBottom_ = rows_ - 1;
+
+   savedRow_ = 0;
+   savedCol_ = 0;
+   savedAttr_ = Attributes();
+
+   autowrap_ = true;
+   cursorVisible_ = true;
+   appCursorKeys_ = false;
+   bracketedPaste_ = false;
+
+   state_ = Ground;
+   params_.clear();
+   csiPrefix_ = '\0';
+   csiIntermediate_ = false;
+   utf8_.clear();
+   utf8Length_ = 0;
+}
+
+void TermScreen::write(const std::string& output)
+{
+   for (std::string::const_iterator it = output.begin(); it != output.end(); ++it)
+   {
+      char ch = *it;
+      unsigned char uch = static_cast<unsigned char>(ch);
+
+      switch (state_)
+      {
+      case Ground:
+      {
+         // continue a multi-byte character
+         if (utf8Length_ > 0)
+         {
+            if ((uch & 0xC0) == 0x80)
+            {
+               utf8_ += ch;
+               if (utf8_.length() == utf8Length_)
+               {
+                  print(utf8_.data(), utf8_.length());
+                  utf8_.clear();
+                  utf8Length_ = 0;
+               }
+               break;
+            }
+
+            // malformed; drop what we have
+            utf8_.clear();
+            utf8Length_ = 0;
+         }
+
+         if (uch < 0x20)
+            control(ch);
+         else if (uch < 0x7F)
+            print(&ch, 1);
+         else if ((uch & 0xE0) == 0xC0 || (uch & 0xF0) == 0xE0 ||
+                  (uch & 0xF8) == 0xF0)
+         {
+            utf8_ = ch;
+            utf8Length_ = (uch & 0xE0) == 0xC0 ? 2 : (uch & 0xF0) == 0xE0 ? 3 : 4;
+         }
+         break;
+      }
+
+      case Escape:
+         if (uch < 0x20)
+            control(ch);
+         else
+            escape(ch);
+         break;
+
+      case EscapeCharset:
+         state_ = Ground;
+         break;
+
+      case Csi:
+         if (uch < 0x20)
+         {
+            if (ch == 0x18 || ch == 0x1A)
+               state_ = Ground;
+            else
+               control(ch);
+         }
+         else if (uch < 0x30)
+         {
+            csiIntermediate_ = true;
+         }
+         else if (uch < 0x40)
+         {
+            if (ch >= '<' && ch <= '?')
+               csiPrefix_ = ch;
+            else
+               params_ += ch;
+         }
+         else if (uch < 0x7F)
+         {
+            state_ = Ground;
+            if (!csiIntermediate_)
+               csi(ch);
+         }
+         break;
+
+      case String:
+         if (ch == '\a' || ch == 0x18 || ch == 0x1A)
+            state_ = Ground;
+         else if (ch == kEsc)
+            state_ = StringEscape;
+         break;
+
+      case StringEscape:
+         // ESC \ is the string terminator; ESC anything else ends the string
+         // and starts a new sequence
+         state_ = Ground;
+         if (ch != '\\')
+            escape(ch);
+         break;
+      }
+   }
+}
+
+void TermScreen::control(char ch)
+{
+   switch (ch)
+   {
+   case '\r':
+      moveCursor(cursorRow_, 0);
+      break;
+
+   case '\n':
+   case '\v':
+   case '\f':
+      wrapPending_ = false;
+      lineFeed();
+      break;
+
+   case '\b':
+      moveCursor(cursorRow_, cursorCol_ - 1);
+      break;
+
+   case '\t':
+      moveCursor(cursorRow_, (cursorCol_ / kTabWidth + 1) * kTabWidth);
+      break;
+
+   case kEsc:
+      state_ = Escape;
+      break;
+
+   default:
+      // BEL, shift in/out, etc.
+      break;
+   }
+}
+
+void TermScreen::escape(char ch)
+{
+   state_ = Ground;
+   switch (ch)
+   {
+   case '[':
+      state_ = Csi;
+      params_.clear();
+      csiPrefix_ = '\0';
+      csiIntermediate_ = false;
+      break;
+
+   case ']': // OSC
+   case 'P': // DCS
+   case 'X': // SOS
+   case '^': // PM
+   case '_': // APC
+      state_ = String;
+      break;
+
+   case '(': case ')': case '*': case '+': case '-': case '.': case '/':
+   case '#': case '%': case ' ':
+      state_ = EscapeCharset;
+      break;
+
+   case '7':
+      savedRow_ = cursorRow_;
+      savedCol_ = cursorCol_;
+      savedAttr_ = attr_;
+      break;
+
+   case '8':
+      moveCursor(savedRow_, savedCol_);
+      attr_ = savedAttr_;
+      break;
+
+   case 'D':
+      wrapPending_ = false;
+      lineFeed();
+      break;
+
+   case 'E':
+      moveCursor(cursorRow_, 0);
+      lineFeed();
+      break;
+
+   case 'M':
+      wrapPending_ = false;
+      reverseLineFeed();
+      break;
+
+   case 'c':
+      reset();
+      break;
+
+   default:
+      break;
+   }
+}
+
+void TermScreen::csi(char final)
+{
+   parsedParams_.clear();
+   std::string::size_type start = 0;
+   while (start <= params_.length())
+   {
+      std::string::size_type end = params_.find_first_of(";:", start);
+      if (end == std::string::npos)
+         end = params_.length();
+      parsedParams_.push_back(end > start ?
+            std::atoi(params_.substr(start, end - start).c_str()) : -1);
+      start = end + 1;
+   }
+
+   if (csiPrefix_ == '?')
+   {
+      if (final == 'h' || final == 'l')
+      {
+         for (std::size_t i = 0; i < parsedParams_.size(); i++)
+            setPrivateMode(parsedParams_[i], final == 'h');
+      }
+      return;
+   }
+   else if (csiPrefix_ != '\0')
+   {
+      return;
+   }
+
+   int n = std::max(1, param(0, 1));
+   switch (final)
+   {
+   case 'A':
+      moveCursor(cursorRow_ - n, cursorCol_);
+      break;
+   case 'B':
+   case 'e':
+      moveCursor(cursorRow_ + n, cursorCol_);
+      break;
+   case 'C':
+   case 'a':
+      moveCursor(cursorRow_, cursorCol_ + n);
+      break;
+   case 'D':
+      moveCursor(cursorRow_, cursorCol_ - n);
+      break;
+   case 'E':
+      moveCursor(cursorRow_ + n, 0);
+      break;
+   case 'F':
+      moveCursor(cursorRow_ - n, 0);
+      break;
+   case 'G':
+   case '`':
+      moveCursor(cursorRow_, n - 1);
+      break;
+   case 'H':
+   case 'f':
+      moveCursor(n - 1, std::max(1, param(1, 1)) - 1);
+      break;
+   case 'd':
+      moveCursor(n - 1, cursorCol_);
+      break;
+
+   case 'J':
+      eraseDisplay(param(0, 0));
+      break;
+   case 'K':
+      eraseLine(param(0, 0));
+      break;
+
+   case 'L':
+      if (cursorRow_ >= scrollTop_ && cursorRow_ <= scrollBottom_)
+      {
+         scrollDown(cursorRow_, n);
+         moveCursor(cursorRow_, 0);
+      }
+      break;
+   case 'M':
+      if (cursorRow_ >= scrollTop_ && cursorRow_ <= scrollBottom_)
+      {
+         // deleted lines don't go into the scrollback
+         scrollUp(cursorRow_, n, false);
+         moveCursor(cursorRow_, 0);
+      }
+      break;
+
+   case '@':
+   {
+      Line& line = screen_[cursorRow_];
+      if (static_cast<std::size_t>(cursorCol_) < line.cells.size())
+      {
+         std::size_t length = std::max(line.cells.size(),
+                                       static_cast<std::size_t>(cols_));
+         Cell blank;
+         blank.attr.bg = attr_.bg;
+         line.cells.insert(line.cells.begin() + cursorCol_, n, blank);
+         if (line.cells.size() > length)
+            line.cells.resize(length);
+      }
+      wrapPending_ = false;
+      break;
+   }
+   case 'P':
+   {
+      Line& line = screen_[cursorRow_];
+      if (static_cast<std::size_t>(cursorCol_) < line.cells.size())
+      {
+         std::size_t count = std::min(static_cast<std::size_t>(n),
+                                      line.cells.size() - cursorCol_);
+         line.cells.erase(line.cells.begin() + cursorCol_,
+                          line.cells.begin() + cursorCol_ + count);
+      }
+      wrapPending_ = false;
+      break;
+   }
+   case 'X':
+      eraseCells(screen_[cursorRow_], cursorCol_, cursorCol_ + n);
+      wrapPending_ = false;
+      break;
+
+   case 'S':
+      scrollUp(scrollTop_, n);
+      break;
+   case 'T':
+      scrollDown(scrollTop_, n);
+      break;
+
+   case 'r':
+   {
+      int top = std::max(1, param(0, 1)) - 1;
+      int bottom = param(1, rows_);
+      if (bottom < 1 || bottom > rows_)
+         bottom = rows_;
+      bottom -= 1;
+      if (top < bottom)
+      {
+         scrollTop_ = top;
+         scrollBottom_ = bottom;
+         moveCursor(0, 0);
+      }
+      break;
+   }
+
+   case 's':
+      savedRow_ = cursorRow_;
+      savedCol_ = cursorCol_;
+      break;
+   case 'u':
+      moveCursor(savedRow_, savedCol_);
+      break;
+
+   case 'm':
+      sgr();
+      break;
+
+   default:
+      break;
+   }
+}
+
+void TermScreen::sgr()
+{
+   for (std::size_t i = 0; i < parsedParams_.size(); i++)
+   {
+      int code = std::max(0, parsedParams_[i]);
+
+      if (code == 0)
+         attr_ = Attributes();
+      else if (code >= 1 && code <= 9 && code != 6)
+      {
+         for (std::size_t flag = 0; flag < kFlagCount; flag++)
+         {
+            if (kFlagCodes[flag] == code)
+               attr_.flags |= (1 << flag);
+         }
+      }
+      else if (code == 22)
+         attr_.flags &= ~(kBold | kDim);
+      else if (code == 23)
+         attr_.flags &= ~kItalic;
+      else if (code == 24)
+         attr_.flags &= ~kUnderline;
+      else if (code == 25)
+         attr_.flags &= ~kBlink;
+      else if (code == 27)
+         attr_.flags &= ~kInverse;
+      else if (code == 28)
+         attr_.flags &= ~kInvisible;
+      else if (code == 29)
+         attr_.flags &= ~kStrike;
+      else if (code >= 30 && code <= 37)
+         attr_.fg = code - 30;
+      else if (code == 39)
+         attr_.fg = -1;
+      else if (code >= 40 && code <= 47)
+         attr_.bg = code - 40;
+      else if (code == 49)
+         attr_.bg = -1;
+      else if (code >= 90 && code <= 97)
+         attr_.fg = code - 90 + 8;
+      else if (code >= 100 && code <= 107)
+         attr_.bg = code - 100 + 8;
+      else if (code == 38 || code == 48)
+      {
+         boost::int32_t* pColor = code == 38 ? &attr_.fg : &attr_.bg;
+         int type = param(i + 1, 0);
+         if (type == 5)
+         {
+            *pColor = std::min(255, std::max(0, param(i + 2, 0)));
+            i += 2;
+         }
+         else if (type == 2)
+         {
+            *pColor = kRgbColor |
+                      ((std::max(0, param(i + 2, 0)) & 0xFF) << 16) |
+                      ((std::max(0, param(i + 3, 0)) & 0xFF) << 8) |
+                      (std::max(0, param(i + 4, 0)) & 0xFF);
+            i += 4;
+         }
+         else
+         {
+            // unknown color type; skip the rest of the sequence
+            break;
+         }
+      }
+   }
+}
+
+void TermScreen::setPrivateMode(int mode, bool set)
+{
+   switch (mode)
+   {
+   case 1:
+      appCursorKeys_ = set;
+      break;
+   case 7:
+      autowrap_ = set;
+      break;
+   case 25:
+      cursorVisible_ = set;
+      break;
+   case 2004:
+      bracketedPaste_ = set;
+      break;
+   default:
+      break;
+   }
+}
+
+void TermScreen::print(const char* bytes, std::size_t length)
+{
+   int width = charWidth(bytes, length);
+   if (width == 0)
+   {
+      combine(bytes, length);
+      return;
+   }
+
+   // (a wide character can't fit on a screen one column wide)
+   if (cols_ < 2)
+      width = 1;
+
+   if (wrapPending_)
+   {
+      screen_[cursorRow_].wrapped = true;
+      cursorCol_ = 0;
+      wrapPending_ = false;
+      lineFeed();
+   }
+
+   // a wide character which doesn't fit in the last column goes on the next
+   // line (or, without autowrap, in the last two columns)
+   if (cursorCol_ + width > cols_)
+   {
+      if (autowrap_)
+      {
+         // (the last column is kept, blank, so that the line renders at
+         // full width and wraps on the client too)
+         Line& line = screen_[cursorRow_];
+         if (line.cells.size() < static_cast<std::size_t>(cols_))
+            line.cells.resize(cols_);
+         line.wrapped = true;
+         cursorCol_ = 0;
+         lineFeed();
+      }
+      else
+      {
+         cursorCol_ = cols_ - width;
+      }
+   }
+
+   Line& line = screen_[cursorRow_];
+   if (line.cells.size() < static_cast<std::size_t>(cursorCol_ + width))
+      line.cells.resize(cursorCol_ + width);
+   clearWideCharacters(line, cursorCol_, cursorCol_ + width);
+
+   Cell& cell = line.cells[cursorCol_];
+   std::copy(bytes, bytes + length, cell.bytes);
+   cell.length = static_cast<boost::uint8_t>(length);
+   cell.attr = attr_;
+
+   if (width == 2)
+   {
+      Cell& continuation = line.cells[cursorCol_ + 1];
+      continuation.length = 0;
+      continuation.attr = attr_;
+   }
+
+   if (cursorCol_ + width < cols_)
+      cursorCol_ += width;
+   else
+   {
+      cursorCol_ = cols_ - 1;
+      if (autowrap_)
+         wrapPending_ = true;
+   }
+}
+
+void TermScreen::combine(const char* bytes, std::size_t length)
+{
+   // the character before the cursor (or under it, if the cursor is waiting
+   // to wrap); there's nothing to combine with at the start of a line
+   int col = wrapPending_ ? cursorCol_ : cursorCol_ - 1;
+   Line& line = screen_[cursorRow_];
+   if (col < 0 || static_cast<std::size_t>(col) >= line.cells.size())
+      return;
+   if (line.cells[col].isContinuation() && col > 0)
+      --col;
+
+   Cell& cell = line.cells[col];
+   if (cell.isContinuation() || cell.length + length > Cell::kMaxBytes)
+      return;
+   std::copy(bytes, bytes + length, cell.bytes + cell.length);
+   cell.length = static_cast<boost::uint8_t>(cell.length + length);
+}
+
+// blank the parts of wide characters which are left behind when the cells
+// [from, to) are overwritten
+void TermScreen::clearWideCharacters(Line& line, int from, int to)
+{
+   if (from > 0 && line.cells[from].isContinuation())
+   {
+      Cell& first = line.cells[from - 1];
+      first.bytes[0] = ' ';
+      first.length = 1;
+   }
+
+   if (static_cast<std::size_t>(to) < line.cells.size() &&
+       line.cells[to].isContinuation())
+   {
+      Cell& continuation = line.cells[to];
+      continuation.bytes[0] = ' ';
+      continuation.length = 1;
+   }
+}
+
+void TermScreen::lineFeed()
+{
+   if (cursorRow_ == scrollBottom_)
+      scrollUp(scrollTop_, 1);
+   else if (cursorRow_ < rows_ - 1)
+      ++cursorRow_;
+}
+
+void TermScreen::reverseLineFeed()
+{
+   if (cursorRow_ == scrollTop_)
+      scrollDown(scrollTop_, 1);
+   else if (cursorRow_ > 0)
+      --cursorRow_;
+}
+
+void TermScreen::scrollUp(int top, int count, bool saveLines)
+{
+   count = std::min(count, scrollBottom_ - top + 1);
+   for (int i = 0; i < count; i++)
+   {
+      // only lines leaving the top of the screen go into the scrollback
+      if (saveLines && top == 0)
+         pushScrollback(screen_[top]);
+
+      screen_.erase(screen_.begin() + top);
+      screen_.insert(screen_.begin() + scrollBottom_, Line());
+   }
+}
+
+void TermScreen::scrollDown(int top, int count)
+{
+   count = std::min(count, scrollBottom_ - top + 1);
+   for (int i = 0; i < count; i++)
+   {
+      screen_.erase(screen_.begin() + scrollBottom_);
+      screen_.insert(screen_.begin() + top, Line());
+   }
+}
+
+void TermScreen::pushScrollback(const Line& line)
+{
+   if (maxScrollbackLines_ == 0)
+      return;
+
+   scrollback_.push_back(line);
+   while (scrollback_.size() > maxScrollbackLines_)
+      scrollback_.pop_front();
+}
+
+void TermScreen::eraseCells(Line& line, int from, int to)
+{
+   std::size_t size = line.cells.size();
+   std::size_t start = static_cast<std::size_t>(std::max(0, from));
+   if (start >= size)
+      return;
+
+   // erasing to the end of the line with the default background
+   if (static_cast<std::size_t>(to) >= size && attr_.bg == -1)
+   {
+      line.cells.resize(start);
+      return;
+   }
+
+   Cell blank;
+   blank.attr.bg = attr_.bg;
+   std::size_t end = std::min(size, static_cast<std::size_t>(to));
+   std::fill(line.cells.begin() + start, line.cells.begin() + end, blank);
+}
+
+void TermScreen::eraseLine(int mode)
+{
+   Line& line = screen_[cursorRow_];
+   switch (mode)
+   {
+   case 0:
+      eraseCells(line, cursorCol_, INT_MAX);
+      line.wrapped = false;
+      break;
+   case 1:
+      eraseCells(line, 0, cursorCol_ + 1);
+      break;
+   case 2:
+      eraseCells(line, 0, INT_MAX);
+      line.wrapped = false;
+      break;
+   default:
+      break;
+   }
+   wrapPending_ = false;
+}
+
+void TermScreen::eraseDisplay(int mode)
+{
+   switch (mode)
+   {
+   case 0:
+      eraseLine(0);
+      for (int row = cursorRow_ + 1; row < rows_; row++)
+         screen_[row] = Line();
+      break;
+   case 1:
+      for (int row = 0; row < cursorRow_; row++)
+         screen_[row] = Line();
+      eraseLine(1);
+      break;
+   case 2:
+      screen_.assign(rows_, Line());
+      break;
+   case 3:
+      scrollback_.clear();
+      break;
+   default:
+      break;
+   }
+   wrapPending_ = false;
+}
+
+void TermScreen::moveCursor(int row, int col)
+{
+   cursorRow_ = std::max(0, std::min(rows_ - 1, row));
+   cursorCol_ = std::max(0, std::min(cols_ - 1, col));
+   wrapPending_ = false;
+}
+
+int TermScreen::param(std::size_t index, int defaultValue) const
+{
+   if (index >= parsedParams_.size() || parsedParams_[index] < 0)
+      return defaultValue;
+   return parsedParams_[index];
+}
+
+void TermScreen::resize(int cols, int rows)
+{
+   cols = std::max(1, cols);
+   rows = std::max(1, rows);
+   if (cols == cols_ && rows == rows_)
+      return;
+
+   // drop empty rows below the cursor, then move rows into the scrollback
+   while (static_cast<int>(screen_.size()) > rows)
+   {
+      if (static_cast<int>(screen_.size()) - 1 > cursorRow_ &&
+          screen_.back().cells.empty())
+      {
+         screen_.pop_back();
+      }
+      else
+      {
+         pushScrollback(screen_.front());
+         screen_.erase(screen_.begin());
+         --cursorRow_;
+         --savedRow_;
+      }
+   }
+
+   // bring lines back from the scrollback, then add rows to the bottom
+   while (static_cast<int>(screen_.size()) < rows && !scrollback_.empty())
+   {
+      screen_.insert(screen_.begin(), scrollback_.back());
+      scrollback_.pop_back();
+      ++cursorRow_;
+      ++savedRow_;
+   }
+   screen_.resize(rows);
+
+   cols_ = cols;
+   rows_ = rows;
+   scrollTop_ = 0;
+   scrollBottom_ = rows_ - 1;
+
+   savedRow_ = std::max(0, std::min(rows_ - 1, savedRow_));
+   savedCol_ = std::max(0, std::min(cols_ - 1, savedCol_));
+   moveCursor(cursorRow_, cursorCol_);
+}
+
+void TermScreen::renderLine(const Line& line,
+                            bool trim,
+                            Attributes* pAttr,
+                            std::string* pOutput) const
+{
+   std::size_t length = line.cells.size();
+   if (trim)
+   {
+      while (length > 0 && line.cells[length - 1].isBlank())
+         --length;
+   }
+
+   for (std::size_t i = 0; i < length; i++)
+   {
+      const Cell& cell = line.cells[i];
+      if (cell.attr != *pAttr)
+      {
+         *pOutput += renderAttributes(cell.attr);
+         *pAttr = cell.attr;
+      }
+      pOutput->append(cell.bytes, cell.length);
+   }
+}
+
+std::string TermScreen::render() const
+{
+   std::string output;
+   Attributes attr;
+
+   // the screen is rendered down to its last non-empty row (or the cursor,
+   // if that's further down)
+   int lastRow = cursorRow_;
+   for (int row = rows_ - 1; row > lastRow; row--)
+   {
+      if (!screen_[row].cells.empty())
+      {
+         lastRow = row;
+         break;
+      }
+   }
+
+   std::size_t lines = scrollback_.size() + lastRow + 1;
+   for (std::size_t i = 0; i < lines; i++)
+   {
+      const Line& line = i < scrollback_.size() ?
+               scrollback_[i] : screen_[i - scrollback_.size()];
+
+      // lines which wrapped are written out in full so that the client
+      // wraps them too
+      bool wraps = line.wrapped &&
+                   line.cells.size() >= static_cast<std::size_t>(cols_) &&
+                   i + 1 < lines;
+      renderLine(line, !wraps, &attr, &output);
+
+      if (i + 1 < lines && !wraps)
+      {
+         // don't let a background color bleed onto the next line
+         if (attr.bg != -1)
+         {
+            attr = Attributes();
+            output += renderAttributes(attr);
+         }
+         output += "\r\n";
+      }
+   }
+
+   // position the cursor relative to the last row written
+   output += '\r';
+   if (lastRow > cursorRow_)
+      output += kCsi + toString(lastRow - cursorRow_) + 'A';
+   const Line& cursorLine = screen_[cursorRow_];
+   if (wrapPending_ &&
+       cursorLine.cells.size() > static_cast<std::size_t>(cursorCol_))
+   {
+      // rewrite the final character so that the client is also waiting to
+      // wrap (all of it, if it's wide)
+      int col = cursorCol_;
+      if (cursorLine.cells[col].isContinuation() && col > 0)
+         --col;
+      if (col > 0)
+         output += kCsi + toString(col) + 'C';
+      const Cell& cell = cursorLine.cells[col];
+      if (cell.attr != attr)
+      {
+         output += renderAttributes(cell.attr);
+         attr = cell.attr;
+      }
+      output.append(cell.bytes, cell.length);
+   }
+   else if (cursorCol_ > 0)
+   {
+      output += kCsi + toString(cursorCol_) + 'C';
+   }
+
+   if (attr != attr_)
+      output += renderAttributes(attr_);
+
+   if (appCursorKeys_)
+      output += "\x1b[?1h";
+   if (bracketedPaste_)
+      output += "\x1b[?2004h";
+   if (!cursorVisible_)
+      output += "\x1b[?25l";
+   if (!autowrap_)
+      output += "\x1b[?7l";
+
+   return output;
+}
+
+std::string TermScreen::lineText(std::size_t index) const
+{
+   const Line* pLine = NULL;
+   if (index < scrollback_.size())
+      pLine = &scrollback_[index];
+   else if (index - scrollback_.size() < screen_.size())
+      pLine = &screen_[index - scrollback_.size()];
+   else
+      return std::string();
+
+   std::string text;
+   for (std::size_t i = 0; i < pLine->cells.size(); i++)
+      text.append(pLine->cells[i].bytes, pLine->cells[i].length);
+   std::string::size_type end = text.find_last_not_of(' ');
+   return end == std::string::npos ? std::string() : text.substr(0, end + 1);
+}
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,292 @@
+/*
+ * TermScreenTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/text/TermScreen.hpp>
+
+#include <sstream>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+using namespace core::text;
+
+namespace {
+
+// the text of every line of a screen (scrollback included)
+std::string screenText(const TermScreen& screen)
+{
+   std::string text;
+   std::size_t lines = screen.scrollbackLines() + screen.rows();
+   for (std::size_t i = 0; i < lines; i++)
+      text += screen.lineText(i) + "|";
+   return text;
+}
+
+// does replaying the rendered screen recreate it?
+bool rendersFaithfully(const TermScreen& screen)
+{
+   TermScreen replay(screen.cols(), screen.rows(), 1000);
+   replay.write(screen.render());
+   return screenText(replay) == screenText(screen) &&
+          replay.cursorRow() == screen.cursorRow() &&
+          replay.cursorCol() == screen.cursorCol() &&
+          replay.render() == screen.render();
+}
+
+} // anonymous namespace
+
+TEST_CASE("Terminal Screen Model")
+{
+   SECTION("Plain text and newlines")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("hello\r\nworld");
+      CHECK(screen.lineText(0) == "hello");
+      CHECK(screen.lineText(1) == "world");
+      CHECK(screen.cursorRow() == 1);
+      CHECK(screen.cursorCol() == 5);
+      CHECK(screen.render() == "hello\r\nworld\r\x1b[5C");
+   }
+
+   SECTION("Carriage returns and backspaces overwrite")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("progress 10%\rprogress 100%");
+      CHECK(screen.lineText(0) == "progress 100%");
+      screen.write("\r\nabc\b\bX");
+      CHECK(screen.lineText(1) == "aXc");
+   }
+
+   SECTION("Output scrolls into the scrollback")
+   {
+      TermScreen screen(20, 3, 100);
+      for (int i = 0; i < 10; i++)
+      {
+         std::ostringstream ostr;
+         ostr << "line " << i << "\r\n";
+         screen.write(ostr.str());
+      }
+      CHECK(screen.scrollbackLines() == 8);
+      CHECK(screen.lineText(0) == "line 0");
+      CHECK(screen.lineText(9) == "line 9");
+      CHECK(screen.cursorRow() == 2);
+      CHECK(rendersFaithfully(screen));
+   }
+
+   SECTION("Scrollback is bounded")
+   {
+      TermScreen screen(20, 3, 5);
+      for (int i = 0; i < 1000; i++)
+         screen.write("some output\r\n");
+      CHECK(screen.scrollbackLines() == 5);
+
+      // rendering depends on what's shown, not how much was written
+      std::string rendered = screen.render();
+      for (int i = 0; i < 1000; i++)
+         screen.write("some output\r\n");
+      CHECK(screen.render() == rendered);
+   }
+
+   SECTION("Long lines wrap")
+   {
+      TermScreen screen(10, 4, 100);
+      screen.write("0123456789abcdef\r\nnext");
+      CHECK(screen.lineText(0) == "0123456789");
+      CHECK(screen.lineText(1) == "abcdef");
+      CHECK(screen.lineText(2) == "next");
+      CHECK(screen.render() == "0123456789abcdef\r\nnext\r\x1b[4C");
+      CHECK(rendersFaithfully(screen));
+   }
+
+   SECTION("Cursor waiting to wrap at the right margin")
+   {
+      TermScreen screen(5, 3, 100);
+      screen.write("abcde");
+      CHECK(screen.cursorCol() == 4);
+      CHECK(rendersFaithfully(screen));
+
+      screen.write("f");
+      CHECK(screen.lineText(1) == "f");
+   }
+
+   SECTION("Cursor movement and erasing")
+   {
+      TermScreen screen(20, 5, 100);
+      screen.write("first\r\nsecond\r\nthird");
+      screen.write("\x1b[1;3H");
+      CHECK(screen.cursorRow() == 0);
+      CHECK(screen.cursorCol() == 2);
+      screen.write("\x1b[K");
+      CHECK(screen.lineText(0) == "fi");
+      screen.write("\x1b[2B\x1b[2K");
+      CHECK(screen.lineText(2).empty());
+      screen.write("\x1b[H\x1b[J");
+      CHECK(screenText(screen) == "|||||");
+   }
+
+   SECTION("Full screen redraws are rendered compactly")
+   {
+      TermScreen screen(20, 4, 100);
+      for (int i = 0; i < 500; i++)
+      {
+         std::ostringstream ostr;
+         ostr << "\x1b[H\x1b[2Jcount " << i << "\x1b[3;1Hstatus";
+         screen.write(ostr.str());
+      }
+      CHECK(screen.scrollbackLines() == 0);
+      CHECK(screen.lineText(0) == "count 499");
+      CHECK(screen.lineText(2) == "status");
+      CHECK(screen.render() == "count 499\r\n\r\nstatus\r\x1b[6C");
+   }
+
+   SECTION("Attributes are rendered")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("\x1b[1;31mred\x1b[0m plain \x1b[38;5;200mx\x1b[48;2;1;2;3my");
+      CHECK(screen.render() ==
+            "\x1b[0;1;31mred\x1b[0m plain \x1b[0;38;5;200mx"
+            "\x1b[0;38;5;200;48;2;1;2;3my\r\x1b[12C");
+      CHECK(rendersFaithfully(screen));
+   }
+
+   SECTION("Sequences and characters split across writes")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("caf\xC3");
+      screen.write("\xA9 \x1b[");
+      screen.write("32mok\x1b]0;title");
+      screen.write("\x07!");
+      CHECK(screen.lineText(0) == "caf\xC3\xA9 ok!");
+      CHECK(screen.cursorCol() == 8);
+   }
+
+   SECTION("Scrolling regions")
+   {
+      TermScreen screen(20, 4, 100);
+      screen.write("header\r\n\x1b[2;3r\x1b[2;1Ha\r\nb\r\nc\r\nd");
+      CHECK(screen.lineText(0) == "header");
+      CHECK(screen.lineText(1) == "c");
+      CHECK(screen.lineText(2) == "d");
+      CHECK(screen.scrollbackLines() == 0);
+   }
+
+   SECTION("Modes which affect input are rendered")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("\x1b[?2004h$ ");
+      CHECK(screen.render() == "$\r\x1b[2C\x1b[?2004h");
+      screen.write("\x1b[?2004l");
+      CHECK(screen.render() == "$\r\x1b[2C");
+   }
+
+   SECTION("Resizing keeps the rows around the cursor")
+   {
+      TermScreen screen(20, 5, 100);
+      screen.write("one\r\ntwo\r\nthree\r\nfour\r\n$ ");
+      screen.resize(20, 3);
+      CHECK(screen.scrollbackLines() == 2);
+      CHECK(screen.lineText(4) == "$");
+      CHECK(screen.cursorRow() == 2);
+
+      screen.resize(10, 6);
+      CHECK(screen.scrollbackLines() == 0);
+      CHECK(screen.cursorRow() == 4);
+      CHECK(screen.rows() == 6);
+      CHECK(rendersFaithfully(screen));
+   }
+
+   SECTION("Wide characters take two cells")
+   {
+      // U+4E2D
+      const std::string wide = "\xE4\xB8\xAD";
+      TermScreen screen(10, 3, 100);
+      screen.write("a" + wide + "b");
+      CHECK(screen.lineText(0) == "a" + wide + "b");
+      CHECK(screen.cursorCol() == 4);
+      CHECK(screen.render() == "a" + wide + "b\r\x1b[4C");
+      CHECK(rendersFaithfully(screen));
+
+      // overwriting half of a wide character blanks the other half
+      screen.write("\rxy");
+      CHECK(screen.lineText(0) == "xy b");
+      screen.write("\r" + wide + "\b" + "z");
+      CHECK(screen.lineText(0) == " z b");
+      CHECK(rendersFaithfully(screen));
+   }
+
+   SECTION("Wide characters which don't fit wrap")
+   {
+      const std::string wide = "\xE4\xB8\xAD";
+      TermScreen screen(5, 3, 100);
+      screen.write("abcd" + wide);
+      CHECK(screen.lineText(0) == "abcd");
+      CHECK(screen.lineText(1) == wide);
+      CHECK(screen.cursorRow() == 1);
+      CHECK(screen.cursorCol() == 2);
+      CHECK(rendersFaithfully(screen));
+
+      // one in the last two columns waits to wrap
+      screen.write("\r\nabc" + wide);
+      CHECK(screen.lineText(2) == "abc" + wide);
+      CHECK(screen.cursorCol() == 4);
+      CHECK(rendersFaithfully(screen));
+
+      screen.write("d");
+      CHECK(screen.lineText(3) == "d");
+   }
+
+   SECTION("Combining characters join the character before them")
+   {
+      // U+0301 (combining acute accent)
+      const std::string accent = "\xCC\x81";
+      const std::string wide = "\xE4\xB8\xAD";
+      TermScreen screen(3, 4, 100);
+      screen.write("e" + accent + "x");
+      CHECK(screen.lineText(0) == "e" + accent + "x");
+      CHECK(screen.cursorCol() == 2);
+
+      // including wide characters, characters waiting to wrap and across
+      // writes
+      screen.write("\r\n" + wide + accent);
+      CHECK(screen.lineText(1) == wide + accent);
+      CHECK(screen.cursorCol() == 2);
+      screen.write("\r\nabc\xCC");
+      screen.write("\x81");
+      CHECK(screen.lineText(2) == "abc" + accent);
+      CHECK(screen.cursorCol() == 2);
+      CHECK(rendersFaithfully(screen));
+
+      // there's nothing to join at the start of a line
+      screen.write("\r\n" + accent + "a");
+      CHECK(screen.lineText(3) == "a");
+      CHECK(screen.cursorCol() == 1);
+   }
+
+   SECTION("Reset")
+   {
+      TermScreen screen(20, 3, 100);
+      screen.write("text\r\n\x1b" "c");
+      CHECK(screenText(screen) == "|||");
+      CHECK(screen.render() == "\r");
+   }
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
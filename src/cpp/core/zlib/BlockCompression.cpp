@@ -0,0 +1,426 @@
+/*
+ * BlockCompression.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/zlib/BlockCompression.hpp>
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+
+#include "zlib.h"
+
+namespace rstudio {
+namespace core {
+namespace zlib {
+
+namespace {
+
+// gzip member header: the fixed fields, then an extra field holding our
+// subfield ('R', 'S') with the member size and the block size
+const std::size_t kHeaderSize = 24;
+const std::size_t kTrailerSize = 8;
+const unsigned char kFlagExtra = 0x04;
+const char kSubfieldId1 = 'R';
+const char kSubfieldId2 = 'S';
+
+void putUInt16(boost::uint32_t value, unsigned char* pOut)
+{
+   pOut[0] = value & 0xFF;
+   pOut[1] = (value >> 8) & 0xFF;
+}
+
+void putUInt32(boost::uint32_t value, unsigned char* pOut)
+{
+   for (int i = 0; i < 4; i++)
+      pOut[i] = (value >> (8 * i)) & 0xFF;
+}
+
+boost::uint32_t getUInt16(const unsigned char* pIn)
+{
+   return pIn[0] | (pIn[1] << 8);
+}
+
+boost::uint32_t getUInt32(const unsigned char* pIn)
+{
+   boost::uint32_t value = 0;
+   for (int i = 3; i >= 0; i--)
+      value = (value << 8) | pIn[i];
+   return value;
+}
+
+Error formatError(const std::string& description, const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::illegal_byte_sequence,
+                      description,
+                      location);
+}
+
+// compress a block into a complete gzip member
+Error compressBlock(const std::string& input, int level, std::string* pOutput)
+{
+   z_stream zStream;
+   zStream.zalloc = Z_NULL;
+   zStream.zfree = Z_NULL;
+   zStream.opaque = Z_NULL;
+
+   // (negative window bits for a raw deflate stream; we write the gzip
+   // wrapper ourselves so the header can record the member's size)
+   int res = deflateInit2(&zStream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                          Z_DEFAULT_STRATEGY);
+   if (res != Z_OK)
+      return systemError(res, "ZLib initialization error", ERROR_LOCATION);
+
+   uLong bound = deflateBound(&zStream, static_cast<uLong>(input.size()));
+   pOutput->resize(kHeaderSize + bound + kTrailerSize);
+   unsigned char* pOut = reinterpret_cast<unsigned char*>(&(*pOutput)[0]);
+
+   zStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+   zStream.avail_in = static_cast<uInt>(input.size());
+   zStream.next_out = pOut + kHeaderSize;
+   zStream.avail_out = static_cast<uInt>(bound);
+
+   res = deflate(&zStream, Z_FINISH);
+   std::size_t deflatedSize = zStream.total_out;
+   deflateEnd(&zStream);
+   if (res != Z_STREAM_END)
+      return systemError(res, "ZLib deflation error", ERROR_LOCATION);
+
+   std::size_t memberSize = kHeaderSize + deflatedSize + kTrailerSize;
+
+   unsigned char* pHeader = pOut;
+   std::fill(pHeader, pHeader + kHeaderSize, 0);
+   pHeader[0] = 0x1F;
+   pHeader[1] = 0x8B;
+   pHeader[2] = Z_DEFLATED;
+   pHeader[3] = kFlagExtra;
+   pHeader[9] = 0xFF; // (unknown OS)
+   putUInt16(12, pHeader + 10);
+   pHeader[12] = kSubfieldId1;
+   pHeader[13] = kSubfieldId2;
+   putUInt16(8, pHeader + 14);
+   putUInt32(static_cast<boost::uint32_t>(memberSize), pHeader + 16);
+   putUInt32(static_cast<boost::uint32_t>(input.size()), pHeader + 20);
+
+   unsigned char* pTrailer = pOut + kHeaderSize + deflatedSize;
+   uLong crc = crc32(0L, Z_NULL, 0);
+   crc = crc32(crc,
+               reinterpret_cast<const Bytef*>(input.data()),
+               static_cast<uInt>(input.size()));
+   putUInt32(static_cast<boost::uint32_t>(crc), pTrailer);
+   putUInt32(static_cast<boost::uint32_t>(input.size()), pTrailer + 4);
+
+   pOutput->resize(memberSize);
+   return Success();
+}
+
+// parse a member header, returning the size of the header
+Error parseHeader(const unsigned char* pHeader,
+                  std::size_t size,
+                  std::size_t* pHeaderSize,
+                  BlockIndexEntry* pEntry)
+{
+   if (size < kHeaderSize ||
+       pHeader[0] != 0x1F || pHeader[1] != 0x8B || pHeader[2] != Z_DEFLATED ||
+       !(pHeader[3] & kFlagExtra))
+   {
+      return formatError("Not a block compressed gzip member", ERROR_LOCATION);
+   }
+
+   std::size_t extraSize = getUInt16(pHeader + 10);
+   if (size < 12 + extraSize)
+      return formatError("Truncated gzip member header", ERROR_LOCATION);
+
+   // find our subfield in the extra field
+   for (std::size_t pos = 12; pos + 4 <= 12 + extraSize; )
+   {
+      std::size_t subfieldSize = getUInt16(pHeader + pos + 2);
+      if (pHeader[pos] == kSubfieldId1 && pHeader[pos + 1] == kSubfieldId2 &&
+          subfieldSize == 8 && pos + 4 + subfieldSize <= 12 + extraSize)
+      {
+         pEntry->compressedSize = getUInt32(pHeader + pos + 4);
+         pEntry->uncompressedSize = getUInt32(pHeader + pos + 8);
+         *pHeaderSize = 12 + extraSize;
+         if (pEntry->compressedSize < *pHeaderSize + kTrailerSize)
+            return formatError("Invalid gzip member size", ERROR_LOCATION);
+         return Success();
+      }
+      pos += 4 + subfieldSize;
+   }
+
+   return formatError("Gzip member has no block index", ERROR_LOCATION);
+}
+
+} // anonymous namespace
+
+const std::size_t BlockCompressor::kDefaultBlockSize = 4 * 1024 * 1024;
+const std::size_t BlockCompressor::kDefaultMaxThreads = 4;
+const std::size_t BlockCompressor::kDefaultMaxPendingBytes = 32 * 1024 * 1024;
+
+BlockCompressor::BlockCompressor(std::ostream& output,
+                                 int level,
+                                 std::size_t blockSize,
+                                 std::size_t threads,
+                                 std::size_t maxPendingBytes)
+   : output_(output),
+     level_(level),
+     blockSize_(std::max(blockSize, static_cast<std::size_t>(1))),
+     stopping_(false),
+     finished_(false)
+{
+   // (compression usually runs alongside other work, such as R writing
+   // the data being compressed, so by default it doesn't take every core)
+   if (threads == 0)
+   {
+      threads = std::min(
+               static_cast<std::size_t>(std::max(boost::thread::hardware_concurrency(), 1u)),
+               kDefaultMaxThreads);
+   }
+
+   // keep a couple of blocks per thread in flight (so threads don't wait
+   // on the output), within the bound on memory held by pending blocks.
+   // threads beyond the blocks which can be pending would only sit idle
+   maxPending_ = std::min(2 * threads, maxPendingBytes / blockSize_);
+   maxPending_ = std::max(maxPending_, static_cast<std::size_t>(1));
+   threads = std::min(threads, maxPending_);
+
+   for (std::size_t i = 0; i < threads; i++)
+      threads_.create_thread(boost::bind(&BlockCompressor::compressBlocks, this));
+}
+
+BlockCompressor::~BlockCompressor()
+{
+   try
+   {
+      stop();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error BlockCompressor::write(const char* data, std::size_t size)
+{
+   while (size > 0)
+   {
+      if (!pCurrent_)
+      {
+         pCurrent_.reset(new Block());
+         pCurrent_->input.reserve(blockSize_);
+      }
+
+      std::size_t count = std::min(size, blockSize_ - pCurrent_->input.size());
+      pCurrent_->input.append(data, count);
+      data += count;
+      size -= count;
+
+      if (pCurrent_->input.size() == blockSize_)
+      {
+         submitBlock();
+         Error error = writeBlocks(maxPending_);
+         if (error)
+            return error;
+      }
+   }
+
+   return Success();
+}
+
+Error BlockCompressor::finish()
+{
+   if (finished_)
+      return Success();
+   finished_ = true;
+
+   // (an empty input still gets a member so the output is valid gzip)
+   if (pCurrent_ || pending_.empty())
+   {
+      if (!pCurrent_)
+         pCurrent_.reset(new Block());
+      submitBlock();
+   }
+
+   Error error = writeBlocks(0);
+   stop();
+   if (error)
+      return error;
+
+   output_.flush();
+   if (!output_)
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+
+   return Success();
+}
+
+void BlockCompressor::submitBlock()
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   pending_.push_back(pCurrent_);
+   queue_.push_back(pCurrent_);
+   pCurrent_.reset();
+   queued_.notify_one();
+}
+
+Error BlockCompressor::writeBlocks(std::size_t maxPending)
+{
+   while (true)
+   {
+      boost::shared_ptr<Block> pBlock;
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         if (pending_.size() <= maxPending)
+            return Success();
+
+         // blocks are written in order, so wait for the oldest
+         while (!pending_.front()->done)
+            compressed_.wait(lock);
+
+         pBlock = pending_.front();
+         pending_.pop_front();
+      }
+
+      if (pBlock->error)
+         return pBlock->error;
+
+      output_.write(pBlock->output.data(), pBlock->output.size());
+      if (!output_)
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   }
+}
+
+void BlockCompressor::compressBlocks()
+{
+   while (true)
+   {
+      boost::shared_ptr<Block> pBlock;
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         while (queue_.empty() && !stopping_)
+            queued_.wait(lock);
+         if (queue_.empty())
+            return;
+
+         pBlock = queue_.front();
+         queue_.pop_front();
+      }
+
+      Error error = compressBlock(pBlock->input, level_, &pBlock->output);
+
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      pBlock->error = error;
+      pBlock->done = true;
+      std::string().swap(pBlock->input);
+      compressed_.notify_all();
+   }
+}
+
+void BlockCompressor::stop()
+{
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      stopping_ = true;
+      queued_.notify_all();
+   }
+   threads_.join_all();
+}
+
+Error readBlockIndex(std::istream& input, std::vector<BlockIndexEntry>* pIndex)
+{
+   boost::uint64_t offset = 0;
+   boost::uint64_t uncompressedOffset = 0;
+   while (true)
+   {
+      input.clear();
+      input.seekg(static_cast<std::streamoff>(offset));
+
+      unsigned char header[kHeaderSize + 64];
+      input.read(reinterpret_cast<char*>(header), sizeof(header));
+      std::size_t count = static_cast<std::size_t>(input.gcount());
+      if (count == 0)
+         break;
+
+      BlockIndexEntry entry;
+      std::size_t headerSize;
+      Error error = parseHeader(header, count, &headerSize, &entry);
+      if (error)
+         return error;
+
+      entry.offset = offset;
+      entry.uncompressedOffset = uncompressedOffset;
+      pIndex->push_back(entry);
+
+      offset += entry.compressedSize;
+      uncompressedOffset += entry.uncompressedSize;
+   }
+
+   input.clear();
+   return Success();
+}
+
+Error readBlock(std::istream& input,
+                const BlockIndexEntry& entry,
+                std::string* pData)
+{
+   std::string member(entry.compressedSize, '\0');
+   input.clear();
+   input.seekg(static_cast<std::streamoff>(entry.offset));
+   input.read(&member[0], member.size());
+   if (static_cast<std::size_t>(input.gcount()) != member.size())
+      return formatError("Truncated gzip member", ERROR_LOCATION);
+
+   const unsigned char* pMember = reinterpret_cast<const unsigned char*>(member.data());
+   BlockIndexEntry header;
+   std::size_t headerSize;
+   Error error = parseHeader(pMember, member.size(), &headerSize, &header);
+   if (error)
+      return error;
+
+   z_stream zStream;
+   zStream.zalloc = Z_NULL;
+   zStream.zfree = Z_NULL;
+   zStream.opaque = Z_NULL;
+   zStream.next_in = const_cast<Bytef*>(pMember + headerSize);
+   zStream.avail_in = static_cast<uInt>(member.size() - headerSize - kTrailerSize);
+
+   int res = inflateInit2(&zStream, -MAX_WBITS);
+   if (res != Z_OK)
+      return systemError(res, "ZLib initialization error", ERROR_LOCATION);
+
+   pData->resize(header.uncompressedSize);
+   zStream.next_out = reinterpret_cast<Bytef*>(pData->empty() ? NULL : &(*pData)[0]);
+   zStream.avail_out = static_cast<uInt>(pData->size());
+
+   res = inflate(&zStream, Z_FINISH);
+   std::size_t inflatedSize = zStream.total_out;
+   inflateEnd(&zStream);
+   if (res != Z_STREAM_END || inflatedSize != pData->size())
+      return systemError(res, "ZLib inflation error", ERROR_LOCATION);
+
+   const unsigned char* pTrailer = pMember + member.size() - kTrailerSize;
+   uLong crc = crc32(0L, Z_NULL, 0);
+   crc = crc32(crc,
+               reinterpret_cast<const Bytef*>(pData->data()),
+               static_cast<uInt>(pData->size()));
+   if (getUInt32(pTrailer) != static_cast<boost::uint32_t>(crc))
+      return formatError("Gzip member checksum mismatch", ERROR_LOCATION);
+
+   return Success();
+}
+
+} // namespace zlib
+} // namespace core
+} // namespace rstudio
@@ -14,13 +14,63 @@
 */
 
 #include <core/zlib/zlib.hpp>
+#include <core/zlib/BlockCompression.hpp>
+
+#include <sstream>
 
 #include <tests/TestThat.hpp>
 
+#include "zlib.h"
+
 namespace rstudio {
 namespace core {
 namespace zlib {
 
+namespace {
+
+std::string makeBlockTestData(std::size_t size)
+{
+   std::string data;
+   data.reserve(size);
+   for (std::size_t i = 0; data.size() < size; i++)
+      data.append("line " + std::to_string(i) + " of some test data\n");
+   data.resize(size);
+   return data;
+}
+
+// decompress as a standard gzip reader would (member after member)
+std::string gunzip(const std::string& compressed, std::size_t* pMembers = NULL)
+{
+   std::string output;
+   std::size_t offset = 0;
+   while (offset < compressed.size())
+   {
+      z_stream zStream = z_stream();
+      REQUIRE(inflateInit2(&zStream, MAX_WBITS + 32) == Z_OK);
+      zStream.next_in = (Bytef*) compressed.data() + offset;
+      zStream.avail_in = static_cast<uInt>(compressed.size() - offset);
+
+      int res = Z_OK;
+      while (res != Z_STREAM_END)
+      {
+         char buffer[4096];
+         zStream.next_out = (Bytef*) buffer;
+         zStream.avail_out = sizeof(buffer);
+         res = inflate(&zStream, Z_NO_FLUSH);
+         REQUIRE((res == Z_OK || res == Z_STREAM_END));
+         output.append(buffer, sizeof(buffer) - zStream.avail_out);
+      }
+
+      offset += zStream.total_in;
+      inflateEnd(&zStream);
+      if (pMembers)
+         ++*pMembers;
+   }
+   return output;
+}
+
+} // anonymous namespace
+
 context("zlib")
 {
    test_that("can compress & decompress difficult strings")
@@ -82,6 +132,115 @@ context("zlib")
 
       CHECK(empty == uncompressed);
    }
+
+   test_that("block compressed output is readable as gzip")
+   {
+      const std::string data = makeBlockTestData(100000);
+
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_BEST_SPEED, 4096, 4);
+      for (std::size_t i = 0; i < data.size(); i += 1000)
+         REQUIRE(!compressor.write(data.data() + i, std::min<std::size_t>(1000, data.size() - i)));
+      REQUIRE(!compressor.finish());
+
+      CHECK(gunzip(output.str()) == data);
+   }
+
+   test_that("block compressed output has a gzip member per block")
+   {
+      const std::string data = makeBlockTestData(50000);
+
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_DEFAULT_COMPRESSION, 8192, 3);
+      REQUIRE(!compressor.write(data.data(), data.size()));
+      REQUIRE(!compressor.finish());
+
+      std::size_t members = 0;
+      CHECK(gunzip(output.str(), &members) == data);
+      CHECK(members == 7);
+   }
+
+   test_that("block compressed blocks can be read individually")
+   {
+      const std::string data = makeBlockTestData(50000);
+
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_DEFAULT_COMPRESSION, 8192, 3);
+      REQUIRE(!compressor.write(data.data(), data.size()));
+      REQUIRE(!compressor.finish());
+
+      std::istringstream input(output.str());
+      std::vector<BlockIndexEntry> index;
+      REQUIRE(!readBlockIndex(input, &index));
+      REQUIRE(index.size() == 7);
+      CHECK(index.back().uncompressedOffset == 6 * 8192);
+      CHECK(index.back().uncompressedSize == 50000 - 6 * 8192);
+      CHECK(index.back().offset + index.back().compressedSize == output.str().size());
+
+      // read in reverse order to check blocks don't depend on each other
+      for (std::size_t i = index.size(); i > 0; i--)
+      {
+         const BlockIndexEntry& entry = index[i - 1];
+         std::string block;
+         REQUIRE(!readBlock(input, entry, &block));
+         CHECK(block == data.substr(entry.uncompressedOffset, entry.uncompressedSize));
+      }
+   }
+
+   test_that("reading a block detects corrupt data")
+   {
+      const std::string data = makeBlockTestData(20000);
+
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_BEST_SPEED, 8192, 2);
+      REQUIRE(!compressor.write(data.data(), data.size()));
+      REQUIRE(!compressor.finish());
+
+      std::string compressed = output.str();
+      std::istringstream input(compressed);
+      std::vector<BlockIndexEntry> index;
+      REQUIRE(!readBlockIndex(input, &index));
+      REQUIRE(index.size() == 3);
+
+      // flip a bit in the second block's checksum
+      compressed[index[1].offset + index[1].compressedSize - 8] ^= 0x01;
+      std::istringstream corrupt(compressed);
+      std::string block;
+      CHECK(readBlock(corrupt, index[1], &block));
+      REQUIRE(!readBlock(corrupt, index[2], &block));
+      CHECK(block == data.substr(index[2].uncompressedOffset));
+
+      // a plain gzip file has no block index
+      std::istringstream plain(compressed.substr(0, 2) + std::string(30, '\0'));
+      std::vector<BlockIndexEntry> plainIndex;
+      CHECK(readBlockIndex(plain, &plainIndex));
+   }
+
+   test_that("block compression works within a pending bound of one block")
+   {
+      const std::string data = makeBlockTestData(100000);
+
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_BEST_SPEED, 4096, 8, 1);
+      for (std::size_t i = 0; i < data.size(); i += 5000)
+         REQUIRE(!compressor.write(data.data() + i, std::min<std::size_t>(5000, data.size() - i)));
+      REQUIRE(!compressor.finish());
+
+      CHECK(gunzip(output.str()) == data);
+   }
+
+   test_that("block compressing no data writes an empty gzip file")
+   {
+      std::ostringstream output;
+      BlockCompressor compressor(output, Z_BEST_SPEED);
+      REQUIRE(!compressor.finish());
+
+      CHECK(!output.str().empty());
+
+      std::size_t members = 0;
+      CHECK(gunzip(output.str(), &members).empty());
+      CHECK(members == 1);
+   }
 }
 
 } // namespace zlib
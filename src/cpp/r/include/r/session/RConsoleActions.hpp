@@ -16,16 +16,17 @@
 #ifndef R_SESSION_CONSOLE_ACTIONS_HPP
 #define R_SESSION_CONSOLE_ACTIONS_HPP
 
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
 #include <boost/circular_buffer.hpp>
 
 #include <core/BoostThread.hpp>
+#include <core/FilePath.hpp>
 #include <core/json/Json.hpp>
 
 namespace rstudio {
 namespace core {
    class Error;
-   class FilePath;
 }
 }
 
@@ -44,10 +45,11 @@ ConsoleActions& consoleActions();
 
 class ConsoleActions : boost::noncopyable
 {
-private:
+public:
+   // the session uses the consoleActions() singleton (other instances are
+   // only created by tests)
    ConsoleActions();
-   friend ConsoleActions& consoleActions();
-   
+
 public:
    int capacity() const ;
    void setCapacity(int capacity);
@@ -64,9 +66,19 @@ public:
    // one for type and one for data)
    void asJson(core::json::Object* pActions) const;
    
+   // actions are saved as an append-only log: saving to the file last
+   // saved to (or loaded from) appends only the actions added or changed
+   // since then, and the log is compacted to the current actions once it
+   // holds more than twice their capacity. loading reads the log from its
+   // end, so only the records which are still visible are parsed
    core::Error loadFromFile(const core::FilePath& filePath);
    core::Error saveToFile(const core::FilePath& filePath) const;
 
+private:
+   core::Error loadLegacyFile(const core::FilePath& filePath);
+   std::string logRecord(std::size_t index) const;
+   core::Error compactLog(const core::FilePath& filePath) const;
+
 private:
    // protect data using a mutex because background threads (e.g.
    // console output capture threads) can interact with console actions
@@ -74,6 +86,19 @@ private:
    boost::circular_buffer<core::json::Value> actionsType_;
    boost::circular_buffer<core::json::Value> actionsData_;
    std::vector<std::string> pendingInput_;
+
+   // sequence number of the next action added (actions combined into the
+   // last action keep its sequence number)
+   boost::int64_t nextSeq_;
+
+   // log state: the oldest action changed since the log was written,
+   // whether the actions have been reset since, and the log's path, size
+   // and number of records
+   mutable boost::int64_t firstUnsavedSeq_;
+   mutable bool resetPending_;
+   mutable core::FilePath logPath_;
+   mutable uintmax_t logSize_;
+   mutable std::size_t logRecords_;
 };
 
    
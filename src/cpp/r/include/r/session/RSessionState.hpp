@@ -54,10 +54,14 @@ bool rProfileOnRestore(const core::FilePath& statePath);
 
 bool packratModeEnabled(const core::FilePath& statePath);
 
+// restore session state. when lazyLoadObjects is set, large workspace
+// values are only read when first used (so the state path must not be
+// removed once restored)
 bool restore(const core::FilePath& statePath, 
              bool serverMode,
              boost::function<core::Error()>* pDeferredRestoreAction,
-             std::string* pErrorMessages); 
+             std::string* pErrorMessages,
+             bool lazyLoadObjects = false);
    
 bool destroy(const core::FilePath& statePath);
 
@@ -0,0 +1,240 @@
+/*
+ * RBlockCompression.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RBlockCompression.hpp"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/Log.hpp>
+#include <core/zlib/BlockCompression.hpp>
+
+#include <r/RExec.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace block_compression {
+
+namespace {
+
+// compression level of the active scope (-1 if none is active), and the
+// threads it compresses with
+int s_level = -1;
+int s_threads = 0;
+
+// the save defaults to restore when the scope ends
+boost::scoped_ptr<r::sexp::PreservedSEXP> s_pSaveDefaults;
+
+#ifndef _WIN32
+
+// compress what's written to the pipe into the file. the pipe is always
+// read to its end (even if compressing fails) so the writer never blocks
+void compressPipe(int fd,
+                  const FilePath& file,
+                  int level,
+                  int threads,
+                  Error* pError)
+{
+   boost::shared_ptr<std::ostream> pStream;
+   Error error = file.open_w(&pStream);
+
+   boost::shared_ptr<core::zlib::BlockCompressor> pCompressor;
+   if (!error)
+   {
+      pCompressor.reset(new core::zlib::BlockCompressor(
+                           *pStream,
+                           level,
+                           core::zlib::BlockCompressor::kDefaultBlockSize,
+                           static_cast<std::size_t>(threads)));
+   }
+
+   std::vector<char> buffer(64 * 1024);
+   while (true)
+   {
+      ssize_t count = ::read(fd, &buffer[0], buffer.size());
+      if (count == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         if (!error)
+            error = systemError(errno, ERROR_LOCATION);
+         break;
+      }
+      else if (count == 0)
+      {
+         break;
+      }
+
+      if (!error)
+         error = pCompressor->write(&buffer[0], count);
+   }
+
+   if (!error)
+      error = pCompressor->finish();
+
+   *pError = error;
+}
+
+#endif
+
+} // anonymous namespace
+
+CompressionScope::CompressionScope(int level, int threads)
+   : owner_(false)
+{
+#ifndef _WIN32
+   if (s_level != -1)
+      return;
+
+   // turn off R's compression (we compress instead)
+   r::sexp::Protect protect;
+   SEXP saveDefaultsSEXP = R_NilValue;
+   Error error = r::exec::RFunction(".rs.setSaveCompression", false)
+                                          .call(&saveDefaultsSEXP, &protect);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   s_pSaveDefaults.reset(new r::sexp::PreservedSEXP(saveDefaultsSEXP));
+   s_level = level;
+   s_threads = std::max(threads, 0);
+   owner_ = true;
+#endif
+}
+
+CompressionScope::~CompressionScope()
+{
+   try
+   {
+      if (!owner_ || !s_pSaveDefaults)
+         return;
+
+      Error error = r::exec::RFunction(".rs.restoreSaveDefaults",
+                                       s_pSaveDefaults->get()).call();
+      if (error)
+         LOG_ERROR(error);
+
+      s_pSaveDefaults.reset();
+      s_level = -1;
+   }
+   catch(...)
+   {
+   }
+}
+
+bool active()
+{
+   return s_level != -1;
+}
+
+Error writeFile(const FilePath& file,
+                const boost::function<Error(const FilePath&)>& writeFunction)
+{
+#ifndef _WIN32
+   if (!active())
+      return writeFunction(file);
+
+   // create the pipe the file is written through
+   FilePath pipePath = file.parent().complete(file.filename() + ".pipe");
+   Error error = pipePath.removeIfExists();
+   if (error)
+      return error;
+
+   if (::mkfifo(pipePath.absolutePath().c_str(), S_IRUSR | S_IWUSR) == -1)
+   {
+      // fall back to an uncompressed file
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", pipePath);
+      LOG_ERROR(error);
+      return writeFunction(file);
+   }
+
+   // open both ends ourselves: the read end so the writer's open doesn't
+   // block, and the write end so the reader doesn't see the end of the
+   // pipe until the write function is done (even if it never opens it)
+   int readFd = ::open(pipePath.absolutePath().c_str(), O_RDONLY | O_NONBLOCK);
+   int writeFd = -1;
+   if (readFd != -1)
+      writeFd = ::open(pipePath.absolutePath().c_str(), O_WRONLY | O_NONBLOCK);
+   if (readFd == -1 || writeFd == -1)
+   {
+      error = systemError(errno, ERROR_LOCATION);
+      if (readFd != -1)
+         ::close(readFd);
+      pipePath.removeIfExists();
+      return error;
+   }
+
+   // the reader blocks waiting for data
+   ::fcntl(readFd, F_SETFL, ::fcntl(readFd, F_GETFL) & ~O_NONBLOCK);
+
+   Error compressError;
+   boost::thread reader(boost::bind(compressPipe,
+                                    readFd,
+                                    file,
+                                    s_level,
+                                    s_threads,
+                                    &compressError));
+
+   error = writeFunction(pipePath);
+
+   ::close(writeFd);
+   reader.join();
+   ::close(readFd);
+   pipePath.removeIfExists();
+
+   if (!error)
+      error = compressError;
+   if (error)
+      file.removeIfExists();
+
+   return error;
+#else
+   return writeFunction(file);
+#endif
+}
+
+Error compressFile(const FilePath& file,
+                   int level,
+                   const boost::function<Error(const FilePath&)>& writeFunction)
+{
+   CompressionScope scope(level);
+   return writeFile(file, writeFunction);
+}
+
+} // namespace block_compression
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -0,0 +1,86 @@
+/*
+ * RBlockCompression.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_BLOCK_COMPRESSION_HPP
+#define R_SESSION_BLOCK_COMPRESSION_HPP
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace block_compression {
+
+// Parallel compression of the files written when saving session state.
+//
+// R compresses what save and saveRDS write on the thread which runs R, so
+// saving a large workspace is bound by a single core. While a compression
+// scope is active R's save compression is turned off, and files written
+// through writeFile are instead streamed (through a pipe) to a block
+// compressor which compresses them on several cores. The output is gzip,
+// so it is read back by load and readRDS as usual.
+//
+// Plot snapshots, which are saved as the plots are rendered rather than
+// when the session is suspended, are written through compressFile.
+//
+// (on Windows there's no pipe to stream through, so files are written
+// with R's own compression)
+
+// zlib compression level R's save uses by default
+const int kDefaultSaveLevel = 6;
+
+class CompressionScope : boost::noncopyable
+{
+public:
+   // use the given zlib compression level and number of threads (0 for
+   // the block compressor's default)
+   explicit CompressionScope(int level, int threads = 0);
+   ~CompressionScope();
+
+private:
+   // (a scope created while another is active leaves it in effect)
+   bool owner_;
+};
+
+// is a compression scope active?
+bool active();
+
+// write a file using the given function (which is passed the path it
+// should write to), block compressing its output if a scope is active
+core::Error writeFile(
+      const core::FilePath& file,
+      const boost::function<core::Error(const core::FilePath&)>& writeFunction);
+
+// write a file using the given function, block compressing its output at
+// the given level (or the active scope's, if there is one)
+core::Error compressFile(
+      const core::FilePath& file,
+      int level,
+      const boost::function<core::Error(const core::FilePath&)>& writeFunction);
+
+} // namespace block_compression
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_BLOCK_COMPRESSION_HPP
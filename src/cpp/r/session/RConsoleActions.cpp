@@ -18,6 +18,7 @@
 #include <algorithm>
 
 #include <boost/algorithm/string/split.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include <core/Log.hpp>
 #include <core/Error.hpp>
@@ -36,6 +37,24 @@ namespace session {
 namespace {   
 const char * const kActionType = "type";
 const char * const kActionData = "data";
+
+// log records are json arrays, one per line: [seq, type, data] for an
+// action and [] when the actions are reset
+const char * const kLogReset = "[]\n";
+
+// compact the log once it has this many times the capacity in records
+const std::size_t kLogCompactionFactor = 2;
+
+// find the last newline in [pBegin, pEnd) (NULL if there is none)
+const char* findLastNewline(const char* pBegin, const char* pEnd)
+{
+   while (pEnd > pBegin)
+   {
+      if (*--pEnd == '\n')
+         return pEnd;
+   }
+   return NULL;
+}
 }
    
 ConsoleActions& consoleActions()
@@ -45,6 +64,11 @@ ConsoleActions& consoleActions()
 }
    
 ConsoleActions::ConsoleActions()
+   : nextSeq_(0),
+     firstUnsavedSeq_(0),
+     resetPending_(false),
+     logSize_(0),
+     logRecords_(0)
 {
    setCapacity(1000);
 }
@@ -65,8 +89,15 @@ void ConsoleActions::setCapacity(int capacity)
 {
    LOCK_MUTEX(mutex_)
    {
+      // shrinking the buffers drops their newest actions
+      std::size_t size = actionsType_.size();
       actionsType_.set_capacity(capacity);
       actionsData_.set_capacity(capacity);
+      nextSeq_ -= static_cast<boost::int64_t>(size - actionsType_.size());
+      firstUnsavedSeq_ = std::min(firstUnsavedSeq_, nextSeq_);
+
+      // the log needs to be compacted to the new capacity
+      logPath_ = FilePath();
    }
    END_LOCK_MUTEX
 }
@@ -102,11 +133,14 @@ void ConsoleActions::add(int type, const std::string& data)
           actionsData_.back().get_str().size() < 512)
       {
          actionsData_.back() = actionsData_.back().get_str() + data;
+         firstUnsavedSeq_ = std::min(firstUnsavedSeq_, nextSeq_ - 1);
       }
       else
       {
          actionsType_.push_back(type);
          actionsData_.push_back(data);
+         firstUnsavedSeq_ = std::min(firstUnsavedSeq_, nextSeq_);
+         nextSeq_++;
       }
    }
    END_LOCK_MUTEX
@@ -128,6 +162,8 @@ void ConsoleActions::reset()
       // clear the existing actions
       actionsType_.clear();
       actionsData_.clear();
+      firstUnsavedSeq_ = nextSeq_;
+      resetPending_ = true;
    }
    END_LOCK_MUTEX
 }
@@ -162,69 +198,257 @@ Error ConsoleActions::loadFromFile(const FilePath& filePath)
    {
       actionsType_.clear();
       actionsData_.clear();
+      nextSeq_ = 0;
+      firstUnsavedSeq_ = 0;
+      resetPending_ = false;
+      logPath_ = FilePath();
+      logSize_ = 0;
+      logRecords_ = 0;
+
+      if (!filePath.exists() || filePath.size() == 0)
+         return Success();
+
+      boost::iostreams::mapped_file_source file;
+      try
+      {
+         file.open(filePath.absolutePath());
+      }
+      catch(const std::exception& e)
+      {
+         Error error = systemError(boost::system::errc::io_error,
+                                   ERROR_LOCATION);
+         error.addProperty("path", filePath);
+         error.addProperty("what", e.what());
+         return error;
+      }
+
+      const char* pData = file.data();
+      std::size_t size = file.size();
+
+      // actions saved before they were logged were saved as a json object
+      if (pData[0] == '{')
+      {
+         file.close();
+         return loadLegacyFile(filePath);
+      }
+
+      // a record torn by a crash is dropped (and the log compacted when
+      // it is next saved)
+      bool tornTail = pData[size - 1] != '\n';
+      std::size_t end = size;
+      if (tornTail)
+      {
+         const char* pLastNewline = findLastNewline(pData, pData + size);
+         end = pLastNewline ? (pLastNewline - pData) + 1 : 0;
+      }
 
-      if (filePath.exists())
+      // read records from the end of the log until the buffer is full or
+      // the actions were reset. a record for an action which has already
+      // been read is an earlier version of it (before output was combined
+      // into it), so it is skipped
+      std::vector<json::Array> records;
+      boost::int64_t oldestSeq = 0;
+      std::size_t capacity = actionsType_.capacity();
+      while (end > 0 && records.size() < capacity)
       {
-         // read from file
-         std::string actionsJson ;
-         Error error = readStringFromFile(filePath, &actionsJson);
-         if (error)
-            return error ;
+         const char* pLineEnd = pData + end - 1;
+         const char* pNewline = findLastNewline(pData, pLineEnd);
+         const char* pLine = pNewline ? pNewline + 1 : pData;
+         end = pLine - pData;
 
-         // parse json and confirm it contains an object
          json::Value value;
-         if ( json::parse(actionsJson, &value) &&
-              (value.type() == json::ObjectType) )
+         if (!json::parse(std::string(pLine, pLineEnd), &value) ||
+             value.type() != json::ArrayType)
          {
-            json::Object& actions = value.get_obj();
-
-            const json::Value& typeValue = actions[kActionType] ;
-            if (typeValue.type() == json::ArrayType)
-            {
-               const json::Array& actionsType = typeValue.get_array();
-               std::copy(actionsType.begin(),
-                         actionsType.end(),
-                         std::back_inserter(actionsType_));
-            }
-            else
-            {
-               LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
-            }
-
-            json::Value& dataValue = actions[kActionData] ;
-            if ( dataValue.type() == json::ArrayType )
-            {
-               const json::Array& actionsData = dataValue.get_array();
-               std::copy(actionsData.begin(),
-                         actionsData.end(),
-                         std::back_inserter(actionsData_));
-            }
-            else
-            {
-               LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
-            }
+            LOG_WARNING_MESSAGE("unexpected console action record in: " +
+                                filePath.absolutePath());
+            tornTail = true;
+            continue;
          }
-         else
+
+         const json::Array& record = value.get_array();
+         if (record.empty())
+            break;
+
+         if (record.size() != 3 ||
+             record[0].type() != json::IntegerType ||
+             record[2].type() != json::StringType)
          {
-            LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
+            LOG_WARNING_MESSAGE("unexpected console action record in: " +
+                                filePath.absolutePath());
+            tornTail = true;
+            continue;
          }
+
+         boost::int64_t seq = record[0].get_int64();
+         if (!records.empty() && seq >= oldestSeq)
+            continue;
+
+         if (records.empty())
+            nextSeq_ = seq + 1;
+         oldestSeq = seq;
+         records.push_back(record);
+      }
+
+      for (std::vector<json::Array>::const_reverse_iterator it =
+             records.rbegin(); it != records.rend(); ++it)
+      {
+         actionsType_.push_back((*it)[1]);
+         actionsData_.push_back((*it)[2]);
+      }
+      firstUnsavedSeq_ = nextSeq_;
+
+      // continue appending to the log (unless it needs to be compacted)
+      if (!tornTail)
+      {
+         logPath_ = filePath;
+         logSize_ = size;
+         logRecords_ = std::count(pData, pData + size, '\n');
       }
    }
    END_LOCK_MUTEX
    
    return Success();
 }
-   
+
+Error ConsoleActions::loadLegacyFile(const FilePath& filePath)
+{
+   // read from file
+   std::string actionsJson ;
+   Error error = readStringFromFile(filePath, &actionsJson);
+   if (error)
+      return error ;
+
+   // parse json and confirm it contains an object
+   json::Value value;
+   if ( json::parse(actionsJson, &value) &&
+        (value.type() == json::ObjectType) )
+   {
+      json::Object& actions = value.get_obj();
+
+      const json::Value& typeValue = actions[kActionType] ;
+      if (typeValue.type() == json::ArrayType)
+      {
+         const json::Array& actionsType = typeValue.get_array();
+         std::copy(actionsType.begin(),
+                   actionsType.end(),
+                   std::back_inserter(actionsType_));
+      }
+      else
+      {
+         LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
+      }
+
+      json::Value& dataValue = actions[kActionData] ;
+      if ( dataValue.type() == json::ArrayType )
+      {
+         const json::Array& actionsData = dataValue.get_array();
+         std::copy(actionsData.begin(),
+                   actionsData.end(),
+                   std::back_inserter(actionsData_));
+      }
+      else
+      {
+         LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
+      }
+   }
+   else
+   {
+      LOG_WARNING_MESSAGE("unexpected json type in: " + actionsJson);
+   }
+
+   // the types and data must pair up
+   std::size_t size = std::min(actionsType_.size(), actionsData_.size());
+   actionsType_.resize(size);
+   actionsData_.resize(size);
+
+   nextSeq_ = size;
+   firstUnsavedSeq_ = nextSeq_;
+   return Success();
+}
+
+std::string ConsoleActions::logRecord(std::size_t index) const
+{
+   json::Array record;
+   boost::int64_t firstSeq =
+         nextSeq_ - static_cast<boost::int64_t>(actionsType_.size());
+   record.push_back(firstSeq + static_cast<boost::int64_t>(index));
+   record.push_back(actionsType_[index]);
+   record.push_back(actionsData_[index]);
+   return json::write(record) + "\n";
+}
+
+Error ConsoleActions::compactLog(const FilePath& filePath) const
+{
+   std::string records;
+   for (std::size_t i = 0; i < actionsType_.size(); i++)
+      records += logRecord(i);
+
+   // write the log to a temporary file and move it into place, so the
+   // previous log remains intact until the new one is complete
+   FilePath tempPath(filePath.absolutePath() + ".tmp");
+   Error error = writeStringToFile(tempPath, records);
+   if (!error)
+      error = tempPath.move(filePath, FilePath::MoveDirect);
+   if (error)
+   {
+      logPath_ = FilePath();
+      return error;
+   }
+
+   logPath_ = filePath;
+   logSize_ = records.size();
+   logRecords_ = actionsType_.size();
+   firstUnsavedSeq_ = nextSeq_;
+   resetPending_ = false;
+   return Success();
+}
+
 Error ConsoleActions::saveToFile(const core::FilePath& filePath) const
 {
-   // write actions
-   json::Object actionsObject;
-   asJson(&actionsObject);
-   std::ostringstream ostr ;
-   json::writeFormatted(actionsObject, ostr);
-   
-   // write to file
-   return writeStringToFile(filePath, ostr.str());
+   LOCK_MUTEX(mutex_)
+   {
+      // actions changed since the log was last written
+      boost::int64_t firstSeq =
+            nextSeq_ - static_cast<boost::int64_t>(actionsType_.size());
+      std::size_t first = static_cast<std::size_t>(
+                              std::max(firstUnsavedSeq_, firstSeq) - firstSeq);
+      std::size_t count = actionsType_.size() - first;
+
+      // compact the log if it isn't the one we've been writing (or has
+      // been changed by someone else), or if it has grown too large
+      if (logPath_ != filePath ||
+          !filePath.exists() ||
+          filePath.size() != logSize_ ||
+          logRecords_ + count >= kLogCompactionFactor * actionsType_.capacity())
+      {
+         return compactLog(filePath);
+      }
+
+      std::string records;
+      if (resetPending_)
+         records += kLogReset;
+      for (std::size_t i = first; i < actionsType_.size(); i++)
+         records += logRecord(i);
+
+      if (records.empty())
+         return Success();
+
+      Error error = appendToFile(filePath, records);
+      if (error)
+      {
+         logPath_ = FilePath();
+         return error;
+      }
+
+      logSize_ += records.size();
+      logRecords_ += count + (resetPending_ ? 1 : 0);
+      firstUnsavedSeq_ = nextSeq_;
+      resetPending_ = false;
+   }
+   END_LOCK_MUTEX
+
+   return Success();
 }
    
 } // namespace session
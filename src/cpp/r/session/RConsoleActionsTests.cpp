@@ -0,0 +1,271 @@
+/*
+ * RConsoleActionsTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <r/session/RConsoleActions.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempActionsFile
+{
+public:
+   TempActionsFile()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempActionsFile()
+   {
+      dir_.removeIfExists();
+   }
+
+   FilePath path() const { return dir_.complete("console_actions"); }
+
+   std::string contents() const
+   {
+      std::string contents;
+      Error error = readStringFromFile(path(), &contents);
+      return error ? std::string() : contents;
+   }
+
+   std::size_t records() const
+   {
+      std::string log = contents();
+      return std::count(log.begin(), log.end(), '\n');
+   }
+
+private:
+   FilePath dir_;
+};
+
+std::string actionsJson(const ConsoleActions& actions)
+{
+   json::Object object;
+   actions.asJson(&object);
+   return json::write(object);
+}
+
+// load the file into new actions and compare them with the actions saved
+void checkReload(const ConsoleActions& actions, const FilePath& path)
+{
+   ConsoleActions reloaded;
+   reloaded.setCapacity(actions.capacity());
+   REQUIRE(!reloaded.loadFromFile(path));
+   CHECK(actionsJson(reloaded) == actionsJson(actions));
+}
+
+void addCommand(ConsoleActions* pActions,
+                const std::string& input,
+                const std::string& output)
+{
+   pActions->add(kConsoleActionPrompt, "> ");
+   pActions->add(kConsoleActionInput, input);
+   pActions->add(kConsoleActionOutput, output);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Console Actions")
+{
+   TempActionsFile temp;
+   ConsoleActions actions;
+
+   SECTION("Actions round trip through the log")
+   {
+      addCommand(&actions, "x <- 1", "");
+      addCommand(&actions, "print(x)", "[1] 1\n");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.records() == 6);
+      checkReload(actions, temp.path());
+   }
+
+   SECTION("Saving again appends only the new actions")
+   {
+      addCommand(&actions, "x <- 1", "");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      std::string saved = temp.contents();
+
+      addCommand(&actions, "y <- 2", "");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(boost::algorithm::starts_with(temp.contents(), saved));
+      CHECK(temp.records() == 6);
+
+      // saving without changes doesn't write anything
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.records() == 6);
+
+      checkReload(actions, temp.path());
+   }
+
+   SECTION("Appending continues after the log is loaded")
+   {
+      addCommand(&actions, "x <- 1", "");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      std::string saved = temp.contents();
+
+      ConsoleActions reloaded;
+      REQUIRE(!reloaded.loadFromFile(temp.path()));
+      addCommand(&reloaded, "y <- 2", "");
+      REQUIRE(!reloaded.saveToFile(temp.path()));
+      CHECK(boost::algorithm::starts_with(temp.contents(), saved));
+      CHECK(temp.records() == 6);
+
+      checkReload(reloaded, temp.path());
+   }
+
+   SECTION("Output combined into the last action is logged again")
+   {
+      actions.add(kConsoleActionInput, "for (i in 1:3) print(i)");
+      actions.add(kConsoleActionOutput, "[1] 1\n");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.records() == 2);
+
+      // the combined action is appended with the same sequence number, and
+      // only its latest version is loaded
+      actions.add(kConsoleActionOutput, "[1] 2\n");
+      actions.add(kConsoleActionOutput, "[1] 3\n");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.records() == 3);
+      checkReload(actions, temp.path());
+
+      json::Object object;
+      actions.asJson(&object);
+      const json::Array& data = object["data"].get_array();
+      REQUIRE(data.size() == 2);
+      CHECK(data[1].get_str() == "[1] 1\n[1] 2\n[1] 3\n");
+
+      // and later actions follow it
+      actions.add(kConsoleActionPrompt, "> ");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      checkReload(actions, temp.path());
+   }
+
+   SECTION("A torn record at the end of the log is dropped")
+   {
+      addCommand(&actions, "x <- 1", "");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      std::string saved = temp.contents();
+
+      // simulate a record which was only partially written
+      REQUIRE(!writeStringToFile(temp.path(), saved + "[3,2,\"[1] "));
+
+      ConsoleActions reloaded;
+      REQUIRE(!reloaded.loadFromFile(temp.path()));
+      CHECK(actionsJson(reloaded) == actionsJson(actions));
+
+      // the next save compacts the log rather than appending to the torn
+      // record
+      addCommand(&reloaded, "y <- 2", "");
+      REQUIRE(!reloaded.saveToFile(temp.path()));
+      CHECK(temp.records() == 6);
+      checkReload(reloaded, temp.path());
+   }
+
+   SECTION("Actions before a reset aren't loaded")
+   {
+      addCommand(&actions, "x <- 1", "");
+      REQUIRE(!actions.saveToFile(temp.path()));
+
+      actions.reset();
+      actions.add(kConsoleActionPrompt, "> ");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.contents().find("\n[]\n") != std::string::npos);
+      CHECK(temp.records() == 5);
+
+      ConsoleActions reloaded;
+      REQUIRE(!reloaded.loadFromFile(temp.path()));
+      CHECK(actionsJson(reloaded) == actionsJson(actions));
+
+      json::Object object;
+      reloaded.asJson(&object);
+      CHECK(object["type"].get_array().size() == 1);
+
+      // a reset with nothing added since is still logged
+      actions.reset();
+      REQUIRE(!actions.saveToFile(temp.path()));
+      checkReload(actions, temp.path());
+   }
+
+   SECTION("Actions saved as a json object are loaded")
+   {
+      REQUIRE(!writeStringToFile(temp.path(),
+         "{\"type\":[0,1,2],\"data\":[\"> \",\"x\",\"[1] 1\\n\"]}"));
+
+      REQUIRE(!actions.loadFromFile(temp.path()));
+      json::Object object;
+      actions.asJson(&object);
+      REQUIRE(object["type"].get_array().size() == 3);
+      CHECK(object["type"].get_array()[1].get_int() == kConsoleActionInput);
+      CHECK(object["data"].get_array()[2].get_str() == "[1] 1\n");
+
+      // the next save replaces it with a log
+      actions.add(kConsoleActionPrompt, "> ");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.contents()[0] == '[');
+      CHECK(temp.records() == 4);
+      checkReload(actions, temp.path());
+   }
+
+   SECTION("The log is compacted at twice the capacity")
+   {
+      actions.setCapacity(5);
+      for (int i = 0; i < 5; i++)
+         actions.add(kConsoleActionInput, "x");
+      REQUIRE(!actions.saveToFile(temp.path()));
+      CHECK(temp.records() == 5);
+
+      std::size_t maxRecords = 0;
+      bool compacted = false;
+      for (int i = 0; i < 20; i++)
+      {
+         std::size_t records = temp.records();
+         actions.add(kConsoleActionInput, "x");
+         REQUIRE(!actions.saveToFile(temp.path()));
+         maxRecords = std::max(maxRecords, temp.records());
+         if (temp.records() < records)
+         {
+            CHECK(temp.records() == 5);
+            compacted = true;
+         }
+         checkReload(actions, temp.path());
+      }
+
+      CHECK(compacted);
+      CHECK(maxRecords < 10);
+   }
+}
+
+} // namespace tests
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -169,6 +169,7 @@ void deferredRestoreNewSession()
 } // anonymous namespace
 
 void restoreSession(const FilePath& suspendedSessionPath,
+                    bool lazyLoadObjects,
                     std::string* pErrorMessages)
 {
    // don't show output during deserialization (packages loaded
@@ -184,7 +185,8 @@ void restoreSession(const FilePath& suspendedSessionPath,
    r::session::state::restore(suspendedSessionPath,
                               utils::isServerMode(),
                               &deferredRestoreAction,
-                              pErrorMessages);
+                              pErrorMessages,
+                              lazyLoadObjects);
 
    if (deferredRestoreAction)
    {
@@ -270,7 +272,9 @@ Error initialize()
    {
       // restore session
       std::string errorMessages ;
-      restoreSession(restartContext().sessionStatePath(), &errorMessages);
+      // (restart state is removed once restored, so nothing can be left
+      // to load later)
+      restoreSession(restartContext().sessionStatePath(), false, &errorMessages);
 
       // show any error messages
       if (!errorMessages.empty())
@@ -283,7 +287,9 @@ Error initialize()
    {  
       // restore session
       std::string errorMessages ;
-      restoreSession(suspendedSessionPath(), &errorMessages);
+      // (the suspended session stays in place until the session quits, so
+      // large values can be left there until they're used)
+      restoreSession(suspendedSessionPath(), true, &errorMessages);
       
       // show any error messages
       if (!errorMessages.empty())
@@ -0,0 +1,577 @@
+/*
+ * RObjectStore.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RObjectStore.hpp"
+#include "RBlockCompression.hpp"
+
+#include <cstring>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RExec.hpp>
+#include <r/RSexp.hpp>
+#include <r/RSxpInfo.hpp>
+#include <r/RVersionInfo.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace object_store {
+
+namespace {
+
+const char * const kObjectsDir = "objects";
+const char * const kManifestExt = ".manifest";
+
+// (the function promises for lazily restored values call)
+const char * const kReadObjectFunction = ".rs.readObjectFile";
+
+// values smaller than this are left in the environment file (where they
+// cost little to rewrite)
+const std::size_t kMinStoredBytes = 1024 * 1024;
+
+// nesting beyond this isn't plain data worth storing separately
+const int kMaxDepth = 32;
+
+// 128-bit hash of a value's content. this reads each byte of the value
+// once (in memory), which is far cheaper than serializing and writing it
+class ContentHash
+{
+public:
+   ContentHash()
+      : h1_(UINT64_C(0x243F6A8885A308D3)),
+        h2_(UINT64_C(0x13198A2E03707344)),
+        length_(0)
+   {
+   }
+
+   void update(boost::uint64_t value)
+   {
+      mix(value);
+      length_ += sizeof(value);
+   }
+
+   void update(const void* data, std::size_t size)
+   {
+      const char* pData = static_cast<const char*>(data);
+      std::size_t i = 0;
+      for (; i + sizeof(boost::uint64_t) <= size; i += sizeof(boost::uint64_t))
+      {
+         boost::uint64_t word;
+         std::memcpy(&word, pData + i, sizeof(word));
+         mix(word);
+      }
+
+      if (i < size)
+      {
+         boost::uint64_t word = 0;
+         std::memcpy(&word, pData + i, size - i);
+         mix(word);
+      }
+
+      length_ += size;
+   }
+
+   std::string hexDigest() const
+   {
+      boost::uint64_t h1 = finalize(h1_ ^ length_);
+      boost::uint64_t h2 = finalize(h2_ + length_);
+      return boost::str(boost::format("%016x%016x") % h1 % h2);
+   }
+
+private:
+   static boost::uint64_t rotl(boost::uint64_t value, int bits)
+   {
+      return (value << bits) | (value >> (64 - bits));
+   }
+
+   static boost::uint64_t finalize(boost::uint64_t h)
+   {
+      h ^= h >> 33;
+      h *= UINT64_C(0xFF51AFD7ED558CCD);
+      h ^= h >> 33;
+      h *= UINT64_C(0xC4CEB9FE1A85EC53);
+      h ^= h >> 33;
+      return h;
+   }
+
+   void mix(boost::uint64_t word)
+   {
+      h1_ = rotl(h1_ ^ (word * UINT64_C(0x87C37B91114253D5)), 31) * UINT64_C(0x4CF5AD432745937F);
+      h2_ = rotl(h2_ + (word * UINT64_C(0x9E3779B97F4A7C15)), 27) * UINT64_C(0xC2B2AE3D27D4EB4F);
+      h2_ += h1_;
+   }
+
+   boost::uint64_t h1_;
+   boost::uint64_t h2_;
+   boost::uint64_t length_;
+};
+
+bool isAltrep(SEXP valueSEXP)
+{
+   // (ALTREP objects were introduced in R 3.5.0)
+   static bool hasAltrep =
+         !(version_info::currentRVersion() < r_util::RVersionNumber(3, 5, 0));
+   if (!hasAltrep)
+      return false;
+
+   return reinterpret_cast<r::sxpinfo*>(valueSEXP)->alt;
+}
+
+// determine whether the value is plain data -- vectors and lists (with
+// attributes of the same) -- and if so its approximate size. anything which
+// could share state with other bindings (environments, closures, external
+// pointers) must be saved along with them, and ALTREP objects are left to
+// R's serialization (which may not need to expand them)
+bool measure(SEXP valueSEXP, int depth, std::size_t* pBytes)
+{
+   if (depth > kMaxDepth || isAltrep(valueSEXP))
+      return false;
+
+   std::size_t length = static_cast<std::size_t>(XLENGTH(valueSEXP));
+   switch (TYPEOF(valueSEXP))
+   {
+   case NILSXP:
+      break;
+   case LGLSXP:
+   case INTSXP:
+      *pBytes += length * sizeof(int);
+      break;
+   case REALSXP:
+      *pBytes += length * sizeof(double);
+      break;
+   case CPLXSXP:
+      *pBytes += length * sizeof(Rcomplex);
+      break;
+   case RAWSXP:
+      *pBytes += length;
+      break;
+   case STRSXP:
+      *pBytes += length * sizeof(SEXP);
+      break;
+   case VECSXP:
+      for (std::size_t i = 0; i < length; i++)
+      {
+         if (!measure(VECTOR_ELT(valueSEXP, i), depth + 1, pBytes))
+            return false;
+      }
+      break;
+   default:
+      return false;
+   }
+
+   for (SEXP attribSEXP = ATTRIB(valueSEXP);
+        attribSEXP != R_NilValue;
+        attribSEXP = CDR(attribSEXP))
+   {
+      if (!measure(CAR(attribSEXP), depth + 1, pBytes))
+         return false;
+   }
+
+   return true;
+}
+
+// hash a value which measure() has accepted
+void hashValue(SEXP valueSEXP, ContentHash* pHash)
+{
+   R_xlen_t length = XLENGTH(valueSEXP);
+   pHash->update(TYPEOF(valueSEXP));
+   pHash->update(OBJECT(valueSEXP));
+   pHash->update(IS_S4_OBJECT(valueSEXP));
+   pHash->update(length);
+
+   switch (TYPEOF(valueSEXP))
+   {
+   case LGLSXP:
+      pHash->update(LOGICAL(valueSEXP), length * sizeof(int));
+      break;
+   case INTSXP:
+      pHash->update(INTEGER(valueSEXP), length * sizeof(int));
+      break;
+   case REALSXP:
+      pHash->update(REAL(valueSEXP), length * sizeof(double));
+      break;
+   case CPLXSXP:
+      pHash->update(COMPLEX(valueSEXP), length * sizeof(Rcomplex));
+      break;
+   case RAWSXP:
+      pHash->update(RAW(valueSEXP), length);
+      break;
+   case STRSXP:
+      for (R_xlen_t i = 0; i < length; i++)
+      {
+         SEXP charSEXP = STRING_ELT(valueSEXP, i);
+         if (charSEXP == NA_STRING)
+         {
+            pHash->update(~UINT64_C(0));
+            continue;
+         }
+         pHash->update(Rf_getCharCE(charSEXP));
+         pHash->update(LENGTH(charSEXP));
+         pHash->update(CHAR(charSEXP), LENGTH(charSEXP));
+      }
+      break;
+   case VECSXP:
+      for (R_xlen_t i = 0; i < length; i++)
+         hashValue(VECTOR_ELT(valueSEXP, i), pHash);
+      break;
+   default:
+      break;
+   }
+
+   for (SEXP attribSEXP = ATTRIB(valueSEXP);
+        attribSEXP != R_NilValue;
+        attribSEXP = CDR(attribSEXP))
+   {
+      const char* tag = CHAR(PRINTNAME(TAG(attribSEXP)));
+      pHash->update(tag, std::strlen(tag) + 1);
+      hashValue(CAR(attribSEXP), pHash);
+   }
+}
+
+FilePath objectsPath(const FilePath& statePath)
+{
+   return statePath.complete(kObjectsDir);
+}
+
+FilePath manifestPath(const FilePath& environmentFile)
+{
+   return environmentFile.parent().complete(environmentFile.filename() +
+                                            kManifestExt);
+}
+
+Error saveObjectFile(SEXP valueSEXP, const FilePath& file)
+{
+   return r::exec::RFunction(".rs.saveObjectFile",
+                             valueSEXP,
+                             file.absolutePath()).call();
+}
+
+Error saveObject(SEXP valueSEXP, const FilePath& objectPath)
+{
+   // write to a temporary file first so a partially written value never
+   // appears to be in the store
+   FilePath tempPath = objectPath.parent().complete(objectPath.filename() + ".tmp");
+   Error error = block_compression::writeFile(tempPath,
+                                              boost::bind(saveObjectFile,
+                                                          valueSEXP,
+                                                          _1));
+   if (error)
+   {
+      tempPath.removeIfExists();
+      return error;
+   }
+
+   return tempPath.move(objectPath);
+}
+
+Error writeManifest(const FilePath& manifestFile,
+                    const std::vector<std::string>& lines)
+{
+   FilePath tempPath = manifestFile.parent().complete(manifestFile.filename() + ".tmp");
+   Error error = writeStringVectorToFile(tempPath, lines);
+   if (error)
+      return error;
+
+   return tempPath.move(manifestFile);
+}
+
+// parse a manifest line ("<hash> <size> <name>")
+bool parseManifestLine(const std::string& line,
+                       std::string* pHash,
+                       double* pSize,
+                       std::string* pName)
+{
+   std::string::size_type hashEnd = line.find(' ');
+   if (hashEnd == std::string::npos)
+      return false;
+   std::string::size_type sizeEnd = line.find(' ', hashEnd + 1);
+   if (sizeEnd == std::string::npos)
+      return false;
+
+   *pHash = line.substr(0, hashEnd);
+   *pSize = safe_convert::stringTo<double>(
+            line.substr(hashEnd + 1, sizeEnd - hashEnd - 1), 0);
+   *pName = line.substr(sizeEnd + 1);
+   return true;
+}
+
+bool addReferencedObjects(const FilePath& path, std::set<std::string>* pReferenced)
+{
+   if (path.extensionLowerCase() != kManifestExt)
+      return true;
+
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(path, &lines, false);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return true;
+   }
+
+   for (std::size_t i = 0; i < lines.size(); i++)
+   {
+      std::string hash, name;
+      double size;
+      if (parseManifestLine(lines[i], &hash, &size, &name))
+         pReferenced->insert(hash);
+   }
+
+   return true;
+}
+
+// is this a promise installed by a lazy restore which hasn't been used yet?
+// if so, get the stored object it will read and the object's size
+bool isStoredObjectPromise(SEXP valueSEXP, FilePath* pObjectPath, double* pSize)
+{
+   if (TYPEOF(valueSEXP) != PROMSXP || PRVALUE(valueSEXP) != R_UnboundValue)
+      return false;
+
+   // .rs.readObjectFile("<path>", <size>)
+   SEXP codeSEXP = PRCODE(valueSEXP);
+   if (TYPEOF(codeSEXP) != LANGSXP ||
+       CAR(codeSEXP) != Rf_install(kReadObjectFunction) ||
+       Rf_length(codeSEXP) != 3)
+   {
+      return false;
+   }
+
+   SEXP pathSEXP = CADR(codeSEXP);
+   SEXP sizeSEXP = CADDR(codeSEXP);
+   if (TYPEOF(pathSEXP) != STRSXP || Rf_length(pathSEXP) != 1 ||
+       TYPEOF(sizeSEXP) != REALSXP || Rf_length(sizeSEXP) != 1)
+   {
+      return false;
+   }
+
+   *pObjectPath = FilePath(CHAR(STRING_ELT(pathSEXP, 0)));
+   *pSize = REAL(sizeSEXP)[0];
+   return true;
+}
+
+// copy an object from the store of another state path
+Error copyObject(const FilePath& sourcePath, const FilePath& objectPath)
+{
+   FilePath tempPath = objectPath.parent().complete(objectPath.filename() + ".tmp");
+   Error error = sourcePath.copy(tempPath);
+   if (error)
+   {
+      tempPath.removeIfExists();
+      return error;
+   }
+
+   return tempPath.move(objectPath);
+}
+
+} // anonymous namespace
+
+Error saveEnvironment(SEXP envSEXP,
+                      const FilePath& environmentFile,
+                      const FilePath& statePath,
+                      std::vector<std::string>* pUnsaved)
+{
+   FilePath objectsDir = objectsPath(statePath);
+
+   r::sexp::Protect protect;
+   std::vector<r::sexp::Variable> vars;
+   r::sexp::listEnvironment(envSEXP, true, false, &protect, &vars);
+
+   std::vector<std::string> manifest;
+   for (std::size_t i = 0; i < vars.size(); i++)
+   {
+      const std::string& name = vars[i].first;
+      SEXP valueSEXP = vars[i].second;
+
+      // names which can't be written on a line of the manifest are saved
+      // the usual way
+      if (name.find_first_of("\r\n") != std::string::npos)
+      {
+         pUnsaved->push_back(name);
+         continue;
+      }
+
+      // values which haven't been used since they were lazily restored are
+      // kept without reading them back in
+      FilePath sourcePath;
+      double size = 0;
+      if (isStoredObjectPromise(valueSEXP, &sourcePath, &size) &&
+          sourcePath.exists())
+      {
+         std::string digest = sourcePath.filename();
+         FilePath objectPath = objectsDir.complete(digest);
+         if (!objectPath.exists())
+         {
+            Error error = objectsDir.ensureDirectory();
+            if (error)
+               return error;
+
+            error = copyObject(sourcePath, objectPath);
+            if (error)
+               return error;
+         }
+
+         manifest.push_back(digest + " " +
+                            safe_convert::numberToString(size) + " " + name);
+         continue;
+      }
+
+      // other promises are stored by value once forced (and otherwise left
+      // for save to force)
+      if (TYPEOF(valueSEXP) == PROMSXP && PRVALUE(valueSEXP) != R_UnboundValue)
+         valueSEXP = PRVALUE(valueSEXP);
+
+      std::size_t bytes = 0;
+      if (TYPEOF(valueSEXP) == PROMSXP ||
+          !measure(valueSEXP, 0, &bytes) ||
+          bytes < kMinStoredBytes)
+      {
+         pUnsaved->push_back(name);
+         continue;
+      }
+
+      ContentHash hash;
+      hashValue(valueSEXP, &hash);
+      std::string digest = hash.hexDigest();
+
+      // write the value unless the store already has it
+      FilePath objectPath = objectsDir.complete(digest);
+      if (!objectPath.exists())
+      {
+         Error error = objectsDir.ensureDirectory();
+         if (error)
+            return error;
+
+         error = saveObject(valueSEXP, objectPath);
+         if (error)
+            return error;
+      }
+
+      manifest.push_back(digest + " " +
+                         safe_convert::numberToString(bytes) + " " + name);
+   }
+
+   FilePath manifestFile = manifestPath(environmentFile);
+   if (manifest.empty())
+      return manifestFile.removeIfExists();
+   else
+      return writeManifest(manifestFile, manifest);
+}
+
+bool hasManifest(const FilePath& environmentFile)
+{
+   return manifestPath(environmentFile).exists();
+}
+
+Error readManifest(const FilePath& environmentFile,
+                   const FilePath& statePath,
+                   std::vector<std::string>* pNames,
+                   std::vector<std::string>* pFiles,
+                   std::vector<double>* pSizes)
+{
+   FilePath manifestFile = manifestPath(environmentFile);
+   if (!manifestFile.exists())
+      return Success();
+
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(manifestFile, &lines, false);
+   if (error)
+      return error;
+
+   FilePath objectsDir = objectsPath(statePath);
+   for (std::size_t i = 0; i < lines.size(); i++)
+   {
+      std::string hash, name;
+      double size;
+      if (!parseManifestLine(lines[i], &hash, &size, &name))
+         continue;
+
+      pNames->push_back(name);
+      pFiles->push_back(objectsDir.complete(hash).absolutePath());
+      pSizes->push_back(size);
+   }
+
+   return Success();
+}
+
+Error restoreEnvironment(SEXP envSEXP,
+                         const FilePath& environmentFile,
+                         const FilePath& statePath,
+                         bool lazy)
+{
+   std::vector<std::string> names, files;
+   std::vector<double> sizes;
+   Error error = readManifest(environmentFile, statePath, &names, &files, &sizes);
+   if (error)
+      return error;
+
+   if (names.empty())
+      return Success();
+
+   r::exec::RFunction restore(".rs.restoreObjectFiles");
+   restore.addParam(names);
+   restore.addParam(files);
+   restore.addParam(sizes);
+   restore.addParam(envSEXP);
+   restore.addParam("lazy", lazy);
+   return restore.call();
+}
+
+Error removeUnreferencedObjects(const FilePath& statePath)
+{
+   FilePath objectsDir = objectsPath(statePath);
+   if (!objectsDir.exists())
+      return Success();
+
+   std::set<std::string> referenced;
+   Error error = statePath.childrenRecursive(
+            boost::bind(addReferencedObjects, _2, &referenced));
+   if (error)
+      return error;
+
+   std::vector<FilePath> objects;
+   error = objectsDir.children(&objects);
+   if (error)
+      return error;
+
+   for (std::size_t i = 0; i < objects.size(); i++)
+   {
+      if (referenced.count(objects[i].filename()))
+         continue;
+
+      error = objects[i].remove();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   return Success();
+}
+
+} // namespace object_store
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -0,0 +1,86 @@
+/*
+ * RObjectStore.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_OBJECT_STORE_HPP
+#define R_SESSION_OBJECT_STORE_HPP
+
+#include <string>
+#include <vector>
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace object_store {
+
+// Content-addressed storage for the values in suspended environments.
+//
+// Large values made only of plain data (vectors and lists, with their
+// attributes) are each saved to a file in the state path's object store,
+// named by a hash of their content. The values saved for an environment
+// file are listed (with their sizes) in a manifest next to it, and the
+// environment file itself only needs to hold the remaining bindings. Since
+// a value's file is named by its content, a value which hasn't changed
+// since the last suspend is found in the store and isn't written again.
+//
+// Stored values can be restored lazily, as promises which read the value
+// from the store when it is first used. Such promises which are still
+// unused when the environment is next saved keep their stored value
+// without it being read.
+
+// save the large plain data values in the environment to the store and
+// write the manifest for the environment file. the names of the bindings
+// which still need saving to the environment file are returned
+core::Error saveEnvironment(SEXP envSEXP,
+                            const core::FilePath& environmentFile,
+                            const core::FilePath& statePath,
+                            std::vector<std::string>* pUnsaved);
+
+// were any of the environment file's bindings saved to the store?
+bool hasManifest(const core::FilePath& environmentFile);
+
+// read the manifest for the environment file (returning the names of the
+// stored bindings, the files holding their values, and their approximate
+// size in memory)
+core::Error readManifest(const core::FilePath& environmentFile,
+                         const core::FilePath& statePath,
+                         std::vector<std::string>* pNames,
+                         std::vector<std::string>* pFiles,
+                         std::vector<double>* pSizes);
+
+// restore the stored bindings listed in the environment file's manifest
+// (lazily, if the state path will outlive the restored environment)
+core::Error restoreEnvironment(SEXP envSEXP,
+                               const core::FilePath& environmentFile,
+                               const core::FilePath& statePath,
+                               bool lazy);
+
+// remove values which no manifest in the state path refers to
+core::Error removeUnreferencedObjects(const core::FilePath& statePath);
+
+} // namespace object_store
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_OBJECT_STORE_HPP
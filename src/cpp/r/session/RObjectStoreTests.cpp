@@ -0,0 +1,315 @@
+/*
+ * RObjectStoreTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RObjectStore.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <algorithm>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+#include <r/RExec.hpp>
+#include <r/RSexp.hpp>
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace object_store {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempStatePath
+{
+public:
+   TempStatePath()
+   {
+      FilePath::tempFilePath(&path_);
+      path_.ensureDirectory();
+   }
+
+   ~TempStatePath()
+   {
+      path_.removeIfExists();
+   }
+
+   const FilePath& path() const { return path_; }
+   FilePath environmentFile() const { return path_.complete("environment"); }
+   FilePath objectsDir() const { return path_.complete("objects"); }
+
+   std::vector<std::string> objects() const
+   {
+      std::vector<FilePath> children;
+      if (objectsDir().exists())
+         objectsDir().children(&children);
+
+      std::vector<std::string> names;
+      for (std::size_t i = 0; i < children.size(); i++)
+         names.push_back(children[i].filename());
+      std::sort(names.begin(), names.end());
+      return names;
+   }
+
+private:
+   FilePath path_;
+};
+
+SEXP evaluate(const std::string& code, r::sexp::Protect* pProtect)
+{
+   SEXP valueSEXP = R_NilValue;
+   Error error = r::exec::evaluateString(code, &valueSEXP, pProtect);
+   REQUIRE(!error);
+   return valueSEXP;
+}
+
+// an environment with two bindings of the same large value, and a small one
+SEXP largeEnvironment(r::sexp::Protect* pProtect)
+{
+   return evaluate("local({"
+                   "  e <- new.env();"
+                   "  e$a <- as.numeric(seq_len(2e5));"
+                   "  e$b <- e$a;"
+                   "  e$small <- 1:10;"
+                   "  e })", pProtect);
+}
+
+void assignBinding(SEXP envSEXP, const std::string& name, const std::string& code)
+{
+   r::sexp::Protect protect;
+   SEXP valueSEXP = evaluate(code, &protect);
+   r::exec::RFunction assignFunction("assign");
+   assignFunction.addParam(name);
+   assignFunction.addParam(valueSEXP);
+   assignFunction.addParam("envir", envSEXP);
+   REQUIRE(!assignFunction.call());
+}
+
+void removeBinding(SEXP envSEXP, const std::string& name)
+{
+   r::exec::RFunction rmFunction("rm");
+   rmFunction.addParam("list", name);
+   rmFunction.addParam("envir", envSEXP);
+   REQUIRE(!rmFunction.call());
+}
+
+// get (forcing any promise) the value bound in the environment
+SEXP get(SEXP envSEXP, const std::string& name, r::sexp::Protect* pProtect)
+{
+   SEXP valueSEXP = R_NilValue;
+   r::exec::RFunction getFunction("get");
+   getFunction.addParam(name);
+   getFunction.addParam("envir", envSEXP);
+   REQUIRE(!getFunction.call(&valueSEXP, pProtect));
+   return valueSEXP;
+}
+
+bool identicalValues(SEXP xSEXP, SEXP ySEXP)
+{
+   bool identical = false;
+   Error error = r::exec::RFunction("identical", xSEXP, ySEXP).call(&identical);
+   return !error && identical;
+}
+
+struct Manifest
+{
+   std::vector<std::string> names;
+   std::vector<std::string> files;
+   std::vector<double> sizes;
+
+   std::string fileFor(const std::string& name) const
+   {
+      for (std::size_t i = 0; i < names.size(); i++)
+      {
+         if (names[i] == name)
+            return FilePath(files[i]).filename();
+      }
+      return std::string();
+   }
+};
+
+Manifest manifest(const FilePath& environmentFile, const FilePath& statePath)
+{
+   Manifest manifest;
+   REQUIRE(!readManifest(environmentFile,
+                         statePath,
+                         &manifest.names,
+                         &manifest.files,
+                         &manifest.sizes));
+   return manifest;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Object Store")
+{
+   TempStatePath state;
+   r::sexp::Protect protect;
+   SEXP envSEXP = largeEnvironment(&protect);
+
+   SECTION("Large values are stored once, by content")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      REQUIRE(unsaved.size() == 1);
+      CHECK(unsaved[0] == "small");
+      CHECK(hasManifest(state.environmentFile()));
+
+      Manifest stored = manifest(state.environmentFile(), state.path());
+      CHECK(stored.names.size() == 2);
+      CHECK(stored.fileFor("a") == stored.fileFor("b"));
+      CHECK(stored.sizes[0] >= 2e5 * sizeof(double));
+
+      std::vector<std::string> objects = state.objects();
+      REQUIRE(objects.size() == 1);
+      CHECK(objects[0] == stored.fileFor("a"));
+   }
+
+   SECTION("Stored values round trip")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      SEXP restoredSEXP = evaluate("new.env()", &protect);
+      REQUIRE(!restoreEnvironment(restoredSEXP, state.environmentFile(), state.path(), false));
+      CHECK(identicalValues(get(restoredSEXP, "a", &protect), get(envSEXP, "a", &protect)));
+      CHECK(identicalValues(get(restoredSEXP, "b", &protect), get(envSEXP, "b", &protect)));
+
+      // lazily restored values read the same values when first used
+      SEXP lazySEXP = evaluate("new.env()", &protect);
+      REQUIRE(!restoreEnvironment(lazySEXP, state.environmentFile(), state.path(), true));
+      CHECK(identicalValues(get(lazySEXP, "a", &protect), get(envSEXP, "a", &protect)));
+   }
+
+   SECTION("Unused lazily restored values are kept without being read")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+      std::string digest = manifest(state.environmentFile(), state.path()).fileFor("a");
+
+      // save the lazily restored environment to another state path
+      SEXP lazySEXP = evaluate("new.env()", &protect);
+      REQUIRE(!restoreEnvironment(lazySEXP, state.environmentFile(), state.path(), true));
+
+      TempStatePath other;
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(lazySEXP, other.environmentFile(), other.path(), &unsaved));
+      CHECK(unsaved.empty());
+      CHECK(manifest(other.environmentFile(), other.path()).fileFor("a") == digest);
+      CHECK(other.objects() == state.objects());
+   }
+
+   SECTION("Unchanged values aren't written again")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      // replace the stored value with a marker; a save which wrote the
+      // value again would overwrite it
+      FilePath objectPath = state.objectsDir().complete(state.objects()[0]);
+      REQUIRE(!writeStringToFile(objectPath, "unchanged"));
+
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      std::string contents;
+      REQUIRE(!readStringFromFile(objectPath, &contents));
+      CHECK(contents == "unchanged");
+      CHECK(state.objects().size() == 1);
+   }
+
+   SECTION("Changed values are stored under their new content")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+      std::string original = manifest(state.environmentFile(), state.path()).fileFor("a");
+
+      // change one element
+      assignBinding(envSEXP, "a", "replace(as.numeric(seq_len(2e5)), 1000, -1)");
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      Manifest stored = manifest(state.environmentFile(), state.path());
+      CHECK(stored.fileFor("a") != original);
+      CHECK(stored.fileFor("b") == original);
+      CHECK(state.objects().size() == 2);
+   }
+
+   SECTION("Objects no manifest refers to are removed")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+      std::string original = manifest(state.environmentFile(), state.path()).fileFor("a");
+
+      // a manifest elsewhere in the state path (e.g. for an attached data
+      // environment) keeps its values
+      FilePath dataDir = state.path().complete("search_path/environments");
+      REQUIRE(!dataDir.ensureDirectory());
+      SEXP dataSEXP = evaluate("local({ e <- new.env(); e$x <- as.numeric(seq_len(2e5)); e })",
+                               &protect);
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(dataSEXP, dataDir.complete("data"), state.path(), &unsaved));
+
+      assignBinding(envSEXP, "a", "as.numeric(seq_len(3e5))");
+      removeBinding(envSEXP, "b");
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+      std::string changed = manifest(state.environmentFile(), state.path()).fileFor("a");
+      CHECK(state.objects().size() == 2);
+
+      REQUIRE(!removeUnreferencedObjects(state.path()));
+      std::vector<std::string> objects = state.objects();
+      CHECK(objects.size() == 2);
+      CHECK(std::count(objects.begin(), objects.end(), original) == 1);
+      CHECK(std::count(objects.begin(), objects.end(), changed) == 1);
+
+      // once the data environment no longer has it, the original goes too
+      removeBinding(dataSEXP, "x");
+      unsaved.clear();
+      REQUIRE(!saveEnvironment(dataSEXP, dataDir.complete("data"), state.path(), &unsaved));
+      CHECK_FALSE(hasManifest(dataDir.complete("data")));
+
+      REQUIRE(!removeUnreferencedObjects(state.path()));
+      objects = state.objects();
+      REQUIRE(objects.size() == 1);
+      CHECK(objects[0] == changed);
+   }
+
+   SECTION("Unreadable manifest lines are skipped")
+   {
+      std::vector<std::string> unsaved;
+      REQUIRE(!saveEnvironment(envSEXP, state.environmentFile(), state.path(), &unsaved));
+
+      FilePath manifestFile = state.path().complete("environment.manifest");
+      std::string contents;
+      REQUIRE(!readStringFromFile(manifestFile, &contents));
+      REQUIRE(!writeStringToFile(manifestFile, contents + "torn\n"));
+
+      Manifest stored = manifest(state.environmentFile(), state.path());
+      CHECK(stored.names.size() == 2);
+   }
+}
+
+} // namespace tests
+} // namespace object_store
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -20,6 +20,8 @@
 //
 
 #include "RSearchPath.hpp"
+#include "RBlockCompression.hpp"
+#include "RObjectStore.hpp"
 
 #include <string>
 #include <vector>
@@ -80,20 +82,64 @@ void reportRestoreError(const std::string& context,
    REprintf(report.c_str());
 }   
    
-Error saveGlobalEnvironmentToFile(const FilePath& environmentFile)
+Error saveEnvironmentFile(SEXP envSEXP,
+                         const std::vector<std::string>& names,
+                         const FilePath& environmentFile)
 {
-   std::string envPath =
-            string_utils::utf8ToSystem(environmentFile.absolutePath());
-   return executeSafely(boost::bind(R_SaveGlobalEnvToFile, envPath.c_str()));
+   return RFunction(".rs.saveEnvironment",
+                    envSEXP,
+                    environmentFile.absolutePath(),
+                    names).call();
+}
+
+Error saveGlobalEnvironmentToFile(const FilePath& statePath)
+{
+   // save large values to the object store
+   FilePath environmentFile = statePath.complete(kEnvironmentFile);
+   std::vector<std::string> unsaved;
+   Error error = object_store::saveEnvironment(R_GlobalEnv,
+                                               environmentFile,
+                                               statePath,
+                                               &unsaved);
+   if (error)
+      return error;
+
+   // save everything else to the environment file (R's own save of the
+   // global environment moves a temporary file into place, so can't write
+   // through a block compressed file)
+   if (object_store::hasManifest(environmentFile) ||
+       block_compression::active())
+   {
+      return block_compression::writeFile(environmentFile,
+                                          boost::bind(saveEnvironmentFile,
+                                                      R_GlobalEnv,
+                                                      unsaved,
+                                                      _1));
+   }
+   else
+   {
+      std::string envPath =
+               string_utils::utf8ToSystem(environmentFile.absolutePath());
+      return executeSafely(boost::bind(R_SaveGlobalEnvToFile, envPath.c_str()));
+   }
 }
    
-Error restoreGlobalEnvironment(const core::FilePath& environmentFile)
+Error restoreGlobalEnvironment(const core::FilePath& statePath,
+                               bool lazyLoadObjects)
 {
    // tolerate no environment saved
+   FilePath environmentFile = statePath.complete(kEnvironmentFile);
    if (!environmentFile.exists())
       return Success();
    
-   return RFunction("load", environmentFile.absolutePath()).call();
+   Error error = RFunction("load", environmentFile.absolutePath()).call();
+   if (error)
+      return error;
+
+   return object_store::restoreEnvironment(R_GlobalEnv,
+                                           environmentFile,
+                                           statePath,
+                                           lazyLoadObjects);
 }
 
 bool isPackage(const std::string& elementName, std::string* pPackageName)
@@ -200,13 +246,31 @@ void loadPackage(const std::string& packageName, const std::string& path)
 }
    
 void attachEnvironmentData(const FilePath& dataFilePath, 
-                           const std::string& name)
+                           const std::string& name,
+                           const FilePath& statePath,
+                           bool lazyLoadObjects)
 {
    if (dataFilePath.exists())
    {
-      Error error = r::exec::RFunction(".rs.attachDataFile",
-                                       dataFilePath.absolutePath(),
-                                       name).call();
+      // (along with any of its values saved to the object store)
+      std::vector<std::string> objectNames, objectFiles;
+      std::vector<double> objectSizes;
+      Error error = object_store::readManifest(dataFilePath,
+                                               statePath,
+                                               &objectNames,
+                                               &objectFiles,
+                                               &objectSizes);
+      if (error)
+         LOG_ERROR(error);
+
+      r::exec::RFunction attach(".rs.attachDataFile",
+                                dataFilePath.absolutePath(),
+                                name);
+      attach.addParam("objectNames", objectNames);
+      attach.addParam("objectFiles", objectFiles);
+      attach.addParam("objectSizes", objectSizes);
+      attach.addParam("lazy", lazyLoadObjects);
+      error = attach.call();
       
       if (error)
       {
@@ -229,8 +293,7 @@ void attachEnvironmentData(const FilePath& dataFilePath,
 Error save(const FilePath& statePath)
 {
    // save the global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = saveGlobalEnvironmentToFile(environmentFile);
+   Error error = saveGlobalEnvironmentToFile(statePath);
    if (error)
       return error;
    
@@ -298,10 +361,20 @@ Error save(const FilePath& statePath)
                                                 searchPathElements.size()-1);
          FilePath dataFilePath = environmentDataPath.complete(itemIndex);
          
-         // save the environment
-         Error error = r::exec::RFunction(".rs.saveEnvironment",
-                                          envSEXP,
-                                          dataFilePath.absolutePath()).call();
+         // save the environment (large values go to the object store)
+         std::vector<std::string> unsaved;
+         Error error = object_store::saveEnvironment(envSEXP,
+                                                     dataFilePath,
+                                                     statePath,
+                                                     &unsaved);
+         if (error)
+            return error;
+
+         error = block_compression::writeFile(dataFilePath,
+                                              boost::bind(saveEnvironmentFile,
+                                                          envSEXP,
+                                                          unsaved,
+                                                          _1));
          if (error)
             return error;
       }
@@ -316,17 +389,25 @@ Error save(const FilePath& statePath)
 
    // save the package paths list
    FilePath packagePathsFile = searchPathDir.complete(kPackagePaths);
-   return writeStringMapToFile(packagePathsFile, packagePaths);
+   error = writeStringMapToFile(packagePathsFile, packagePaths);
+   if (error)
+      return error;
+
+   // drop values saved by earlier suspends which are no longer needed
+   return object_store::removeUnreferencedObjects(statePath);
 }
 
 
 Error saveGlobalEnvironment(const FilePath& statePath)
 {
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   return saveGlobalEnvironmentToFile(environmentFile);
+   Error error = saveGlobalEnvironmentToFile(statePath);
+   if (error)
+      return error;
+
+   return object_store::removeUnreferencedObjects(statePath);
 }
 
-Error restoreSearchPath(const FilePath& statePath)
+Error restoreSearchPath(const FilePath& statePath, bool lazyLoadObjects)
 {
    Error error;
    
@@ -387,7 +468,10 @@ Error restoreSearchPath(const FilePath& statePath)
       {
          std::string itemIndex = safe_convert::numberToString(i);
          FilePath dataFilePath = environmentDataPath.complete(itemIndex);
-         attachEnvironmentData(dataFilePath, pathElement);
+         attachEnvironmentData(dataFilePath,
+                               pathElement,
+                               statePath,
+                               lazyLoadObjects);
       }
       
       else
@@ -399,11 +483,12 @@ Error restoreSearchPath(const FilePath& statePath)
    return Success();
 }
 
-Error restore(const FilePath& statePath, bool isCompatibleSessionState)
+Error restore(const FilePath& statePath,
+              bool isCompatibleSessionState,
+              bool lazyLoadObjects)
 {
    // restore global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = restoreGlobalEnvironment(environmentFile);
+   Error error = restoreGlobalEnvironment(statePath, lazyLoadObjects);
    if (error)
       return error;
    
@@ -412,7 +497,7 @@ Error restore(const FilePath& statePath, bool isCompatibleSessionState)
    // R session)
    if (isCompatibleSessionState)
    {
-      Error error = restoreSearchPath(statePath);
+      Error error = restoreSearchPath(statePath, lazyLoadObjects);
       if (error)
          return error;
    }
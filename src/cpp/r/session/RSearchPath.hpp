@@ -30,7 +30,12 @@ namespace search_path {
 
 core::Error save(const core::FilePath& statePath);
 core::Error saveGlobalEnvironment(const core::FilePath& statePath);
-core::Error restore(const core::FilePath& statePath, bool isCompatibleSessionState = true);
+// restore the global environment and search path. large values saved to
+// the object store are restored as promises (read when first used) when
+// lazyLoadObjects is set, which requires the state path to remain in place
+core::Error restore(const core::FilePath& statePath,
+                    bool isCompatibleSessionState = true,
+                    bool lazyLoadObjects = false);
    
 } // namespace search_path
 } // namespace session
@@ -20,6 +20,7 @@
 
 #include <boost/function.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
@@ -37,6 +38,7 @@
 #include <r/session/RConsoleHistory.hpp>
 #include <r/session/RGraphics.hpp>
 
+#include "RBlockCompression.hpp"
 #include "RClientMetrics.hpp"
 #include "RSearchPath.hpp"
 #include "graphics/RGraphicsPlotManager.hpp"
@@ -72,6 +74,9 @@ const char * const kDevModeOn = "dev_mode_on";
 const char * const kPackratModeOn = "packrat_mode_on";
 const char * const kRProfileOnRestore = "r_profile_on_restore";
 
+// zlib compression level for saved environments (fastest)
+const int kSaveCompressionLevel = 1;
+
 // is the suspended session state compatible with the active R version?
 std::string s_activeRVersion;
 std::string s_suspendedRVersion;
@@ -428,13 +433,25 @@ bool save(const FilePath& statePath,
    // save working context
    saveWorkingContext(statePath, &settings, &saved);
 
-   // save search path (disable save compression if requested)
+   // save search path (disable save compression if requested, otherwise
+   // compress on several cores at a fast level since a suspend is usually
+   // waited on)
+   boost::scoped_ptr<block_compression::CompressionScope> pCompressionScope;
    if (disableSaveCompression)
    {
       error = r::exec::RFunction(".rs.disableSaveCompression").call();
       if (error)
          LOG_ERROR(error);
    }
+   else
+   {
+      pCompressionScope.reset(
+               new block_compression::CompressionScope(
+                  kSaveCompressionLevel,
+                  r::options::getOption<int>("rstudio.saveCompressionThreads",
+                                             0,
+                                             false)));
+   }
 
    if (!excludePackages)
    {
@@ -531,10 +548,14 @@ bool packratModeEnabled(const core::FilePath& statePath)
    return getBoolSetting(statePath, kPackratModeOn, false);
 }
 
-Error deferredRestore(const FilePath& statePath, bool serverMode)
+Error deferredRestore(const FilePath& statePath,
+                      bool serverMode,
+                      bool lazyLoadObjects)
 {
    // search path
-   Error error = search_path::restore(statePath, s_isCompatibleSessionState);
+   Error error = search_path::restore(statePath,
+                                      s_isCompatibleSessionState,
+                                      lazyLoadObjects);
    if (error)
       return error;
    
@@ -597,7 +618,8 @@ bool validateRestoredRVersion(const FilePath& filePath)
 bool restore(const FilePath& statePath,
              bool serverMode,
              boost::function<Error()>* pDeferredRestoreAction,
-             std::string* pErrorMessages)
+             std::string* pErrorMessages,
+             bool lazyLoadObjects)
 {
    Error error;
    
@@ -674,7 +696,10 @@ bool restore(const FilePath& statePath,
    // process that are potentially highly latent. this allows clients
    // to bring their UI up and then receive an event indicating that the
    // latent deserialization actions are taking place
-   *pDeferredRestoreAction = boost::bind(deferredRestore, statePath, serverMode);
+   *pDeferredRestoreAction = boost::bind(deferredRestore,
+                                         statePath,
+                                         serverMode,
+                                         lazyLoadObjects);
    
    // return true if there were no error messages
    return pErrorMessages->empty();
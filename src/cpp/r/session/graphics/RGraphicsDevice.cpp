@@ -34,6 +34,7 @@
 #include "RGraphicsUtils.hpp"
 #include "RGraphicsPlotManager.hpp"
 #include "RGraphicsHandler.hpp"
+#include "../RBlockCompression.hpp"
 
 #include "config.h"
 
@@ -634,6 +635,12 @@ void deviceToNDC(double* x, double* y)
    *y = grconvertY(*y, "device", "ndc");
 }
 
+Error saveGraphicsFile(const core::FilePath& snapshotFile)
+{
+   return r::exec::RFunction(".rs.saveGraphics",
+                             string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
+}
+
 Error saveSnapshot(const core::FilePath& snapshotFile,
                    const core::FilePath& imageFile)
 {
@@ -642,9 +649,11 @@ Error saveSnapshot(const core::FilePath& snapshotFile,
    if (error)
       return error ;
    
-   // save snaphot file
-   error = r::exec::RFunction(".rs.saveGraphics",
-                              string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
+   // save snaphot file (compressed off the R thread, at the level R would
+   // have used)
+   error = block_compression::compressFile(snapshotFile,
+                                           block_compression::kDefaultSaveLevel,
+                                           saveGraphicsFile);
    if (error)
       return error;
 
@@ -17,6 +17,7 @@
 
 #include <iostream>
 
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 
 #include <core/Error.hpp>
@@ -28,12 +29,25 @@
 #include <r/RExec.hpp>
 #include <r/session/RGraphics.hpp>
 
+#include "../RBlockCompression.hpp"
+
 using namespace rstudio::core ;
 
 namespace rstudio {
 namespace r {
 namespace session {
 namespace graphics {
+
+namespace {
+
+Error saveGraphicsSnapshotFile(SEXP snapshot, const FilePath& snapshotFile)
+{
+   return r::exec::RFunction(".rs.saveGraphicsSnapshot",
+                             snapshot,
+                             string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
+}
+
+} // anonymous namespace
       
 Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
            const FilePath& baseDirPath,
@@ -168,9 +182,10 @@ Error Plot::renderFromDisplaySnapshot(SEXP snapshot)
  
    // generate snapshot file
    FilePath snapshotFile = snapshotFilePath(storageUuid);
-   Error error = r::exec::RFunction(".rs.saveGraphicsSnapshot",
-                                    snapshot,
-                                    string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
+   Error error = block_compression::compressFile(
+                     snapshotFile,
+                     block_compression::kDefaultSaveLevel,
+                     boost::bind(saveGraphicsSnapshotFile, snapshot, _1));
    if (error)
       return error ;
 
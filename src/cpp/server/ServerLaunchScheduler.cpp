@@ -0,0 +1,135 @@
+/*
+ * ServerLaunchScheduler.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ServerLaunchScheduler.hpp"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/PeriodicCommand.hpp>
+
+#include <monitor/MonitorClient.hpp>
+
+#include <server_core/sessions/SessionLaunchQueue.hpp>
+
+#include <server/ServerOptions.hpp>
+#include <server/ServerScheduler.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace server {
+namespace launch_scheduler {
+
+namespace {
+
+// run admitted launches on an io thread rather than whichever thread freed
+// the slot
+server_core::sessions::LaunchQueue s_launchQueue(
+      boost::bind(scheduler::postCommand, _1));
+
+boost::posix_time::ptime s_lastMetrics;
+
+void sendMetrics()
+{
+   using namespace monitor::metrics;
+   const std::string kScope = "rsession-launch";
+   int interval = server::options().monitorIntervalSeconds();
+
+   server_core::sessions::LaunchQueue::Stats stats = s_launchQueue.takeStats();
+
+   std::vector<Metric> metrics;
+   metrics.push_back(Metric(kScope, interval,
+                            MetricData("queue-depth",
+                                       static_cast<double>(stats.queueDepth)),
+                            "gauge"));
+   metrics.push_back(Metric(kScope, interval,
+                            MetricData("active",
+                                       static_cast<double>(stats.active)),
+                            "gauge"));
+   metrics.push_back(Metric(kScope, interval,
+                            MetricData("queued", stats.queuedTotal),
+                            "counter"));
+   if (stats.maxQueueWaitMs >= 0)
+   {
+      metrics.push_back(Metric(kScope, interval,
+                               MetricData("queue-latency", stats.maxQueueWaitMs),
+                               "gauge", "ms"));
+   }
+   monitor::client().sendMetrics(metrics);
+}
+
+bool onPeriodic()
+{
+   // the request waiting on a launch gives up after the proxy's max wait,
+   // so nothing will tell us when those sessions are up
+   s_launchQueue.releaseExpiredSlots();
+
+   // report once per monitor interval rather than on every launch
+   boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+   int interval = std::max(1, server::options().monitorIntervalSeconds());
+   if (s_lastMetrics.is_not_a_date_time() ||
+       now - s_lastMetrics >= boost::posix_time::seconds(interval))
+   {
+      s_lastMetrics = now;
+      sendMetrics();
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+Error initialize()
+{
+   int maxActive = server::options().rsessionLaunchConcurrency();
+   if (maxActive <= 0)
+      maxActive = std::max(2, 2 * static_cast<int>(boost::thread::hardware_concurrency()));
+
+   s_launchQueue.setLimits(
+            static_cast<std::size_t>(maxActive),
+            boost::posix_time::seconds(
+               std::max(1, server::options().rsessionProxyMaxWaitSeconds())));
+
+   scheduler::addCommand(
+      boost::shared_ptr<ScheduledCommand>(new PeriodicCommand(
+         boost::posix_time::seconds(1), onPeriodic, false))
+   );
+
+   return Success();
+}
+
+Error submit(const r_util::SessionContext& context,
+             const LaunchFunction& launch)
+{
+   return s_launchQueue.submit(context, launch);
+}
+
+bool isQueued(const r_util::SessionContext& context)
+{
+   return s_launchQueue.isQueued(context);
+}
+
+void complete(const r_util::SessionContext& context)
+{
+   s_launchQueue.complete(context);
+}
+
+} // namespace launch_scheduler
+} // namespace server
+} // namespace rstudio
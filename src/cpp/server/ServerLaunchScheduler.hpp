@@ -0,0 +1,60 @@
+/*
+ * ServerLaunchScheduler.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_LAUNCH_SCHEDULER_HPP
+#define SERVER_LAUNCH_SCHEDULER_HPP
+
+#include <boost/function.hpp>
+
+#include <core/r_util/RSessionContext.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace server {
+namespace launch_scheduler {
+
+// Admission control for session launches (see server_core::sessions::
+// LaunchQueue). A launch holds its slot until its session responds (see
+// complete) or until the proxy would have given up waiting for it.
+
+typedef boost::function<core::Error()> LaunchFunction;
+
+// read the launch limit and start releasing slots of launches which don't
+// complete (call after the http server is initialized)
+core::Error initialize();
+
+// run the launch now if a slot is free (returning its result), otherwise
+// queue it. queued launches are run on one of the server's io threads. a
+// launch which fails frees its own slot
+core::Error submit(const core::r_util::SessionContext& context,
+                   const LaunchFunction& launch);
+
+// is a launch for the context waiting for a slot?
+bool isQueued(const core::r_util::SessionContext& context);
+
+// the launch for the context has finished (its session responded),
+// freeing its slot for the next launch
+void complete(const core::r_util::SessionContext& context);
+
+} // namespace launch_scheduler
+} // namespace server
+} // namespace rstudio
+
+#endif // SERVER_LAUNCH_SCHEDULER_HPP
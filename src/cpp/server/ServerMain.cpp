@@ -55,6 +55,7 @@
 #include "ServerBrowser.hpp"
 #include "ServerEval.hpp"
 #include "ServerInit.hpp"
+#include "ServerLaunchScheduler.hpp"
 #include "ServerMeta.hpp"
 #include "ServerOffline.hpp"
 #include "ServerPAMAuth.hpp"
@@ -423,6 +424,11 @@ void addCommand(boost::shared_ptr<ScheduledCommand> pCmd)
    s_pHttpServer->addScheduledCommand(pCmd);
 }
 
+void postCommand(const boost::function<void()>& command)
+{
+   s_pHttpServer->ioService().post(command);
+}
+
 } // namespace scheduler
 } // namespace server
 } // namespace rstudio
@@ -520,6 +526,12 @@ int main(int argc, char * const argv[])
                    monitor::client().createLogWriter(kProgramIdentity));
       }
 
+      // initialize session launch admission control (needs to happen post
+      // http server and monitor init)
+      error = launch_scheduler::initialize();
+      if (error)
+         return core::system::exitFailure(error, ERROR_LOCATION);
+
       // call overlay initialize
       error = overlay::initialize();
       if (error)
@@ -584,6 +596,11 @@ int main(int argc, char * const argv[])
       if (error)
          return core::system::exitFailure(error, ERROR_LOCATION);
 
+      // pre-start sessions for users' next sessions (if configured)
+      error = sessionManager().startSessionPool();
+      if (error)
+         return core::system::exitFailure(error, ERROR_LOCATION);
+
       // add http server not found handler
       s_pHttpServer->setNotFoundHandler(pageNotFoundHandler);
 
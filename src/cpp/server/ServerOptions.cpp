@@ -263,6 +263,12 @@ ProgramStatus Options::read(int argc,
       ("rsession-proxy-max-wait-secs",
         value<int>(&rsessionProxyMaxWaitSeconds_)->default_value(10),
          "max time to wait when proxying requests to rsession")
+      ("rsession-pool-size",
+        value<int>(&rsessionPoolSize_)->default_value(0),
+         "number of pre-started sessions to keep ready for recent users")
+      ("rsession-launch-concurrency",
+        value<int>(&rsessionLaunchConcurrency_)->default_value(0),
+         "max number of sessions starting at once (0 for twice the number of cores)")
       ("rsession-memory-limit-mb",
          value<int>(&dep.memoryLimitMb)->default_value(dep.memoryLimitMb),
          "rsession memory limit (mb) - DEPRECATED")
@@ -51,6 +51,13 @@ bool pollProcessSupervisor()
    return true;
 }
 
+void onProcessActivity()
+{
+   // children have output or have exited; poll right away rather than
+   // waiting for the next scheduled poll
+   scheduler::postCommand(pollProcessSupervisor);
+}
+
 } // anonymous namespace
 
 Error runProgram(
@@ -97,7 +104,15 @@ core::Error runProgram(
 
 Error initialize()
 {
-   // periodically poll process supervisor
+   // poll as soon as children have events
+   LOCK_MUTEX(s_mutex)
+   {
+      processSupervisor().setActivityHandler(onProcessActivity);
+   }
+   END_LOCK_MUTEX
+
+   // periodically poll process supervisor (for children which need periodic
+   // attention, or if events can't be watched for on this platform)
    scheduler::addCommand(
       boost::shared_ptr<ScheduledCommand>(new PeriodicCommand(
          boost::posix_time::milliseconds(500), pollProcessSupervisor, false))
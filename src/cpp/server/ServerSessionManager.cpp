@@ -31,7 +31,9 @@
 
 #include <server/auth/ServerValidateUser.hpp>
 
+#include "ServerLaunchScheduler.hpp"
 #include "ServerREnvironment.hpp"
+#include "ServerSessionPool.hpp"
 #include "server-config.h"
 
 
@@ -181,6 +183,11 @@ Error SessionManager::launchSession(boost::asio::io_service& ioService,
    using namespace boost::posix_time;
    LOCK_MUTEX(launchesMutex_)
    {
+      // a launch waiting for a slot is still wanted (even if the request
+      // which asked for it gave up waiting)
+      if (launch_scheduler::isQueued(context))
+         return Success();
+
       // check whether we already have a launch pending
       LaunchMap::const_iterator pos = pendingLaunches_.find(context);
       if (pos != pendingLaunches_.end())
@@ -220,15 +227,45 @@ Error SessionManager::launchSession(boost::asio::io_service& ioService,
       f(&profile);
    }
 
-   // launch the session
-   Error error = sessionLaunchFunction_(ioService, profile, request, onLaunch, onError);
-   if (error)
+   // launch the session (or queue the launch if too many sessions are
+   // already starting). the launch can outlive the request, so it gets its
+   // own copy
+   boost::shared_ptr<http::Request> pRequest(new http::Request());
+   pRequest->assign(request);
+   return launch_scheduler::submit(
+            context,
+            boost::bind(&SessionManager::runLaunch, this, boost::ref(ioService),
+                        profile, pRequest, onLaunch, onError));
+}
+
+Error SessionManager::runLaunch(boost::asio::io_service& ioService,
+                                const r_util::SessionLaunchProfile& profile,
+                                boost::shared_ptr<http::Request> pRequest,
+                                const http::ResponseHandler& onLaunch,
+                                const http::ErrorHandler& onError)
+{
+   // the launch only starts now that it has a slot, so its age is measured
+   // from here (otherwise a launch which waited in the queue for a while
+   // would look stuck as soon as it started, and be launched again)
+   LOCK_MUTEX(launchesMutex_)
    {
-      removePendingLaunch(context);
-      return error;
+      pendingLaunches_[profile.context] =
+            boost::posix_time::microsec_clock::universal_time();
    }
+   END_LOCK_MUTEX
 
-   return Success();
+   Error error = sessionLaunchFunction_(ioService, profile, *pRequest, onLaunch, onError);
+   if (error)
+   {
+      // the scheduler frees the failed launch's slot itself (only once, and
+      // only if the slot is still this launch's)
+      LOCK_MUTEX(launchesMutex_)
+      {
+         pendingLaunches_.erase(profile.context);
+      }
+      END_LOCK_MUTEX
+   }
+   return error;
 }
 
 namespace {
@@ -265,8 +302,21 @@ Error SessionManager::launchAndTrackSession(
    }
    END_LOCK_MUTEX
 
-   // launch the session
+   // hand the launch to a pre-started session if we can (not possible with
+   // a config filter, which has to run after the session switches user)
    PidType pid = 0;
+   if (!configFilter &&
+       session_pool::claimSession(runAsUser,
+                                  profile,
+                                  boost::bind(onProcessExit,
+                                              profile.context.username,
+                                              _1),
+                                  &pid))
+   {
+      return Success();
+   }
+
+   // launch the session
    Error error = launchChildProcess(profile.executablePath,
                                     runAsUser,
                                     profile.config,
@@ -284,6 +334,15 @@ Error SessionManager::launchAndTrackSession(
    return Success();
 }
 
+Error SessionManager::startSessionPool()
+{
+   return session_pool::initialize(
+            boost::bind(&core::system::ChildProcessTracker::addProcess,
+                        &processTracker_,
+                        _1,
+                        _2));
+}
+
 void SessionManager::setSessionLaunchFunction(
                            const SessionLaunchFunction& launchFunction)
 {
@@ -298,11 +357,26 @@ void SessionManager::addSessionLaunchProfileFilter(
 
 void SessionManager::removePendingLaunch(const r_util::SessionContext& context)
 {
+   using namespace boost::posix_time;
+   bool launched = false;
+   time_duration launchTime;
    LOCK_MUTEX(launchesMutex_)
    {
-      pendingLaunches_.erase(context);
+      LaunchMap::iterator pos = pendingLaunches_.find(context);
+      if (pos != pendingLaunches_.end())
+      {
+         launched = true;
+         launchTime = microsec_clock::universal_time() - pos->second;
+         pendingLaunches_.erase(pos);
+      }
    }
    END_LOCK_MUTEX
+
+   if (launched)
+      session_pool::launchCompleted(context, launchTime);
+
+   // let the next launch start
+   launch_scheduler::complete(context);
 }
 
 void SessionManager::notifySIGCHLD()
@@ -0,0 +1,378 @@
+/*
+ * ServerSessionPool.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ServerSessionPool.hpp"
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+#include <core/json/Json.hpp>
+#include <core/system/Environment.hpp>
+#include <core/system/PosixSystem.hpp>
+
+#include <monitor/MonitorClient.hpp>
+#include <session/SessionConstants.hpp>
+
+#include <server/ServerOptions.hpp>
+
+#include "ServerREnvironment.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace server {
+namespace session_pool {
+
+namespace {
+
+// templates are only handed launches which they could have been started
+// with: the same user, R and process limits
+struct TemplateSession
+{
+   TemplateSession() : pid(-1), fdHandoff(-1) {}
+   PidType pid;
+   int fdHandoff;
+   std::string user;
+   std::string rHome;
+   std::string limits;
+};
+
+boost::mutex s_mutex;
+std::deque<TemplateSession> s_templates;
+boost::function<void(PidType, const ExitHandler&)> s_trackProcess;
+
+// exit handlers for claimed templates (which are now sessions)
+std::map<PidType, ExitHandler> s_claimedExitHandlers;
+
+// metrics
+double s_hits = 0;
+double s_misses = 0;
+
+// launches handed to templates which haven't responded yet
+std::set<r_util::SessionContext> s_claimedLaunches;
+
+std::string limitsSignature(const core::system::ProcessLimits& limits)
+{
+   r_util::SessionLaunchProfile profile;
+   profile.config.limits = limits;
+   return json::write(r_util::sessionLaunchProfileToJson(profile));
+}
+
+void closeHandoff(const TemplateSession& templateSession)
+{
+   if (::close(templateSession.fdHandoff) == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+}
+
+void onTemplateExit(PidType pid, int status)
+{
+   ExitHandler exitHandler;
+   LOCK_MUTEX(s_mutex)
+   {
+      // drop templates which exit before they're claimed
+      for (std::deque<TemplateSession>::iterator it = s_templates.begin();
+           it != s_templates.end();
+           ++it)
+      {
+         if (it->pid == pid)
+         {
+            closeHandoff(*it);
+            s_templates.erase(it);
+            break;
+         }
+      }
+
+      std::map<PidType, ExitHandler>::iterator it =
+                                             s_claimedExitHandlers.find(pid);
+      if (it != s_claimedExitHandlers.end())
+      {
+         exitHandler = it->second;
+         s_claimedExitHandlers.erase(it);
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (exitHandler)
+      exitHandler(pid, status);
+}
+
+Error startTemplate(const std::string& runAsUser,
+                    const r_util::SessionLaunchProfile& profile,
+                    TemplateSession* pTemplate)
+{
+   // templates get the R environment the server gives sessions (so that
+   // they link against the right R), the limits of the session they were
+   // started after, and are told they are templates
+   core::system::ProcessConfig config;
+   core::r_util::RVersion rVersion = r_environment::rVersion();
+   config.environment = rVersion.environment();
+   core::system::setenv(&config.environment, kRStudioSessionTemplate, "1");
+   config.stdStreamBehavior = core::system::StdStreamInherit;
+   config.limits = profile.config.limits;
+   std::string rsessionPath = server::options().rsessionPath();
+
+   // the handoff channel becomes the template's standard input
+   int fds[2];
+   if (::pipe(fds) == -1)
+      return systemError(errno, ERROR_LOCATION);
+   ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+   PidType pid = ::fork();
+
+   // error
+   if (pid < 0)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      ::close(fds[0]);
+      ::close(fds[1]);
+      return error;
+   }
+
+   // child
+   else if (pid == 0)
+   {
+      // like other sessions, don't tie our lifetime to the server's
+      if (::setpgid(0,0) == -1)
+      {
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         ::exit(EXIT_FAILURE);
+      }
+
+      if (::dup2(fds[0], STDIN_FILENO) == -1)
+      {
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         ::exit(EXIT_FAILURE);
+      }
+
+      // switches to the user (permanently dropping privilege) before exec,
+      // just as a session launch does
+      Error error = core::system::runProcess(rsessionPath,
+                                             runAsUser,
+                                             config,
+                                             core::system::ProcessConfigFilter());
+      LOG_ERROR(error);
+      ::exit(EXIT_FAILURE);
+   }
+
+   // parent
+   ::close(fds[0]);
+   pTemplate->pid = pid;
+   pTemplate->fdHandoff = fds[1];
+   pTemplate->user = runAsUser;
+   pTemplate->rHome = core::system::getenv(config.environment, "R_HOME");
+   pTemplate->limits = limitsSignature(config.limits);
+
+   if (s_trackProcess)
+      s_trackProcess(pid, onTemplateExit);
+
+   return Success();
+}
+
+// start a template for the user's next session unless they have one
+// already, making room by retiring the oldest template if the pool is full
+// (called with s_mutex held)
+void prepareTemplate(const std::string& runAsUser,
+                     const r_util::SessionLaunchProfile& profile)
+{
+   int poolSize = server::options().rsessionPoolSize();
+   if (poolSize <= 0)
+      return;
+
+   BOOST_FOREACH(const TemplateSession& templateSession, s_templates)
+   {
+      if (templateSession.user == runAsUser)
+         return;
+   }
+
+   if (static_cast<int>(s_templates.size()) >= poolSize)
+   {
+      // a template exits when its handoff channel closes unclaimed
+      closeHandoff(s_templates.front());
+      s_templates.pop_front();
+   }
+
+   TemplateSession templateSession;
+   Error error = startTemplate(runAsUser, profile, &templateSession);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   s_templates.push_back(templateSession);
+}
+
+Error writeHandoff(const TemplateSession& templateSession,
+                   const std::string& message)
+{
+   std::size_t written = 0;
+   while (written < message.size())
+   {
+      ssize_t result = ::write(templateSession.fdHandoff,
+                               message.data() + written,
+                               message.size() - written);
+      if (result == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         return systemError(errno, ERROR_LOCATION);
+      }
+      written += result;
+   }
+   return Success();
+}
+
+void sendMetrics(const std::string& latencyName, double latencyMs)
+{
+   using namespace monitor::metrics;
+   const std::string kScope = "rsession-pool";
+   int interval = server::options().monitorIntervalSeconds();
+
+   std::vector<Metric> metrics;
+   metrics.push_back(Metric(kScope, interval, MetricData("hits", s_hits),
+                            "counter"));
+   metrics.push_back(Metric(kScope, interval, MetricData("misses", s_misses),
+                            "counter"));
+   if (!latencyName.empty())
+   {
+      metrics.push_back(Metric(kScope, interval,
+                               MetricData(latencyName, latencyMs),
+                               "gauge", "ms"));
+   }
+   monitor::client().sendMetrics(metrics);
+}
+
+} // anonymous namespace
+
+Error initialize(
+         const boost::function<void(PidType, const ExitHandler&)>& trackProcess)
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      s_trackProcess = trackProcess;
+   }
+   END_LOCK_MUTEX
+
+   return Success();
+}
+
+bool claimSession(const std::string& runAsUser,
+                  const r_util::SessionLaunchProfile& profile,
+                  const ExitHandler& exitHandler,
+                  PidType* pPid)
+{
+   if (server::options().rsessionPoolSize() <= 0)
+      return false;
+
+   // templates are only started with the default session and R
+   std::string rHome = core::system::getenv(profile.config.environment,
+                                            "R_HOME");
+   std::string limits = limitsSignature(profile.config.limits);
+   bool suitable = profile.executablePath == server::options().rsessionPath();
+
+   json::Object handoffJson;
+   handoffJson["runAsUser"] = runAsUser;
+   handoffJson["profile"] = r_util::sessionLaunchProfileToJson(profile);
+   std::string message = json::write(handoffJson) + "\n";
+
+   bool claimed = false;
+   LOCK_MUTEX(s_mutex)
+   {
+      for (std::deque<TemplateSession>::iterator it = s_templates.begin();
+           suitable && it != s_templates.end();
+           ++it)
+      {
+         if (it->user != runAsUser)
+            continue;
+
+         TemplateSession templateSession = *it;
+         s_templates.erase(it);
+
+         // a template for other R or limits can't be used; make way for
+         // one which can
+         if (templateSession.rHome != rHome || templateSession.limits != limits)
+         {
+            closeHandoff(templateSession);
+            break;
+         }
+
+         // a template which has exited can't be written to (EPIPE)
+         Error error = writeHandoff(templateSession, message);
+         closeHandoff(templateSession);
+         if (error)
+         {
+            LOG_ERROR(error);
+            break;
+         }
+
+         s_claimedExitHandlers[templateSession.pid] = exitHandler;
+         *pPid = templateSession.pid;
+         claimed = true;
+         break;
+      }
+
+      if (claimed)
+      {
+         ++s_hits;
+         s_claimedLaunches.insert(profile.context);
+      }
+      else
+      {
+         ++s_misses;
+         s_claimedLaunches.erase(profile.context);
+      }
+
+      // the user is likely to start another session (or restart this one)
+      if (suitable)
+         prepareTemplate(runAsUser, profile);
+   }
+   END_LOCK_MUTEX
+
+   sendMetrics(std::string(), 0);
+
+   return claimed;
+}
+
+void launchCompleted(const r_util::SessionContext& context,
+                     const boost::posix_time::time_duration& elapsed)
+{
+   if (server::options().rsessionPoolSize() <= 0)
+      return;
+
+   // (the claim itself only writes to a pipe; what templates save, if
+   // anything, shows in how long their sessions take to respond)
+   bool claimed = false;
+   LOCK_MUTEX(s_mutex)
+   {
+      claimed = s_claimedLaunches.erase(context) > 0;
+   }
+   END_LOCK_MUTEX
+
+   sendMetrics(claimed ? "hit-launch-latency" : "miss-launch-latency",
+               elapsed.total_microseconds() / 1000.0);
+}
+
+} // namespace session_pool
+} // namespace server
+} // namespace rstudio
@@ -0,0 +1,79 @@
+/*
+ * ServerSessionPool.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_SESSION_POOL_HPP
+#define SERVER_SESSION_POOL_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+
+#include <core/system/PosixChildProcessTracker.hpp>
+#include <core/system/Types.hpp>
+
+#include <core/r_util/RSessionLaunchProfile.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace server {
+namespace session_pool {
+
+// A pool of pre-started rsession processes ("templates"). After a session
+// is launched for a user a template is started for that user's next
+// session; like a session it switches to the user (permanently dropping
+// privilege) before exec, and then waits (before doing anything which
+// depends on the launch) for the server to hand it a launch profile. When
+// a template is claimed it takes on the profile's environment and
+// arguments, and carries on as though it had been launched directly.
+//
+// Templates save process startup and loading rsession's and R's libraries,
+// but not R initialization: R's startup, the user's profile scripts and
+// module initialization all depend on the launch (its environment and
+// project), so they still run once the template is claimed. Nor do they
+// help a user's first session; a template which could serve any user
+// would have to keep root privilege until it was claimed.
+
+typedef core::system::ChildProcessTracker::ExitHandler ExitHandler;
+
+// trackProcess is called with the pid of each template started (and the
+// handler for its exit) so that it can be reaped
+core::Error initialize(
+         const boost::function<void(PidType, const ExitHandler&)>& trackProcess);
+
+// hand the launch profile to one of the user's templates, returning the pid
+// of the session which will serve it (exitHandler is called when it exits).
+// returns false if no suitable template is available. either way, a
+// template is started for the user's next session if the pool has room
+bool claimSession(const std::string& runAsUser,
+                  const core::r_util::SessionLaunchProfile& profile,
+                  const ExitHandler& exitHandler,
+                  PidType* pPid);
+
+// record that a launch's session has responded (elapsed is the time since
+// the launch started), reporting how long pooled and direct launches take
+void launchCompleted(const core::r_util::SessionContext& context,
+                     const boost::posix_time::time_duration& elapsed);
+
+} // namespace session_pool
+} // namespace server
+} // namespace rstudio
+
+#endif // SERVER_SESSION_POOL_HPP
@@ -210,6 +210,16 @@ public:
       return rsessionProxyMaxWaitSeconds_;
    }
 
+   int rsessionPoolSize() const
+   {
+      return rsessionPoolSize_;
+   }
+
+   int rsessionLaunchConcurrency() const
+   {
+      return rsessionLaunchConcurrency_;
+   }
+
    std::string monitorSharedSecret() const
    {
       return std::string(monitorSharedSecret_.c_str());
@@ -297,6 +307,8 @@ private:
    std::string rsessionConfigFile_;
    std::string rsessionLdLibraryPath_;
    int rsessionProxyMaxWaitSeconds_;
+   int rsessionPoolSize_;
+   int rsessionLaunchConcurrency_;
    std::string monitorSharedSecret_;
    int monitorIntervalSeconds_;
    std::string secureCookieKeyFile_;
@@ -18,6 +18,8 @@
 
 #include <string>
 
+#include <boost/function.hpp>
+
 #include <core/ScheduledCommand.hpp>
 
 namespace rstudio {
@@ -30,6 +32,10 @@ namespace scheduler {
 // scheduled commands so it should ONLY be called during server init
 void addCommand(boost::shared_ptr<core::ScheduledCommand> pCmd);
 
+// run a command on one of the server's io threads as soon as possible (safe
+// to call from any thread)
+void postCommand(const boost::function<void()>& command);
+
 } // namespace scheduler
 } // namespace server
 } // namespace rstudio
@@ -49,8 +49,8 @@ SessionManager& sessionManager();
 
 // Session manager for launching managed sessions. This includes
 // automatically waiting for other pending launches (rather than
-// attempting to launch the same session twice) as well as reaping
-// of session child processes
+// attempting to launch the same session twice), limiting how many
+// sessions start at once, as well as reaping of session child processes
 class SessionManager
 {
 private:
@@ -89,7 +89,17 @@ public:
    // notification that a SIGCHLD was received
    void notifySIGCHLD();
 
+   // set up the pool of pre-started sessions used by the default launcher
+   core::Error startSessionPool();
+
 private:
+   // run a launch once the launch scheduler has admitted it
+   core::Error runLaunch(boost::asio::io_service& ioService,
+                         const core::r_util::SessionLaunchProfile& profile,
+                         boost::shared_ptr<core::http::Request> pRequest,
+                         const core::http::ResponseHandler& onLaunch,
+                         const core::http::ErrorHandler& onError);
+
    // default session launcher -- runs the process then uses the
    // ChildProcessTracker to track it's pid for later reaping
    core::Error launchAndTrackSession(
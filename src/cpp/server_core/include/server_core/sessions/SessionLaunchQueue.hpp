@@ -0,0 +1,142 @@
+/*
+ * SessionLaunchQueue.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_CORE_SESSION_LAUNCH_QUEUE_HPP
+#define SERVER_CORE_SESSION_LAUNCH_QUEUE_HPP
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/Thread.hpp>
+#include <core/r_util/RSessionContext.hpp>
+
+namespace rstudio {
+namespace server_core {
+namespace sessions {
+
+// Admission control for session launches. Only a limited number of
+// sessions are allowed to be starting at once; a launch holds its slot
+// until its session responds (see complete) or until the slot timeout
+// passes. Launches beyond the limit are queued, and the queue is served
+// round-robin by user so that one user reconnecting many sessions doesn't
+// hold up everyone else.
+class LaunchQueue : boost::noncopyable
+{
+public:
+   typedef boost::function<core::Error()> LaunchFunction;
+
+   // runs a queued launch once it's admitted (e.g. by posting it to another
+   // thread, rather than running it on whichever thread freed the slot)
+   typedef boost::function<void(const boost::function<void()>&)> LaunchRunner;
+
+   typedef boost::function<boost::posix_time::ptime()> Clock;
+
+   struct Stats
+   {
+      Stats() : queueDepth(0), active(0), queuedTotal(0), maxQueueWaitMs(-1) {}
+      std::size_t queueDepth;
+      std::size_t active;
+      double queuedTotal;
+
+      // longest wait of the launches admitted from the queue since the
+      // stats were last taken (-1 if there were none)
+      double maxQueueWaitMs;
+   };
+
+   explicit LaunchQueue(const LaunchRunner& runLaunch,
+                        const Clock& clock = Clock());
+
+   // launches allowed to be starting at once (0 for no limit), and how long
+   // a launch can hold its slot without completing
+   void setLimits(std::size_t maxActive,
+                  const boost::posix_time::time_duration& slotTimeout);
+
+   // run the launch now if a slot is free (returning its result), otherwise
+   // queue it. a launch which fails frees its slot
+   core::Error submit(const core::r_util::SessionContext& context,
+                      const LaunchFunction& launch);
+
+   // is a launch for the context waiting for a slot?
+   bool isQueued(const core::r_util::SessionContext& context);
+
+   // the launch for the context has finished (its session responded),
+   // freeing its slot for the next launch
+   void complete(const core::r_util::SessionContext& context);
+
+   // free the slots of launches which have held them for longer than the
+   // slot timeout (nothing will tell us when their sessions are up)
+   void releaseExpiredSlots();
+
+   Stats takeStats();
+
+private:
+   struct QueuedLaunch
+   {
+      core::r_util::SessionContext context;
+      LaunchFunction launch;
+      boost::posix_time::ptime queued;
+   };
+
+   struct Slot
+   {
+      Slot() : id(0) {}
+      boost::uint64_t id;
+      boost::posix_time::ptime admitted;
+   };
+
+   typedef std::map<core::r_util::SessionContext, Slot> ActiveMap;
+
+   boost::posix_time::ptime now() const;
+   boost::uint64_t admitLocked(const core::r_util::SessionContext& context);
+   bool isQueuedLocked(const core::r_util::SessionContext& context) const;
+   void dispatchLocked(std::vector<boost::function<void()> >* pReady);
+   void runAdmitted(const QueuedLaunch& launch, boost::uint64_t slotId);
+   void releaseSlot(const core::r_util::SessionContext& context,
+                    boost::uint64_t slotId);
+   void runReady(const std::vector<boost::function<void()> >& ready);
+
+private:
+   LaunchRunner runLaunch_;
+   Clock clock_;
+
+   boost::mutex mutex_;
+   std::size_t maxActive_;
+   boost::posix_time::time_duration slotTimeout_;
+   boost::uint64_t nextSlotId_;
+
+   // launches holding a slot
+   ActiveMap active_;
+
+   // queued launches for each user, and the users with queued launches in
+   // the order they'll next be served
+   std::map<std::string, std::deque<QueuedLaunch> > queues_;
+   std::deque<std::string> users_;
+
+   Stats stats_;
+};
+
+} // namespace sessions
+} // namespace server_core
+} // namespace rstudio
+
+#endif // SERVER_CORE_SESSION_LAUNCH_QUEUE_HPP
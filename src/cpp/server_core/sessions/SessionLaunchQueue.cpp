@@ -0,0 +1,251 @@
+/*
+ * SessionLaunchQueue.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <server_core/sessions/SessionLaunchQueue.hpp>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace server_core {
+namespace sessions {
+
+LaunchQueue::LaunchQueue(const LaunchRunner& runLaunch, const Clock& clock)
+   : runLaunch_(runLaunch),
+     clock_(clock),
+     maxActive_(0),
+     slotTimeout_(boost::posix_time::seconds(10)),
+     nextSlotId_(1)
+{
+}
+
+void LaunchQueue::setLimits(std::size_t maxActive,
+                            const boost::posix_time::time_duration& slotTimeout)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      maxActive_ = maxActive;
+      slotTimeout_ = slotTimeout;
+   }
+   END_LOCK_MUTEX
+}
+
+Error LaunchQueue::submit(const r_util::SessionContext& context,
+                          const LaunchFunction& launch)
+{
+   boost::uint64_t slotId = 0;
+   LOCK_MUTEX(mutex_)
+   {
+      if (maxActive_ == 0 || (active_.size() < maxActive_ && users_.empty()))
+      {
+         slotId = admitLocked(context);
+      }
+      else if (!isQueuedLocked(context))
+      {
+         QueuedLaunch queued;
+         queued.context = context;
+         queued.launch = launch;
+         queued.queued = now();
+
+         std::deque<QueuedLaunch>& queue = queues_[context.username];
+         if (queue.empty())
+            users_.push_back(context.username);
+         queue.push_back(queued);
+
+         ++stats_.queueDepth;
+         ++stats_.queuedTotal;
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (slotId == 0)
+      return Success();
+
+   Error error = launch();
+   if (error)
+      releaseSlot(context, slotId);
+   return error;
+}
+
+bool LaunchQueue::isQueued(const r_util::SessionContext& context)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return isQueuedLocked(context);
+   }
+   END_LOCK_MUTEX
+   return false;
+}
+
+void LaunchQueue::complete(const r_util::SessionContext& context)
+{
+   std::vector<boost::function<void()> > ready;
+   LOCK_MUTEX(mutex_)
+   {
+      if (active_.erase(context) == 0)
+         return;
+
+      dispatchLocked(&ready);
+   }
+   END_LOCK_MUTEX
+
+   runReady(ready);
+}
+
+void LaunchQueue::releaseExpiredSlots()
+{
+   std::vector<boost::function<void()> > ready;
+   LOCK_MUTEX(mutex_)
+   {
+      boost::posix_time::ptime expired = now() - slotTimeout_;
+      for (ActiveMap::iterator it = active_.begin(); it != active_.end(); )
+      {
+         if (it->second.admitted < expired)
+            active_.erase(it++);
+         else
+            ++it;
+      }
+
+      dispatchLocked(&ready);
+   }
+   END_LOCK_MUTEX
+
+   runReady(ready);
+}
+
+LaunchQueue::Stats LaunchQueue::takeStats()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      stats_.active = active_.size();
+      Stats stats = stats_;
+      stats_.maxQueueWaitMs = -1;
+      return stats;
+   }
+   END_LOCK_MUTEX
+   return Stats();
+}
+
+boost::posix_time::ptime LaunchQueue::now() const
+{
+   if (clock_)
+      return clock_();
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+// give the context a slot (call with mutex_ held). each admission gets its
+// own id so that a launch which fails frees only its own slot, even if the
+// slot has since been freed and the context admitted again
+boost::uint64_t LaunchQueue::admitLocked(const r_util::SessionContext& context)
+{
+   Slot& slot = active_[context];
+   slot.id = nextSlotId_++;
+   slot.admitted = now();
+   return slot.id;
+}
+
+bool LaunchQueue::isQueuedLocked(const r_util::SessionContext& context) const
+{
+   std::map<std::string, std::deque<QueuedLaunch> >::const_iterator it =
+         queues_.find(context.username);
+   if (it == queues_.end())
+      return false;
+
+   BOOST_FOREACH(const QueuedLaunch& launch, it->second)
+   {
+      if (launch.context == context)
+         return true;
+   }
+   return false;
+}
+
+// give free slots to queued launches, taking one launch from each user in
+// turn (call with mutex_ held)
+void LaunchQueue::dispatchLocked(std::vector<boost::function<void()> >* pReady)
+{
+   boost::posix_time::ptime time = now();
+   while (active_.size() < maxActive_ && !users_.empty())
+   {
+      std::string user = users_.front();
+      users_.pop_front();
+
+      std::deque<QueuedLaunch>& queue = queues_[user];
+      QueuedLaunch launch = queue.front();
+      queue.pop_front();
+      if (queue.empty())
+         queues_.erase(user);
+      else
+         users_.push_back(user);
+      --stats_.queueDepth;
+
+      double waitMs = static_cast<double>(
+                        (time - launch.queued).total_milliseconds());
+      stats_.maxQueueWaitMs = std::max(stats_.maxQueueWaitMs, waitMs);
+
+      boost::uint64_t slotId = admitLocked(launch.context);
+      pReady->push_back(boost::bind(&LaunchQueue::runAdmitted,
+                                    this, launch, slotId));
+   }
+}
+
+void LaunchQueue::runAdmitted(const QueuedLaunch& launch,
+                              boost::uint64_t slotId)
+{
+   Error error = launch.launch();
+   if (error)
+   {
+      LOG_ERROR(error);
+      releaseSlot(launch.context, slotId);
+   }
+}
+
+void LaunchQueue::releaseSlot(const r_util::SessionContext& context,
+                              boost::uint64_t slotId)
+{
+   std::vector<boost::function<void()> > ready;
+   LOCK_MUTEX(mutex_)
+   {
+      ActiveMap::iterator it = active_.find(context);
+      if (it == active_.end() || it->second.id != slotId)
+         return;
+
+      active_.erase(it);
+      dispatchLocked(&ready);
+   }
+   END_LOCK_MUTEX
+
+   runReady(ready);
+}
+
+void LaunchQueue::runReady(const std::vector<boost::function<void()> >& ready)
+{
+   BOOST_FOREACH(const boost::function<void()>& launch, ready)
+   {
+      if (runLaunch_)
+         runLaunch_(launch);
+      else
+         launch();
+   }
+}
+
+} // namespace sessions
+} // namespace server_core
+} // namespace rstudio
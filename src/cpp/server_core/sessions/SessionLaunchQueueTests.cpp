@@ -0,0 +1,279 @@
+/*
+ * SessionLaunchQueueTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+#include <server_core/sessions/SessionLaunchQueue.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <core/SafeConvert.hpp>
+
+namespace rstudio {
+namespace server_core {
+namespace sessions {
+
+using namespace rstudio::core;
+using namespace boost::posix_time;
+
+namespace {
+
+r_util::SessionContext sessionContext(const std::string& user, int session)
+{
+   return r_util::SessionContext(
+            user,
+            r_util::SessionScope::projectNone(
+               safe_convert::numberToString(session)));
+}
+
+// records the launches run and the queued launches handed to the runner,
+// with a clock the tests move by hand
+class LaunchRecorder
+{
+public:
+   LaunchRecorder()
+      : now_(time_from_string("2019-01-01 00:00:00.000")),
+        queue_(boost::bind(&LaunchRecorder::post, this, _1),
+               boost::bind(&LaunchRecorder::now, this))
+   {
+      queue_.setLimits(2, seconds(10));
+   }
+
+   LaunchQueue& queue() { return queue_; }
+
+   LaunchQueue::LaunchFunction launch(const r_util::SessionContext& context,
+                                      bool fail = false)
+   {
+      return boost::bind(&LaunchRecorder::run, this, context, fail);
+   }
+
+   // run the launches the queue admitted
+   void runPosted()
+   {
+      std::vector<boost::function<void()> > posted;
+      posted.swap(posted_);
+      BOOST_FOREACH(const boost::function<void()>& launch, posted)
+      {
+         launch();
+      }
+   }
+
+   void advance(const time_duration& duration) { now_ += duration; }
+
+   std::vector<r_util::SessionContext> launched;
+
+private:
+   Error run(const r_util::SessionContext& context, bool fail)
+   {
+      launched.push_back(context);
+      if (fail)
+         return systemError(boost::system::errc::resource_unavailable_try_again,
+                            ERROR_LOCATION);
+      return Success();
+   }
+
+   void post(const boost::function<void()>& launch)
+   {
+      posted_.push_back(launch);
+   }
+
+   ptime now() const { return now_; }
+
+   ptime now_;
+   std::vector<boost::function<void()> > posted_;
+   LaunchQueue queue_;
+};
+
+} // anonymous namespace
+
+context("Session launch queue")
+{
+   test_that("launches beyond the limit are queued until a slot is free")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+
+      for (int i = 0; i < 3; i++)
+      {
+         r_util::SessionContext context = sessionContext("alice", i);
+         expect_true(!queue.submit(context, recorder.launch(context)));
+      }
+      expect_true(recorder.launched.size() == 2);
+      expect_true(queue.isQueued(sessionContext("alice", 2)));
+      expect_false(queue.isQueued(sessionContext("alice", 0)));
+
+      // resubmitting a queued launch doesn't queue it twice
+      r_util::SessionContext queued = sessionContext("alice", 2);
+      expect_true(!queue.submit(queued, recorder.launch(queued)));
+      expect_true(queue.takeStats().queueDepth == 1);
+
+      queue.complete(sessionContext("alice", 0));
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 3);
+      expect_true(recorder.launched[2] == queued);
+      expect_false(queue.isQueued(queued));
+
+      LaunchQueue::Stats stats = queue.takeStats();
+      expect_true(stats.active == 2);
+      expect_true(stats.queueDepth == 0);
+      expect_true(stats.queuedTotal == 1);
+
+      // completing a launch which isn't active admits nothing extra
+      queue.complete(sessionContext("alice", 0));
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 3);
+   }
+
+   test_that("queued launches are served round-robin by user")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+
+      r_util::SessionContext first = sessionContext("alice", 0);
+      r_util::SessionContext second = sessionContext("alice", 1);
+      expect_true(!queue.submit(first, recorder.launch(first)));
+      expect_true(!queue.submit(second, recorder.launch(second)));
+
+      // alice reconnects many sessions before bob and carol ask for one
+      for (int i = 2; i < 6; i++)
+      {
+         r_util::SessionContext context = sessionContext("alice", i);
+         expect_true(!queue.submit(context, recorder.launch(context)));
+      }
+      r_util::SessionContext bob = sessionContext("bob", 0);
+      r_util::SessionContext carol = sessionContext("carol", 0);
+      expect_true(!queue.submit(bob, recorder.launch(bob)));
+      expect_true(!queue.submit(carol, recorder.launch(carol)));
+
+      // a newcomer doesn't jump ahead of the queue while it's non-empty
+      queue.complete(first);
+      queue.complete(second);
+      r_util::SessionContext dave = sessionContext("dave", 0);
+      expect_true(!queue.submit(dave, recorder.launch(dave)));
+      recorder.runPosted();
+
+      expect_true(recorder.launched.size() == 4);
+      expect_true(recorder.launched[2] == sessionContext("alice", 2));
+      expect_true(recorder.launched[3] == bob);
+
+      queue.complete(sessionContext("alice", 2));
+      queue.complete(bob);
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 6);
+      expect_true(recorder.launched[4] == carol);
+      expect_true(recorder.launched[5] == sessionContext("alice", 3));
+
+      queue.complete(carol);
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 7);
+      expect_true(recorder.launched[6] == dave);
+   }
+
+   test_that("slots are released once they expire")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+
+      for (int i = 0; i < 3; i++)
+      {
+         r_util::SessionContext context = sessionContext("alice", i);
+         expect_true(!queue.submit(context, recorder.launch(context)));
+      }
+
+      recorder.advance(seconds(5));
+      queue.releaseExpiredSlots();
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 2);
+
+      recorder.advance(seconds(6));
+      queue.releaseExpiredSlots();
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 3);
+
+      LaunchQueue::Stats stats = queue.takeStats();
+      expect_true(stats.active == 1);
+      expect_true(stats.maxQueueWaitMs == 11000);
+
+      // the wait is reported once
+      expect_true(queue.takeStats().maxQueueWaitMs == -1);
+   }
+
+   test_that("a failed launch frees its slot exactly once")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+
+      r_util::SessionContext failing = sessionContext("alice", 0);
+      expect_true(queue.submit(failing, recorder.launch(failing, true)));
+      expect_true(queue.takeStats().active == 0);
+
+      // the session is told it's done as well (e.g. its pending launch is
+      // removed); that mustn't free another launch's slot
+      queue.complete(failing);
+
+      r_util::SessionContext first = sessionContext("bob", 0);
+      r_util::SessionContext second = sessionContext("bob", 1);
+      r_util::SessionContext third = sessionContext("bob", 2);
+      expect_true(!queue.submit(first, recorder.launch(first)));
+      expect_true(!queue.submit(second, recorder.launch(second)));
+      expect_true(!queue.submit(third, recorder.launch(third)));
+      expect_true(queue.takeStats().active == 2);
+      expect_true(queue.isQueued(third));
+   }
+
+   test_that("a failed queued launch admits the next one")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+
+      r_util::SessionContext first = sessionContext("alice", 0);
+      r_util::SessionContext second = sessionContext("alice", 1);
+      r_util::SessionContext failing = sessionContext("alice", 2);
+      r_util::SessionContext last = sessionContext("bob", 0);
+      expect_true(!queue.submit(first, recorder.launch(first)));
+      expect_true(!queue.submit(second, recorder.launch(second)));
+      expect_true(!queue.submit(failing, recorder.launch(failing, true)));
+      expect_true(!queue.submit(last, recorder.launch(last)));
+
+      queue.complete(first);
+      recorder.runPosted();
+      recorder.runPosted();
+      expect_true(recorder.launched.size() == 4);
+      expect_true(recorder.launched[3] == last);
+
+      // a stale completion for the failed launch leaves the others alone
+      queue.complete(failing);
+      expect_true(queue.takeStats().active == 2);
+   }
+
+   test_that("no limit runs every launch immediately")
+   {
+      LaunchRecorder recorder;
+      LaunchQueue& queue = recorder.queue();
+      queue.setLimits(0, seconds(10));
+
+      for (int i = 0; i < 10; i++)
+      {
+         r_util::SessionContext context = sessionContext("alice", i);
+         expect_true(!queue.submit(context, recorder.launch(context)));
+      }
+      expect_true(recorder.launched.size() == 10);
+      expect_true(queue.takeStats().queueDepth == 0);
+   }
+}
+
+} // namespace sessions
+} // namespace server_core
+} // namespace rstudio
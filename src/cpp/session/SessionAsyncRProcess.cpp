@@ -26,6 +26,8 @@
 
 #include <session/SessionAsyncRProcess.hpp>
 
+#include "SessionAsyncRWorkerPool.hpp"
+
 namespace rstudio {
 namespace session {
 namespace async_r {
@@ -86,6 +88,40 @@ void AsyncRProcess::start(const char* rCommand,
       args.push_back("--internet2");
 #endif
 
+   core::system::ProcessCallbacks cb;
+   using namespace module_context;
+   cb.onContinue = boost::bind(&AsyncRProcess::onContinue,
+                               AsyncRProcess::shared_from_this());
+   cb.onStdout = boost::bind(&AsyncRProcess::onStdout,
+                             AsyncRProcess::shared_from_this(),
+                             _2);
+   cb.onStderr = boost::bind(&AsyncRProcess::onStderr,
+                             AsyncRProcess::shared_from_this(),
+                             _2);
+   cb.onExit =  boost::bind(&AsyncRProcess::onProcessCompleted,
+                             AsyncRProcess::shared_from_this(),
+                             _1);
+   cb.onStarted = boost::bind(&AsyncRProcess::onStarted,
+                              AsyncRProcess::shared_from_this(),
+                              _1);
+
+   // tasks which don't need standard input can be handed to a warm worker
+   // (if one is free) rather than paying for R startup
+   if ((rOptions & R_PROCESS_POOLED) && input.empty())
+   {
+      AsyncRTask task;
+      task.command = rCommand;
+      task.workingDir = workingDir;
+      task.environment = environment;
+      task.sourceFiles = rSourceFiles;
+      task.redirectStdErr = (rOptions & R_PROCESS_REDIRECTSTDERR) != 0;
+      if (runPooledTask(args, task, cb))
+      {
+         isRunning_ = true;
+         return;
+      }
+   }
+
    args.push_back("-e");
    
    bool needsQuote = false;
@@ -159,23 +195,6 @@ void AsyncRProcess::start(const char* rCommand,
    }
    options.environment = childEnv;
 
-   core::system::ProcessCallbacks cb;
-   using namespace module_context;
-   cb.onContinue = boost::bind(&AsyncRProcess::onContinue,
-                               AsyncRProcess::shared_from_this());
-   cb.onStdout = boost::bind(&AsyncRProcess::onStdout,
-                             AsyncRProcess::shared_from_this(),
-                             _2);
-   cb.onStderr = boost::bind(&AsyncRProcess::onStderr,
-                             AsyncRProcess::shared_from_this(),
-                             _2);
-   cb.onExit =  boost::bind(&AsyncRProcess::onProcessCompleted,
-                             AsyncRProcess::shared_from_this(),
-                             _1);
-   cb.onStarted = boost::bind(&AsyncRProcess::onStarted,
-                              AsyncRProcess::shared_from_this(),
-                              _1);
-
    // forward input if requested
    input_ = input;
 
@@ -0,0 +1,553 @@
+/*
+ * SessionAsyncRWorkerPool.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionAsyncRWorkerPool.hpp"
+
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/StringUtils.hpp>
+#include <core/system/Environment.hpp>
+#include <core/system/System.hpp>
+
+#include <r/ROptions.hpp>
+
+#include <session/SessionModuleContext.hpp>
+#include <session/SessionOptions.hpp>
+
+#ifdef _WIN32
+#define kPathSeparator ";"
+#else
+#define kPathSeparator ":"
+#endif
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace async_r {
+
+namespace {
+
+// worker configuration (read from R options at startup)
+struct WorkerConfig
+{
+   WorkerConfig() : maxTasks(0), memoryLimitMb(0), idleTimeoutSecs(0) {}
+   int maxTasks;
+   int memoryLimitMb;
+   int idleTimeoutSecs;
+   std::vector<std::string> packages;
+};
+WorkerConfig s_config;
+
+boost::shared_ptr<PooledWorker> startWorker(
+                                 const std::string& key,
+                                 const std::vector<std::string>& rArgs);
+
+WorkerPool s_pool(startWorker);
+
+std::string rStringLiteral(const std::string& str)
+{
+   return "'" + string_utils::singleQuotedStrEscape(str) + "'";
+}
+
+// the library paths, with when each was last changed (installing or
+// removing a package changes its library's modification time)
+std::string libraryState()
+{
+   std::string libPaths = module_context::libPathsString();
+   std::vector<std::string> paths;
+   boost::algorithm::split(paths, libPaths,
+                           boost::algorithm::is_any_of(kPathSeparator));
+
+   std::string state = libPaths;
+   BOOST_FOREACH(const std::string& path, paths)
+   {
+      FilePath libPath(path);
+      if (!path.empty() && libPath.exists())
+         state += " " + safe_convert::numberToString(libPath.lastWriteTime());
+   }
+   return state;
+}
+
+std::string poolKey(const std::vector<std::string>& rArgs)
+{
+   // workers are only reused for tasks which would have been started with
+   // the same arguments and libraries. a worker keeps the namespaces its
+   // tasks loaded, so once packages are installed or removed it's retired
+   // rather than running tasks against the old versions
+   return boost::algorithm::join(rArgs, " ") + "\n" + libraryState();
+}
+
+// start a worker for vanilla tasks (the most common kind, e.g. indexing
+// package information) so the first of them doesn't wait for R to start
+void prestartWorker()
+{
+   std::vector<std::string> rArgs;
+   rArgs.push_back("--slave");
+   rArgs.push_back("--vanilla");
+   s_pool.prestart(poolKey(rArgs), rArgs);
+}
+
+// the R code which runs a task in a worker
+std::string taskCode(const AsyncRTask& task)
+{
+   std::string code;
+   if (!task.workingDir.empty())
+      code += "setwd(" + rStringLiteral(task.workingDir.absolutePath()) + ")\n";
+
+   BOOST_FOREACH(const core::system::Option& var, task.environment)
+   {
+      code += "Sys.setenv(" + rStringLiteral(var.first) + " = " +
+              rStringLiteral(var.second) + ")\n";
+   }
+
+   BOOST_FOREACH(const FilePath& sourceFile, task.sourceFiles)
+   {
+      code += "source(" + rStringLiteral(sourceFile.absolutePath()) + ")\n";
+   }
+
+   code += task.command;
+   return code;
+}
+
+class AsyncRWorker : public PooledWorker,
+                     public boost::enable_shared_from_this<AsyncRWorker>
+{
+public:
+   explicit AsyncRWorker(const std::string& key)
+      : key_(key), state_(Idle), tasksRun_(0), closeInput_(false),
+        idleSince_(boost::posix_time::second_clock::universal_time())
+   {
+   }
+
+   Error start(const std::vector<std::string>& rArgs)
+   {
+      FilePath rProgramPath;
+      Error error = module_context::rScriptPath(&rProgramPath);
+      if (error)
+         return error;
+
+      FilePath workerScript =
+            session::options().rResourcesPath().childPath("async_r_worker.R");
+
+      std::vector<std::string> args = rArgs;
+      args.push_back("-e");
+#ifdef _WIN32
+      args.push_back("\"source('" +
+                     string_utils::singleQuotedStrEscape(
+                        workerScript.absolutePath()) + "')\"");
+#else
+      args.push_back("source(" + rStringLiteral(workerScript.absolutePath()) + ")");
+#endif
+
+      core::system::ProcessOptions options;
+      options.terminateChildren = true;
+
+      // same environment as a one-off process, plus the packages to preload
+      core::system::Options childEnv;
+      core::system::environment(&childEnv);
+      std::string libPaths = module_context::libPathsString();
+      if (!libPaths.empty())
+         core::system::setenv(&childEnv, "R_LIBS", libPaths);
+      core::system::setenv(&childEnv, "RS_ASYNC_R_WORKER_PACKAGES",
+                           boost::algorithm::join(s_config.packages, ","));
+      options.environment = childEnv;
+
+      core::system::ProcessCallbacks cb;
+      cb.onStarted = boost::bind(&AsyncRWorker::onStarted,
+                                 shared_from_this(), _1);
+      cb.onContinue = boost::bind(&AsyncRWorker::onContinue,
+                                  shared_from_this(), _1);
+      cb.onStdout = boost::bind(&AsyncRWorker::onStdout,
+                                shared_from_this(), _1, _2);
+      cb.onStderr = boost::bind(&AsyncRWorker::onStderr,
+                                shared_from_this(), _1, _2);
+      cb.onExit = boost::bind(&AsyncRWorker::onExit,
+                              shared_from_this(), _1);
+
+      return module_context::processSupervisor().runProgram(
+               rProgramPath.absolutePath(), args, options, cb);
+   }
+
+   const std::string& key() const { return key_; }
+   bool idle() const { return state_ == Idle && !closeInput_; }
+
+   // queue a task; it is written to the worker by the next poll's onContinue
+   void assign(const AsyncRTask& task,
+               const core::system::ProcessCallbacks& callbacks)
+   {
+      task_ = task;
+      callbacks_ = callbacks;
+      state_ = Pending;
+      module_context::processSupervisor().continueSoon();
+   }
+
+   void retire()
+   {
+      closeInput_ = true;
+      module_context::processSupervisor().continueSoon();
+   }
+
+private:
+   void dispatch(core::system::ProcessOperations& ops)
+   {
+      if (state_ == Pending)
+      {
+         std::string code = taskCode(task_);
+         std::size_t lines = std::count(code.begin(), code.end(), '\n') + 1;
+         token_ = core::system::generateUuid(false);
+         stdout_.reset(token_);
+         stderr_.reset(token_);
+
+         std::string frame = token_ + " " +
+               safe_convert::numberToString(lines) + "\n" + code + "\n";
+         Error error = ops.writeToStdin(frame, false);
+         if (error)
+         {
+            // the task will be completed when the worker exits
+            LOG_ERROR(error);
+            safeTerminate(ops);
+         }
+
+         state_ = Running;
+         if (callbacks_.onStarted)
+            callbacks_.onStarted(ops);
+      }
+      else if (state_ == Idle && closeInput_)
+      {
+         Error error = ops.writeToStdin(std::string(), true);
+         if (error)
+         {
+            LOG_ERROR(error);
+            safeTerminate(ops);
+         }
+         closeInput_ = false;
+         state_ = Exiting;
+      }
+   }
+
+   void onStarted(core::system::ProcessOperations& ops)
+   {
+      dispatch(ops);
+   }
+
+   bool onContinue(core::system::ProcessOperations& ops)
+   {
+      // don't hold on to R processes nobody is using
+      if (idle() && s_config.idleTimeoutSecs > 0 &&
+          boost::posix_time::second_clock::universal_time() - idleSince_ >
+             boost::posix_time::seconds(s_config.idleTimeoutSecs))
+      {
+         s_pool.remove(shared_from_this());
+         retire();
+      }
+
+      dispatch(ops);
+
+      // let the task decide whether it should keep running (if not, the
+      // worker is terminated and the task completes with its exit status)
+      if (state_ == Running && callbacks_.onContinue)
+         return callbacks_.onContinue(ops);
+
+      return true;
+   }
+
+   void onStdout(core::system::ProcessOperations& ops, const std::string& output)
+   {
+      if (state_ != Running)
+         return;
+
+      forwardStdout(ops, stdout_.append(output));
+      checkComplete(ops);
+   }
+
+   void onStderr(core::system::ProcessOperations& ops, const std::string& output)
+   {
+      if (state_ != Running)
+         return;
+
+      forwardStderr(ops, stderr_.append(output));
+      checkComplete(ops);
+   }
+
+   void onExit(int exitStatus)
+   {
+      s_pool.remove(shared_from_this());
+
+      // if the task exited the worker (or was terminated) then the worker's
+      // exit status is the task's
+      if (state_ == Running || state_ == Pending)
+      {
+         state_ = Exiting;
+         completeTask(exitStatus);
+      }
+   }
+
+   void forwardStdout(core::system::ProcessOperations& ops,
+                      const std::string& output)
+   {
+      if (!output.empty() && callbacks_.onStdout)
+         callbacks_.onStdout(ops, output);
+   }
+
+   void forwardStderr(core::system::ProcessOperations& ops,
+                      const std::string& output)
+   {
+      if (output.empty())
+         return;
+
+      if (task_.redirectStdErr)
+         forwardStdout(ops, output);
+      else if (callbacks_.onStderr)
+         callbacks_.onStderr(ops, output);
+   }
+
+   void checkComplete(core::system::ProcessOperations& ops)
+   {
+      if (!stdout_.complete() || !stderr_.complete())
+         return;
+
+      // trailer is ' <status> <memory in use (MB)>'
+      std::vector<std::string> fields;
+      std::string trailer = string_utils::trimWhitespace(stdout_.trailer());
+      boost::algorithm::split(fields, trailer, boost::algorithm::is_space(),
+                              boost::algorithm::token_compress_on);
+      int exitStatus = fields.size() > 0
+            ? safe_convert::stringTo<int>(fields[0], EXIT_FAILURE)
+            : EXIT_FAILURE;
+      double memoryMb = fields.size() > 1
+            ? safe_convert::stringTo<double>(fields[1], 0)
+            : 0;
+
+      // recycle workers which have run enough tasks or grown too large
+      ++tasksRun_;
+      if ((s_config.maxTasks > 0 && tasksRun_ >= s_config.maxTasks) ||
+          (s_config.memoryLimitMb > 0 && memoryMb > s_config.memoryLimitMb))
+      {
+         s_pool.remove(shared_from_this());
+         retire();
+      }
+
+      // become idle before completing the task (its completion handler
+      // may well start another task)
+      state_ = Idle;
+      idleSince_ = boost::posix_time::second_clock::universal_time();
+      dispatch(ops);
+      completeTask(exitStatus);
+   }
+
+   void completeTask(int exitStatus)
+   {
+      core::system::ProcessCallbacks callbacks = callbacks_;
+      callbacks_ = core::system::ProcessCallbacks();
+      if (callbacks.onExit)
+         callbacks.onExit(exitStatus);
+   }
+
+   void safeTerminate(core::system::ProcessOperations& ops)
+   {
+      Error error = ops.terminate();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+private:
+   enum State { Idle, Pending, Running, Exiting };
+
+   std::string key_;
+   State state_;
+   int tasksRun_;
+   bool closeInput_;
+   boost::posix_time::ptime idleSince_;
+
+   AsyncRTask task_;
+   core::system::ProcessCallbacks callbacks_;
+   std::string token_;
+   TaskStream stdout_;
+   TaskStream stderr_;
+};
+
+boost::shared_ptr<PooledWorker> startWorker(
+                                 const std::string& key,
+                                 const std::vector<std::string>& rArgs)
+{
+   boost::shared_ptr<AsyncRWorker> pWorker(new AsyncRWorker(key));
+   Error error = pWorker->start(rArgs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return boost::shared_ptr<PooledWorker>();
+   }
+
+   return pWorker;
+}
+
+} // anonymous namespace
+
+void TaskStream::reset(const std::string& token)
+{
+   marker_ = "\n" + token;
+   buffer_.clear();
+   trailer_.clear();
+   complete_ = false;
+}
+
+std::string TaskStream::append(const std::string& output)
+{
+   if (complete_)
+      return std::string();
+
+   buffer_.append(output);
+
+   std::string::size_type pos = buffer_.find(marker_);
+   if (pos != std::string::npos)
+   {
+      std::string::size_type eol = buffer_.find('\n', pos + marker_.size());
+      if (eol != std::string::npos)
+      {
+         trailer_ = buffer_.substr(pos + marker_.size(),
+                                   eol - pos - marker_.size());
+         complete_ = true;
+      }
+   }
+   else
+   {
+      pos = buffer_.size() - partialMarkerSize();
+   }
+
+   std::string taskOutput = buffer_.substr(0, pos);
+   if (complete_)
+      buffer_.clear();
+   else
+      buffer_.erase(0, pos);
+   return taskOutput;
+}
+
+// size of the longest suffix of the buffer which begins the marker
+std::string::size_type TaskStream::partialMarkerSize() const
+{
+   std::string::size_type n = std::min(buffer_.size(), marker_.size() - 1);
+   for (; n > 0; --n)
+   {
+      if (buffer_.compare(buffer_.size() - n, n, marker_, 0, n) == 0)
+         break;
+   }
+   return n;
+}
+
+bool WorkerPool::run(const std::string& key,
+                     const std::vector<std::string>& rArgs,
+                     const AsyncRTask& task,
+                     const core::system::ProcessCallbacks& callbacks)
+{
+   if (size_ <= 0)
+      return false;
+
+   // prefer an idle worker started with the same arguments
+   boost::shared_ptr<PooledWorker> pWorker;
+   boost::shared_ptr<PooledWorker> pOtherIdleWorker;
+   BOOST_FOREACH(const boost::shared_ptr<PooledWorker>& pCandidate, workers_)
+   {
+      if (!pCandidate->idle())
+         continue;
+
+      if (pCandidate->key() == key)
+      {
+         pWorker = pCandidate;
+         break;
+      }
+      pOtherIdleWorker = pCandidate;
+   }
+
+   if (!pWorker)
+   {
+      // make room by retiring an idle worker with other arguments
+      if (static_cast<int>(workers_.size()) >= size_)
+      {
+         if (!pOtherIdleWorker)
+            return false;
+
+         remove(pOtherIdleWorker);
+         pOtherIdleWorker->retire();
+      }
+
+      pWorker = startWorker_(key, rArgs);
+      if (!pWorker)
+         return false;
+      workers_.push_back(pWorker);
+   }
+
+   pWorker->assign(task, callbacks);
+   return true;
+}
+
+void WorkerPool::prestart(const std::string& key,
+                          const std::vector<std::string>& rArgs)
+{
+   if (size_ <= 0 || !workers_.empty())
+      return;
+
+   boost::shared_ptr<PooledWorker> pWorker = startWorker_(key, rArgs);
+   if (pWorker)
+      workers_.push_back(pWorker);
+}
+
+void WorkerPool::remove(const boost::shared_ptr<PooledWorker>& pWorker)
+{
+   workers_.erase(std::remove(workers_.begin(), workers_.end(), pWorker),
+                  workers_.end());
+}
+
+bool runPooledTask(const std::vector<std::string>& rArgs,
+                   const AsyncRTask& task,
+                   const core::system::ProcessCallbacks& callbacks)
+{
+   return s_pool.run(poolKey(rArgs), rArgs, task, callbacks);
+}
+
+Error initializeWorkerPool()
+{
+   // workers are started by tasks which can use one (and one is started
+   // ahead of the first task), and exit after they've been idle for a while
+   s_pool.setSize(r::options::getOption<int>(
+            "rstudio.asyncRWorkers", 1, false));
+   s_config.maxTasks = r::options::getOption<int>(
+            "rstudio.asyncRWorkerMaxTasks", 25, false);
+   s_config.memoryLimitMb = r::options::getOption<int>(
+            "rstudio.asyncRWorkerMemoryLimit", 256, false);
+   s_config.idleTimeoutSecs = r::options::getOption<int>(
+            "rstudio.asyncRWorkerIdleTimeout", 60, false);
+   s_config.packages = r::options::getOption<std::vector<std::string> >(
+            "rstudio.asyncRWorkerPackages", std::vector<std::string>(), false);
+
+   // (once the session is up, so R startup doesn't compete with it)
+   module_context::scheduleDelayedWork(boost::posix_time::seconds(1),
+                                       prestartWorker);
+
+   return Success();
+}
+
+} // namespace async_r
+} // namespace session
+} // namespace rstudio
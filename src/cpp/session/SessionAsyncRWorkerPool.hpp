@@ -0,0 +1,157 @@
+/*
+ * SessionAsyncRWorkerPool.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_ASYNC_R_WORKER_POOL_HPP
+#define SESSION_ASYNC_R_WORKER_POOL_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/system/Process.hpp>
+#include <core/system/Types.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace async_r {
+
+// a background R task which can be run by a pooled worker
+struct AsyncRTask
+{
+   AsyncRTask() : redirectStdErr(false) {}
+
+   std::string command;
+   core::FilePath workingDir;
+   core::system::Options environment;
+   std::vector<core::FilePath> sourceFiles;
+   bool redirectStdErr;
+};
+
+// one of a worker's output streams. output is forwarded to the running
+// task until the line bearing the task's token arrives; a tail which could
+// be the start of that line is held back until we know
+class TaskStream
+{
+public:
+   TaskStream() : complete_(false) {}
+
+   void reset(const std::string& token);
+
+   bool complete() const { return complete_; }
+   const std::string& trailer() const { return trailer_; }
+
+   // append output, returning the part which belongs to the task
+   std::string append(const std::string& output);
+
+private:
+   std::string::size_type partialMarkerSize() const;
+
+   std::string marker_;
+   std::string buffer_;
+   std::string trailer_;
+   bool complete_;
+};
+
+// a long-lived R process which runs tasks one at a time
+class PooledWorker : boost::noncopyable
+{
+public:
+   virtual ~PooledWorker() {}
+
+   // workers only run tasks with the key they were started with (which
+   // reflects their R arguments and library paths)
+   virtual const std::string& key() const = 0;
+   virtual bool idle() const = 0;
+
+   // run a task; the callbacks are invoked as they would be for a process
+   // running the task
+   virtual void assign(const AsyncRTask& task,
+                       const core::system::ProcessCallbacks& callbacks) = 0;
+
+   // exit once any task the worker has is complete
+   virtual void retire() = 0;
+};
+
+// decides which of the pool's workers (if any) runs a task. workers are
+// started when a task needs one (or ahead of the first task)
+class WorkerPool : boost::noncopyable
+{
+public:
+   typedef boost::function<boost::shared_ptr<PooledWorker>(
+                              const std::string& key,
+                              const std::vector<std::string>& rArgs)>
+                                                            WorkerFactory;
+
+   explicit WorkerPool(const WorkerFactory& startWorker)
+      : size_(0), startWorker_(startWorker)
+   {
+   }
+
+   // the maximum number of workers (0 disables the pool)
+   void setSize(int size) { size_ = size; }
+   int size() const { return size_; }
+
+   std::size_t workerCount() const { return workers_.size(); }
+
+   // run a task on an idle worker with the same key, starting one if there
+   // is room. returns false without running the task if the pool is
+   // disabled, all of its workers are busy or a worker couldn't be started
+   // (the caller should then run the task in a process of its own)
+   bool run(const std::string& key,
+            const std::vector<std::string>& rArgs,
+            const AsyncRTask& task,
+            const core::system::ProcessCallbacks& callbacks);
+
+   // start a worker for tasks with the given key if the pool has none, so
+   // that the first task doesn't wait for it
+   void prestart(const std::string& key,
+                 const std::vector<std::string>& rArgs);
+
+   // stop tracking a worker which is exiting
+   void remove(const boost::shared_ptr<PooledWorker>& pWorker);
+
+private:
+   int size_;
+   WorkerFactory startWorker_;
+   std::vector<boost::shared_ptr<PooledWorker> > workers_;
+};
+
+// read the pool's configuration (the pool is sized and configured via the
+// rstudio.asyncRWorkers* R options)
+core::Error initializeWorkerPool();
+
+// run a task on an idle worker started with the given R arguments. the
+// callbacks are invoked as they would be for a process running the task
+// (with the worker's process operations). returns false without running
+// the task if the pool is disabled or all of its workers are busy
+bool runPooledTask(const std::vector<std::string>& rArgs,
+                   const AsyncRTask& task,
+                   const core::system::ProcessCallbacks& callbacks);
+
+} // namespace async_r
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_ASYNC_R_WORKER_POOL_HPP
@@ -0,0 +1,242 @@
+/*
+ * SessionAsyncRWorkerPoolTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionAsyncRWorkerPool.hpp"
+
+#include <boost/bind.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace async_r {
+namespace tests {
+
+namespace {
+
+class FakeWorker : public PooledWorker
+{
+public:
+   explicit FakeWorker(const std::string& key)
+      : key_(key), busy_(false), retired_(false), tasks_(0)
+   {
+   }
+
+   const std::string& key() const { return key_; }
+   bool idle() const { return !busy_ && !retired_; }
+
+   void assign(const AsyncRTask& task,
+               const core::system::ProcessCallbacks&)
+   {
+      command_ = task.command;
+      busy_ = true;
+      tasks_++;
+   }
+
+   void retire() { retired_ = true; }
+
+   void finishTask() { busy_ = false; }
+
+   bool retired() const { return retired_; }
+   int tasks() const { return tasks_; }
+   const std::string& command() const { return command_; }
+
+private:
+   std::string key_;
+   bool busy_;
+   bool retired_;
+   int tasks_;
+   std::string command_;
+};
+
+// starts fake workers (or fails to, when asked)
+class FakeWorkerFactory
+{
+public:
+   FakeWorkerFactory() : fail(false) {}
+
+   boost::shared_ptr<PooledWorker> start(const std::string& key,
+                                         const std::vector<std::string>&)
+   {
+      if (fail)
+         return boost::shared_ptr<PooledWorker>();
+
+      boost::shared_ptr<FakeWorker> pWorker(new FakeWorker(key));
+      started.push_back(pWorker);
+      return pWorker;
+   }
+
+   bool fail;
+   std::vector<boost::shared_ptr<FakeWorker> > started;
+};
+
+AsyncRTask task(const std::string& command)
+{
+   AsyncRTask task;
+   task.command = command;
+   return task;
+}
+
+bool runTask(WorkerPool* pPool,
+             const std::string& key,
+             const std::string& command)
+{
+   return pPool->run(key,
+                     std::vector<std::string>(),
+                     task(command),
+                     core::system::ProcessCallbacks());
+}
+
+} // anonymous namespace
+
+TEST_CASE("Async R Worker Pool")
+{
+   FakeWorkerFactory factory;
+   WorkerPool pool(boost::bind(&FakeWorkerFactory::start, &factory, _1, _2));
+   pool.setSize(1);
+
+   SECTION("A disabled pool leaves tasks to their own processes")
+   {
+      pool.setSize(0);
+      CHECK_FALSE(runTask(&pool, "vanilla", "1"));
+      pool.prestart("vanilla", std::vector<std::string>());
+      CHECK(factory.started.empty());
+   }
+
+   SECTION("Workers are started by the first task which needs one")
+   {
+      CHECK(pool.workerCount() == 0);
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      REQUIRE(factory.started.size() == 1);
+      CHECK(factory.started[0]->command() == "1");
+      CHECK(pool.workerCount() == 1);
+   }
+
+   SECTION("A worker can be started ahead of the first task")
+   {
+      pool.prestart("vanilla", std::vector<std::string>());
+      REQUIRE(factory.started.size() == 1);
+      CHECK(pool.workerCount() == 1);
+
+      // but only while the pool has none
+      pool.prestart("vanilla", std::vector<std::string>());
+      CHECK(factory.started.size() == 1);
+
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      CHECK(factory.started.size() == 1);
+      CHECK(factory.started[0]->command() == "1");
+   }
+
+   SECTION("Workers started for other libraries are replaced")
+   {
+      // (the key changes as packages are installed)
+      pool.prestart("vanilla", std::vector<std::string>());
+      REQUIRE(runTask(&pool, "vanilla 2", "1"));
+      REQUIRE(factory.started.size() == 2);
+      CHECK(factory.started[0]->retired());
+      CHECK(factory.started[1]->command() == "1");
+      CHECK(pool.workerCount() == 1);
+   }
+
+   SECTION("Idle workers run later tasks")
+   {
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      factory.started[0]->finishTask();
+      REQUIRE(runTask(&pool, "vanilla", "2"));
+
+      CHECK(factory.started.size() == 1);
+      CHECK(factory.started[0]->tasks() == 2);
+      CHECK(factory.started[0]->command() == "2");
+   }
+
+   SECTION("Tasks fall back to their own processes while workers are busy")
+   {
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      CHECK_FALSE(runTask(&pool, "vanilla", "2"));
+      CHECK_FALSE(runTask(&pool, "other", "3"));
+      CHECK(factory.started.size() == 1);
+      CHECK(factory.started[0]->tasks() == 1);
+   }
+
+   SECTION("Idle workers with other arguments make room for a task")
+   {
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      factory.started[0]->finishTask();
+
+      REQUIRE(runTask(&pool, "other", "2"));
+      REQUIRE(factory.started.size() == 2);
+      CHECK(factory.started[0]->retired());
+      CHECK(factory.started[1]->key() == "other");
+      CHECK(pool.workerCount() == 1);
+   }
+
+   SECTION("Tasks fall back to their own processes if a worker can't start")
+   {
+      factory.fail = true;
+      CHECK_FALSE(runTask(&pool, "vanilla", "1"));
+      CHECK(pool.workerCount() == 0);
+   }
+
+   SECTION("Removed workers are replaced when needed")
+   {
+      REQUIRE(runTask(&pool, "vanilla", "1"));
+      pool.remove(factory.started[0]);
+      CHECK(pool.workerCount() == 0);
+
+      REQUIRE(runTask(&pool, "vanilla", "2"));
+      CHECK(factory.started.size() == 2);
+   }
+}
+
+TEST_CASE("Async R Worker Task Streams")
+{
+   TaskStream stream;
+   stream.reset("TOKEN");
+
+   SECTION("Output is forwarded until the task's token")
+   {
+      CHECK(stream.append("hello\nworld") == "hello\nworld");
+      CHECK_FALSE(stream.complete());
+      CHECK(stream.append("\nTOKEN 0 12.5\nnext") == "");
+      CHECK(stream.complete());
+      CHECK(stream.trailer() == " 0 12.5");
+
+      // anything after the token isn't the task's
+      CHECK(stream.append("more") == "");
+   }
+
+   SECTION("A token split between reads is held back")
+   {
+      CHECK(stream.append("output\nTO") == "output");
+      CHECK(stream.append("KEN 1") == "");
+      CHECK_FALSE(stream.complete());
+      CHECK(stream.append(" 3\n") == "");
+      CHECK(stream.complete());
+      CHECK(stream.trailer() == " 1 3");
+   }
+
+   SECTION("Text which only resembles the token is forwarded")
+   {
+      CHECK(stream.append("a\nTOK") == "a");
+      CHECK(stream.append("ING\n") == "\nTOKING");
+      CHECK_FALSE(stream.complete());
+   }
+}
+
+} // namespace tests
+} // namespace async_r
+} // namespace session
+} // namespace rstudio
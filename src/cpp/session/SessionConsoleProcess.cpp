@@ -286,6 +286,9 @@ void ConsoleProcess::enqueInputInternalLock(const Input& input)
       enqueInput(input);
    }
    END_LOCK_MUTEX
+
+   // queued input is dispatched by onContinue
+   module_context::processSupervisor().continueSoon();
 }
 
 void ConsoleProcess::enqueInput(const Input& input)
@@ -384,17 +387,20 @@ void ConsoleProcess::enquePrompt(const std::string& prompt)
 void ConsoleProcess::interrupt()
 {
    interrupt_ = true;
+   module_context::processSupervisor().continueSoon();
 }
 
 void ConsoleProcess::interruptChild()
 {
    interruptChild_ = true;
+   module_context::processSupervisor().continueSoon();
 }
 
 void ConsoleProcess::resize(int cols, int rows)
 {
    newCols_ = cols;
    newRows_ = rows;
+   module_context::processSupervisor().continueSoon();
 }
 
 bool ConsoleProcess::onContinue(core::system::ProcessOperations& ops)
@@ -434,6 +440,15 @@ bool ConsoleProcess::onContinue(core::system::ProcessOperations& ops)
    }
    END_LOCK_MUTEX
 
+   // send output which has been held to coalesce it (checking again at the
+   // next poll if some is still held)
+   if (procInfo_->getChannelMode() == Websocket)
+   {
+      socketOutput_.sendDue();
+      if (socketOutput_.hasPending())
+         module_context::processSupervisor().continueSoon();
+   }
+
    if (newCols_ != -1 && newRows_ != -1)
    {
       ops.ptySetSize(newCols_, newRows_);
@@ -509,6 +524,13 @@ void ConsoleProcess::deleteEnvFile() const
 
 std::string ConsoleProcess::getSavedBufferChunk(int chunk, bool* pMoreAvailable) const
 {
+   // redraw terminals from their screen model rather than replaying output
+   if (procInfo_->getTerminalSequence() != kNoTerminal)
+   {
+      *pMoreAvailable = false;
+      return chunk == 0 ? procInfo_->getScreenSnapshot() : std::string();
+   }
+
    return procInfo_->getSavedBufferChunk(chunk, pMoreAvailable);
 }
 
@@ -531,19 +553,25 @@ void ConsoleProcess::enqueOutputEvent(const std::string &output)
    if (procInfo_->getAltBufferActive() != currentAltBufferStatus)
       saveConsoleProcesses();
 
+   if (procInfo_->getChannelMode() == Websocket)
+   {
+      socketOutput_.append(output);
+      if (socketOutput_.hasPending())
+         module_context::processSupervisor().continueSoon();
+      return;
+   }
+
+   enqueRpcOutputEvent(output);
+}
+
+void ConsoleProcess::enqueRpcOutputEvent(const std::string& output)
+{
    // If there's more output than the client can even show, then
    // truncate it to the amount that the client can show. Too much
    // output can overwhelm the client, making it unresponsive.
    std::string trimmedOutput = output;
    string_utils::trimLeadingLines(procInfo_->getMaxOutputLines(), &trimmedOutput);
 
-   if (procInfo_->getChannelMode() == Websocket)
-   {
-      s_terminalSocket.sendText(procInfo_->getHandle(), output);
-      return;
-   }
-
-   // Rpc
    json::Object data;
    data["handle"] = handle();
    data["output"] = trimmedOutput;
@@ -721,6 +749,22 @@ void ConsoleProcess::setRpcMode()
 {
    s_terminalSocket.stopListening(handle());
    procInfo_->setChannelMode(Rpc, "");
+
+   // output which didn't make it over the websocket
+   std::string pending = socketOutput_.takePending();
+   if (!pending.empty())
+      enqueRpcOutputEvent(pending);
+}
+
+Error ConsoleProcess::sendSocketOutput(const std::string& output)
+{
+   return s_terminalSocket.sendText(procInfo_->getHandle(), output);
+}
+
+bool ConsoleProcess::isOutputPaused() const
+{
+   return procInfo_->getChannelMode() == Websocket &&
+          socketOutput_.isBackedUp();
 }
 
 void ConsoleProcess::setZombie()
@@ -749,6 +793,7 @@ core::system::ProcessCallbacks ConsoleProcess::createProcessCallbacks()
    cb.onContinue = boost::bind(&ConsoleProcess::onContinue, ConsoleProcess::shared_from_this(), _1);
    cb.onStdout = boost::bind(&ConsoleProcess::onStdout, ConsoleProcess::shared_from_this(), _1, _2);
    cb.onExit = boost::bind(&ConsoleProcess::onExit, ConsoleProcess::shared_from_this(), _1);
+   cb.isOutputPaused = boost::bind(&ConsoleProcess::isOutputPaused, ConsoleProcess::shared_from_this());
    if (options_.reportHasSubprocs)
    {
       cb.onHasSubprocs = boost::bind(&ConsoleProcess::onHasSubprocs, ConsoleProcess::shared_from_this(), _1, _2);
@@ -912,6 +957,7 @@ ConsoleProcessSocketConnectionCallbacks ConsoleProcess::createConsoleProcessSock
    cb.onReceivedInput = boost::bind(&ConsoleProcess::onReceivedInput, ConsoleProcess::shared_from_this(), _1);
    cb.onConnectionOpened = boost::bind(&ConsoleProcess::onConnectionOpened, ConsoleProcess::shared_from_this());
    cb.onConnectionClosed = boost::bind(&ConsoleProcess::onConnectionClosed, ConsoleProcess::shared_from_this());
+   cb.onReceivedAck = boost::bind(&ConsoleProcess::onReceivedAck, ConsoleProcess::shared_from_this(), _1);
    return cb;
 }
 
@@ -936,11 +982,19 @@ void ConsoleProcess::onReceivedInput(const std::string& input)
 void ConsoleProcess::onConnectionClosed()
 {
    s_terminalSocket.stopListening(handle());
+   socketOutput_.reset();
 }
 
 // websocket connection opened; called on different thread
 void ConsoleProcess::onConnectionOpened()
 {
+   socketOutput_.reset();
+}
+
+// client wrote output to the terminal; called on different thread
+void ConsoleProcess::onReceivedAck(int packets)
+{
+   socketOutput_.acknowledge(packets);
 }
 
 void ConsoleProcess::saveEnvironment(const std::string& env)
@@ -17,6 +17,7 @@
 
 #include <core/system/System.hpp>
 #include <core/text/TermBufferParser.hpp>
+#include <core/text/TermScreen.hpp>
 
 #include "session-config.h"
 
@@ -111,6 +112,13 @@ void ConsoleProcessInfo::appendToOutputBuffer(const std::string &str)
          core::text::stripSecondaryBuffer(str, &altBufferActive_);
 
    console_persist::appendToOutputBuffer(handle_, mainBufferStr);
+
+   // keep the screen model current (if it doesn't exist yet it's built from
+   // the saved buffer, which now includes this output)
+   if (pScreen_)
+      pScreen_->write(mainBufferStr);
+   else
+      screen();
 }
 
 void ConsoleProcessInfo::appendToOutputBuffer(char ch)
@@ -121,37 +129,14 @@ void ConsoleProcessInfo::appendToOutputBuffer(char ch)
 std::string ConsoleProcessInfo::getSavedBufferChunk(
       int requestedChunk, bool* pMoreAvailable) const
 {
-   // We read the entire buffer into memory to return a given chunk. This is
-   // ok for our current usage pattern, where the buffer-size is bounded
-   // to a certain number of lines and is infrequently reloaded (only upon
-   // browser refresh or reloading a session). If this pattern becomes
-   // more frequent and/or we support much larger buffers, we'd want to
-   // reconsider this implementation.
-
-   // Read buffer (trims to maxOutputLines_ when chunk zero is requested)
-   std::string buffer = console_persist::getSavedBuffer(
+   // Trims to maxOutputLines_ when chunk zero is requested; the saved
+   // buffer is indexed so the chunk is read without loading the rest of it
+   return console_persist::getSavedBufferChunk(
             handle_,
-            requestedChunk == 0 ? maxOutputLines_ : 0);
-
-   *pMoreAvailable = false;
-
-   // Common case, entire buffer fits in chunk zero
-   if (requestedChunk == 0 && (buffer.length() <= kOutputBufferSize))
-      return buffer;
-
-   // Chunk requested past end of buffer?
-   if (requestedChunk * kOutputBufferSize >= buffer.length())
-      return std::string();
-
-   // Otherwise return substring for the chunk (substr doesn't mind if you ask
-   // for more characters than are available in the string, as long as the
-   // starting position is within the string)
-   std::string chunk = buffer.substr(
-            requestedChunk * kOutputBufferSize, kOutputBufferSize);
-   if (requestedChunk * kOutputBufferSize + chunk.length() < buffer.length())
-      *pMoreAvailable = true;
-
-   return chunk;
+            requestedChunk == 0 ? maxOutputLines_ : 0,
+            requestedChunk,
+            kOutputBufferSize,
+            pMoreAvailable);
 }
 
 std::string ConsoleProcessInfo::getFullSavedBuffer() const
@@ -165,6 +150,35 @@ int ConsoleProcessInfo::getBufferLineCount() const
    return console_persist::getSavedBufferLineCount(handle_, maxOutputLines_);
 }
 
+std::string ConsoleProcessInfo::getScreenSnapshot() const
+{
+   return screen().render();
+}
+
+void ConsoleProcessInfo::setCols(int cols)
+{
+   cols_ = cols;
+   if (pScreen_)
+      pScreen_->resize(cols_, rows_);
+}
+
+void ConsoleProcessInfo::setRows(int rows)
+{
+   rows_ = rows;
+   if (pScreen_)
+      pScreen_->resize(cols_, rows_);
+}
+
+text::TermScreen& ConsoleProcessInfo::screen() const
+{
+   if (!pScreen_)
+   {
+      pScreen_.reset(new text::TermScreen(cols_, rows_, maxOutputLines_));
+      pScreen_->write(console_persist::getSavedBuffer(handle_, maxOutputLines_));
+   }
+   return *pScreen_;
+}
+
 std::string ConsoleProcessInfo::bufferedOutput() const
 {
    boost::circular_buffer<char>::const_iterator pos =
@@ -181,6 +195,9 @@ std::string ConsoleProcessInfo::bufferedOutput() const
 void ConsoleProcessInfo::deleteLogFile(bool lastLineOnly) const
 {
    console_persist::deleteLogFile(handle_, lastLineOnly);
+
+   // rebuilt from what remains of the saved buffer when next needed
+   pScreen_.reset();
 }
 
 void ConsoleProcessInfo::deleteEnvFile() const
@@ -536,6 +536,41 @@ TEST_CASE("ConsoleProcessInfo")
       // cleanup
       cpi.deleteLogFile();
    }
+
+   SECTION("Snapshot the screen for terminals")
+   {
+      const int lines = 10;
+      ConsoleProcessInfo cpi(caption, title, handle1, sequence, shellType,
+                             altActive, cwd, cols, rows, zombie, trackEnv);
+      cpi.setMaxOutputLines(lines);
+
+      // blow away anything that might have been left over from a previous
+      // failed run
+      cpi.deleteLogFile();
+      CHECK(cpi.getScreenSnapshot() == "\r");
+
+      // a progress meter rewriting a single line many times
+      for (int i = 0; i < 1000; i++)
+         cpi.appendToOutputBuffer("\rprogress " + boost::lexical_cast<std::string>(i));
+      CHECK(cpi.getScreenSnapshot() == "progress 999\r\x1b[12C");
+
+      // scrollback is limited to the maximum number of lines
+      for (int i = 0; i < 1000; i++)
+         cpi.appendToOutputBuffer("\r\nline " + boost::lexical_cast<std::string>(i));
+      std::string snapshot = cpi.getScreenSnapshot();
+      CHECK(snapshot.find("line 900\r\n") == std::string::npos);
+      CHECK(snapshot.find("\r\nline 999\r") != std::string::npos);
+
+      // the screen is rebuilt from the saved buffer (e.g. after a restart)
+      ConsoleProcessInfo restored(caption, title, handle1, sequence, shellType,
+                                  altActive, cwd, cols, rows, zombie, trackEnv);
+      restored.setMaxOutputLines(lines);
+      CHECK(restored.getScreenSnapshot().find("\r\nline 999\r") != std::string::npos);
+
+      // cleanup
+      cpi.deleteLogFile();
+      CHECK(cpi.getScreenSnapshot() == "\r");
+   }
 }
 
 } // end namespace tests
@@ -15,7 +15,10 @@
 
 #include <session/SessionConsoleProcessPersist.hpp>
 
+#include <map>
+
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/FileSerializer.hpp>
 
@@ -23,6 +26,8 @@
 #include <session/SessionOptions.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "SessionConsoleProcessScrollback.hpp"
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -51,7 +56,10 @@ namespace console_persist {
 //                Added autoClose, zombie
 // 2017/06/16 - console05 -> console06
 //                Added trackEnv
-#define kConsoleDir "console06"
+// 2026/10/18 - console06 -> console07
+//                Saved buffers are memory mapped ring buffers rather than
+//                plain text logs
+#define kConsoleDir "console07"
 
 namespace {
 
@@ -60,6 +68,10 @@ FilePath s_consoleProcIndexPath;
 bool s_inited = false;
 const std::string s_envFileExt = ".env";
 
+// open scrollback stores, by handle
+typedef std::map<std::string, boost::shared_ptr<ScrollbackStore> > Stores;
+Stores s_stores;
+
 void initialize()
 {
    if (s_inited) return;
@@ -127,6 +139,48 @@ Error getEnvFilePath(const std::string& handle, FilePath* pFile)
    return Success();
 }
 
+// get the scrollback store for the given handle, opening it if necessary.
+// returns an empty pointer if there's no saved buffer and create is false
+boost::shared_ptr<ScrollbackStore> getStore(const std::string& handle,
+                                            bool create)
+{
+   Stores::const_iterator it = s_stores.find(handle);
+   if (it != s_stores.end())
+      return it->second;
+
+   FilePath log;
+   Error error = getLogFilePath(handle, &log);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return boost::shared_ptr<ScrollbackStore>();
+   }
+
+   if (!create && !log.exists())
+      return boost::shared_ptr<ScrollbackStore>();
+
+   boost::shared_ptr<ScrollbackStore> pStore(new ScrollbackStore());
+   error = pStore->open(log);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return boost::shared_ptr<ScrollbackStore>();
+   }
+
+   s_stores[handle] = pStore;
+   return pStore;
+}
+
+void closeStore(const std::string& handle)
+{
+   Stores::iterator it = s_stores.find(handle);
+   if (it != s_stores.end())
+   {
+      it->second->close();
+      s_stores.erase(it);
+   }
+}
+
 } // anonymous namespace
 
 std::string loadConsoleProcessMetadata()
@@ -160,71 +214,75 @@ void saveConsoleProcesses(const std::string& metadata)
 
 std::string getSavedBuffer(const std::string& handle, int maxLines)
 {
-   std::string content;
-   FilePath log;
+   boost::shared_ptr<ScrollbackStore> pStore = getStore(handle, false);
+   if (!pStore)
+      return std::string();
 
-   Error error = getLogFilePath(handle, &log);
-   if (error)
-   {
-      LOG_ERROR(error);
-      return content;
-   }
+   // Trim the buffer based on maxLines. Otherwise it can grow (up to the
+   // capacity of the store) until the terminal is closed or cleared.
+   if (maxLines > 0)
+      pStore->trimLines(maxLines);
 
-   if (!log.exists())
-   {
-      return "";
-   }
+   return pStore->readAll();
+}
 
-   error = core::readStringFromFile(log, &content);
-   if (error)
-   {
-      LOG_ERROR(error);
-      return content;
-   }
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                std::size_t chunkSize,
+                                bool* pMoreAvailable)
+{
+   *pMoreAvailable = false;
 
-   if (maxLines < 1)
-      return content;
+   boost::shared_ptr<ScrollbackStore> pStore = getStore(handle, false);
+   if (!pStore || chunk < 0)
+      return std::string();
 
-   // Trim the buffer based on maxLines. Otherwise it can grow without
-   // bound until the terminal is closed or cleared.
-   std::string trimmedOutput = content;
-   if (string_utils::trimLeadingLines(maxLines, &trimmedOutput))
-   {
-      error = core::writeStringToFile(log, trimmedOutput);
-      if (error)
-      {
-          LOG_ERROR(error);
-          return content;
-      }
-   }
-   return trimmedOutput;
+   if (maxLines > 0)
+      pStore->trimLines(maxLines);
+
+   std::size_t offset = static_cast<std::size_t>(chunk) * chunkSize;
+   std::string result = pStore->read(offset, chunkSize);
+   if (offset + result.length() < pStore->size())
+      *pMoreAvailable = true;
+   return result;
 }
 
 int getSavedBufferLineCount(const std::string& handle, int maxLines)
 {
-   std::string buffer = getSavedBuffer(handle, maxLines);
-   return static_cast<int>(string_utils::countNewlines(buffer) + 1);
+   boost::shared_ptr<ScrollbackStore> pStore = getStore(handle, false);
+   if (!pStore)
+      return 1;
+
+   if (maxLines > 0)
+      pStore->trimLines(maxLines);
+
+   return static_cast<int>(pStore->lineCount());
 }
 
 void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
-   if (error)
-   {
-      LOG_ERROR(error);
+   if (buffer.empty())
       return;
-   }
 
-   error = rstudio::core::appendToFile(log, buffer);
-   if (error)
-   {
-      LOG_ERROR(error);
-   }
+   boost::shared_ptr<ScrollbackStore> pStore = getStore(handle, true);
+   if (pStore)
+      pStore->append(buffer);
 }
 
 void deleteLogFile(const std::string &handle, bool lastLineOnly)
 {
+   if (lastLineOnly)
+   {
+      // remove the last line; if there's no complete line in the buffer
+      // just blow it away
+      boost::shared_ptr<ScrollbackStore> pStore = getStore(handle, false);
+      if (!pStore || pStore->truncateToLastLine())
+         return;
+   }
+
+   closeStore(handle);
+
    FilePath log;
    Error error = getLogFilePath(handle, &log);
    if (error)
@@ -233,47 +291,9 @@ void deleteLogFile(const std::string &handle, bool lastLineOnly)
       return;
    }
 
-   if (!log.exists())
-      return;
-
-   if (!lastLineOnly)
-   {
-      // blow away the file
-      error = log.removeIfExists();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-   }
-   else
-   {
-      // read the file, remove last line and rewrite buffer
-      std::string content;
-      error = core::readStringFromFile(log, &content);
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-
-      size_t lastNewline = content.find_last_of('\n');
-
-      // no complete line in buffer, just blow it away
-      if (lastNewline == std::string::npos)
-      {
-         deleteLogFile(handle, false);
-         return;
-      }
-
-      // erase everything after the final newline
-      content.erase(++lastNewline);
-      error = core::writeStringToFile(log, content);
-      if (error)
-      {
-          LOG_ERROR(error);
-      }
-   }
+   error = log.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
 }
 
 void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
@@ -299,6 +319,7 @@ void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
 
       if (!validHandle(child.stem()))
       {
+         closeStore(child.filename());
          error = child.remove();
          if (error)
             LOG_ERROR(error);
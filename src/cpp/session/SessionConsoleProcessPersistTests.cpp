@@ -170,6 +170,37 @@ TEST_CASE("ConsoleProcess Persistence")
       CHECK((loaded.compare(expect) == 0));
    }
 
+   SECTION("Read a buffer in chunks")
+   {
+      std::stringstream ss;
+      for (size_t i = 0; i < maxLines * 2; i++)
+      {
+         ss << i << '\n';
+      }
+      console_persist::appendToOutputBuffer(handle2, ss.str());
+
+      // chunk zero trims the buffer, as getSavedBuffer does
+      const size_t chunkSize = 1000;
+      bool moreAvailable = false;
+      std::string chunks = console_persist::getSavedBufferChunk(
+               handle2, maxLines, 0, chunkSize, &moreAvailable);
+      CHECK((chunks.length() == chunkSize));
+      CHECK(moreAvailable);
+
+      int chunk = 1;
+      while (moreAvailable)
+      {
+         chunks.append(console_persist::getSavedBufferChunk(
+                          handle2, 0, chunk++, chunkSize, &moreAvailable));
+      }
+
+      std::string loaded = console_persist::getSavedBuffer(handle2, maxLines);
+      CHECK((chunks.compare(loaded) == 0));
+      CHECK(console_persist::getSavedBufferChunk(
+               handle2, 0, chunk, chunkSize, &moreAvailable).empty());
+      CHECK_FALSE(moreAvailable);
+   }
+
    SECTION("Delete unknown log files")
    {
       std::string orig1("hello how are you?\nthat is good\nhave a nice day");
@@ -0,0 +1,289 @@
+/*
+ * SessionConsoleProcessScrollback.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleProcessScrollback.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+namespace {
+
+const char kFileMagic[4] = { 'R', 'S', 'S', 'B' };
+const boost::uint32_t kFileVersion = 1;
+
+// the header is padded so that the ring starts on a cache line
+const std::size_t kHeaderSize = 64;
+
+// enough for 100k lines of (escape sequence laden) terminal output; the
+// file is sparse until the terminal has produced that much
+const std::size_t kScrollbackCapacity = 16 * 1024 * 1024;
+
+Error mapError(const FilePath& filePath,
+               const std::exception& e,
+               const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("path", filePath);
+   error.addProperty("what", e.what());
+   return error;
+}
+
+} // anonymous namespace
+
+struct ScrollbackStore::Header
+{
+   char magic[4];
+   boost::uint32_t version;
+   boost::uint64_t capacity;
+
+   // positions of the first retained byte and of the byte following the
+   // last one
+   boost::uint64_t begin;
+   boost::uint64_t end;
+};
+
+const std::size_t ScrollbackStore::kDefaultCapacity = kScrollbackCapacity;
+
+ScrollbackStore::~ScrollbackStore()
+{
+   try
+   {
+      close();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error ScrollbackStore::open(const FilePath& filePath, std::size_t capacity)
+{
+   close();
+   filePath_ = filePath;
+
+   // map an existing store
+   if (filePath_.exists())
+   {
+      try
+      {
+         file_.open(filePath_.absolutePath(),
+                    boost::iostreams::mapped_file::readwrite);
+      }
+      catch(const std::exception& e)
+      {
+         LOG_ERROR(mapError(filePath_, e, ERROR_LOCATION));
+      }
+
+      if (file_.is_open() && file_.size() >= kHeaderSize)
+      {
+         const Header* pHeader = reinterpret_cast<const Header*>(file_.data());
+         if (std::memcmp(pHeader->magic, kFileMagic, sizeof(kFileMagic)) == 0 &&
+             pHeader->version == kFileVersion &&
+             pHeader->capacity > 0 &&
+             pHeader->capacity == file_.size() - kHeaderSize &&
+             pHeader->begin <= pHeader->end &&
+             pHeader->end - pHeader->begin <= pHeader->capacity)
+         {
+            pHeader_ = reinterpret_cast<Header*>(file_.data());
+            pData_ = file_.data() + kHeaderSize;
+            capacity_ = static_cast<std::size_t>(pHeader_->capacity);
+            indexNewlines();
+            return Success();
+         }
+      }
+
+      // not a store we can use (e.g. a torn create); start over
+      close();
+      Error error = filePath_.removeIfExists();
+      if (error)
+         return error;
+   }
+
+   // create a new store
+   try
+   {
+      boost::iostreams::mapped_file_params params(filePath_.absolutePath());
+      params.flags = boost::iostreams::mapped_file::readwrite;
+      params.new_file_size = kHeaderSize + capacity;
+      file_.open(params);
+   }
+   catch(const std::exception& e)
+   {
+      close();
+      return mapError(filePath_, e, ERROR_LOCATION);
+   }
+
+   pHeader_ = reinterpret_cast<Header*>(file_.data());
+   pData_ = file_.data() + kHeaderSize;
+   capacity_ = capacity;
+
+   std::memcpy(pHeader_->magic, kFileMagic, sizeof(kFileMagic));
+   pHeader_->version = kFileVersion;
+   pHeader_->capacity = capacity;
+   pHeader_->begin = 0;
+   pHeader_->end = 0;
+
+   return Success();
+}
+
+void ScrollbackStore::close()
+{
+   pHeader_ = NULL;
+   pData_ = NULL;
+   capacity_ = 0;
+   newlines_.clear();
+   if (file_.is_open())
+      file_.close();
+}
+
+void ScrollbackStore::append(const std::string& output)
+{
+   if (!isOpen() || output.empty())
+      return;
+
+   const char* pOutput = output.data();
+   std::size_t length = output.size();
+   boost::uint64_t end = pHeader_->end + length;
+
+   // only the most recent output fits
+   if (length > capacity_)
+   {
+      pOutput += length - capacity_;
+      length = capacity_;
+   }
+   boost::uint64_t position = end - length;
+
+   // copy into the ring, wrapping around if necessary
+   std::size_t offset = static_cast<std::size_t>(position % capacity_);
+   std::size_t first = std::min(length, capacity_ - offset);
+   std::memcpy(pData_ + offset, pOutput, first);
+   std::memcpy(pData_, pOutput + first, length - first);
+
+   const char* pNewline = pOutput;
+   const char* pEnd = pOutput + length;
+   while ((pNewline = static_cast<const char*>(
+              std::memchr(pNewline, '\n', pEnd - pNewline))) != NULL)
+   {
+      newlines_.push_back(position + (pNewline - pOutput));
+      ++pNewline;
+   }
+
+   // when output is overwritten drop the (now partial) line it was part of
+   boost::uint64_t begin = pHeader_->begin;
+   if (end - begin > capacity_)
+   {
+      begin = end - capacity_;
+      while (!newlines_.empty() && newlines_.front() < begin)
+         newlines_.pop_front();
+      if (!newlines_.empty())
+         begin = newlines_.front();
+   }
+
+   setBounds(begin, end);
+}
+
+std::size_t ScrollbackStore::size() const
+{
+   if (!isOpen())
+      return 0;
+   return static_cast<std::size_t>(pHeader_->end - pHeader_->begin);
+}
+
+std::string ScrollbackStore::read(std::size_t offset, std::size_t length) const
+{
+   std::size_t available = size();
+   if (offset >= available)
+      return std::string();
+   length = std::min(length, available - offset);
+
+   std::string result(length, '\0');
+   std::size_t index =
+         static_cast<std::size_t>((pHeader_->begin + offset) % capacity_);
+   std::size_t first = std::min(length, capacity_ - index);
+   std::memcpy(&result[0], pData_ + index, first);
+   std::memcpy(&result[0] + first, pData_, length - first);
+   return result;
+}
+
+bool ScrollbackStore::trimLines(int maxLines)
+{
+   if (!isOpen() || maxLines < 1)
+      return false;
+
+   std::size_t lines = static_cast<std::size_t>(maxLines);
+   if (size() <= lines * 2 || newlines_.size() <= lines)
+      return false;
+
+   // keep the newline ending the last dropped line
+   std::size_t drop = newlines_.size() - lines - 1;
+   boost::uint64_t begin = newlines_[drop];
+   newlines_.erase(newlines_.begin(), newlines_.begin() + drop);
+   setBounds(begin, pHeader_->end);
+   return true;
+}
+
+bool ScrollbackStore::truncateToLastLine()
+{
+   if (!isOpen() || newlines_.empty())
+      return false;
+
+   setBounds(pHeader_->begin, newlines_.back() + 1);
+   return true;
+}
+
+void ScrollbackStore::setBounds(boost::uint64_t begin, boost::uint64_t end)
+{
+   pHeader_->begin = begin;
+   pHeader_->end = end;
+}
+
+void ScrollbackStore::indexNewlines()
+{
+   newlines_.clear();
+
+   boost::uint64_t position = pHeader_->begin;
+   while (position < pHeader_->end)
+   {
+      // scan up to the end of the buffer or of the ring, whichever is first
+      std::size_t index = static_cast<std::size_t>(position % capacity_);
+      std::size_t length = static_cast<std::size_t>(
+               std::min<boost::uint64_t>(pHeader_->end - position,
+                                         capacity_ - index));
+
+      const char* pStart = pData_ + index;
+      const char* pEnd = pStart + length;
+      const char* pNewline = pStart;
+      while ((pNewline = static_cast<const char*>(
+                 std::memchr(pNewline, '\n', pEnd - pNewline))) != NULL)
+      {
+         newlines_.push_back(position + (pNewline - pStart));
+         ++pNewline;
+      }
+
+      position += length;
+   }
+}
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
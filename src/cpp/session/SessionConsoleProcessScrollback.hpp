@@ -0,0 +1,109 @@
+/*
+ * SessionConsoleProcessScrollback.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
+#define SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
+
+#include <deque>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+// Scrollback for a terminal, kept in a fixed-size memory mapped file used
+// as a ring buffer. Bytes are addressed by their (ever increasing) position
+// in the terminal's output; the file holds the most recent output between
+// the begin and end positions recorded in its header. The positions of the
+// retained newlines are indexed in memory (rebuilt when the file is opened)
+// so that trimming to a number of lines, counting lines and reading a range
+// of the buffer don't require scanning it. Appends are copied straight into
+// the mapping and written back to disk by the kernel.
+class ScrollbackStore : boost::noncopyable
+{
+public:
+   // default capacity, in bytes, of newly created stores
+   static const std::size_t kDefaultCapacity;
+
+   ScrollbackStore() : pHeader_(NULL), pData_(NULL), capacity_(0) {}
+   ~ScrollbackStore();
+
+   // open (creating with the given capacity if necessary) the store at the
+   // given path. an existing file which isn't a valid store is replaced
+   core::Error open(const core::FilePath& filePath,
+                    std::size_t capacity = kDefaultCapacity);
+   void close();
+
+   bool isOpen() const { return pData_ != NULL; }
+
+   // add output to the end of the buffer, dropping the oldest output if
+   // the buffer is full
+   void append(const std::string& output);
+
+   // number of bytes in the buffer
+   std::size_t size() const;
+
+   // number of lines in the buffer (newlines + 1)
+   std::size_t lineCount() const { return newlines_.size() + 1; }
+
+   // read up to length bytes starting at the given offset into the buffer
+   std::string read(std::size_t offset, std::size_t length) const;
+   std::string readAll() const { return read(0, size()); }
+
+   // drop leading lines so that at most maxLines remain (the retained
+   // output starts with the newline which ended the last dropped line).
+   // as with string_utils::trimLeadingLines, nothing is dropped unless the
+   // buffer holds more than twice maxLines bytes. returns true if the
+   // buffer was trimmed
+   bool trimLines(int maxLines);
+
+   // drop everything following the last newline; returns false (leaving
+   // the buffer alone) if the buffer holds no newlines
+   bool truncateToLastLine();
+
+private:
+   struct Header;
+
+   void setBounds(boost::uint64_t begin, boost::uint64_t end);
+   void indexNewlines();
+
+private:
+   core::FilePath filePath_;
+   boost::iostreams::mapped_file file_;
+   Header* pHeader_;
+   char* pData_;
+   std::size_t capacity_;
+
+   // positions of the newlines in the buffer, in order
+   std::deque<boost::uint64_t> newlines_;
+};
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_PROCESS_SCROLLBACK_HPP
@@ -0,0 +1,187 @@
+/*
+ * SessionConsoleProcessScrollbackTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleProcessScrollback.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <sstream>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/StringUtils.hpp>
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempStorePath
+{
+public:
+   TempStorePath()
+   {
+      FilePath::tempFilePath(&path_);
+   }
+
+   ~TempStorePath()
+   {
+      path_.removeIfExists();
+   }
+
+   const FilePath& path() const { return path_; }
+
+private:
+   FilePath path_;
+};
+
+std::string numberedLines(std::size_t first, std::size_t count)
+{
+   std::ostringstream ostr;
+   for (std::size_t i = first; i < first + count; i++)
+      ostr << i << '\n';
+   return ostr.str();
+}
+
+} // anonymous namespace
+
+TEST_CASE("ConsoleProcess Scrollback")
+{
+   TempStorePath temp;
+
+   SECTION("Append and read back output")
+   {
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path()));
+
+      std::string output("hello\nworld\nno newline");
+      store.append(output);
+      CHECK(store.size() == output.size());
+      CHECK(store.lineCount() == 3);
+      CHECK(store.readAll() == output);
+      CHECK(store.read(6, 5) == "world");
+      CHECK(store.read(15, 100) == "newline");
+      CHECK(store.read(100, 5).empty());
+   }
+
+   SECTION("Output is retained when the store is reopened")
+   {
+      std::string output = numberedLines(0, 100);
+      {
+         ScrollbackStore store;
+         REQUIRE(!store.open(temp.path(), 256));
+         store.append(output);
+      }
+
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path(), 256));
+      std::string expect = store.readAll();
+      CHECK(expect.size() <= 256);
+      CHECK(string_utils::countNewlines(expect) + 1 == store.lineCount());
+      CHECK(output.substr(output.size() - expect.size()) == expect);
+   }
+
+   SECTION("Trimming matches trimming the full output")
+   {
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path()));
+
+      std::string output = numberedLines(0, 2000);
+      store.append(output);
+
+      std::string expect = output;
+      string_utils::trimLeadingLines(1000, &expect);
+      CHECK(store.trimLines(1000));
+      CHECK(store.readAll() == expect);
+      CHECK(store.lineCount() == string_utils::countNewlines(expect) + 1);
+
+      // appending after trimming continues the buffer
+      store.append("more");
+      CHECK(store.readAll() == expect + "more");
+   }
+
+   SECTION("Old output is dropped a line at a time when the ring wraps")
+   {
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path(), 1000));
+
+      std::string output;
+      for (std::size_t i = 0; i < 50; i++)
+      {
+         std::string lines = numberedLines(i * 20, 20);
+         store.append(lines);
+         output.append(lines);
+      }
+
+      std::string retained = store.readAll();
+      CHECK(retained.size() <= 1000);
+      CHECK(retained[0] == '\n');
+      CHECK(output.substr(output.size() - retained.size()) == retained);
+      CHECK(store.lineCount() == string_utils::countNewlines(retained) + 1);
+
+      // chunks read across the end of the ring
+      std::string chunks;
+      for (std::size_t offset = 0; offset < store.size(); offset += 64)
+         chunks.append(store.read(offset, 64));
+      CHECK(chunks == retained);
+   }
+
+   SECTION("Output larger than the store keeps its tail")
+   {
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path(), 100));
+
+      std::string output(250, 'x');
+      store.append(output);
+      CHECK(store.readAll() == std::string(100, 'x'));
+      CHECK(store.lineCount() == 1);
+   }
+
+   SECTION("Truncate to the last line")
+   {
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path()));
+
+      store.append("partial");
+      CHECK_FALSE(store.truncateToLastLine());
+      CHECK(store.readAll() == "partial");
+
+      store.append("\nprompt> ");
+      CHECK(store.truncateToLastLine());
+      CHECK(store.readAll() == "partial\n");
+   }
+
+   SECTION("A file which isn't a store is replaced")
+   {
+      REQUIRE(!writeStringToFile(temp.path(), "plain text log\n"));
+
+      ScrollbackStore store;
+      REQUIRE(!store.open(temp.path()));
+      CHECK(store.size() == 0);
+      store.append("new");
+      CHECK(store.readAll() == "new");
+   }
+}
+
+} // end namespace tests
+} // end namespace console_process
+} // end namespace session
+} // end namespace rstudio
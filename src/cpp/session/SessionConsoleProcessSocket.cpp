@@ -325,10 +325,16 @@ void ConsoleProcessSocket::onMessage(terminalServer* s,
    ConsoleProcessSocketConnectionDetails details = connections_.get(handle);
 
    std::string payload = msg->get_payload();
+   int packets = 0;
    if (ConsoleProcessSocketPacket::isKeepAlive(payload))
    {
       sendPong(handle);
    }
+   else if (ConsoleProcessSocketPacket::isAck(payload, &packets))
+   {
+      if (details.connectionCallbacks_.onReceivedAck)
+         details.connectionCallbacks_.onReceivedAck(packets);
+   }
    else if (details.connectionCallbacks_.onReceivedInput)
    {
       details.connectionCallbacks_.onReceivedInput(ConsoleProcessSocketPacket::getMessage(payload));
@@ -0,0 +1,191 @@
+/*
+ * SessionConsoleProcessSocketOutput.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionConsoleProcessSocketOutput.hpp>
+
+#include <algorithm>
+
+#include <core/Error.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+namespace {
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+// the length of the longest prefix of the first maxLength bytes of text
+// which doesn't end part way through a UTF-8 sequence (websocket text
+// frames must be valid UTF-8)
+std::size_t utf8PrefixLength(const std::string& text, std::size_t maxLength)
+{
+   std::size_t length = std::min(maxLength, text.length());
+
+   // look back (over at most three continuation bytes) for the lead byte
+   // of the final sequence
+   for (std::size_t back = 1; back <= 4 && back <= length; ++back)
+   {
+      unsigned char ch = static_cast<unsigned char>(text[length - back]);
+      if ((ch & 0xC0) == 0x80)
+         continue;
+
+      std::size_t sequenceLength = 1;
+      if ((ch & 0xE0) == 0xC0)
+         sequenceLength = 2;
+      else if ((ch & 0xF0) == 0xE0)
+         sequenceLength = 3;
+      else if ((ch & 0xF8) == 0xF0)
+         sequenceLength = 4;
+
+      return sequenceLength > back ? length - back : length;
+   }
+
+   // not UTF-8; nothing to be gained by holding any of it back
+   return length;
+}
+
+} // anonymous namespace
+
+const boost::posix_time::time_duration ConsoleProcessSocketOutput::kFrameInterval =
+      boost::posix_time::milliseconds(10);
+const std::size_t ConsoleProcessSocketOutput::kMaxFrameBytes = 64 * 1024;
+const int ConsoleProcessSocketOutput::kMaxUnackedFrames = 8;
+const std::size_t ConsoleProcessSocketOutput::kMaxPendingBytes = 4 * 64 * 1024;
+
+ConsoleProcessSocketOutput::ConsoleProcessSocketOutput(const SendFunction& send)
+   : send_(send),
+     unackedFrames_(0),
+     clientAcks_(false)
+{
+}
+
+void ConsoleProcessSocketOutput::append(const std::string& output)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      pending_.append(output);
+      sendFrames();
+   }
+   END_LOCK_MUTEX
+}
+
+void ConsoleProcessSocketOutput::sendDue()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      sendFrames();
+   }
+   END_LOCK_MUTEX
+}
+
+void ConsoleProcessSocketOutput::acknowledge(int frames)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      clientAcks_ = true;
+      unackedFrames_ = std::max(0, unackedFrames_ - frames);
+      sendFrames();
+   }
+   END_LOCK_MUTEX
+}
+
+void ConsoleProcessSocketOutput::reset()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      unackedFrames_ = 0;
+      clientAcks_ = false;
+   }
+   END_LOCK_MUTEX
+}
+
+std::string ConsoleProcessSocketOutput::takePending()
+{
+   std::string pending;
+   LOCK_MUTEX(mutex_)
+   {
+      pending.swap(pending_);
+   }
+   END_LOCK_MUTEX
+   return pending;
+}
+
+bool ConsoleProcessSocketOutput::hasPending() const
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return !pending_.empty();
+   }
+   END_LOCK_MUTEX
+   return false;
+}
+
+bool ConsoleProcessSocketOutput::isBackedUp() const
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return pending_.length() >= kMaxPendingBytes;
+   }
+   END_LOCK_MUTEX
+   return false;
+}
+
+void ConsoleProcessSocketOutput::sendFrames()
+{
+   while (!pending_.empty())
+   {
+      // wait for the client to catch up
+      if (clientAcks_ && unackedFrames_ >= kMaxUnackedFrames)
+         return;
+
+      // hold partial frames until the frame interval has passed
+      boost::posix_time::ptime time = now();
+      if (pending_.length() < kMaxFrameBytes &&
+          !lastFrameTime_.is_not_a_date_time() &&
+          time - lastFrameTime_ < kFrameInterval)
+      {
+         return;
+      }
+
+      std::size_t length = utf8PrefixLength(pending_, kMaxFrameBytes);
+      if (length == 0)
+         return;
+
+      Error error = send_(pending_.substr(0, length));
+      if (error)
+      {
+         // nobody is listening; the output is in the saved buffer which is
+         // sent when the client reconnects
+         pending_.clear();
+         unackedFrames_ = 0;
+         return;
+      }
+
+      pending_.erase(0, length);
+      lastFrameTime_ = time;
+      ++unackedFrames_;
+   }
+}
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,195 @@
+/*
+ * SessionConsoleProcessSocketOutputTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionConsoleProcessSocketOutput.hpp>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <core/Error.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+using namespace rstudio::core;
+
+namespace {
+
+class Client
+{
+public:
+   Client() : connected_(true) {}
+
+   Error receive(const std::string& frame)
+   {
+      if (!connected_)
+         return systemError(boost::system::errc::not_connected, ERROR_LOCATION);
+      frames_.push_back(frame);
+      return Success();
+   }
+
+   ConsoleProcessSocketOutput::SendFunction sendFunction()
+   {
+      return boost::bind(&Client::receive, this, _1);
+   }
+
+   std::string received() const
+   {
+      std::string output;
+      for (std::size_t i = 0; i < frames_.size(); ++i)
+         output.append(frames_[i]);
+      return output;
+   }
+
+   std::vector<std::string> frames_;
+   bool connected_;
+};
+
+void waitForFrameInterval()
+{
+   boost::this_thread::sleep(ConsoleProcessSocketOutput::kFrameInterval +
+                             boost::posix_time::milliseconds(5));
+}
+
+} // anonymous namespace
+
+context("output for terminal websockets")
+{
+   test_that("output after a quiet period is sent immediately")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      output.append("$ ");
+      expect_true(client.frames_.size() == 1);
+
+      waitForFrameInterval();
+      output.append("l");
+      expect_true(client.frames_.size() == 2);
+      expect_true(client.received() == "$ l");
+   }
+
+   test_that("output arriving together is coalesced")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      output.append("first\n");
+      for (int i = 0; i < 100; ++i)
+         output.append("more\n");
+      expect_true(client.frames_.size() == 1);
+
+      // nothing goes out until the frame interval has passed
+      output.sendDue();
+      expect_true(client.frames_.size() == 1);
+      expect_true(output.hasPending());
+
+      waitForFrameInterval();
+      output.sendDue();
+      expect_true(client.frames_.size() == 2);
+      expect_true(client.frames_[1].size() == 500);
+      expect_false(output.hasPending());
+   }
+
+   test_that("frames are bounded in size")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      std::size_t size = ConsoleProcessSocketOutput::kMaxFrameBytes * 5 / 2;
+      output.append(std::string(size, 'x'));
+      expect_true(client.frames_.size() == 2);
+      expect_true(client.frames_[0].size() == ConsoleProcessSocketOutput::kMaxFrameBytes);
+
+      waitForFrameInterval();
+      output.sendDue();
+      expect_true(client.frames_.size() == 3);
+      expect_true(client.received() == std::string(size, 'x'));
+   }
+
+   test_that("UTF-8 sequences are not split between frames")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      // "é" is 0xC3 0xA9
+      output.append("caf\xC3");
+      expect_true(client.received() == "caf");
+
+      waitForFrameInterval();
+      output.append("\xA9!");
+      expect_true(client.received() == "caf\xC3\xA9!");
+   }
+
+   test_that("clients which acknowledge output are flow controlled")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      output.append("hello");
+      output.acknowledge(1);
+
+      std::size_t frameBytes = ConsoleProcessSocketOutput::kMaxFrameBytes;
+      int maxFrames = ConsoleProcessSocketOutput::kMaxUnackedFrames;
+      output.append(std::string(frameBytes * (maxFrames + 2), 'x'));
+      expect_true(client.frames_.size() == 1 + static_cast<std::size_t>(maxFrames));
+      expect_false(output.isBackedUp());
+
+      output.append(std::string(ConsoleProcessSocketOutput::kMaxPendingBytes, 'y'));
+      expect_true(output.isBackedUp());
+
+      // acknowledgements let more output through
+      output.acknowledge(maxFrames);
+      expect_false(output.isBackedUp());
+      expect_true(client.received().size() ==
+                  5 + frameBytes * (maxFrames + 2) +
+                  ConsoleProcessSocketOutput::kMaxPendingBytes);
+   }
+
+   test_that("clients which don't acknowledge output are not flow controlled")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      std::size_t size = ConsoleProcessSocketOutput::kMaxPendingBytes * 2;
+      output.append(std::string(size, 'x'));
+      expect_false(output.isBackedUp());
+      expect_true(client.received().size() == size);
+   }
+
+   test_that("output is dropped when nobody is listening")
+   {
+      Client client;
+      ConsoleProcessSocketOutput output(client.sendFunction());
+
+      client.connected_ = false;
+      output.append("lost");
+      expect_true(output.takePending().empty());
+
+      client.connected_ = true;
+      waitForFrameInterval();
+      output.append("found");
+      expect_true(client.received() == "found");
+   }
+}
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
@@ -15,12 +15,15 @@
 
 #include <session/SessionConsoleProcessSocketPacket.hpp>
 
+#include <core/SafeConvert.hpp>
+
 namespace rstudio {
 namespace session {
 namespace console_process {
 
 const std::string ConsoleProcessSocketPacket::kKeepAlivePrefix = "b";
 const std::string ConsoleProcessSocketPacket::kTextPrefix = "a";
+const std::string ConsoleProcessSocketPacket::kAckPrefix = "c";
 
 /* static */
 std::string ConsoleProcessSocketPacket::textPacket(const std::string& text)
@@ -53,6 +56,27 @@ std::string ConsoleProcessSocketPacket::getMessage(const std::string& text)
    }
 }
 
+/* static */
+std::string ConsoleProcessSocketPacket::ackPacket(int packets)
+{
+   return kAckPrefix + core::safe_convert::numberToString(packets);
+}
+
+/* static */
+bool ConsoleProcessSocketPacket::isAck(const std::string& text, int* pPackets)
+{
+   if (text.compare(0, kAckPrefix.length(), kAckPrefix))
+      return false;
+
+   int packets = core::safe_convert::stringTo<int>(
+            text.substr(kAckPrefix.length()), -1);
+   if (packets < 0)
+      return false;
+
+   *pPackets = packets;
+   return true;
+}
+
 } // namespace console_process
 } // namespace session
 } // namespace rstudio
@@ -35,7 +35,10 @@
 #include <core/json/Json.hpp>
 #include <core/json/JsonRpc.hpp>
 
+#include <core/Thread.hpp>
+
 #include <core/system/Crypto.hpp>
+#include <core/system/Process.hpp>
 
 #include <core/text/TemplateFilter.hpp>
 
@@ -74,6 +77,11 @@ std::vector<std::string> s_waitForMethodNames;
 // url for next session
 std::string s_nextSessionUrl;
 
+// set (on the process supervisor's background thread) when child processes
+// have output or exit events pending
+boost::mutex s_childActivityMutex;
+bool s_childActivity = false;
+
 boost::posix_time::ptime timeoutTimeFromNow()
 {
    int timeoutMinutes = options().timeoutMinutes();
@@ -162,6 +170,34 @@ bool isMethod(boost::shared_ptr<HttpConnection> ptrConnection,
    return isMethod(ptrConnection->request().uri(), method);
 }
 
+void onChildActivity()
+{
+   LOCK_MUTEX(s_childActivityMutex)
+   {
+      s_childActivity = true;
+   }
+   END_LOCK_MUTEX
+
+   // stop waiting for a connection so that the children are polled
+   httpConnectionListener().mainConnectionQueue().wake();
+}
+
+// poll child processes if they have events pending (returns true if they did)
+bool pollActiveChildren()
+{
+   bool activity = false;
+   LOCK_MUTEX(s_childActivityMutex)
+   {
+      activity = s_childActivity;
+      s_childActivity = false;
+   }
+   END_LOCK_MUTEX
+
+   if (activity)
+      module_context::processSupervisor().poll();
+   return activity;
+}
+
 Error startHttpConnectionListener()
 {
    initializeHttpConnectionListener();
@@ -169,6 +205,10 @@ Error startHttpConnectionListener()
    if (error)
       return error;
 
+   // poll child processes as soon as they have events pending rather than
+   // only during background processing
+   module_context::processSupervisor().setActivityHandler(onChildActivity);
+
    if (options().standalone())
    {
       // log the endpoint to which we have bound to so other services can discover us
@@ -250,6 +290,9 @@ void polledEventHandler()
       return;
    }
 
+   // child processes with events pending are serviced straight away
+   pollActiveChildren();
+
    // static lastPerformed value used for throttling
    using namespace boost::posix_time;
    static ptime s_lastPerformed;
@@ -426,6 +469,7 @@ bool waitForMethod(const std::string& method,
    boost::posix_time::ptime timeoutTime = timeoutTimeFromNow();
    boost::posix_time::time_duration connectionQueueTimeout =
                                    boost::posix_time::milliseconds(50);
+   boost::posix_time::ptime lastBackgroundProcessing;
 
    // wait until we get the method we are looking for
    while(true)
@@ -470,14 +514,24 @@ bool waitForMethod(const std::string& method,
       if (main_process::haveActiveChildren())
          timeoutTime = timeoutTimeFromNow();
 
-      // look for a connection (waiting for the specified interval)
+      // look for a connection (waiting for the specified interval, or until
+      // child processes have events pending)
       boost::shared_ptr<HttpConnection> ptrConnection =
           httpConnectionListener().mainConnectionQueue().dequeConnection(
                                             connectionQueueTimeout);
 
+      // child processes which woke us are serviced straight away; the rest
+      // of background processing still happens at the usual interval
+      if (!ptrConnection && pollActiveChildren() &&
+          boost::posix_time::microsec_clock::universal_time() <
+                     lastBackgroundProcessing + connectionQueueTimeout)
+      {
+         continue;
+      }
 
       // perform background processing (true for isIdle)
       module_context::onBackgroundProcessing(true);
+      lastBackgroundProcessing = boost::posix_time::microsec_clock::universal_time();
 
       // process pending events
       processEvents();
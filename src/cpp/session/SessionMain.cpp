@@ -65,6 +65,7 @@
 #include <core/system/Crypto.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/Environment.hpp>
+#include <core/system/ProcessArgs.hpp>
 #include <core/system/ParentProcessMonitor.hpp>
 
 #include <core/system/FileMonitor.hpp>
@@ -101,6 +102,7 @@
 #include <session/RVersionSettings.hpp>
 
 #include "SessionAddins.hpp"
+#include "SessionAsyncRWorkerPool.hpp"
 
 #include "SessionModuleContextInternal.hpp"
 
@@ -113,6 +115,7 @@
 #include "SessionMainProcess.hpp"
 #include "SessionRpc.hpp"
 #include "SessionSuspend.hpp"
+#include "SessionTemplate.hpp"
 
 #include <session/SessionRUtil.hpp>
 #include <session/SessionPackageProvidedExtension.hpp>
@@ -574,6 +577,7 @@ Error rInit(const rstudio::r::session::RInitInfo& rInitInfo)
 
       // workers
       (workers::web_request::initialize)
+      (async_r::initializeWorkerPool)
 
       // R code
       (bind(sourceModuleRFile, "SessionCodeTools.R"))
@@ -1034,6 +1038,7 @@ void rSuspended(const rstudio::r::session::RSuspendOptions& options)
 
    // fire event
    module_context::onSuspended(options, &(persistentState().settings()));
+   persistentState().flush();
 }
    
 void rResumed()
@@ -1157,6 +1162,9 @@ void rCleanup(bool terminatedNormally)
       // fire shutdown event to modules
       module_context::events().onShutdown(terminatedNormally);
 
+      // write any pending persistent state
+      rsession::persistentState().flush();
+
       // destroy session if requested
       if (s_destroySession)
       {
@@ -1620,6 +1628,32 @@ int main (int argc, char * const argv[])
 {
    try
    {
+#ifdef RSTUDIO_SERVER
+      // sessions pre-started by the server wait here (before doing anything
+      // which depends on the user) to be claimed for a user, and then carry
+      // on with the arguments they would have been launched with
+      if (session_template::isTemplate())
+      {
+         bool claimed = false;
+         std::vector<std::string> claimArgs;
+         Error error = session_template::waitForClaim(&claimed, &claimArgs);
+         if (error)
+         {
+            initializeSystemLog("rsession-template",
+                                core::system::kLogLevelWarning);
+            LOG_ERROR(error);
+            return EXIT_FAILURE;
+         }
+         if (!claimed)
+            return EXIT_SUCCESS;
+
+         static core::system::ProcessArgs* s_pClaimArgs =
+                                 new core::system::ProcessArgs(claimArgs);
+         argc = static_cast<int>(s_pClaimArgs->argCount());
+         argv = s_pClaimArgs->args();
+      }
+#endif
+
       // initialize log so we capture all errors including ones which occur
       // reading the config file (if we are in desktop mode then the log
       // will get re-initialized below)
@@ -38,7 +38,18 @@ namespace session {
 namespace {
 const char * const kActiveClientId = "active-client-id";
 const char * const kAbend = "abend";
+
+// longest time a change to the (write-behind) scoped settings may go
+// unwritten
+const int kMaxStalenessSeconds = 5;
+
+bool flushStaleSettings()
+{
+   persistentState().settings().flushIfStale();
+   return true;
 }
+
+} // anonymous namespace
    
 PersistentState& persistentState()
 {
@@ -62,12 +73,27 @@ Error PersistentState::initialize()
    if (error)
       return error;
 
+   // the scoped settings are changed often (e.g. stored hashes and the
+   // active environment) so coalesce their writes. the session settings
+   // hold the client id and abend flag, which must be written as soon as
+   // they change
+   settings_.setWriteBehind(boost::posix_time::seconds(kMaxStalenessSeconds));
+   module_context::schedulePeriodicWork(boost::posix_time::seconds(1),
+                                        flushStaleSettings,
+                                        false);
+
    // session settings
    scratchPath = module_context::sessionScratchPath();
    statePath = scratchPath.complete("session-persistent-state");
    return sessionSettings_.initialize(statePath);
 }
 
+void PersistentState::flush()
+{
+   settings_.flush();
+   sessionSettings_.flush();
+}
+
 std::string PersistentState::activeClientId()
 {
    if (serverMode_)
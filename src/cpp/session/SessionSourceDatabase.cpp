@@ -46,10 +46,9 @@
 #include <session/SessionModuleContext.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "SessionSourceDatabaseJournal.hpp"
 #include "SessionSourceDatabaseSupervisor.hpp"
 
-#define kContentsSuffix "-contents"
-
 // NOTE: if a file is deleted then its properties database entry is not
 // deleted. this has two implications:
 //
@@ -81,6 +80,10 @@ namespace {
 // lookup)
 std::map<std::string, std::string> s_idToPath;
 
+// durable properties last written for each path (so unchanged properties
+// aren't rewritten on every put)
+std::map<std::string, std::string> s_durableProperties;
+
 struct PropertiesDatabase
 {
    FilePath path;
@@ -578,7 +581,7 @@ Error SourceDocument::writeToFile(const FilePath& filePath, bool writeContents)
    if (writeContents)
    {
       FilePath contentsPath(filePath.absolutePath() + kContentsSuffix);
-      Error error = writeStringToFile(contentsPath, contents_);
+      Error error = supervisor::writeDatabaseFile(contentsPath, contents_);
       if (error)
          return error;
    }
@@ -590,7 +593,7 @@ Error SourceDocument::writeToFile(const FilePath& filePath, bool writeContents)
    // write properties to file
    std::ostringstream oss;
    json::writeFormatted(jsonProperties, oss);
-   Error error = writeStringToFile(filePath, oss.str());
+   Error error = supervisor::writeDatabaseFile(filePath, oss.str());
    return error;
 }
 
@@ -642,9 +645,10 @@ Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceD
 {
    FilePath propertiesPath = source_database::path().complete(id);
    
-   // attempt to read file contents from sidecar file if available
+   // attempt to read file contents from the journal, or the sidecar file if
+   // available
    std::string contents;
-   if (includeContents)
+   if (includeContents && !journal::getContents(id, &contents))
    {
       FilePath contentsPath(propertiesPath.absolutePath() + kContentsSuffix);
       if (contentsPath.exists())
@@ -657,6 +661,18 @@ Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceD
       }
    }
    
+   // use properties from the journal if they haven't been written yet
+   json::Object jsonDoc;
+   if (journal::getProperties(id, &jsonDoc))
+   {
+      if (includeContents)
+         jsonDoc["contents"] = contents;
+      else
+         jsonDoc["contents"] = std::string();
+
+      return pDoc->readFromJson(&jsonDoc);
+   }
+
    if (propertiesPath.exists())
    {
       // read the contents of the file
@@ -676,7 +692,7 @@ Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceD
       }
       
       // initialize doc from json
-      json::Object jsonDoc = value.get_obj();
+      jsonDoc = value.get_obj();
       
       // migration: if we have a 'contents' field, but no '-contents' side-car
       // file, perform a one-time generation of that sidecar file from contents
@@ -714,7 +730,9 @@ bool isSourceDocument(const FilePath& filePath)
        filename == "lock_file" ||
        filename == "suspend_file" ||
        filename == "restart_file" ||
-       boost::algorithm::ends_with(filename, kContentsSuffix))
+       journal::isJournalFile(filePath) ||
+       boost::algorithm::ends_with(filename, kContentsSuffix) ||
+       boost::algorithm::ends_with(filename, kTemporarySuffix))
    {
       return false;
    }
@@ -793,7 +811,7 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
 Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs)
 {
    std::vector<FilePath> files ;
-   Error error = source_database::path().children(&files);
+   Error error = source_database::list(&files);
    if (error)
       return error ;
    
@@ -827,29 +845,63 @@ Error list(std::vector<FilePath>* pPaths)
       return error;
    
    // filter to actual source documents
+   std::vector<FilePath> paths;
    core::algorithm::copy_if(
             children.begin(),
             children.end(),
-            std::back_inserter(*pPaths),
+            std::back_inserter(paths),
             isSourceDocument);
-   
+
+   // add documents which so far have only been journaled
+   std::vector<std::string> journaled;
+   journal::listDocuments(&journaled);
+   BOOST_FOREACH(const std::string& id, journaled)
+   {
+      FilePath filePath = source_database::path().complete(id);
+      if (std::find(paths.begin(), paths.end(), filePath) == paths.end())
+         paths.push_back(filePath);
+   }
+
+   pPaths->insert(pPaths->end(), paths.begin(), paths.end());
    return Success();
 }
    
 Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents)
 {   
-   // write to file
-   FilePath filePath = source_database::path().complete(pDoc->id());
-   Error error = pDoc->writeToFile(filePath, writeContents);
+   Error error;
+   if (journal::attached())
+   {
+      // journal the change (it's written to the database on compaction)
+      json::Object jsonProperties;
+      pDoc->writeToJson(&jsonProperties, false);
+      error = journal::put(pDoc->id(),
+                           jsonProperties,
+                           writeContents ? &pDoc->contents() : NULL);
+   }
+   else
+   {
+      // write to file
+      FilePath filePath = source_database::path().complete(pDoc->id());
+      error = pDoc->writeToFile(filePath, writeContents);
+   }
    if (error)
       return error ;
 
-   // write properties to durable storage (if there is a path)
+   // write properties to durable storage (if there is a path and they've
+   // changed since we last wrote them)
    if (!pDoc->path().empty())
    {
-      error = putProperties(pDoc->path(), pDoc->properties());
-      if (error)
-         LOG_ERROR(error);
+      std::ostringstream ostr;
+      json::write(pDoc->properties(), ostr);
+      std::string& written = s_durableProperties[pDoc->path()];
+      if (ostr.str() != written)
+      {
+         error = putProperties(pDoc->path(), pDoc->properties());
+         if (error)
+            LOG_ERROR(error);
+         else
+            written = ostr.str();
+      }
    }
 
    return Success();
@@ -857,13 +909,21 @@ Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents)
    
 Error remove(const std::string& id)
 {
+   Error error = journal::remove(id);
+   if (error)
+      LOG_ERROR(error);
+
    return source_database::path().complete(id).removeIfExists();
 }
    
 Error removeAll()
 {
+   Error error = journal::removeAll();
+   if (error)
+      LOG_ERROR(error);
+
    std::vector<FilePath> files ;
-   Error error = source_database::path().children(&files);
+   error = source_database::path().children(&files);
    if (error)
       return error ;
    
@@ -959,7 +1019,13 @@ namespace {
 
 void onQuit()
 {
-   Error error = supervisor::saveMostRecentDocuments();
+   // compact the journal first so the documents can be shared (rather
+   // than rewritten) when they are saved
+   Error error = journal::detach();
+   if (error)
+      LOG_ERROR(error);
+
+   error = supervisor::saveMostRecentDocuments();
    if (error)
       LOG_ERROR(error);
 
@@ -970,9 +1036,22 @@ void onQuit()
 
 void onSuspend(const r::session::RSuspendOptions& options, core::Settings*)
 {
+   Error error = journal::compact();
+   if (error)
+      LOG_ERROR(error);
+
    supervisor::suspendSourceDatabase(options.status);
 }
 
+bool compactJournal()
+{
+   Error error = journal::compact();
+   if (error)
+      LOG_ERROR(error);
+
+   return true;
+}
+
 void onResume(const Settings&)
 {
    supervisor::resumeSourceDatabase();
@@ -1043,6 +1122,11 @@ Error initialize()
    if (error)
       return error;
 
+   // recover any changes journaled by a session which didn't exit cleanly
+   error = journal::attach(supervisor::sessionDirPath());
+   if (error)
+      LOG_ERROR(error);
+
    RS_REGISTER_CALL_METHOD(rs_getDocumentProperties, 2);
 
    events().onDocUpdated.connect(onDocUpdated);
@@ -1055,6 +1139,12 @@ Error initialize()
    module_context::addSuspendHandler(
          module_context::SuspendHandler(onSuspend, onResume));
 
+   // write journaled changes to the database periodically
+   module_context::schedulePeriodicWork(boost::posix_time::minutes(5),
+                                        compactJournal,
+                                        true,
+                                        false);
+
    return Success();
 }
 
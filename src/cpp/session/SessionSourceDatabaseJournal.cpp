@@ -0,0 +1,587 @@
+/*
+ * SessionSourceDatabaseJournal.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceDatabaseJournal.hpp"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <map>
+#include <sstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+
+#include "SessionSourceDatabaseSupervisor.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace journal {
+
+namespace {
+
+const char * const kJournalFile = "journal";
+
+// compact once the journal is this large
+const boost::uint64_t kMaxJournalSize = 4 * 1024 * 1024;
+
+// record types
+const char kGroup = 'G';
+const char kContentsRecord = 'C';
+const char kEditRecord = 'E';
+const char kPropertiesRecord = 'P';
+const char kRemoveRecord = 'R';
+
+struct Document
+{
+   Document()
+      : hasContents(false), contentsPending(false), propertiesPending(false)
+   {
+   }
+
+   // the contents are kept until the document is next compacted (so edits
+   // to them can be journaled)
+   std::string contents;
+   std::string hash;
+   bool hasContents;
+   bool contentsPending;
+
+   json::Object properties;
+   bool propertiesPending;
+};
+
+FilePath s_sessionDir;
+FilePath s_journalPath;
+boost::shared_ptr<std::ostream> s_pJournal;
+boost::uint64_t s_journalSize = 0;
+std::map<std::string, Document> s_documents;
+
+FilePath contentsPath(const std::string& id)
+{
+   return s_sessionDir.complete(id + kContentsSuffix);
+}
+
+FilePath propertiesPath(const std::string& id)
+{
+   return s_sessionDir.complete(id);
+}
+
+void setContents(Document* pDoc, const std::string& contents)
+{
+   pDoc->contents = contents;
+   pDoc->hash = hash::crc32Hash(contents);
+   pDoc->hasContents = true;
+}
+
+// load a document's contents from the database (if they aren't known).
+// they're read exactly as they were written, since edits are hashed and
+// applied against the contents as put (whatever their line endings)
+void ensureContents(const std::string& id, Document* pDoc)
+{
+   if (pDoc->hasContents)
+      return;
+
+   FilePath filePath = contentsPath(id);
+   if (!filePath.exists())
+      return;
+
+   std::string contents;
+   Error error = readStringFromFile(filePath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   setContents(pDoc, contents);
+}
+
+void writeRecord(char type,
+                 const std::string& id,
+                 const std::string& fields,
+                 const std::string& payload,
+                 std::ostream& os)
+{
+   os << type << " " << id;
+   if (!fields.empty())
+      os << " " << fields;
+   os << " " << payload.size() << "\n" << payload;
+}
+
+// write the record for a change to a document's contents
+void writeContentsRecord(const std::string& id,
+                         const Document& doc,
+                         const std::string& contents,
+                         std::ostream& os)
+{
+   if (doc.hasContents)
+   {
+      // find the edited range: everything between the common prefix and
+      // the common suffix of the old and new contents
+      const std::string& previous = doc.contents;
+      std::size_t maxCommon = std::min(previous.size(), contents.size());
+
+      std::size_t prefix = 0;
+      while (prefix < maxCommon && previous[prefix] == contents[prefix])
+         prefix++;
+
+      std::size_t suffix = 0;
+      while (suffix < maxCommon - prefix &&
+             previous[previous.size() - suffix - 1] ==
+                contents[contents.size() - suffix - 1])
+      {
+         suffix++;
+      }
+
+      std::size_t length = previous.size() - prefix - suffix;
+      std::string replacement = contents.substr(
+                                 prefix, contents.size() - prefix - suffix);
+
+      // journal the edit unless it's most of the document
+      if (replacement.size() < contents.size() / 2)
+      {
+         std::ostringstream fields;
+         fields << doc.hash << " " << prefix << " " << length;
+         writeRecord(kEditRecord, id, fields.str(), replacement, os);
+         return;
+      }
+   }
+
+   writeRecord(kContentsRecord, id, std::string(), contents, os);
+}
+
+// flush what's been written to the file (or directory) to disk
+Error syncPath(const FilePath& path)
+{
+#ifndef _WIN32
+   int fd = ::open(path.absolutePath().c_str(), O_RDONLY);
+   if (fd == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", path);
+      return error;
+   }
+
+   int result;
+   do
+   {
+      result = ::fsync(fd);
+   } while (result == -1 && errno == EINTR);
+
+   Error error;
+   if (result == -1)
+   {
+      error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", path);
+   }
+
+   ::close(fd);
+   return error;
+#else
+   return Success();
+#endif
+}
+
+Error openJournal(bool truncate)
+{
+   s_pJournal.reset();
+   Error error = s_journalPath.open_w(&s_pJournal, truncate);
+   if (error)
+      return error;
+
+   s_journalSize = truncate ? 0 : s_journalPath.size();
+   return Success();
+}
+
+Error appendGroup(const std::string& records)
+{
+   if (!s_pJournal)
+   {
+      Error error = openJournal(false);
+      if (error)
+         return error;
+   }
+
+   // write the group (and its records) in one go
+   std::ostringstream group;
+   group << kGroup << " " << records.size() << " "
+         << hash::crc32HexHash(records) << "\n" << records;
+   std::string data = group.str();
+
+   s_pJournal->write(data.data(), data.size());
+   s_pJournal->flush();
+   if (!s_pJournal->good())
+   {
+      s_pJournal.reset();
+      Error error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", s_journalPath);
+      return error;
+   }
+
+   // the put isn't in the database yet, so it's only safe once the group
+   // is on disk
+   Error error = syncPath(s_journalPath);
+   if (error)
+      return error;
+
+   s_journalSize += data.size();
+   if (s_journalSize > kMaxJournalSize)
+   {
+      error = compact();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   return Success();
+}
+
+// read a header line ("<type> <fields>\n") at the given position
+bool readHeader(const std::string& data,
+                std::size_t* pPos,
+                char* pType,
+                std::istringstream* pFields)
+{
+   std::size_t end = data.find('\n', *pPos);
+   if (end == std::string::npos || end == *pPos)
+      return false;
+
+   *pType = data[*pPos];
+   pFields->str(data.substr(*pPos + 1, end - *pPos - 1));
+   pFields->clear();
+   *pPos = end + 1;
+   return true;
+}
+
+bool readPayload(const std::string& data,
+                 std::size_t* pPos,
+                 std::size_t size,
+                 std::string* pPayload)
+{
+   if (size > data.size() - *pPos)
+      return false;
+
+   *pPayload = data.substr(*pPos, size);
+   *pPos += size;
+   return true;
+}
+
+// apply the records of a group to the documents
+bool replayRecords(const std::string& records)
+{
+   std::size_t pos = 0;
+   while (pos < records.size())
+   {
+      char type;
+      std::istringstream fields;
+      if (!readHeader(records, &pos, &type, &fields))
+         return false;
+
+      std::string id;
+      fields >> id;
+      if (id.empty())
+         return false;
+
+      if (type == kRemoveRecord)
+      {
+         s_documents.erase(id);
+         propertiesPath(id).removeIfExists();
+         continue;
+      }
+
+      std::string hash;
+      std::size_t offset = 0, length = 0, size = 0;
+      if (type == kEditRecord)
+         fields >> hash >> offset >> length;
+      fields >> size;
+
+      std::string payload;
+      if (fields.fail() || !readPayload(records, &pos, size, &payload))
+         return false;
+
+      Document& doc = s_documents[id];
+      if (type == kContentsRecord)
+      {
+         setContents(&doc, payload);
+         doc.contentsPending = true;
+      }
+      else if (type == kEditRecord)
+      {
+         // only apply the edit to the contents it was made to (the edit
+         // may already be in the database, if the journal was being
+         // compacted when the session ended)
+         ensureContents(id, &doc);
+         if (doc.hasContents && doc.hash == hash &&
+             offset + length <= doc.contents.size())
+         {
+            std::string contents = doc.contents;
+            contents.replace(offset, length, payload);
+            setContents(&doc, contents);
+            doc.contentsPending = true;
+         }
+      }
+      else if (type == kPropertiesRecord)
+      {
+         json::Value value;
+         if (json::parse(payload, &value) && json::isType<json::Object>(value))
+         {
+            doc.properties = value.get_obj();
+            doc.propertiesPending = true;
+         }
+      }
+      else
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+Error replay()
+{
+   std::string data;
+   Error error = readStringFromFile(s_journalPath, &data);
+   if (error)
+      return error;
+
+   // replay complete groups (stopping at one torn by a crash)
+   std::size_t pos = 0;
+   while (pos < data.size())
+   {
+      char type;
+      std::istringstream fields;
+      std::size_t size = 0;
+      std::string crc, records;
+      if (!readHeader(data, &pos, &type, &fields) ||
+          type != kGroup ||
+          !(fields >> size >> crc) ||
+          !readPayload(data, &pos, size, &records) ||
+          hash::crc32HexHash(records) != crc)
+      {
+         LOG_WARNING_MESSAGE("Dropping incomplete source database journal "
+                             "entries from " + s_journalPath.absolutePath());
+         break;
+      }
+
+      if (!replayRecords(records))
+      {
+         LOG_WARNING_MESSAGE("Invalid source database journal entry in " +
+                             s_journalPath.absolutePath());
+         break;
+      }
+   }
+
+   return Success();
+}
+
+} // anonymous namespace
+
+Error attach(const FilePath& sessionDir)
+{
+   s_sessionDir = sessionDir;
+   s_journalPath = sessionDir.complete(kJournalFile);
+   s_documents.clear();
+   s_pJournal.reset();
+
+   // recover changes journaled by a session which didn't exit cleanly
+   if (s_journalPath.exists() && s_journalPath.size() > 0)
+   {
+      Error error = replay();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   // write them to the database, leaving an empty journal
+   return compact();
+}
+
+Error detach()
+{
+   if (!attached())
+      return Success();
+
+   Error error = compact();
+   s_pJournal.reset();
+   s_documents.clear();
+   s_sessionDir = FilePath();
+   return error;
+}
+
+bool attached()
+{
+   return !s_sessionDir.empty();
+}
+
+bool isJournalFile(const FilePath& filePath)
+{
+   return filePath.filename() == kJournalFile;
+}
+
+Error put(const std::string& id,
+          const json::Object& propertiesJson,
+          const std::string* pContents)
+{
+   Document& doc = s_documents[id];
+
+   // (the contents of a compacted document are read back so the change to
+   // them can be journaled as an edit)
+   if (pContents)
+      ensureContents(id, &doc);
+
+   std::ostringstream records;
+   if (pContents && (!doc.hasContents || doc.contents != *pContents))
+   {
+      writeContentsRecord(id, doc, *pContents, records);
+      setContents(&doc, *pContents);
+      doc.contentsPending = true;
+   }
+
+   std::ostringstream propertiesOs;
+   json::write(propertiesJson, propertiesOs);
+   writeRecord(kPropertiesRecord, id, std::string(), propertiesOs.str(), records);
+   doc.properties = propertiesJson;
+   doc.propertiesPending = true;
+
+   return appendGroup(records.str());
+}
+
+bool getProperties(const std::string& id, json::Object* pPropertiesJson)
+{
+   std::map<std::string, Document>::const_iterator it = s_documents.find(id);
+   if (it == s_documents.end() || !it->second.propertiesPending)
+      return false;
+
+   *pPropertiesJson = it->second.properties;
+   return true;
+}
+
+bool getContents(const std::string& id, std::string* pContents)
+{
+   std::map<std::string, Document>::const_iterator it = s_documents.find(id);
+   if (it == s_documents.end() || !it->second.hasContents)
+      return false;
+
+   *pContents = it->second.contents;
+   return true;
+}
+
+void listDocuments(std::vector<std::string>* pIds)
+{
+   for (std::map<std::string, Document>::const_iterator it = s_documents.begin();
+        it != s_documents.end();
+        ++it)
+   {
+      if (it->second.propertiesPending)
+         pIds->push_back(it->first);
+   }
+}
+
+Error remove(const std::string& id)
+{
+   std::map<std::string, Document>::iterator it = s_documents.find(id);
+   if (it == s_documents.end())
+      return Success();
+
+   // if the document has journaled changes then record its removal (so
+   // they aren't replayed)
+   bool pending = it->second.contentsPending || it->second.propertiesPending;
+   s_documents.erase(it);
+   if (!pending)
+      return Success();
+
+   std::ostringstream records;
+   records << kRemoveRecord << " " << id << "\n";
+   return appendGroup(records.str());
+}
+
+Error removeAll()
+{
+   s_documents.clear();
+   s_pJournal.reset();
+   s_journalSize = 0;
+   return s_journalPath.removeIfExists();
+}
+
+Error compact()
+{
+   if (!attached())
+      return Success();
+
+   bool written = false;
+   for (std::map<std::string, Document>::iterator it = s_documents.begin();
+        it != s_documents.end();
+        ++it)
+   {
+      Document& doc = it->second;
+      if (doc.contentsPending)
+      {
+         FilePath filePath = contentsPath(it->first);
+         Error error = supervisor::writeDatabaseFile(filePath, doc.contents);
+         if (!error)
+            error = syncPath(filePath);
+         if (error)
+            return error;
+         doc.contentsPending = false;
+         written = true;
+      }
+
+      if (doc.propertiesPending)
+      {
+         std::ostringstream oss;
+         json::writeFormatted(doc.properties, oss);
+         FilePath filePath = propertiesPath(it->first);
+         Error error = supervisor::writeDatabaseFile(filePath, oss.str());
+         if (!error)
+            error = syncPath(filePath);
+         if (error)
+            return error;
+         doc.propertiesPending = false;
+         written = true;
+      }
+   }
+
+   // the renames into place must be on disk before the journal is emptied
+   if (written)
+   {
+      Error error = syncPath(s_sessionDir);
+      if (error)
+         return error;
+   }
+
+   // everything journaled is now in the database, so the documents' contents
+   // needn't be held any longer (they're read back if the document is put
+   // again)
+   s_documents.clear();
+
+   return openJournal(true);
+}
+
+} // namespace journal
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,93 @@
+/*
+ * SessionSourceDatabaseJournal.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_DATABASE_JOURNAL_HPP
+#define SESSION_SOURCE_DATABASE_JOURNAL_HPP
+
+#include <string>
+#include <vector>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace journal {
+
+// An append-only journal of changes to the documents in the session's
+// source database directory.
+//
+// Rather than rewriting a document's contents and properties files each
+// time it is put, the change is appended to the journal: the edit made to
+// the contents (or the full contents, for a document with none in the
+// database yet) and the document's properties. The records for a put are
+// appended together as one checksummed group, so a group torn by a crash
+// is dropped whole when the journal is replayed. Each group is synced to
+// disk before the put returns.
+//
+// The journal is compacted into the usual contents and properties files
+// when it grows large, periodically when the session is idle, and on
+// suspend and quit (after which the documents' contents are no longer
+// held in memory). A journal left behind by a session which didn't exit
+// cleanly is replayed (and compacted) when the directory is attached.
+// Replaying is idempotent, since each edit records the hash of the
+// contents it applies to.
+
+// attach to the session's source database directory (replaying any
+// journal left in it)
+core::Error attach(const core::FilePath& sessionDir);
+
+// compact and close the journal
+core::Error detach();
+
+bool attached();
+
+bool isJournalFile(const core::FilePath& filePath);
+
+// journal a put of the document (pContents is NULL if the contents
+// haven't changed)
+core::Error put(const std::string& id,
+                const core::json::Object& propertiesJson,
+                const std::string* pContents);
+
+// get the document's properties or contents if they are known to the
+// journal (returns false if they should be read from the database)
+bool getProperties(const std::string& id, core::json::Object* pPropertiesJson);
+bool getContents(const std::string& id, std::string* pContents);
+
+// list the documents whose properties haven't been compacted yet
+void listDocuments(std::vector<std::string>* pIds);
+
+core::Error remove(const std::string& id);
+
+// forget all documents and remove the journal
+core::Error removeAll();
+
+// write the journaled changes to the database and empty the journal
+core::Error compact();
+
+} // namespace journal
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_DATABASE_JOURNAL_HPP
@@ -0,0 +1,274 @@
+/*
+ * SessionSourceDatabaseJournalTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceDatabaseJournal.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+#include "SessionSourceDatabaseSupervisor.hpp"
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace journal {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempSessionDir
+{
+public:
+   TempSessionDir()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempSessionDir()
+   {
+      detach();
+      dir_.removeIfExists();
+   }
+
+   const FilePath& path() const { return dir_; }
+   FilePath journalPath() const { return dir_.complete("journal"); }
+
+   std::string contents(const std::string& id) const
+   {
+      std::string contents;
+      readStringFromFile(dir_.complete(id + kContentsSuffix), &contents);
+      return contents;
+   }
+
+   json::Object properties(const std::string& id) const
+   {
+      std::string contents;
+      readStringFromFile(dir_.complete(id), &contents);
+
+      json::Value value;
+      if (!json::parse(contents, &value) || !json::isType<json::Object>(value))
+         return json::Object();
+      return value.get_obj();
+   }
+
+   std::string journal() const
+   {
+      std::string contents;
+      readStringFromFile(journalPath(), &contents);
+      return contents;
+   }
+
+private:
+   FilePath dir_;
+};
+
+json::Object properties(int version)
+{
+   json::Object properties;
+   properties["version"] = version;
+   return properties;
+}
+
+int version(const json::Object& properties)
+{
+   json::Object::const_iterator it = properties.find("version");
+   if (it == properties.end() || !json::isType<int>(it->second))
+      return -1;
+   return it->second.get_int();
+}
+
+// a document long enough that a small change to it is journaled as an edit
+std::string document(const std::string& lineEnding = "\n")
+{
+   std::string contents;
+   for (int i = 0; i < 50; i++)
+      contents += "line " + safe_convert::numberToString(i) + lineEnding;
+   return contents;
+}
+
+// attach again without detaching, as a session which crashed would
+void crashAndReattach(const TempSessionDir& dir)
+{
+   REQUIRE(!attach(dir.path()));
+}
+
+} // anonymous namespace
+
+TEST_CASE("Source Database Journal")
+{
+   TempSessionDir dir;
+   REQUIRE(!attach(dir.path()));
+
+   SECTION("Puts are replayed when the journal is left behind")
+   {
+      std::string original = document();
+      std::string edited = original;
+      edited.insert(20, "inserted ");
+
+      REQUIRE(!put("a", properties(1), &original));
+      REQUIRE(!put("a", properties(2), &edited));
+      REQUIRE(!put("b", properties(1), &original));
+
+      // nothing has been compacted yet
+      CHECK_FALSE(dir.path().complete("a").exists());
+
+      crashAndReattach(dir);
+      CHECK(dir.contents("a") == edited);
+      CHECK(version(dir.properties("a")) == 2);
+      CHECK(dir.contents("b") == original);
+      CHECK(dir.journal().empty());
+   }
+
+   SECTION("Torn groups are dropped whole")
+   {
+      std::string original = document();
+      std::string edited = original;
+      edited.replace(100, 4, "LINE");
+
+      REQUIRE(!put("a", properties(1), &original));
+      std::size_t intactSize = dir.journal().size();
+      REQUIRE(!put("a", properties(2), &edited));
+
+      // lose the end of the last group
+      std::string journal = dir.journal();
+      REQUIRE(journal.size() > intactSize + 10);
+      REQUIRE(!writeStringToFile(dir.journalPath(), journal.substr(0, journal.size() - 10)));
+
+      crashAndReattach(dir);
+      CHECK(dir.contents("a") == original);
+      CHECK(version(dir.properties("a")) == 1);
+   }
+
+   SECTION("Groups with a bad checksum aren't replayed")
+   {
+      std::string original = document();
+      REQUIRE(!put("a", properties(1), &original));
+      std::size_t intactSize = dir.journal().size();
+      REQUIRE(!put("a", properties(2), NULL));
+
+      // corrupt the properties of the last group (keeping its size)
+      std::string journal = dir.journal();
+      std::size_t pos = journal.find("\"version\":2", intactSize);
+      REQUIRE(pos != std::string::npos);
+      journal[pos + 10] = '3';
+      REQUIRE(!writeStringToFile(dir.journalPath(), journal));
+
+      crashAndReattach(dir);
+      CHECK(version(dir.properties("a")) == 1);
+   }
+
+   SECTION("Edits already in the database aren't applied again")
+   {
+      std::string original = document();
+      std::string edited = original;
+      edited.insert(20, "inserted ");
+
+      REQUIRE(!put("a", properties(1), &original));
+      REQUIRE(!compact());
+      REQUIRE(!put("a", properties(2), &edited));
+      std::string journal = dir.journal();
+      CHECK(journal.find("\nE a ") != std::string::npos);
+
+      // the session ends after compacting but before the journal was
+      // emptied
+      REQUIRE(!compact());
+      REQUIRE(!writeStringToFile(dir.journalPath(), journal));
+
+      crashAndReattach(dir);
+      CHECK(dir.contents("a") == edited);
+      CHECK(version(dir.properties("a")) == 2);
+
+      // and replaying the same journal again changes nothing
+      REQUIRE(!writeStringToFile(dir.journalPath(), journal));
+      crashAndReattach(dir);
+      CHECK(dir.contents("a") == edited);
+   }
+
+   SECTION("Edits replay against contents with any line endings")
+   {
+      std::string original = document("\r\n");
+      std::string edited = original;
+      edited.insert(30, "inserted ");
+
+      REQUIRE(!put("a", properties(1), &original));
+      REQUIRE(!compact());
+      REQUIRE(!put("a", properties(2), &edited));
+      CHECK(dir.journal().find("\nE a ") != std::string::npos);
+
+      crashAndReattach(dir);
+      CHECK(dir.contents("a") == edited);
+   }
+
+   SECTION("Compaction writes the database and empties the journal")
+   {
+      std::string original = document();
+      REQUIRE(!put("a", properties(1), &original));
+      REQUIRE(!put("b", properties(1), &original));
+
+      std::vector<std::string> ids;
+      listDocuments(&ids);
+      CHECK(ids.size() == 2);
+
+      REQUIRE(!compact());
+      CHECK(dir.journal().empty());
+      CHECK(dir.contents("a") == original);
+      CHECK(version(dir.properties("b")) == 1);
+
+      // compacted documents are read from the database
+      std::string contents;
+      json::Object propertiesJson;
+      CHECK_FALSE(getContents("a", &contents));
+      CHECK_FALSE(getProperties("a", &propertiesJson));
+      ids.clear();
+      listDocuments(&ids);
+      CHECK(ids.empty());
+
+      // and a later change to them is still journaled as an edit
+      std::string edited = original;
+      edited.insert(40, "inserted ");
+      REQUIRE(!put("a", properties(2), &edited));
+      CHECK(dir.journal().find("\nE a ") != std::string::npos);
+      REQUIRE(getContents("a", &contents));
+      CHECK(contents == edited);
+   }
+
+   SECTION("Removed documents aren't replayed")
+   {
+      std::string original = document();
+      REQUIRE(!put("a", properties(1), &original));
+      REQUIRE(!remove("a"));
+
+      crashAndReattach(dir);
+      CHECK_FALSE(dir.path().complete("a").exists());
+
+      std::vector<std::string> ids;
+      listDocuments(&ids);
+      CHECK(ids.empty());
+   }
+}
+
+} // namespace tests
+} // namespace journal
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
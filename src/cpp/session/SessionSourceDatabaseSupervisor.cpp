@@ -380,6 +380,30 @@ bool reclaimOrphanedSession()
    return false;
 }
 
+// copy a document into another source database directory (sharing its
+// files if it has been written to the session's directory, so that only
+// metadata is written)
+Error copyDocument(boost::shared_ptr<SourceDocument> pDoc,
+                   const FilePath& targetPath)
+{
+   FilePath propertiesPath = sessionDirPath().complete(pDoc->id());
+   FilePath contentsPath(propertiesPath.absolutePath() + kContentsSuffix);
+   if (propertiesPath.exists() && contentsPath.exists())
+   {
+      FilePath targetContentsPath(targetPath.absolutePath() + kContentsSuffix);
+      Error error = core::system::shareFile(contentsPath,
+                                            targetContentsPath);
+      if (!error)
+         error = core::system::shareFile(propertiesPath, targetPath);
+      if (!error)
+         return Success();
+
+      LOG_ERROR(error);
+   }
+
+   return pDoc->writeToFile(targetPath);
+}
+
 Error removeAndRecreate(const FilePath& dir)
 {
    // blow it away if it exists then recreate it
@@ -499,7 +523,7 @@ Error saveMostRecentDocuments()
          FilePath targetDir = pDoc->isUntitled() ? mostRecentDirUntitled :
                                                    mostRecentDir;
 
-         Error error = pDoc->writeToFile(targetDir.childPath(pDoc->id()));
+         Error error = copyDocument(pDoc, targetDir.childPath(pDoc->id()));
          if (error)
             LOG_ERROR(error);
       }
@@ -545,13 +569,13 @@ Error detachFromSourceDatabase()
          if (targetPath.exists())
             targetPath = file_utils::uniqueFilePath(untitledDir);
 
-         error = pDoc->writeToFile(targetPath);
+         error = copyDocument(pDoc, targetPath);
          if (error)
             LOG_ERROR(error);
       }
       else
       {
-         error = pDoc->writeToFile(titledDir.complete(pDoc->id()));
+         error = copyDocument(pDoc, titledDir.complete(pDoc->id()));
          if (error)
             LOG_ERROR(error);
       }
@@ -575,6 +599,16 @@ FilePath sessionDirPath()
          module_context::activeSession().id());
 }
 
+Error writeDatabaseFile(const FilePath& filePath, const std::string& contents)
+{
+   FilePath tempPath(filePath.absolutePath() + kTemporarySuffix);
+   Error error = writeStringToFile(tempPath, contents);
+   if (error)
+      return error;
+
+   return tempPath.move(filePath, FilePath::MoveDirect);
+}
+
 void suspendSourceDatabase(int status)
 {
    // write a sentinel so we can differentiate between a sdb that's orphaned
@@ -16,7 +16,11 @@
 #ifndef SESSION_SOURCE_DATABASE_SUPERVISOR_HPP
 #define SESSION_SOURCE_DATABASE_SUPERVISOR_HPP
 
+#include <string>
+
 #define kSessionSourceDatabasePrefix "sources"
+#define kContentsSuffix "-contents"
+#define kTemporarySuffix "-tmp"
 
 namespace rstudio {
 namespace core {
@@ -42,6 +46,11 @@ void resumeSourceDatabase();
 
 core::FilePath sessionDirPath();
 
+// write a file in the source database. files are replaced rather than
+// written in place, since they may share their data with copies
+core::Error writeDatabaseFile(const core::FilePath& filePath,
+                              const std::string& contents);
+
 } // namespace supervisor
 } // namespace source_database
 } // namespace session
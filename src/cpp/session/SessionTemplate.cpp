@@ -0,0 +1,177 @@
+/*
+ * SessionTemplate.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionTemplate.hpp"
+
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+#include <core/system/Environment.hpp>
+#include <core/system/PosixSystem.hpp>
+#include <core/system/PosixUser.hpp>
+
+#include <core/r_util/RSessionLaunchProfile.hpp>
+
+#include <session/SessionConstants.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace session_template {
+
+namespace {
+
+// read R's default packages so that loading them once we're claimed is
+// served from the page cache (this is the same for every user)
+void preloadDefaultPackages()
+{
+   FilePath libraryPath = FilePath(core::system::getenv("R_HOME"))
+                                                  .childPath("library");
+   if (!libraryPath.exists())
+      return;
+
+   const char* const kPackages[] = { "base", "methods", "datasets", "utils",
+                                     "grDevices", "graphics", "stats" };
+   std::vector<char> buffer(65536);
+   for (std::size_t i = 0; i < sizeof(kPackages) / sizeof(kPackages[0]); i++)
+   {
+      std::string package = kPackages[i];
+      std::vector<FilePath> files;
+      files.push_back(libraryPath.childPath(package + "/R/" + package + ".rdb"));
+      files.push_back(libraryPath.childPath(package + "/R/" + package + ".rdx"));
+      files.push_back(libraryPath.childPath(package + "/libs/" + package + ".so"));
+      for (std::size_t j = 0; j < files.size(); j++)
+      {
+         std::ifstream stream(files[j].absolutePath().c_str(),
+                              std::ios::in | std::ios::binary);
+         while (stream.read(&buffer[0], buffer.size()))
+         {
+         }
+      }
+   }
+}
+
+// read the (single line) handoff message from standard input; an empty
+// message means the server closed the channel without claiming us
+Error readHandoff(std::string* pMessage)
+{
+   char ch;
+   while (true)
+   {
+      ssize_t result = ::read(STDIN_FILENO, &ch, 1);
+      if (result == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         return systemError(errno, ERROR_LOCATION);
+      }
+      else if (result == 0 || ch == '\n')
+      {
+         return Success();
+      }
+
+      pMessage->push_back(ch);
+   }
+}
+
+} // anonymous namespace
+
+bool isTemplate()
+{
+   return !core::system::getenv(kRStudioSessionTemplate).empty();
+}
+
+Error waitForClaim(bool* pClaimed, std::vector<std::string>* pArgs)
+{
+   *pClaimed = false;
+
+   preloadDefaultPackages();
+
+   std::string message;
+   Error error = readHandoff(&message);
+   if (error)
+      return error;
+   if (message.empty())
+      return Success();
+
+   json::Value handoffValue;
+   if (!json::parse(message, &handoffValue) ||
+       !json::isType<json::Object>(handoffValue))
+   {
+      return systemError(boost::system::errc::protocol_error, ERROR_LOCATION);
+   }
+
+   std::string runAsUser;
+   json::Object profileJson;
+   error = json::readObject(handoffValue.get_obj(),
+                            "runAsUser", &runAsUser,
+                            "profile", &profileJson);
+   if (error)
+      return error;
+   r_util::SessionLaunchProfile profile =
+                        r_util::sessionLaunchProfileFromJson(profileJson);
+
+   // standard input was the handoff channel; sessions launched directly
+   // by the server read nothing from it either
+   int fd = ::open("/dev/null", O_RDONLY);
+   if (fd == -1)
+      return systemError(errno, ERROR_LOCATION);
+   if (::dup2(fd, STDIN_FILENO) == -1)
+   {
+      error = systemError(errno, ERROR_LOCATION);
+      ::close(fd);
+      return error;
+   }
+   ::close(fd);
+
+   // we were started as the user the server expected to claim us (with the
+   // launch's limits) so we only need to check that it did
+   if (!runAsUser.empty())
+   {
+      core::system::user::User user;
+      error = core::system::user::currentUser(&user);
+      if (error)
+         return error;
+      if (user.username != runAsUser)
+      {
+         error = systemError(boost::system::errc::permission_denied,
+                             ERROR_LOCATION);
+         error.addProperty("user", runAsUser);
+         return error;
+      }
+   }
+
+   error = core::system::specializeProcess(profile.executablePath,
+                                           std::string(),
+                                           profile.config,
+                                           core::system::ProcessConfigFilter(),
+                                           pArgs);
+   if (error)
+      return error;
+
+   *pClaimed = true;
+   return Success();
+}
+
+} // namespace session_template
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,46 @@
+/*
+ * SessionTemplate.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_TEMPLATE_HPP
+#define SESSION_TEMPLATE_HPP
+
+#include <string>
+#include <vector>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace session_template {
+
+// was this session pre-started by the server's session pool?
+bool isTemplate();
+
+// wait for the server to claim this session, then become the session the
+// server would otherwise have launched (templates are started as the user
+// they'll be claimed for, so this means taking its environment). provides
+// the arguments it would have been launched with; pClaimed is false if the
+// server retired the template instead
+core::Error waitForClaim(bool* pClaimed, std::vector<std::string>* pArgs);
+
+} // namespace session_template
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_TEMPLATE_HPP
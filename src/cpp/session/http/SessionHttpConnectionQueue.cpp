@@ -107,6 +107,17 @@ std::string HttpConnectionQueue::peekNextConnectionUri()
    return std::string();
 }
 
+void HttpConnectionQueue::wake()
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      wakePending_ = true;
+   }
+   END_LOCK_MUTEX
+
+   pWaitCondition_->notify_all();
+}
+
 bool HttpConnectionQueue::waitForConnection(
                      const boost::posix_time::time_duration& waitDuration)
 {
@@ -114,8 +125,13 @@ bool HttpConnectionQueue::waitForConnection(
    try
    {
       unique_lock<mutex> lock(*pMutex_);
-      system_time timeoutTime = get_system_time() + waitDuration;
-      return pWaitCondition_->timed_wait(lock, timeoutTime);
+      if (!wakePending_)
+      {
+         system_time timeoutTime = get_system_time() + waitDuration;
+         pWaitCondition_->timed_wait(lock, timeoutTime);
+      }
+      wakePending_ = false;
+      return !queue_.empty();
    }
    catch(const thread_resource_error& e)
    {
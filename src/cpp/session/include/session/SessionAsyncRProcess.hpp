@@ -37,7 +37,8 @@ enum AsyncRProcessOptions
    R_PROCESS_REDIRECTSTDERR = 1 << 1,
    R_PROCESS_VANILLA        = 1 << 2,
    R_PROCESS_AUGMENTED      = 1 << 3,
-   R_PROCESS_NO_RDATA       = 1 << 4
+   R_PROCESS_NO_RDATA       = 1 << 4,
+   R_PROCESS_POOLED         = 1 << 5  // may run in a pooled worker
 };
 
 inline AsyncRProcessOptions operator | (AsyncRProcessOptions lhs,
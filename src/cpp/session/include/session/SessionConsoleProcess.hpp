@@ -19,6 +19,7 @@
 
 #include <deque>
 
+#include <boost/bind.hpp>
 #include <boost/regex.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -28,6 +29,7 @@
 #include <core/terminal/PrivateCommand.hpp>
 
 #include <session/SessionConsoleProcessSocket.hpp>
+#include <session/SessionConsoleProcessSocketOutput.hpp>
 
 namespace rstudio {
 namespace core {
@@ -190,7 +192,8 @@ public:
    void setRpcMode();
 
    // Get the given (0-based) chunk of the saved buffer; if more is available
-   // after the requested chunk, *pMoreAvailable will be set to true
+   // after the requested chunk, *pMoreAvailable will be set to true. For
+   // terminals the buffer is a snapshot of the screen, sent as one chunk.
    std::string getSavedBufferChunk(int chunk, bool* pMoreAvailable) const;
 
    // Get the full terminal buffer
@@ -218,6 +221,9 @@ private:
 
    std::string bufferedOutput() const;
    void enqueOutputEvent(const std::string& output);
+   void enqueRpcOutputEvent(const std::string& output);
+   core::Error sendSocketOutput(const std::string& output);
+   bool isOutputPaused() const;
    void enquePromptEvent(const std::string& prompt);
    void handleConsolePrompt(core::system::ProcessOperations& ops,
                             const std::string& prompt);
@@ -227,6 +233,7 @@ private:
    ConsoleProcessSocketConnectionCallbacks createConsoleProcessSocketConnectionCallbacks();
    void onConnectionOpened();
    void onConnectionClosed();
+   void onReceivedAck(int packets);
 
    void saveEnvironment(const std::string& env);
    static void loadEnvironment(const std::string& handle, core::system::Options* pEnv);
@@ -279,6 +286,10 @@ private:
 
    // private command handler, used to capture environment variables during terminal idle time
    core::terminal::PrivateCommand envCaptureCmd_;
+
+   // output waiting to be sent over the websocket
+   ConsoleProcessSocketOutput socketOutput_ {
+      boost::bind(&ConsoleProcess::sendSocketOutput, this, _1)};
 };
 
 core::json::Array processesAsJson(SerializationMode serialMode);
@@ -17,6 +17,7 @@
 
 #include <boost/circular_buffer.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/FilePath.hpp>
 #include <core/json/Json.hpp>
@@ -28,6 +29,9 @@
 namespace rstudio {
 namespace core {
    class Error;
+namespace text {
+   class TermScreen;
+}
 }
 }
 
@@ -137,6 +141,11 @@ public:
    std::string getSavedBufferChunk(int chunk, bool* pMoreAvailable) const;
    std::string getFullSavedBuffer() const;
    int getBufferLineCount() const;
+
+   // Output which redraws the terminal's scrollback and screen; its size
+   // depends on what the terminal is showing rather than on how much output
+   // it has produced
+   std::string getScreenSnapshot() const;
    void deleteLogFile(bool lastLineOnly = false) const;
    void deleteEnvFile() const;
    void saveConsoleEnvironment(const core::system::Options& environment);
@@ -175,8 +184,8 @@ public:
    core::FilePath getCwd() const { return cwd_; }
 
    // Last-known terminal dimensions
-   void setCols(int cols) { cols_ = cols; }
-   void setRows(int rows) { rows_ = rows; }
+   void setCols(int cols);
+   void setRows(int rows);
    int getCols() const { return cols_; }
    int getRows() const { return rows_; }
 
@@ -205,6 +214,10 @@ public:
    static void loadConsoleEnvironment(const std::string& handle, core::system::Options* pEnv);
 
 private:
+   // Model of the terminal's screen and scrollback, (re)built from the saved
+   // buffer when first needed and then kept up to date with its output
+   core::text::TermScreen& screen() const;
+
    std::string caption_;
    std::string title_;
    std::string handle_;
@@ -227,6 +240,7 @@ private:
    AutoCloseMode autoClose_ = DefaultAutoClose;
    bool zombie_ = false;
    bool trackEnv_ = false;
+   mutable boost::shared_ptr<core::text::TermScreen> pScreen_;
 };
 
 } // namespace console_process
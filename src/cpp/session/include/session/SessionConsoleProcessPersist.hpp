@@ -43,6 +43,16 @@ void saveConsoleProcesses(const std::string& metadata);
 // then returns the trimmed buffer.
 std::string getSavedBuffer(const std::string& handle, int maxLines);
 
+// Get one chunk of the saved buffer for the given ConsoleProcess, seeking
+// directly to it (if maxLines > 0 the buffer is first trimmed as for
+// getSavedBuffer). pMoreAvailable is set if the buffer continues past the
+// chunk.
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                std::size_t chunkSize,
+                                bool* pMoreAvailable);
+
 // Return number of lines in the saved buffer for given ConsoleProcess;
 // buffer will be trimmed to max number of lines and rewritten.
 int getSavedBufferLineCount(const std::string& handle, int maxLines);
@@ -58,6 +58,9 @@ struct ConsoleProcessSocketConnectionCallbacks
    // invoked when input arrives on the socket
    boost::function<void (const std::string& input)> onReceivedInput;
 
+   // invoked when the client acknowledges having written output
+   boost::function<void (int packets)> onReceivedAck;
+
    // invoked when connection opens
    boost::function<void()> onConnectionOpened;
 
@@ -0,0 +1,111 @@
+/*
+ * SessionConsoleProcessSocketOutput.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_PROCESS_SOCKET_OUTPUT_HPP
+#define SESSION_CONSOLE_PROCESS_SOCKET_OUTPUT_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+
+// Output waiting to be sent to a terminal over its websocket.
+//
+// Output is coalesced into frames: output arriving after a quiet period is
+// sent straight away (so typing echoes promptly) but output arriving while
+// frames are being sent is held until the frame interval has passed or a
+// full frame has accumulated.
+//
+// Clients which acknowledge the frames they've written to the terminal
+// emulator (see ConsoleProcessSocketPacket::ackPacket) are also flow
+// controlled: only a limited number of frames are sent ahead of the
+// client's acknowledgements, and once the output held back reaches a limit
+// the terminal's output should stop being read (see isBackedUp) so that the
+// terminal's processes block rather than the session buffering without
+// bound. Clients which never acknowledge frames only get coalescing.
+//
+// Output can arrive on the main thread while acknowledgements arrive on the
+// websocket thread, so all operations are synchronized.
+class ConsoleProcessSocketOutput : boost::noncopyable
+{
+public:
+   typedef boost::function<core::Error(const std::string&)> SendFunction;
+
+   // how long output is held to coalesce it into frames
+   static const boost::posix_time::time_duration kFrameInterval;
+
+   // largest frame sent
+   static const std::size_t kMaxFrameBytes;
+
+   // unacknowledged frames allowed in flight
+   static const int kMaxUnackedFrames;
+
+   // held back output at which reading should pause
+   static const std::size_t kMaxPendingBytes;
+
+   explicit ConsoleProcessSocketOutput(const SendFunction& send);
+
+   // queue output, sending any frames which are due
+   void append(const std::string& output);
+
+   // send any frames which are due (call periodically so that held output
+   // goes out once the frame interval has passed)
+   void sendDue();
+
+   // the client has written the given number of frames
+   void acknowledge(int frames);
+
+   // forget flow control state (e.g. when a new connection is made)
+   void reset();
+
+   // remove and return output which hasn't been sent
+   std::string takePending();
+
+   // is there output which hasn't been sent?
+   bool hasPending() const;
+
+   // has so much output been held back that reading should pause?
+   bool isBackedUp() const;
+
+private:
+   // (called with mutex_ held)
+   void sendFrames();
+
+private:
+   SendFunction send_;
+   mutable boost::mutex mutex_;
+   std::string pending_;
+   boost::posix_time::ptime lastFrameTime_;
+   int unackedFrames_;
+   bool clientAcks_;
+};
+
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_PROCESS_SOCKET_OUTPUT_HPP
@@ -29,8 +29,11 @@ namespace console_process {
  * First character is a method indicator, as follows:
  *    "a" = send text, e.g. "aHello"
  *    "b" = ping/pong, e.g. "b"
+ *    "c" = acknowledge output, e.g. "c2" (client has written two text
+ *          packets to the terminal; see ConsoleProcessSocketOutput)
  *
- * Only the "send text" method has a payload (everything after the "a").
+ * Only the "send text" and "acknowledge" methods have a payload (everything
+ * after the method indicator).
  *
  * See TerminalSocketPacket in Java code for client-side of this.
  */
@@ -49,9 +52,17 @@ public:
    // extract text from packet (empty string if unable to comply)
    static std::string getMessage(const std::string& text);
 
+   // create packet acknowledging the given number of text packets
+   static std::string ackPacket(int packets);
+
+   // is this packet an acknowledgement? if so, returns the number of text
+   // packets acknowledged
+   static bool isAck(const std::string& text, int* pPackets);
+
 private:
    static const std::string kKeepAlivePrefix;
    static const std::string kTextPrefix;
+   static const std::string kAckPrefix;
 };
 
 } // namespace console_process
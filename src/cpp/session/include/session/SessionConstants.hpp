@@ -22,6 +22,7 @@
 #define kRStudioUserIdentity              "RSTUDIO_USER_IDENTITY"
 #define kRStudioUserIdentityDisplay       "X-RStudioUserIdentity"
 #define kRStudioLimitRpcClientUid         "RSTUDIO_LIMIT_RPC_CLIENT_UID"
+#define kRStudioSessionTemplate           "RSTUDIO_SESSION_TEMPLATE"
 #define kRSessionPortNumber               "RSTUDIO_SESSION_PORT"
 #define kRSessionStandalonePortNumber     "RSTUDIO_STANDALONE_PORT"
 #define kRStudioSessionStream             "RSTUDIO_SESSION_STREAM"
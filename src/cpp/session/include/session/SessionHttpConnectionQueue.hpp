@@ -40,7 +40,8 @@ class HttpConnectionQueue : boost::noncopyable
 public:
    HttpConnectionQueue()
       : pMutex_(new boost::mutex()),
-        pWaitCondition_(new boost::condition())
+        pWaitCondition_(new boost::condition()),
+        wakePending_(false)
    {
    }
 
@@ -53,6 +54,10 @@ public:
 
    std::string peekNextConnectionUri();
 
+   // end the current (or next) wait for a connection early, without a
+   // connection being returned
+   void wake();
+
    boost::posix_time::ptime lastConnectionTime();
 
 private:
@@ -71,6 +76,7 @@ private:
    // instance data
    boost::posix_time::ptime lastConnectionTime_;
    std::queue<boost::shared_ptr<HttpConnection> > queue_;
+   bool wakePending_;
 };
 
 } // namespace session
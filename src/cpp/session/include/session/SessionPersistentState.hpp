@@ -39,6 +39,9 @@ public:
    // COPYING: boost::noncopyable
    
    core::Error initialize();
+
+   // write any changes which haven't been written yet
+   void flush();
    
    // active-client-id
    std::string activeClientId();
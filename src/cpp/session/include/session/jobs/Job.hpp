@@ -20,12 +20,15 @@
 #include <core/json/Json.hpp>
 #include <r/RSexp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace rstudio {
 namespace session {
 namespace modules {      
 namespace jobs {
 
+class JobOutputJournal;
+
 enum JobState {
    // invalid state sentry
    JobInvalid    = 0,
@@ -118,6 +121,9 @@ public:
    void addOutput(const std::string& output, bool error); 
    core::json::Array output(int position);
 
+   // write out output which is waiting to be saved
+   void flushOutput();
+
    // whether the job pane should should be shown at start
    bool show() const;
    
@@ -148,6 +154,7 @@ public:
 private:
    core::FilePath jobCacheFolder();
    core::FilePath outputCacheFile();
+   JobOutputJournal& outputJournal();
 
    std::string id_;
    std::string name_;
@@ -173,6 +180,8 @@ private:
    r::sexp::PreservedSEXP actions_;
 
    std::vector<std::string> tags_;
+
+   boost::shared_ptr<JobOutputJournal> pOutputJournal_;
 };
 
 
@@ -81,6 +81,8 @@ void removeCompletedLocalJobs();
 
 void endAllJobStreaming();
 
+bool flushJobOutput();
+
 bool localJobsRunning();
 
 } // namespace jobs
@@ -316,7 +316,8 @@ void AsyncPackageInformationProcess::update()
    pProcess->start(
             finalCmd.c_str(),
             core::FilePath(),
-            async_r::R_PROCESS_VANILLA | async_r::R_PROCESS_AUGMENTED,
+            async_r::R_PROCESS_VANILLA | async_r::R_PROCESS_AUGMENTED |
+            async_r::R_PROCESS_POOLED,
             sources);
    
 }
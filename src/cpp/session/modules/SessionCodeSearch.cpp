@@ -589,6 +589,25 @@ public:
       }
    }
    
+   void sourceIndexes(
+            const std::set<std::string>& excludeContexts,
+            std::vector<boost::shared_ptr<r_util::RSourceIndex> >* pIndexes)
+   {
+      BOOST_FOREACH(const Entry& entry, *pEntries_)
+      {
+         if (!entry.hasIndex())
+            continue;
+
+         if (excludeContexts.find(entry.pIndex->context()) !=
+             excludeContexts.end())
+         {
+            continue;
+         }
+
+         pIndexes->push_back(entry.pIndex);
+      }
+   }
+
    template <typename T>
    void searchFiles(const std::string& term,
                     std::size_t maxResults,
@@ -1183,6 +1202,26 @@ void searchSource(const std::string& term,
    }
 }
 
+void searchableSourceIndexes(
+            std::vector<boost::shared_ptr<r_util::RSourceIndex> >* pIndexes)
+{
+   // source database indexes first (as in searchSource)
+   std::set<std::string> srcDBContexts;
+   std::vector<boost::shared_ptr<r_util::RSourceIndex> > indexes
+                                                = rSourceIndex().indexes();
+   BOOST_FOREACH(boost::shared_ptr<r_util::RSourceIndex>& pIndex, indexes)
+   {
+      if (!sourceDatabaseFilter(*pIndex))
+         continue;
+
+      srcDBContexts.insert(pIndex->context());
+      pIndexes->push_back(pIndex);
+   }
+
+   // then project files which aren't open in the source database
+   s_projectIndex.sourceIndexes(srcDBContexts, pIndexes);
+}
+
 namespace {
 
 template <typename T>
@@ -109,6 +109,10 @@ void searchSource(const std::string& term,
                   std::vector<core::r_util::RSourceItem>* pItems,
                   bool* pMoreAvailable);
 
+// the indexes searched by searchSource, in search order
+void searchableSourceIndexes(
+            std::vector<boost::shared_ptr<core::r_util::RSourceIndex> >* pIndexes);
+
 void addAllProjectSymbols(std::set<std::string>* pSymbols);
 
 core::Error initialize();
@@ -16,6 +16,11 @@
 #include "SessionHistoryArchive.hpp"
 
 #include <string>
+#include <algorithm>
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
@@ -45,24 +50,21 @@ FilePath historyDatabaseFilePath()
    return module_context::userScratchPath().complete(kHistoryDatabase);
 }
 
-FilePath historyDatabaseRotatedFilePath()
-{
-   return module_context::userScratchPath().complete(kHistoryDatabase ".1");
-}
-
-void rotateHistoryDatabase()
+bool rotateHistoryDatabase(const FilePath& historyDB,
+                           const FilePath& rotatedHistoryDB)
 {
-   FilePath historyDB = historyDatabaseFilePath();
    if (historyDB.exists() && (historyDB.size() > kHistoryMaxBytes))
    {
       // first remove the rotated file if it exists (ignore errors because
       // there's nothing we can do with them at this level)
-      FilePath rotatedHistoryDB = historyDatabaseRotatedFilePath();
       rotatedHistoryDB.removeIfExists();
 
       // now rotate the file
       historyDB.move(rotatedHistoryDB);
+      return true;
    }
+
+   return false;
 }
 
 void writeEntry(double timestamp, const std::string& command, std::ostream* pOS)
@@ -119,58 +121,118 @@ ReadCollectionAction readHistoryEntry(const std::string& line,
    }
 }
 
+boost::uint32_t trigramAt(const std::string& str, std::size_t pos)
+{
+   return (static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos])) << 16) |
+          (static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos + 1])) << 8) |
+          static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos + 2]));
+}
+
+bool containsAll(const std::string& command,
+                 const std::vector<std::string>& terms)
+{
+   BOOST_FOREACH(const std::string& term, terms)
+   {
+      if (!boost::algorithm::contains(command, term))
+         return false;
+   }
+   return true;
+}
+
 } // anonymous namespace
 
 HistoryArchive& historyArchive()
 {
-   static HistoryArchive instance;
+   static HistoryArchive instance(module_context::userScratchPath());
    return instance;
 }
 
+HistoryArchive::HistoryArchive(const FilePath& databaseDir)
+   : historyDBPath_(databaseDir.complete(kHistoryDatabase)),
+     rotatedHistoryDBPath_(databaseDir.complete(kHistoryDatabase ".1")),
+     entryCacheLastWriteTime_(-1),
+     entryCacheSize_(0),
+     indexedEntries_(0)
+{
+}
+
 Error HistoryArchive::add(const std::string& command)
 {
-   // reset the cache (since this write will invalidate the current one,
-   // no sense in keeping our cache around in memory)
-   entries_.clear();
-   entryCacheLastWriteTime_ = -1;
+   // we can add the entry to the cache (rather than re-reading the archive)
+   // if the cache is current and the command will be read back as a
+   // single entry
+   bool addToCache = isCacheCurrent(historyDBPath_) &&
+                     command.find('\n') == std::string::npos;
 
-   // rotate if necessary
-   rotateHistoryDatabase();
+   // rotate if necessary (this drops the oldest entries, so the cache
+   // will need to be re-read)
+   if (rotateHistoryDatabase(historyDBPath_, rotatedHistoryDBPath_))
+      addToCache = false;
 
    // write the entry to the file
    std::ostringstream ostrEntry ;
    double currentTime = core::date_time::millisecondsSinceEpoch();
    writeEntry(currentTime, command, &ostrEntry);
    ostrEntry << std::endl;
-   return appendToFile(historyDatabaseFilePath(), ostrEntry.str());
+   Error error = appendToFile(historyDBPath_, ostrEntry.str());
+
+   // if another session wrote to the archive at the same time the file
+   // won't be the size we expect
+   uintmax_t expectedSize = entryCacheSize_ + ostrEntry.str().size();
+   if (error || !addToCache || historyDBPath_.size() != expectedSize)
+   {
+      resetCache();
+      return error;
+   }
+
+   std::istringstream istrTimestamp(ostrEntry.str());
+   double timestamp = 0;
+   istrTimestamp >> timestamp;
+   entries_.push_back(HistoryEntry(entries_.size(), timestamp, command));
+   entryCacheLastWriteTime_ = historyDBPath_.lastWriteTime();
+   entryCacheSize_ = expectedSize;
+   return Success();
 }
 
-const std::vector<HistoryEntry>& HistoryArchive::entries() const
+bool HistoryArchive::isCacheCurrent(const FilePath& historyDBPath) const
 {
-   // calculate path to history db
-   FilePath historyDBPath = historyDatabaseFilePath();
+   return historyDBPath.exists() &&
+          historyDBPath.lastWriteTime() == entryCacheLastWriteTime_ &&
+          historyDBPath.size() == entryCacheSize_;
+}
+
+void HistoryArchive::resetCache() const
+{
+   entries_.clear();
+   entryCacheLastWriteTime_ = -1;
+   entryCacheSize_ = 0;
+   index_.clear();
+   indexedEntries_ = 0;
+}
 
+const std::vector<HistoryEntry>& HistoryArchive::entries() const
+{
    // if the file doesn't exist then clear the collection
-   if (!historyDBPath.exists())
+   if (!historyDBPath_.exists())
    {
-      entries_.clear();
+      resetCache();
    }
 
-   // otherwise check for divergent lastWriteTime and read the file
+   // otherwise check for divergent lastWriteTime (or size, since the
+   // write time only has a resolution of a second) and read the file
    // if our internal list isn't up to date
-   else if (historyDBPath.lastWriteTime() != entryCacheLastWriteTime_)
+   else if (!isCacheCurrent(historyDBPath_))
    {
-      entries_.clear();
+      resetCache();
 
       // establish a next index counter
       int nextIndex = 0;
 
       // first read from rotated file if it exists
-      FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
-      if (rotatedHistoryDBPath.exists())
+      if (rotatedHistoryDBPath_.exists())
       {
          Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           rotatedHistoryDBPath,
+                           rotatedHistoryDBPath_,
                            &entries_,
                            boost::bind(readHistoryEntry, _1, _2, &nextIndex));
          if (error)
@@ -181,7 +243,7 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
       // now read from main history db
       std::vector<HistoryEntry> entries;
       Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           historyDBPath,
+                           historyDBPath_,
                            &entries,
                            boost::bind(readHistoryEntry, _1, _2, &nextIndex));
       if (error)
@@ -194,7 +256,8 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
                    entries.end(),
                    std::back_inserter(entries_));
 
-         entryCacheLastWriteTime_ = historyDBPath.lastWriteTime();
+         entryCacheLastWriteTime_ = historyDBPath_.lastWriteTime();
+         entryCacheSize_ = historyDBPath_.size();
       }
 
    }
@@ -203,6 +266,121 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
    return entries_;
 }
 
+void HistoryArchive::search(const std::vector<std::string>& terms,
+                            std::size_t maxEntries,
+                            std::vector<HistoryEntry>* pEntries) const
+{
+   updateIndex();
+
+   std::vector<int> candidates;
+   bool indexed = findCandidates(terms, &candidates);
+   std::size_t count = indexed ? candidates.size() : entries_.size();
+   for (std::size_t i = count; i > 0; --i)
+   {
+      // check limit
+      if (pEntries->size() >= maxEntries)
+         break;
+
+      // candidates contain the terms' trigrams, so check for the terms
+      const HistoryEntry& entry = entries_[indexed ? candidates[i - 1] : i - 1];
+      if (containsAll(entry.command, terms))
+         pEntries->push_back(entry);
+   }
+}
+
+void HistoryArchive::searchByPrefix(const std::string& prefix,
+                                    std::size_t maxEntries,
+                                    bool uniqueOnly,
+                                    std::vector<HistoryEntry>* pEntries) const
+{
+   updateIndex();
+
+   std::vector<int> candidates;
+   bool indexed = findCandidates(std::vector<std::string>(1, prefix),
+                                 &candidates);
+   std::size_t count = indexed ? candidates.size() : entries_.size();
+   std::set<std::string> matchedCommands;
+   for (std::size_t i = count; i > 0; --i)
+   {
+      // check limit
+      if (pEntries->size() >= maxEntries)
+         break;
+
+      const HistoryEntry& entry = entries_[indexed ? candidates[i - 1] : i - 1];
+      if (boost::algorithm::starts_with(entry.command, prefix))
+      {
+         if (!uniqueOnly || (matchedCommands.count(entry.command) == 0))
+         {
+            pEntries->push_back(entry);
+            matchedCommands.insert(entry.command);
+         }
+      }
+   }
+}
+
+void HistoryArchive::updateIndex() const
+{
+   // make sure the cache is current (re-reading it resets the index)
+   entries();
+
+   // index the entries added since we last indexed
+   for (; indexedEntries_ < entries_.size(); ++indexedEntries_)
+   {
+      const std::string& command = entries_[indexedEntries_].command;
+      for (std::size_t pos = 0; pos + 3 <= command.size(); ++pos)
+      {
+         std::vector<int>& positions = index_[trigramAt(command, pos)];
+         if (positions.empty() ||
+             positions.back() != static_cast<int>(indexedEntries_))
+         {
+            positions.push_back(indexedEntries_);
+         }
+      }
+   }
+}
+
+// find the positions of the entries which contain all of the trigrams in
+// the terms (returns false if the terms are too short to have trigrams, in
+// which case all entries need to be checked)
+bool HistoryArchive::findCandidates(const std::vector<std::string>& terms,
+                                    std::vector<int>* pCandidates) const
+{
+   bool found = false;
+   pCandidates->clear();
+   BOOST_FOREACH(const std::string& term, terms)
+   {
+      for (std::size_t pos = 0; pos + 3 <= term.size(); ++pos)
+      {
+         boost::unordered_map<boost::uint32_t, std::vector<int> >::const_iterator
+                                       it = index_.find(trigramAt(term, pos));
+         if (it == index_.end())
+         {
+            pCandidates->clear();
+            return true;
+         }
+
+         if (!found)
+         {
+            *pCandidates = it->second;
+            found = true;
+         }
+         else
+         {
+            std::vector<int> intersection;
+            std::set_intersection(pCandidates->begin(), pCandidates->end(),
+                                  it->second.begin(), it->second.end(),
+                                  std::back_inserter(intersection));
+            pCandidates->swap(intersection);
+         }
+
+         if (pCandidates->empty())
+            return true;
+      }
+   }
+
+   return found;
+}
+
 void HistoryArchive::migrateRhistoryIfNecessary()
 {
    // if the history database doesn't exist see if we can migrate the
@@ -19,12 +19,15 @@
 #include <string>
 #include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <core/FilePath.hpp>
 
 namespace rstudio {
 namespace core {
    class Error;
-   class FilePath;
 }
 }
  
@@ -48,11 +51,16 @@ struct HistoryEntry
 class HistoryArchive;
 HistoryArchive& historyArchive();
 
+// The archive's entries are cached in memory (commands added by this
+// session are appended to the cache, which is re-read only when another
+// session writes to the archive). Searches use an index of the trigrams
+// in each command, which is extended as entries are added.
 class HistoryArchive : boost::noncopyable
 {
-private:
-   HistoryArchive() : entryCacheLastWriteTime_(-1) {}
-   friend HistoryArchive& historyArchive();
+public:
+   // archive kept in the given directory (historyArchive() uses the
+   // user scratch path)
+   explicit HistoryArchive(const core::FilePath& databaseDir);
 
 public:
    static void migrateRhistoryIfNecessary();
@@ -61,9 +69,35 @@ public:
    core::Error add(const std::string& command);
    const std::vector<HistoryEntry>& entries() const;
 
+   // entries which contain all of the terms (most recent first)
+   void search(const std::vector<std::string>& terms,
+               std::size_t maxEntries,
+               std::vector<HistoryEntry>* pEntries) const;
+
+   // entries which start with the prefix (most recent first)
+   void searchByPrefix(const std::string& prefix,
+                       std::size_t maxEntries,
+                       bool uniqueOnly,
+                       std::vector<HistoryEntry>* pEntries) const;
+
 private:
+   bool isCacheCurrent(const core::FilePath& historyDBPath) const;
+   void resetCache() const;
+   void updateIndex() const;
+   bool findCandidates(const std::vector<std::string>& terms,
+                       std::vector<int>* pCandidates) const;
+
+private:
+   core::FilePath historyDBPath_;
+   core::FilePath rotatedHistoryDBPath_;
+
    mutable time_t entryCacheLastWriteTime_;
+   mutable uintmax_t entryCacheSize_;
    mutable std::vector<HistoryEntry> entries_;
+
+   // positions in entries_ of the entries containing each trigram
+   mutable boost::unordered_map<boost::uint32_t, std::vector<int> > index_;
+   mutable std::size_t indexedEntries_;
 };
                        
 } // namespace history
@@ -0,0 +1,327 @@
+/*
+ * SessionHistoryArchiveTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionHistoryArchive.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace history {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempArchiveDir
+{
+public:
+   TempArchiveDir()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempArchiveDir()
+   {
+      dir_.removeIfExists();
+   }
+
+   const FilePath& path() const { return dir_; }
+
+private:
+   FilePath dir_;
+};
+
+// the linear scans which the indexed searches replaced
+std::vector<HistoryEntry> scan(const std::vector<HistoryEntry>& entries,
+                               const std::vector<std::string>& terms,
+                               std::size_t maxEntries)
+{
+   std::vector<HistoryEntry> matches;
+   for (std::vector<HistoryEntry>::const_reverse_iterator it = entries.rbegin();
+        it != entries.rend() && matches.size() < maxEntries;
+        ++it)
+   {
+      bool matched = true;
+      BOOST_FOREACH(const std::string& term, terms)
+      {
+         if (!boost::algorithm::contains(it->command, term))
+            matched = false;
+      }
+      if (matched)
+         matches.push_back(*it);
+   }
+   return matches;
+}
+
+std::vector<HistoryEntry> scanByPrefix(const std::vector<HistoryEntry>& entries,
+                                       const std::string& prefix,
+                                       std::size_t maxEntries,
+                                       bool uniqueOnly)
+{
+   std::vector<HistoryEntry> matches;
+   std::set<std::string> matchedCommands;
+   for (std::vector<HistoryEntry>::const_reverse_iterator it = entries.rbegin();
+        it != entries.rend() && matches.size() < maxEntries;
+        ++it)
+   {
+      if (boost::algorithm::starts_with(it->command, prefix) &&
+          (!uniqueOnly || matchedCommands.count(it->command) == 0))
+      {
+         matches.push_back(*it);
+         matchedCommands.insert(it->command);
+      }
+   }
+   return matches;
+}
+
+std::vector<std::string> terms(const std::string& first,
+                               const std::string& second = std::string())
+{
+   std::vector<std::string> terms(1, first);
+   if (!second.empty())
+      terms.push_back(second);
+   return terms;
+}
+
+std::vector<HistoryEntry> search(const HistoryArchive& archive,
+                                 const std::vector<std::string>& terms,
+                                 std::size_t maxEntries = 1000)
+{
+   std::vector<HistoryEntry> matches;
+   archive.search(terms, maxEntries, &matches);
+   return matches;
+}
+
+std::vector<HistoryEntry> searchByPrefix(const HistoryArchive& archive,
+                                         const std::string& prefix,
+                                         bool uniqueOnly,
+                                         std::size_t maxEntries = 1000)
+{
+   std::vector<HistoryEntry> matches;
+   archive.searchByPrefix(prefix, maxEntries, uniqueOnly, &matches);
+   return matches;
+}
+
+std::vector<int> indexes(const std::vector<HistoryEntry>& entries)
+{
+   std::vector<int> indexes;
+   BOOST_FOREACH(const HistoryEntry& entry, entries)
+   {
+      indexes.push_back(entry.index);
+   }
+   return indexes;
+}
+
+void addCommands(HistoryArchive* pArchive)
+{
+   const char* commands[] = {
+      "x <- 1",
+      "library(ggplot2)",
+      "ggplot(mtcars, aes(mpg, wt)) + geom_point()",
+      "x <- 1",
+      "summary(lm(mpg ~ wt, data = mtcars))",
+      "plot(x)",
+      "library(dplyr)",
+      "mtcars %>% filter(mpg > 20)",
+      "x <- 1",
+      "print(\"h\\u00e9llo\")",
+      "ggplot(mtcars, aes(mpg)) + geom_histogram()"
+   };
+   BOOST_FOREACH(const char* command, commands)
+   {
+      REQUIRE(!pArchive->add(command));
+   }
+}
+
+// searches whose results should match the linear scans
+void checkMatchesScan(const HistoryArchive& archive)
+{
+   const std::vector<HistoryEntry>& entries = archive.entries();
+
+   const char* queries[] = {
+      "", "x", "(", "mt", "mpg", "ggplot", "mtcars", "geom_point",
+      "x <- 1", "h\\u00e9", "not in history", "zzz"
+   };
+   BOOST_FOREACH(const char* query, queries)
+   {
+      CHECK(indexes(search(archive, terms(query))) ==
+            indexes(scan(entries, terms(query), 1000)));
+   }
+
+   CHECK(indexes(search(archive, terms("mtcars", "wt"))) ==
+         indexes(scan(entries, terms("mtcars", "wt"), 1000)));
+   CHECK(indexes(search(archive, terms("ggplot", "hist"))) ==
+         indexes(scan(entries, terms("ggplot", "hist"), 1000)));
+   CHECK(indexes(search(archive, terms("mpg", "dplyr"))) ==
+         indexes(scan(entries, terms("mpg", "dplyr"), 1000)));
+
+   const char* prefixes[] = {
+      "", "x", "li", "lib", "library(", "ggplot(mtcars, aes(mpg",
+      "x <- 1", "mtcars", "plot", "nope"
+   };
+   BOOST_FOREACH(const char* prefix, prefixes)
+   {
+      CHECK(indexes(searchByPrefix(archive, prefix, false)) ==
+            indexes(scanByPrefix(entries, prefix, 1000, false)));
+      CHECK(indexes(searchByPrefix(archive, prefix, true)) ==
+            indexes(scanByPrefix(entries, prefix, 1000, true)));
+   }
+}
+
+} // anonymous namespace
+
+TEST_CASE("History Archive")
+{
+   TempArchiveDir temp;
+   HistoryArchive archive(temp.path());
+   addCommands(&archive);
+
+   SECTION("Added commands are read back in order")
+   {
+      REQUIRE(archive.entries().size() == 11);
+      CHECK(archive.entries()[1].command == "library(ggplot2)");
+      CHECK(archive.entries()[10].index == 10);
+
+      // a second archive reads the same entries from the file
+      HistoryArchive reader(temp.path());
+      REQUIRE(reader.entries().size() == 11);
+      CHECK(reader.entries()[4].command == archive.entries()[4].command);
+   }
+
+   SECTION("Searches match a scan of the entries")
+   {
+      checkMatchesScan(archive);
+
+      // searching indexes the entries; searching again uses the index
+      // extended with the entries added since
+      REQUIRE(!archive.add("mtcars$wt"));
+      checkMatchesScan(archive);
+   }
+
+   SECTION("Searches with terms shorter than a trigram check every entry")
+   {
+      CHECK(indexes(search(archive, terms("x"))) ==
+            indexes(scan(archive.entries(), terms("x"), 1000)));
+      CHECK(search(archive, terms("wt")).size() == 2);
+      CHECK(search(archive, terms("wt", "lm")).size() == 1);
+      CHECK(searchByPrefix(archive, "x", false).size() == 3);
+   }
+
+   SECTION("Searches return the most recent matches up to the limit")
+   {
+      std::vector<HistoryEntry> matches = search(archive, terms("ggplot"), 2);
+      REQUIRE(matches.size() == 2);
+      CHECK(matches[0].index == 10);
+      CHECK(matches[1].index == 2);
+
+      CHECK(indexes(search(archive, terms("mtcars"), 2)) ==
+            indexes(scan(archive.entries(), terms("mtcars"), 2)));
+      CHECK(indexes(searchByPrefix(archive, "x <- 1", true, 1)) ==
+            indexes(scanByPrefix(archive.entries(), "x <- 1", 1, true)));
+   }
+
+   SECTION("Prefix searches can skip repeated commands")
+   {
+      CHECK(searchByPrefix(archive, "x <- 1", false).size() == 3);
+
+      std::vector<HistoryEntry> unique = searchByPrefix(archive, "x <- 1", true);
+      REQUIRE(unique.size() == 1);
+      CHECK(unique[0].index == 8);
+
+      CHECK(searchByPrefix(archive, "library(", true).size() == 2);
+   }
+
+   SECTION("Multi-line commands are searched as the lines read back")
+   {
+      REQUIRE(!archive.add("f <- function() {\n  mtcars\n}"));
+      checkMatchesScan(archive);
+      CHECK(searchByPrefix(archive, "f <- function()", false).size() == 1);
+   }
+
+   SECTION("Entries in the rotated archive are searched first")
+   {
+      REQUIRE(!writeStringToFile(temp.path().complete("history_database.1"),
+                                 "0:ggplot(diamonds)\n0:x <- 2\n"));
+
+      HistoryArchive reader(temp.path());
+      REQUIRE(reader.entries().size() == 13);
+      CHECK(reader.entries()[0].command == "ggplot(diamonds)");
+      checkMatchesScan(reader);
+      CHECK(search(reader, terms("ggplot")).back().index == 0);
+   }
+
+#ifndef _WIN32
+   SECTION("Entries written by another process are found")
+   {
+      // search so that the entries are cached and indexed
+      CHECK(search(archive, terms("diamonds")).empty());
+
+      // add from another process (within the same second, so the archive's
+      // write time may not change)
+      pid_t pid = ::fork();
+      REQUIRE(pid >= 0);
+      if (pid == 0)
+      {
+         HistoryArchive writer(temp.path());
+         Error error = writer.add("ggplot(diamonds, aes(carat))");
+         ::_exit(error ? 1 : 0);
+      }
+      int status = 0;
+      REQUIRE(::waitpid(pid, &status, 0) == pid);
+      REQUIRE(WIFEXITED(status));
+      REQUIRE(WEXITSTATUS(status) == 0);
+
+      std::vector<HistoryEntry> matches = search(archive, terms("diamonds"));
+      REQUIRE(matches.size() == 1);
+      CHECK(matches[0].index == 11);
+      checkMatchesScan(archive);
+
+      // and our own additions are appended after it
+      REQUIRE(!archive.add("ggplot(diamonds)"));
+      REQUIRE(archive.entries().size() == 13);
+      CHECK(search(archive, terms("diamonds")).size() == 2);
+      CHECK(searchByPrefix(archive, "ggplot(diamonds", true).size() == 2);
+
+      HistoryArchive reader(temp.path());
+      CHECK(reader.entries().size() == 13);
+   }
+#endif
+}
+
+} // namespace tests
+} // namespace history
+} // namespace modules
+} // namespace session
+} // namespace rstudio
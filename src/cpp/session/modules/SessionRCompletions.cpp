@@ -39,6 +39,7 @@
 #include <session/SessionModuleContext.hpp>
 
 #include "SessionCodeSearch.hpp"
+#include "SessionRCompletionsCache.hpp"
 #include "SessionLibPathsIndexer.hpp"
 
 using namespace rstudio::core;
@@ -174,30 +175,39 @@ struct SourceIndexCompletions {
    bool moreAvailable;
 };
 
+// completions from each document and project source index, narrowed while
+// the user keeps typing the same identifier
+SourceIndexCompletionCache s_completionCache;
+
 SourceIndexCompletions getSourceIndexCompletions(const std::string& token)
 {
-   // get functions from the source index
-   std::vector<core::r_util::RSourceItem> items;
-   bool moreAvailable = false;
+   const std::size_t kMaxResults = 1000;
 
-   // TODO: wire up 'moreAvailable'
-   modules::code_search::searchSource(token,
-                                      1000,
-                                      true,
-                                      &items,
-                                      &moreAvailable);
+   std::vector<boost::shared_ptr<core::r_util::RSourceIndex> > indexes;
+   modules::code_search::searchableSourceIndexes(&indexes);
+   s_completionCache.retain(indexes);
 
    SourceIndexCompletions srcCompletions;
-   BOOST_FOREACH(const core::r_util::RSourceItem& item, items)
+   srcCompletions.moreAvailable = false;
+   BOOST_FOREACH(const boost::shared_ptr<core::r_util::RSourceIndex>& pIndex,
+                 indexes)
    {
-      if (item.braceLevel() == 0)
+      const std::vector<SourceIndexCompletion>& completions =
+            s_completionCache.completions(pIndex, token);
+
+      BOOST_FOREACH(const SourceIndexCompletion& completion, completions)
       {
-         srcCompletions.completions.push_back(item.name());
-         srcCompletions.isFunction.push_back(item.isFunction() || item.isMethod());
+         if (srcCompletions.completions.size() >= kMaxResults)
+         {
+            srcCompletions.moreAvailable = true;
+            return srcCompletions;
+         }
+
+         srcCompletions.completions.push_back(completion.name);
+         srcCompletions.isFunction.push_back(completion.isFunction);
       }
    }
 
-   srcCompletions.moreAvailable = moreAvailable;
    return srcCompletions;
 }
 
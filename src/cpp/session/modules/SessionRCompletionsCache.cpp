@@ -0,0 +1,133 @@
+/*
+ * SessionRCompletionsCache.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionRCompletionsCache.hpp"
+
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/StringUtils.hpp>
+#include <core/r_util/RSourceIndex.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace r_packages {
+
+namespace {
+
+bool isWildcard(const std::string& token)
+{
+   return token.find('*') != std::string::npos;
+}
+
+} // anonymous namespace
+
+const std::vector<SourceIndexCompletion>& SourceIndexCompletionCache::completions(
+                                                   const Index& pIndex,
+                                                   const std::string& token)
+{
+   Entry& entry = entries_[pIndex.get()];
+
+   // completions for a prefix of this token can be narrowed (wildcard
+   // searches can't be)
+   if (entry.pIndex == pIndex &&
+       !isWildcard(token) &&
+       !isWildcard(entry.token) &&
+       boost::algorithm::istarts_with(token, entry.token))
+   {
+      hits_++;
+      narrow(token, &entry);
+   }
+   else
+   {
+      misses_++;
+      entry.pIndex = pIndex;
+      search(token, &entry);
+   }
+
+   return entry.completions;
+}
+
+void SourceIndexCompletionCache::retain(const std::vector<Index>& indexes)
+{
+   std::set<const r_util::RSourceIndex*> retained;
+   BOOST_FOREACH(const Index& pIndex, indexes)
+   {
+      retained.insert(pIndex.get());
+   }
+
+   typedef std::map<const r_util::RSourceIndex*, Entry>::iterator Iterator;
+   for (Iterator it = entries_.begin(); it != entries_.end(); )
+   {
+      if (retained.count(it->first) == 0)
+         entries_.erase(it++);
+      else
+         ++it;
+   }
+}
+
+void SourceIndexCompletionCache::search(const std::string& token,
+                                        Entry* pEntry)
+{
+   std::vector<r_util::RSourceItem> items;
+   pEntry->pIndex->search(token, true, false, std::back_inserter(items));
+
+   pEntry->token = token;
+   pEntry->completions.clear();
+   pEntry->lowerNames.clear();
+   BOOST_FOREACH(const r_util::RSourceItem& item, items)
+   {
+      if (item.braceLevel() != 0)
+         continue;
+
+      std::string name = item.name();
+      pEntry->completions.push_back(SourceIndexCompletion(
+                                       name,
+                                       item.isFunction() || item.isMethod()));
+      pEntry->lowerNames.push_back(string_utils::toLower(name));
+   }
+}
+
+void SourceIndexCompletionCache::narrow(const std::string& token,
+                                        Entry* pEntry)
+{
+   // source index searches are case-insensitive prefix matches
+   std::string lowerToken = string_utils::toLower(token);
+
+   std::vector<SourceIndexCompletion> completions;
+   std::vector<std::string> lowerNames;
+   for (std::size_t i = 0; i < pEntry->completions.size(); i++)
+   {
+      if (boost::algorithm::starts_with(pEntry->lowerNames[i], lowerToken))
+      {
+         completions.push_back(pEntry->completions[i]);
+         lowerNames.push_back(pEntry->lowerNames[i]);
+      }
+   }
+
+   pEntry->token = token;
+   pEntry->completions.swap(completions);
+   pEntry->lowerNames.swap(lowerNames);
+}
+
+} // namespace r_packages
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,107 @@
+/*
+ * SessionRCompletionsCache.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_R_COMPLETIONS_CACHE_HPP
+#define SESSION_R_COMPLETIONS_CACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace rstudio {
+namespace core {
+namespace r_util {
+class RSourceIndex;
+}
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace r_packages {
+
+struct SourceIndexCompletion
+{
+   SourceIndexCompletion(const std::string& name, bool isFunction)
+      : name(name), isFunction(isFunction)
+   {
+   }
+
+   std::string name;
+   bool isFunction;
+};
+
+// Caches the completions found in each source index for the last token
+// searched. A document's index is replaced whenever the document changes,
+// so entries are keyed by index: an entry belongs to one revision of one
+// document (or project file). While the user keeps typing an identifier
+// (so that each token extends the previous one), the completions from
+// indexes which haven't changed are narrowed from their cached entries and
+// only changed indexes -- typically just the document being edited -- are
+// searched again.
+class SourceIndexCompletionCache : boost::noncopyable
+{
+public:
+   typedef boost::shared_ptr<core::r_util::RSourceIndex> Index;
+
+   SourceIndexCompletionCache() : hits_(0), misses_(0) {}
+
+   // completions for a token from an index (global, top-level items with a
+   // case-insensitive prefix match)
+   const std::vector<SourceIndexCompletion>& completions(
+                                                const Index& pIndex,
+                                                const std::string& token);
+
+   // drop the entries for indexes which aren't in this list (e.g. indexes
+   // of old revisions or of closed documents)
+   void retain(const std::vector<Index>& indexes);
+
+   void clear() { entries_.clear(); }
+
+   // number of cached entries, and of lookups which could and couldn't use
+   // them (for diagnostics)
+   std::size_t size() const { return entries_.size(); }
+   std::size_t hits() const { return hits_; }
+   std::size_t misses() const { return misses_; }
+
+private:
+   struct Entry
+   {
+      // held so that the index's address can't be reused by another index
+      // while the entry exists
+      Index pIndex;
+      std::string token;
+      std::vector<SourceIndexCompletion> completions;
+      std::vector<std::string> lowerNames;
+   };
+
+   void search(const std::string& token, Entry* pEntry);
+   void narrow(const std::string& token, Entry* pEntry);
+
+   std::map<const core::r_util::RSourceIndex*, Entry> entries_;
+   std::size_t hits_;
+   std::size_t misses_;
+};
+
+} // namespace r_packages
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_R_COMPLETIONS_CACHE_HPP
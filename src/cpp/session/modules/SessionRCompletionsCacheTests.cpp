@@ -0,0 +1,134 @@
+/*
+ * SessionRCompletionsCacheTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionRCompletionsCache.hpp"
+
+#include <core/r_util/RSourceIndex.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace r_packages {
+
+using namespace rstudio::core;
+
+namespace {
+
+SourceIndexCompletionCache::Index makeIndex(const std::string& code)
+{
+   return SourceIndexCompletionCache::Index(
+            new r_util::RSourceIndex("utils.R", code));
+}
+
+} // anonymous namespace
+
+context("r_completions_cache")
+{
+   const std::string code =
+         "fooBar <- function() {}\n"
+         "fooBaz <- 1\n"
+         "other <- function() { fooLocal <- 1 }\n";
+
+   test_that("completions are found in the index")
+   {
+      SourceIndexCompletionCache cache;
+      SourceIndexCompletionCache::Index pIndex = makeIndex(code);
+
+      std::vector<SourceIndexCompletion> completions =
+            cache.completions(pIndex, "foo");
+      expect_true(completions.size() == 2);
+      expect_true(completions[0].name == "fooBar");
+      expect_true(completions[0].isFunction);
+      expect_true(completions[1].name == "fooBaz");
+      expect_false(completions[1].isFunction);
+      expect_true(cache.misses() == 1);
+   }
+
+   test_that("completions for extended tokens are narrowed from the cache")
+   {
+      SourceIndexCompletionCache cache;
+      SourceIndexCompletionCache::Index pIndex = makeIndex(code);
+
+      cache.completions(pIndex, "fo");
+      std::vector<SourceIndexCompletion> completions =
+            cache.completions(pIndex, "FOOBA");
+      expect_true(completions.size() == 2);
+
+      completions = cache.completions(pIndex, "fooBaz");
+      expect_true(completions.size() == 1);
+      expect_true(completions[0].name == "fooBaz");
+
+      expect_true(cache.hits() == 2);
+      expect_true(cache.misses() == 1);
+   }
+
+   test_that("tokens which don't extend the cached token are searched")
+   {
+      SourceIndexCompletionCache cache;
+      SourceIndexCompletionCache::Index pIndex = makeIndex(code);
+
+      cache.completions(pIndex, "fooBar");
+      std::vector<SourceIndexCompletion> completions =
+            cache.completions(pIndex, "foo");
+      expect_true(completions.size() == 2);
+
+      completions = cache.completions(pIndex, "oth");
+      expect_true(completions.size() == 1);
+
+      completions = cache.completions(pIndex, "o*r");
+      expect_true(completions.size() == 1);
+      completions = cache.completions(pIndex, "o*rx");
+      expect_true(completions.empty());
+
+      expect_true(cache.hits() == 0);
+      expect_true(cache.misses() == 5);
+   }
+
+   test_that("a new revision of a document invalidates only its entry")
+   {
+      SourceIndexCompletionCache cache;
+      SourceIndexCompletionCache::Index pEdited = makeIndex(code);
+      SourceIndexCompletionCache::Index pOther = makeIndex("fooOther <- 1\n");
+
+      cache.completions(pEdited, "f");
+      cache.completions(pOther, "f");
+
+      // the edited document's index is replaced
+      SourceIndexCompletionCache::Index pRevised =
+            makeIndex(code + "fooNew <- function() {}\n");
+      std::vector<SourceIndexCompletionCache::Index> indexes;
+      indexes.push_back(pRevised);
+      indexes.push_back(pOther);
+      cache.retain(indexes);
+      pEdited.reset();
+      expect_true(cache.size() == 1);
+
+      std::vector<SourceIndexCompletion> completions =
+            cache.completions(pRevised, "foo");
+      expect_true(completions.size() == 3);
+      expect_true(cache.misses() == 3);
+
+      completions = cache.completions(pOther, "foo");
+      expect_true(completions.size() == 1);
+      expect_true(cache.hits() == 1);
+   }
+}
+
+} // namespace r_packages
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -26,6 +26,7 @@
 #include <r/RRoutines.hpp>
 #include <r/RUtil.hpp>
 #include <r/RExec.hpp>
+#include <r/ROptions.hpp>
 
 #include <session/SessionUserSettings.hpp>
 #include <session/SessionModuleContext.hpp>
@@ -104,7 +105,10 @@ Error checkSpelling(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
-   json::Array misspelledIndexes;
+   // check the words as a batch (words we've seen before are answered from
+   // the engine's cache and the rest are checked in parallel)
+   std::vector<std::string> wordsToCheck;
+   std::vector<int> wordIndexes;
    for (std::size_t i=0; i<words.size(); i++)
    {
       if (!json::isType<std::string>(words[i]))
@@ -113,20 +117,26 @@ Error checkSpelling(const json::JsonRpcRequest& request,
          continue;
       }
 
-      std::string word = words[i].get_str();
-      bool isCorrect = true;
-      error = s_pSpellingEngine->checkSpelling(word, &isCorrect);
-      if (error)
-      {
-         // if we can't check a word, ignore it; some combinations of platform, non-ASCII
-         // characters, and locale are known to fail in iconv, and we don't want to put those
-         // failures in front of the user (we just won't be able to spell check those words)
-         LOG_ERROR(error);
-      }
-      else if (!isCorrect) 
-      {
-         misspelledIndexes.push_back(static_cast<int>(i));
-      }
+      wordsToCheck.push_back(words[i].get_str());
+      wordIndexes.push_back(static_cast<int>(i));
+   }
+
+   // words which can't be checked are reported as correct; some combinations
+   // of platform, non-ASCII characters, and locale are known to fail in
+   // iconv, and we don't want to put those failures in front of the user
+   std::vector<bool> isCorrect;
+   error = s_pSpellingEngine->checkSpelling(wordsToCheck, &isCorrect);
+   if (error)
+   {
+      LOG_ERROR(error);
+      isCorrect.assign(wordsToCheck.size(), true);
+   }
+
+   json::Array misspelledIndexes;
+   for (std::size_t i=0; i<isCorrect.size(); i++)
+   {
+      if (!isCorrect[i])
+         misspelledIndexes.push_back(wordIndexes[i]);
    }
 
    pResponse->setResult(misspelledIndexes);
@@ -325,6 +335,10 @@ Error initialize()
                                              userSettings().spellingLanguage(),
                                              hunspellDictionaryManager(),
                                              &r::util::iconvstr);
+   int workers = r::options::getOption<int>("rstudio.spellingWorkers",
+                                            2, false);
+   if (workers > 0)
+      pHunspell->setWorkerThreads(workers);
    s_pSpellingEngine.reset(pHunspell);
 
    // connect to user settings changed
@@ -15,11 +15,14 @@
 
 #include "CodeCompletion.hpp"
 
+#include <cctype>
 #include <iostream>
 
 #include <core/Debug.hpp>
 #include <core/Error.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/system/Process.hpp>
 #include <core/RegexUtils.hpp>
 
@@ -494,8 +497,152 @@ Error getHeaderCompletions(std::string line,
 }
 
 
+// completions computed for a token are cached (per document) so that as the
+// user continues typing the token we can simply re-filter the cached results
+// rather than asking libclang to complete again
+struct CachedCompletion
+{
+   CachedCompletion(const std::string& typedText,
+                    const json::Object& completion,
+                    const json::Object& text)
+      : typedText(typedText), completion(completion), text(text)
+   {
+   }
+   std::string typedText;
+   json::Object completion;
+   json::Object text;
+};
+
+struct CompletionSession
+{
+   CompletionSession() : row(0), column(0) {}
+   std::string filename;
+   int row;
+   int column;
+   std::string fingerprint;
+
+   // the headers the completions came from, and their fingerprint then
+   std::vector<std::string> includedFiles;
+   std::string includesFingerprint;
+
+   std::vector<CachedCompletion> completions;
+};
+
+typedef std::map<std::string, CompletionSession> CompletionSessions;
+CompletionSessions s_completionSessions;
+
+bool isIdentifierChar(char ch)
+{
+   return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_';
+}
+
+const CXUnsavedFile* findUnsavedFile(const std::string& filename)
+{
+   UnsavedFiles& unsavedFiles = rSourceIndex().unsavedFiles();
+   CXUnsavedFile* pFiles = unsavedFiles.unsavedFilesArray();
+   for (unsigned i = 0; i < unsavedFiles.numUnsavedFiles(); i++)
+   {
+      if (filename == pFiles[i].Filename)
+         return &pFiles[i];
+   }
+   return NULL;
+}
+
+// fingerprint of the document contents excluding the token being completed
+// (so that typing within the token doesn't invalidate cached completions but
+// an edit anywhere else does)
+std::string documentFingerprint(const std::string& filename, int row, int column)
+{
+   const CXUnsavedFile* pFile = findUnsavedFile(filename);
+   if (pFile)
+   {
+      const char* pContents = pFile->Contents;
+      std::size_t length = pFile->Length;
+
+      // find the offset of the token (row and column are 1-based)
+      std::size_t offset = 0;
+      for (int line = 1; line < row && offset < length; offset++)
+      {
+         if (pContents[offset] == '\n')
+            line++;
+      }
+      offset = std::min(offset + std::max(column - 1, 0), length);
+
+      std::size_t tokenEnd = offset;
+      while (tokenEnd < length && isIdentifierChar(pContents[tokenEnd]))
+         tokenEnd++;
+
+      std::string contents(pContents, offset);
+      contents.append(pContents + tokenEnd, length - tokenEnd);
+      return "unsaved:" + hash::crc32Hash(contents);
+   }
+
+   // not dirty, so the file on disk is what was completed against
+   return "saved:" + safe_convert::numberToString(
+                                 FilePath(filename).lastWriteTime());
+}
+
+// fingerprint of the headers a document includes (completions change when
+// one is edited, whether or not it's saved)
+std::string includesFingerprint(const std::vector<std::string>& includedFiles)
+{
+   std::string fingerprint;
+   BOOST_FOREACH(const std::string& file, includedFiles)
+   {
+      const CXUnsavedFile* pFile = findUnsavedFile(file);
+      if (pFile)
+         fingerprint += "unsaved:" + hash::crc32Hash(
+                           std::string(pFile->Contents, pFile->Length));
+      else
+         fingerprint += "saved:" + safe_convert::numberToString(
+                                          FilePath(file).lastWriteTime());
+      fingerprint += "\n";
+   }
+   return fingerprint;
+}
+
+json::Array filterCompletions(const std::vector<CachedCompletion>& completions,
+                              const std::string& userText)
+{
+   std::string lastTypedText;
+   json::Array completionsJson;
+   BOOST_FOREACH(const CachedCompletion& completion, completions)
+   {
+      // filter on user text if we have it
+      if (!userText.empty() &&
+          !boost::algorithm::starts_with(completion.typedText, userText))
+      {
+         continue;
+      }
+
+      // if we have the same typed text then just ammend previous result
+      if ((completion.typedText == lastTypedText) && !completionsJson.empty())
+      {
+         json::Object& res = completionsJson.back().get_obj();
+         json::Array& text = res["text"].get_array();
+         text.push_back(completion.text);
+      }
+      else
+      {
+         completionsJson.push_back(completion.completion);
+      }
+
+      lastTypedText = completion.typedText;
+   }
+   return completionsJson;
+}
+
 } // anonymous namespace
 
+void clearCompletionSession(const std::string& docId)
+{
+   s_completionSessions.erase(docId);
+}
+
+void clearAllCompletionSessions()
+{
+   s_completionSessions.clear();
+}
 
 Error getCppCompletions(const core::json::JsonRpcRequest& request,
                         core::json::JsonRpcResponse* pResponse)
@@ -525,57 +672,67 @@ Error getCppCompletions(const core::json::JsonRpcRequest& request,
    if (regex_utils::textMatches(line, reInclude, true, true))
       return getHeaderCompletions(line, filePath, docId, request, pResponse);
 
-   // get the translation unit and do the code completion
+   // if we are still completing the same token and the rest of the
+   // document hasn't changed then re-filter the completions we already have
    std::string filename = filePath.absolutePath();
+   std::string fingerprint = documentFingerprint(filename, row, column);
+   CompletionSessions::const_iterator it = s_completionSessions.find(docId);
+   if (it != s_completionSessions.end() &&
+       it->second.filename == filename &&
+       it->second.row == row &&
+       it->second.column == column &&
+       it->second.fingerprint == fingerprint &&
+       it->second.includesFingerprint ==
+                           includesFingerprint(it->second.includedFiles))
+   {
+      json::Object resultJson;
+      resultJson["completions"] = filterCompletions(it->second.completions,
+                                                    userText);
+      pResponse->setResult(resultJson);
+      return Success();
+   }
+
+   // get the translation unit and do the code completion
    TranslationUnit tu = rSourceIndex().getTranslationUnit(filename);
 
    if (!tu.empty())
    {
-      std::string lastTypedText;
-      json::Array completionsJson;
+      CompletionSession session;
+      session.filename = filename;
+      session.row = row;
+      session.column = column;
+      session.fingerprint = fingerprint;
+      session.includedFiles = tu.getIncludedFiles();
+      session.includesFingerprint = includesFingerprint(session.includedFiles);
+
       boost::shared_ptr<CodeCompleteResults> pResults =
                               tu.codeCompleteAt(filename, row, column);
       if (!pResults->empty())
       {
-         // get results
+         // get results (unfiltered, so they can serve later requests)
          for (unsigned i = 0; i<pResults->getNumResults(); i++)
          {
             CodeCompleteResult result = pResults->getResult(i);
 
-            // filter on user text if we have it
-            if (!userText.empty() &&
-                !boost::algorithm::starts_with(result.getTypedText(), userText))
-            {
-               continue;
-            }
-
             // check whether this completion is valid and bail if not
             if (result.getAvailability() != CXAvailability_Available)
             {
                continue;
             }
 
-            std::string typedText = result.getTypedText();
-
-            // if we have the same typed text then just ammend previous result
-            if ((typedText == lastTypedText) && !completionsJson.empty())
-            {
-               json::Object& res = completionsJson.back().get_obj();
-               json::Array& text = res["text"].get_array();
-               text.push_back(friendlyCompletionText(result));
-            }
-            else
-            {
-               completionsJson.push_back(toJson(result));
-            }
-
-            lastTypedText = typedText;
+            session.completions.push_back(
+                     CachedCompletion(result.getTypedText(),
+                                      toJson(result),
+                                      friendlyCompletionText(result)));
          }
       }
 
       json::Object resultJson;
-      resultJson["completions"] = completionsJson;
+      resultJson["completions"] = filterCompletions(session.completions,
+                                                    userText);
       pResponse->setResult(resultJson);
+
+      s_completionSessions[docId] = session;
    }
 
    return Success();
@@ -31,6 +31,10 @@ namespace clang {
 core::Error getCppCompletions(const core::json::JsonRpcRequest& request,
                               core::json::JsonRpcResponse* pResponse);
 
+// discard cached completions for a document
+void clearCompletionSession(const std::string& docId);
+void clearAllCompletionSessions();
+
 void discoverSystemIncludePaths(std::vector<std::string>* pIncludePaths);
 
 } // namespace clang
@@ -28,6 +28,7 @@
 #include <session/SessionModuleContext.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "DefinitionIndexStore.hpp"
 #include "RSourceIndex.hpp"
 #include "RCompilationDatabase.hpp"
 
@@ -44,22 +45,14 @@ namespace {
 // flag indicating whether we are initialized
 bool s_initialized = false;
 
-struct CppDefinitions
-{
-   std::string file;
-   std::time_t fileLastWrite;
-   std::deque<CppDefinition> definitions;
-};
-
-// store definitions by file
-typedef std::map<std::string,CppDefinitions> DefinitionsByFile;
-DefinitionsByFile s_definitionsByFile;
+// on-disk (memory mapped) index of definitions by file
+DefinitionIndexStore s_definitionIndex;
 
 // visitor used to populate deque
 bool insertDefinition(const CppDefinition& definition,
-                      CppDefinitions* pDefinitions)
+                      std::deque<CppDefinition>* pDefinitions)
 {
-   pDefinitions->definitions.push_back(definition);
+   pDefinitions->push_back(definition);
    return true;
 }
 
@@ -182,20 +175,17 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
    // enough index of the file
    if (event.type() == core::system::FileChangeEvent::FileAdded)
    {
-      // if we have a definition
-      DefinitionsByFile::const_iterator it = s_definitionsByFile.find(file);
-      if (it != s_definitionsByFile.end())
+      // if we have a definition which is fresh enough then bail
+      std::time_t fileLastWrite;
+      if (s_definitionIndex.hasFile(file, &fileLastWrite) &&
+          fileLastWrite >= event.fileInfo().lastWriteTime())
       {
-         // if the definition is fresh enough then bail
-         if (it->second.fileLastWrite >= event.fileInfo().lastWriteTime())
-            return;
+         return;
       }
    }
 
-   // always remove existing definitions
-   s_definitionsByFile.erase(file);
-
-   // if this is an add or an update then re-index
+   // if this is an add or an update then re-index (this replaces the file's
+   // segment in the index), otherwise remove the existing definitions
    if (event.type() == core::system::FileChangeEvent::FileAdded ||
        event.type() == core::system::FileChangeEvent::FileModified)
    {    
@@ -226,12 +216,9 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
 
 
          // create definitions and wire visitor to it
-         CppDefinitions definitions;
-         definitions.file = file;
-         definitions.fileLastWrite = event.fileInfo().lastWriteTime();
-         s_definitionsByFile[file] = definitions;
+         std::deque<CppDefinition> definitions;
          DefinitionVisitor visitor =
-            boost::bind(insertDefinition, _1, &s_definitionsByFile[file]);
+            boost::bind(insertDefinition, _1, &definitions);
 
          // visit the cursors
          libclang::clang().visitChildren(
@@ -242,8 +229,28 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
          // dispose translation unit and index
          libclang::clang().disposeTranslationUnit(tu);
          libclang::clang().disposeIndex(index);
+
+         // write the definitions for this file
+         Error error = s_definitionIndex.writeFile(
+                                 file,
+                                 event.fileInfo().lastWriteTime(),
+                                 definitions);
+         if (error)
+            LOG_ERROR(error);
+      }
+      else
+      {
+         Error error = s_definitionIndex.removeFile(file);
+         if (error)
+            LOG_ERROR(error);
       }
    }
+   else
+   {
+      Error error = s_definitionIndex.removeFile(file);
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 } // anonymous namespace
@@ -358,15 +365,9 @@ FileLocation findDefinitionLocation(const FileLocation& location)
 
       // if we didn't find it there then look for it in our index
       // of all saved files
-      BOOST_FOREACH(const DefinitionsByFile::value_type& defs,
-                    s_definitionsByFile)
-      {
-         BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
-         {
-            if (def.USR == USR)
-               return def.location;
-         }
-      }
+      CppDefinition def;
+      if (s_definitionIndex.findDefinition(USR, &def))
+         return def.location;
    }
 
    // see if we can resolve the cursor to a definition (if we can't
@@ -388,14 +389,34 @@ FileLocation findDefinitionLocation(const FileLocation& location)
 
 namespace {
 
+bool nameMatches(const std::string& term,
+                 const boost::regex& pattern,
+                 const std::string& name)
+{
+   if (!pattern.empty())
+      return regex_utils::textMatches(name, pattern, false, false);
+   else
+      return string_utils::isSubsequence(name, term, true);
+}
+
 bool matches(const std::string& term,
              const boost::regex& pattern,
              const CppDefinition& definition)
 {
-   if (!pattern.empty())
-      return regex_utils::textMatches(definition.name, pattern, false, false);
-   else
-      return string_utils::isSubsequence(definition.name, term, true);
+   return nameMatches(term, pattern, definition.name);
+}
+
+bool isIndexedTranslationUnit(const TranslationUnits& units,
+                              const std::string& file)
+{
+   return units.find(file) != units.end();
+}
+
+bool appendDefinition(const CppDefinition& definition,
+                      std::vector<CppDefinition>* pDefinitions)
+{
+   pDefinitions->push_back(definition);
+   return true;
 }
 
 bool insertMatching(const std::string& term,
@@ -409,20 +430,6 @@ bool insertMatching(const std::string& term,
 }
 
 
-json::Object cppDefinitionToJson(const CppDefinition& definition)
-{
-   using namespace safe_convert;
-   json::Object definitionJson;
-   definitionJson["usr"] = definition.USR;
-   definitionJson["kind"] = numberTo<int>(definition.kind, 0);
-   definitionJson["parent_name"] = definition.parentName;
-   definitionJson["name"] = definition.name;
-   definitionJson["file"] = definition.location.filePath.absolutePath();
-   definitionJson["line"] = numberTo<int>(definition.location.line, 1);
-   definitionJson["column"] = numberTo<int>(definition.location.column, 1);
-   return definitionJson;
-}
-
 CppDefinition cppDefinitionFromJson(const json::Object& object)
 {
    // read json
@@ -456,18 +463,28 @@ CppDefinition cppDefinitionFromJson(const json::Object& object)
 }
 
 FilePath definitionIndexFilePath()
+{
+   return module_context::scopedScratchPath().childPath("cpp-definition-index");
+}
+
+// path to the JSON index written by earlier versions
+FilePath legacyDefinitionIndexFilePath()
 {
    return module_context::scopedScratchPath().childPath("cpp-definition-cache");
 }
 
-void loadDefinitionIndex()
+// import a JSON index written by an earlier version into the binary index
+void migrateLegacyDefinitionIndex()
 {
    using namespace safe_convert;
 
-   FilePath indexFilePath = definitionIndexFilePath();
+   FilePath indexFilePath = legacyDefinitionIndexFilePath();
    if (!indexFilePath.exists())
       return;
 
+   // remove the legacy index whether or not we manage to migrate it
+   RemoveOnExitScope removeScope(indexFilePath, ERROR_LOCATION);
+
    std::string contents;
    Error error = readStringFromFile(indexFilePath, &contents);
    if (error)
@@ -494,10 +511,10 @@ void loadDefinitionIndex()
       }
 
       json::Array defsArrayJson;
+      std::string file;
       double fileLastWrite;
-      CppDefinitions definitions;
       Error error = json::readObject(definitionsJson.get_obj(),
-                                     "file", &definitions.file,
+                                     "file", &file,
                                      "file_last_write", &fileLastWrite,
                                      "definitions", &defsArrayJson);
       if (error)
@@ -505,12 +522,12 @@ void loadDefinitionIndex()
          LOG_ERROR(error);
          continue;
       }
-      definitions.fileLastWrite = numberTo<double, std::time_t>(fileLastWrite, 0);
 
       // if the file doesn't exist then bail
-      if (!FilePath::exists(definitions.file))
+      if (!FilePath::exists(file))
          continue;
 
+      std::deque<CppDefinition> definitions;
       BOOST_FOREACH(const json::Value& defJson, defsArrayJson)
       {
          if (!json::isType<json::Object>(defJson))
@@ -521,47 +538,52 @@ void loadDefinitionIndex()
 
          CppDefinition definition = cppDefinitionFromJson(defJson.get_obj());
          if (!definition.empty())
-            definitions.definitions.push_back(definition);
+            definitions.push_back(definition);
       }
 
-      s_definitionsByFile[definitions.file] = definitions;
+      error = s_definitionIndex.writeFile(
+                     file,
+                     numberTo<double, std::time_t>(fileLastWrite, 0),
+                     definitions);
+      if (error)
+         LOG_ERROR(error);
    }
 }
 
-
-void saveDefinitionIndex()
+void loadDefinitionIndex()
 {
-   using namespace safe_convert;
-
-   json::Array indexJson;
-   BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
+   // open the index; only segment headers are read here, definitions are
+   // read from the mapped file as they are searched
+   Error error = s_definitionIndex.open(definitionIndexFilePath());
+   if (error)
    {
-      const CppDefinitions& definitions = defs.second;
-      json::Object definitionsJson;
-      definitionsJson["file"] = definitions.file;
-      definitionsJson["file_last_write"] = numberTo<std::time_t, double>(
-                                               definitions.fileLastWrite, 0);
-      json::Array defsArrayJson;
-      std::transform(definitions.definitions.begin(),
-                     definitions.definitions.end(),
-                     std::back_inserter(defsArrayJson),
-                     cppDefinitionToJson);
-      definitionsJson["definitions"] = defsArrayJson;
+      LOG_ERROR(error);
 
-      indexJson.push_back(definitionsJson);
+      // start over with an empty index
+      error = definitionIndexFilePath().removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+      error = s_definitionIndex.open(definitionIndexFilePath());
+      if (error)
+      {
+         LOG_ERROR(error);
+         return;
+      }
    }
 
-   std::ostringstream ostr;
-   json::writeFormatted(indexJson, ostr);
-   Error error = writeStringToFile(definitionIndexFilePath(), ostr.str());
-   if (error)
-      LOG_ERROR(error);
+   migrateLegacyDefinitionIndex();
 }
 
 void onShutdown(bool terminatedNormally)
 {
+   // definitions are written as files are indexed, so all that's left to do
+   // is drop superseded segments
    if (terminatedNormally)
-      saveDefinitionIndex();
+   {
+      Error error = s_definitionIndex.compactIfNecessary();
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 
@@ -595,21 +617,12 @@ void searchDefinitions(const std::string& term,
    }
 
    // now search the project index (excluding files we already searched
-   // for within the in-memory index)
-   // if we didn't find it there then look for it in our index
-   // of all saved files
-   BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
-   {
-      // skip files we've already searched
-      if (units.find(defs.first) != units.end())
-         continue;
-
-      BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
-      {
-         if (matches(term, pattern, def))
-            pDefinitions->push_back(def);
-      }
-   }
+   // for within the in-memory index). names are matched before the rest of
+   // each definition is read from the index
+   s_definitionIndex.visitDefinitions(
+            boost::bind(appendDefinition, _1, pDefinitions),
+            boost::bind(isIndexedTranslationUnit, boost::cref(units), _1),
+            boost::bind(nameMatches, term, boost::cref(pattern), _1));
 }
 
 Error initializeDefinitionIndex()
@@ -0,0 +1,652 @@
+/*
+ * DefinitionIndexStore.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DefinitionIndexStore.hpp"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include <boost/foreach.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+
+#include <core/Error.hpp>
+#include <core/FileLock.hpp>
+#include <core/Log.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+
+namespace {
+
+const char kFileMagic[4] = { 'R', 'S', 'D', 'X' };
+const uint32_t kFileVersion = 1;
+const std::size_t kFileHeaderSize = sizeof(kFileMagic) + sizeof(uint32_t);
+
+const uint32_t kSegmentMagic = 0x53454731; // "SEG1"
+const uint32_t kSegmentTombstone = 1;
+
+// magic, flags, size, last write (64 bit), file path length
+const std::size_t kSegmentHeaderSize = 4 * sizeof(uint32_t) + sizeof(int64_t);
+
+// kind, usr, parent name, name, file, line, column
+const std::size_t kRecordFields = 7;
+const std::size_t kRecordSize = kRecordFields * sizeof(uint32_t);
+
+// don't bother compacting small indexes
+const std::size_t kMinCompactBytes = 1024 * 1024;
+
+template <typename T>
+void appendValue(T value, std::string* pBuffer)
+{
+   pBuffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(const char* pData)
+{
+   T value;
+   std::memcpy(&value, pData, sizeof(T));
+   return value;
+}
+
+class StringTable
+{
+public:
+   uint32_t add(const std::string& value)
+   {
+      std::map<std::string, uint32_t>::const_iterator it = offsets_.find(value);
+      if (it != offsets_.end())
+         return it->second;
+
+      uint32_t offset = static_cast<uint32_t>(data_.size());
+      data_.append(value);
+      data_.push_back('\0');
+      offsets_[value] = offset;
+      return offset;
+   }
+
+   const std::string& data() const { return data_; }
+
+private:
+   std::map<std::string, uint32_t> offsets_;
+   std::string data_;
+};
+
+std::string encodeSegment(const std::string& file,
+                          std::time_t lastWriteTime,
+                          const std::deque<CppDefinition>& definitions,
+                          uint32_t flags)
+{
+   StringTable strings;
+   std::string records;
+   records.reserve(definitions.size() * kRecordSize);
+   BOOST_FOREACH(const CppDefinition& definition, definitions)
+   {
+      appendValue<uint32_t>(definition.kind, &records);
+      appendValue<uint32_t>(strings.add(definition.USR), &records);
+      appendValue<uint32_t>(strings.add(definition.parentName), &records);
+      appendValue<uint32_t>(strings.add(definition.name), &records);
+      appendValue<uint32_t>(
+         strings.add(definition.location.filePath.absolutePath()), &records);
+      appendValue<uint32_t>(definition.location.line, &records);
+      appendValue<uint32_t>(definition.location.column, &records);
+   }
+
+   std::size_t size = kSegmentHeaderSize + file.size() +
+                      2 * sizeof(uint32_t) +
+                      records.size() + strings.data().size();
+
+   std::string segment;
+   segment.reserve(size);
+   appendValue<uint32_t>(kSegmentMagic, &segment);
+   appendValue<uint32_t>(flags, &segment);
+   appendValue<uint32_t>(static_cast<uint32_t>(size), &segment);
+   appendValue<int64_t>(static_cast<int64_t>(lastWriteTime), &segment);
+   appendValue<uint32_t>(static_cast<uint32_t>(file.size()), &segment);
+   segment.append(file);
+   appendValue<uint32_t>(static_cast<uint32_t>(definitions.size()), &segment);
+   appendValue<uint32_t>(static_cast<uint32_t>(strings.data().size()), &segment);
+   segment.append(records);
+   segment.append(strings.data());
+   return segment;
+}
+
+// find the offset of a string in a segment's string table
+bool findString(const char* pStrings,
+                std::size_t stringsSize,
+                const std::string& value,
+                uint32_t* pOffset)
+{
+   const char* pEnd = pStrings + stringsSize;
+   for (const char* it = pStrings; it < pEnd; )
+   {
+      const char* pNull = static_cast<const char*>(
+                                       std::memchr(it, '\0', pEnd - it));
+      if (pNull == NULL)
+         break;
+
+      std::size_t length = pNull - it;
+      if (length == value.size() &&
+          std::memcmp(it, value.data(), length) == 0)
+      {
+         *pOffset = static_cast<uint32_t>(it - pStrings);
+         return true;
+      }
+
+      it = pNull + 1;
+   }
+
+   return false;
+}
+
+CppDefinition decodeRecord(const char* pStrings, const uint32_t* fields)
+{
+   return CppDefinition(
+            std::string(pStrings + fields[1]),
+            static_cast<CppDefinitionKind>(fields[0]),
+            std::string(pStrings + fields[2]),
+            std::string(pStrings + fields[3]),
+            core::libclang::FileLocation(FilePath(pStrings + fields[4]),
+                                         fields[5],
+                                         fields[6]));
+}
+
+Error corruptIndexError(const FilePath& filePath,
+                        std::size_t offset,
+                        const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::illegal_byte_sequence,
+                             location);
+   error.addProperty("path", filePath);
+   error.addProperty("offset", safe_convert::numberToString(offset));
+   return error;
+}
+
+// identifies a version of the file: another session appending to it changes
+// its size and write time, and compacting it replaces it with a new file
+std::string fileIdentity(const FilePath& filePath)
+{
+   if (!filePath.exists())
+      return std::string();
+
+   std::string identity = safe_convert::numberToString(filePath.size()) + " " +
+                          safe_convert::numberToString(filePath.lastWriteTime());
+#ifndef _WIN32
+   struct stat st;
+   if (::stat(filePath.absolutePath().c_str(), &st) == 0)
+      identity += " " + safe_convert::numberToString(st.st_ino);
+#endif
+   return identity;
+}
+
+Error truncateFile(const FilePath& filePath, std::size_t size)
+{
+   try
+   {
+      boost::filesystem::resize_file(filePath.absolutePathNative(), size);
+   }
+   catch(const boost::filesystem::filesystem_error& e)
+   {
+      Error error(e.code(), ERROR_LOCATION);
+      error.addProperty("path", filePath);
+      return error;
+   }
+   return Success();
+}
+
+} // anonymous namespace
+
+Error DefinitionIndexStore::open(const FilePath& filePath)
+{
+   filePath_ = filePath;
+
+   // write an empty index if we don't have one
+   if (!filePath_.exists() || filePath_.size() < kFileHeaderSize)
+   {
+      std::string header(kFileMagic, sizeof(kFileMagic));
+      appendValue<uint32_t>(kFileVersion, &header);
+      Error error = writeStringToFile(filePath_, header);
+      if (error)
+         return error;
+   }
+
+   Error error = map();
+   if (error)
+      return error;
+
+   // drop files deleted while the session wasn't running
+   bool removedFiles = false;
+   for (std::map<std::string, Segment>::iterator it = segments_.begin();
+        it != segments_.end(); )
+   {
+      if (!FilePath::exists(it->first))
+      {
+         deadBytes_ += it->second.size;
+         liveBytes_ -= it->second.size;
+         segments_.erase(it++);
+         removedFiles = true;
+      }
+      else
+      {
+         ++it;
+      }
+   }
+
+   // a compaction makes those removals durable (and truncates any torn
+   // write, which would otherwise hide segments appended after it)
+   if (removedFiles || tornTail_)
+      return compact();
+   else
+      return compactIfNecessary();
+}
+
+Error DefinitionIndexStore::map()
+{
+   unmap();
+
+   Error error = mapFile();
+   if (error)
+      return error;
+
+   const char* pData = file_.data();
+   std::size_t size = file_.size();
+   if (size < kFileHeaderSize ||
+       std::memcmp(pData, kFileMagic, sizeof(kFileMagic)) != 0 ||
+       readValue<uint32_t>(pData + sizeof(kFileMagic)) != kFileVersion)
+   {
+      unmap();
+      return corruptIndexError(filePath_, 0, ERROR_LOCATION);
+   }
+
+   scanSegments(kFileHeaderSize);
+   return Success();
+}
+
+Error DefinitionIndexStore::mapFile()
+{
+   try
+   {
+      mappedIdentity_ = fileIdentity(filePath_);
+      file_.open(filePath_.absolutePath());
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", filePath_);
+      error.addProperty("what", e.what());
+      return error;
+   }
+
+   return Success();
+}
+
+void DefinitionIndexStore::scanSegments(std::size_t offset)
+{
+   // scan segment headers only (records are decoded lazily)
+   const char* pData = file_.data();
+   std::size_t size = file_.size();
+   endOffset_ = offset;
+   while (offset < size)
+   {
+      const char* pSegment = pData + offset;
+      std::size_t remaining = size - offset;
+      if (remaining < kSegmentHeaderSize ||
+          readValue<uint32_t>(pSegment) != kSegmentMagic)
+      {
+         // a torn write at the end of the index; ignore the remainder
+         LOG_ERROR(corruptIndexError(filePath_, offset, ERROR_LOCATION));
+         deadBytes_ += remaining;
+         tornTail_ = true;
+         break;
+      }
+
+      uint32_t flags = readValue<uint32_t>(pSegment + 4);
+      std::size_t segmentSize = readValue<uint32_t>(pSegment + 8);
+      int64_t lastWriteTime = readValue<int64_t>(pSegment + 12);
+      std::size_t fileLen = readValue<uint32_t>(pSegment + 20);
+      std::size_t bodyOffset = kSegmentHeaderSize + fileLen;
+      if (segmentSize > remaining ||
+          bodyOffset + 2 * sizeof(uint32_t) > segmentSize)
+      {
+         LOG_ERROR(corruptIndexError(filePath_, offset, ERROR_LOCATION));
+         deadBytes_ += remaining;
+         tornTail_ = true;
+         break;
+      }
+
+      Segment segment;
+      segment.offset = offset;
+      segment.size = segmentSize;
+      segment.lastWriteTime = static_cast<std::time_t>(lastWriteTime);
+      segment.numRecords = readValue<uint32_t>(pSegment + bodyOffset);
+      segment.stringsSize = readValue<uint32_t>(pSegment + bodyOffset + 4);
+      segment.recordsOffset = offset + bodyOffset + 2 * sizeof(uint32_t);
+      segment.stringsOffset = segment.recordsOffset +
+                              segment.numRecords * kRecordSize;
+      if (segment.stringsOffset + segment.stringsSize != offset + segmentSize)
+      {
+         LOG_ERROR(corruptIndexError(filePath_, offset, ERROR_LOCATION));
+         deadBytes_ += remaining;
+         tornTail_ = true;
+         break;
+      }
+
+      // later segments supersede earlier ones for the same file
+      std::string file(pSegment + kSegmentHeaderSize, fileLen);
+      std::map<std::string, Segment>::iterator it = segments_.find(file);
+      if (it != segments_.end())
+      {
+         deadBytes_ += it->second.size;
+         liveBytes_ -= it->second.size;
+         segments_.erase(it);
+      }
+
+      if (flags & kSegmentTombstone)
+      {
+         deadBytes_ += segmentSize;
+      }
+      else
+      {
+         segments_[file] = segment;
+         liveBytes_ += segmentSize;
+      }
+
+      offset += segmentSize;
+      endOffset_ = offset;
+   }
+}
+
+void DefinitionIndexStore::unmap()
+{
+   if (file_.is_open())
+      file_.close();
+   segments_.clear();
+   deadBytes_ = 0;
+   liveBytes_ = 0;
+   endOffset_ = 0;
+   tornTail_ = false;
+   mappedIdentity_.clear();
+}
+
+bool DefinitionIndexStore::changedOnDisk() const
+{
+   return fileIdentity(filePath_) != mappedIdentity_;
+}
+
+FilePath DefinitionIndexStore::lockFilePath() const
+{
+   return filePath_.parent().complete(filePath_.filename() + ".lock");
+}
+
+bool DefinitionIndexStore::hasFile(const std::string& file,
+                                   std::time_t* pLastWriteTime) const
+{
+   std::map<std::string, Segment>::const_iterator it = segments_.find(file);
+   if (it == segments_.end())
+      return false;
+
+   *pLastWriteTime = it->second.lastWriteTime;
+   return true;
+}
+
+Error DefinitionIndexStore::appendSegment(const std::string& segment)
+{
+   ScopedFileLock lock(FileLock::createDefault(), lockFilePath());
+   if (lock.error())
+      return lock.error();
+
+   // pick up segments appended (or a compaction made) by another session
+   if (!file_.is_open() || changedOnDisk())
+   {
+      Error error = map();
+      if (error)
+         return error;
+   }
+
+   // release the mapping while we append (required on Windows)
+   std::size_t offset = endOffset_;
+   std::size_t tornBytes = file_.size() - offset;
+   file_.close();
+
+   // the new segment goes after the last intact one (a torn write before it
+   // would hide it), and is dropped if it can't be written in full
+   Error error;
+   if (tornBytes > 0)
+      error = truncateFile(filePath_, offset);
+   if (!error)
+   {
+      boost::shared_ptr<std::ostream> pOfs;
+      error = filePath_.open_w(&pOfs, false);
+      if (!error)
+      {
+         pOfs->write(segment.data(), segment.size());
+         pOfs->flush();
+         if (!pOfs->good())
+         {
+            error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+            error.addProperty("path", filePath_);
+         }
+      }
+      pOfs.reset();
+
+      if (error)
+      {
+         Error truncateError = truncateFile(filePath_, offset);
+         if (truncateError)
+            LOG_ERROR(truncateError);
+      }
+   }
+
+   // map the file again and read just what follows the last intact segment
+   // (the segments before it are already known)
+   deadBytes_ -= tornBytes;
+   tornTail_ = false;
+   Error mapError = mapFile();
+   if (mapError)
+   {
+      LOG_ERROR(mapError);
+      unmap();
+   }
+   else
+   {
+      scanSegments(offset);
+   }
+
+   return error;
+}
+
+Error DefinitionIndexStore::writeFile(const std::string& file,
+                                      std::time_t lastWriteTime,
+                                      const std::deque<CppDefinition>& definitions)
+{
+   return appendSegment(encodeSegment(file, lastWriteTime, definitions, 0));
+}
+
+Error DefinitionIndexStore::removeFile(const std::string& file)
+{
+   if (segments_.find(file) == segments_.end())
+      return Success();
+
+   return appendSegment(encodeSegment(file,
+                                      0,
+                                      std::deque<CppDefinition>(),
+                                      kSegmentTombstone));
+}
+
+bool DefinitionIndexStore::isValidRecord(const Segment& segment,
+                                         const uint32_t* fields)
+{
+   // guard against offsets outside of the string table
+   for (std::size_t i = 1; i <= 4; i++)
+   {
+      if (fields[i] >= segment.stringsSize)
+         return false;
+   }
+   return true;
+}
+
+bool DefinitionIndexStore::visitSegment(const Segment& segment,
+                                        const Visitor& visitor,
+                                        const FileFilter& nameMatches) const
+{
+   const char* pData = file_.data();
+   const char* pStrings = pData + segment.stringsOffset;
+
+   for (uint32_t i = 0; i < segment.numRecords; i++)
+   {
+      uint32_t fields[kRecordFields];
+      std::memcpy(fields,
+                  pData + segment.recordsOffset + (i * kRecordSize),
+                  kRecordSize);
+
+      if (!isValidRecord(segment, fields))
+         continue;
+
+      if (nameMatches && !nameMatches(std::string(pStrings + fields[3])))
+         continue;
+
+      if (!visitor(decodeRecord(pStrings, fields)))
+         return false;
+   }
+
+   return true;
+}
+
+bool DefinitionIndexStore::findDefinition(const std::string& USR,
+                                          CppDefinition* pDefinition) const
+{
+   if (!file_.is_open() || USR.empty())
+      return false;
+
+   const char* pData = file_.data();
+
+   typedef std::map<std::string, Segment>::value_type SegmentEntry;
+   BOOST_FOREACH(const SegmentEntry& entry, segments_)
+   {
+      // strings are stored once per segment, so a definition with this USR
+      // refers to the string's offset; skip segments without the string
+      const Segment& segment = entry.second;
+      const char* pStrings = pData + segment.stringsOffset;
+      uint32_t usrOffset = 0;
+      if (!findString(pStrings, segment.stringsSize, USR, &usrOffset))
+         continue;
+
+      for (uint32_t i = 0; i < segment.numRecords; i++)
+      {
+         const char* pRecord = pData + segment.recordsOffset + (i * kRecordSize);
+         if (readValue<uint32_t>(pRecord + sizeof(uint32_t)) != usrOffset)
+            continue;
+
+         uint32_t fields[kRecordFields];
+         std::memcpy(fields, pRecord, kRecordSize);
+         if (!isValidRecord(segment, fields))
+            continue;
+
+         *pDefinition = decodeRecord(pStrings, fields);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void DefinitionIndexStore::visitDefinitions(const Visitor& visitor,
+                                            const FileFilter& skipFile,
+                                            const FileFilter& nameMatches) const
+{
+   if (!file_.is_open())
+      return;
+
+   typedef std::map<std::string, Segment>::value_type SegmentEntry;
+   BOOST_FOREACH(const SegmentEntry& entry, segments_)
+   {
+      if (skipFile && skipFile(entry.first))
+         continue;
+
+      if (!visitSegment(entry.second, visitor, nameMatches))
+         break;
+   }
+}
+
+Error DefinitionIndexStore::compactIfNecessary()
+{
+   if (deadBytes_ > kMinCompactBytes && deadBytes_ > liveBytes_)
+      return compact();
+   else
+      return Success();
+}
+
+Error DefinitionIndexStore::compact()
+{
+   if (!file_.is_open())
+      return Success();
+
+   ScopedFileLock lock(FileLock::createDefault(), lockFilePath());
+   if (lock.error())
+      return lock.error();
+
+   // don't drop segments appended by another session
+   if (changedOnDisk())
+   {
+      Error error = map();
+      if (error)
+         return error;
+   }
+
+   return writeCompacted();
+}
+
+Error DefinitionIndexStore::writeCompacted()
+{
+   // write the live segments to a new file
+   std::string contents(kFileMagic, sizeof(kFileMagic));
+   appendValue<uint32_t>(kFileVersion, &contents);
+   contents.reserve(kFileHeaderSize + liveBytes_);
+
+   typedef std::map<std::string, Segment>::value_type SegmentEntry;
+   BOOST_FOREACH(const SegmentEntry& entry, segments_)
+   {
+      contents.append(file_.data() + entry.second.offset, entry.second.size);
+   }
+
+   FilePath tempPath = filePath_.parent().complete(
+                                       filePath_.filename() + ".compact");
+   Error error = writeStringToFile(tempPath, contents);
+   if (error)
+      return error;
+
+   // swap it in
+   unmap();
+   error = tempPath.move(filePath_);
+   if (error)
+      LOG_ERROR(error);
+
+   return map();
+}
+
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
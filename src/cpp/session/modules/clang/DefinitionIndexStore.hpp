@@ -0,0 +1,145 @@
+/*
+ * DefinitionIndexStore.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_MODULES_CLANG_DEFINITION_INDEX_STORE_HPP
+#define SESSION_MODULES_CLANG_DEFINITION_INDEX_STORE_HPP
+
+#include <ctime>
+#include <deque>
+#include <map>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <core/FilePath.hpp>
+
+#include "DefinitionIndex.hpp"
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+
+// On-disk index of C++ definitions, organized as an append-only sequence of
+// per-file segments. Each segment holds the indexed file's path and last
+// write time, a block of fixed-size definition records, and a string table
+// the records refer into. The file is memory mapped and only the segment
+// headers are read when it is opened; definitions are decoded on demand
+// while searching. Re-indexing a file appends a new segment (or a tombstone
+// when a file is removed) which supersedes any earlier segment for the same
+// file; superseded segments are dropped by compact().
+//
+// Sessions with the same scratch path share the index, so it's only written
+// (appended to or compacted) while holding a lock, and a session which
+// finds the file changed by another maps it again before writing.
+class DefinitionIndexStore : boost::noncopyable
+{
+public:
+   typedef boost::function<bool(const CppDefinition&)> Visitor;
+   typedef boost::function<bool(const std::string&)> FileFilter;
+
+   DefinitionIndexStore()
+      : deadBytes_(0), liveBytes_(0), endOffset_(0), tornTail_(false)
+   {
+   }
+
+   // open (creating if necessary) the index at the given path
+   core::Error open(const core::FilePath& filePath);
+
+   // is there an index for the given file, and when was it written?
+   bool hasFile(const std::string& file, std::time_t* pLastWriteTime) const;
+
+   // replace the definitions for a file / remove a file from the index
+   core::Error writeFile(const std::string& file,
+                         std::time_t lastWriteTime,
+                         const std::deque<CppDefinition>& definitions);
+   core::Error removeFile(const std::string& file);
+
+   // visit definitions (optionally skipping some files); visitation stops
+   // when the visitor returns false. the name matcher (if provided) is
+   // applied to the raw name before the full definition is decoded
+   void visitDefinitions(const Visitor& visitor,
+                         const FileFilter& skipFile = FileFilter(),
+                         const FileFilter& nameMatches = FileFilter()) const;
+
+   // find the definition with the given USR (only definitions with that
+   // USR are decoded)
+   bool findDefinition(const std::string& USR,
+                       CppDefinition* pDefinition) const;
+
+   // rewrite the index without superseded segments if they dominate it
+   core::Error compactIfNecessary();
+   core::Error compact();
+
+private:
+   struct Segment
+   {
+      Segment()
+         : offset(0), size(0), lastWriteTime(0),
+           numRecords(0), recordsOffset(0), stringsOffset(0), stringsSize(0)
+      {
+      }
+      std::size_t offset;
+      std::size_t size;
+      std::time_t lastWriteTime;
+      uint32_t numRecords;
+      std::size_t recordsOffset;
+      std::size_t stringsOffset;
+      std::size_t stringsSize;
+   };
+
+   core::Error map();
+   core::Error mapFile();
+   void scanSegments(std::size_t offset);
+   void unmap();
+   bool changedOnDisk() const;
+   core::FilePath lockFilePath() const;
+   core::Error appendSegment(const std::string& segment);
+   core::Error writeCompacted();
+   static bool isValidRecord(const Segment& segment, const uint32_t* fields);
+   bool visitSegment(const Segment& segment,
+                     const Visitor& visitor,
+                     const FileFilter& nameMatches) const;
+
+private:
+   core::FilePath filePath_;
+   boost::iostreams::mapped_file_source file_;
+   std::map<std::string, Segment> segments_;
+   std::size_t deadBytes_;
+   std::size_t liveBytes_;
+
+   // the end of the last intact segment (anything after it is torn)
+   std::size_t endOffset_;
+   bool tornTail_;
+
+   // the size, write time, etc. of the file when it was mapped
+   std::string mappedIdentity_;
+};
+
+} // namespace clang
+} // namepace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_MODULES_CLANG_DEFINITION_INDEX_STORE_HPP
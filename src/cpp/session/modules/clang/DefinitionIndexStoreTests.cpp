@@ -0,0 +1,363 @@
+/*
+ * DefinitionIndexStoreTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DefinitionIndexStore.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <boost/bind.hpp>
+
+#include <core/Error.hpp>
+#include <core/FileLock.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempIndexDir
+{
+public:
+   TempIndexDir()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempIndexDir()
+   {
+      dir_.removeIfExists();
+   }
+
+   FilePath indexPath() const { return dir_.complete("definitions.idx"); }
+
+   // indexed source files (the index drops files which don't exist)
+   std::string sourceFile(const std::string& name) const
+   {
+      FilePath path = dir_.complete(name);
+      if (!path.exists())
+         writeStringToFile(path, "// " + name);
+      return path.absolutePath();
+   }
+
+private:
+   FilePath dir_;
+};
+
+CppDefinition definition(const std::string& file,
+                         const std::string& name,
+                         unsigned line)
+{
+   return CppDefinition("c:@F@" + name,
+                        CppFunctionDefinition,
+                        "",
+                        name,
+                        libclang::FileLocation(FilePath(file), line, 1));
+}
+
+std::deque<CppDefinition> definitions(const std::string& file,
+                                      const std::string& prefix,
+                                      int count)
+{
+   std::deque<CppDefinition> defs;
+   for (int i = 0; i < count; i++)
+   {
+      defs.push_back(definition(file,
+                                prefix + safe_convert::numberToString(i),
+                                i + 1));
+   }
+   return defs;
+}
+
+bool collect(const CppDefinition& definition,
+             std::vector<CppDefinition>* pDefinitions)
+{
+   pDefinitions->push_back(definition);
+   return true;
+}
+
+std::vector<CppDefinition> allDefinitions(const DefinitionIndexStore& store)
+{
+   std::vector<CppDefinition> defs;
+   store.visitDefinitions(boost::bind(collect, _1, &defs));
+   return defs;
+}
+
+bool nameIs(const std::string& expected, const std::string& name)
+{
+   return name == expected;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Definition Index Store")
+{
+   TempIndexDir temp;
+   std::string fooFile = temp.sourceFile("foo.cpp");
+   std::string barFile = temp.sourceFile("bar.cpp");
+
+   SECTION("Definitions round trip through the index")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 42, definitions(fooFile, "foo", 3)));
+
+      std::time_t lastWriteTime = 0;
+      REQUIRE(store.hasFile(fooFile, &lastWriteTime));
+      CHECK(lastWriteTime == 42);
+      CHECK_FALSE(store.hasFile(barFile, &lastWriteTime));
+
+      std::vector<CppDefinition> defs = allDefinitions(store);
+      REQUIRE(defs.size() == 3);
+      CHECK(defs[1].name == "foo1");
+      CHECK(defs[1].USR == "c:@F@foo1");
+      CHECK(defs[1].kind == CppFunctionDefinition);
+      CHECK(defs[1].location.filePath.absolutePath() == fooFile);
+      CHECK(defs[1].location.line == 2);
+   }
+
+   SECTION("Definitions persist when the index is reopened")
+   {
+      {
+         DefinitionIndexStore store;
+         REQUIRE(!store.open(temp.indexPath()));
+         REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 2)));
+         REQUIRE(!store.writeFile(barFile, 2, definitions(barFile, "bar", 2)));
+      }
+
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      CHECK(allDefinitions(store).size() == 4);
+   }
+
+   SECTION("Writing a file supersedes its earlier definitions")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "old", 5)));
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 1)));
+      REQUIRE(!store.writeFile(fooFile, 2, definitions(fooFile, "new", 2)));
+
+      std::vector<CppDefinition> defs = allDefinitions(store);
+      CHECK(defs.size() == 3);
+
+      std::vector<CppDefinition> matches;
+      store.visitDefinitions(boost::bind(collect, _1, &matches),
+                             DefinitionIndexStore::FileFilter(),
+                             boost::bind(nameIs, "old0", _1));
+      CHECK(matches.empty());
+
+      // the appended segments are read back the same way when reopened
+      DefinitionIndexStore reopened;
+      REQUIRE(!reopened.open(temp.indexPath()));
+      CHECK(allDefinitions(reopened).size() == 3);
+   }
+
+   SECTION("Removed files are tombstoned")
+   {
+      {
+         DefinitionIndexStore store;
+         REQUIRE(!store.open(temp.indexPath()));
+         REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 2)));
+         REQUIRE(!store.removeFile(fooFile));
+
+         std::time_t lastWriteTime = 0;
+         CHECK_FALSE(store.hasFile(fooFile, &lastWriteTime));
+         CHECK(allDefinitions(store).empty());
+      }
+
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      CHECK(allDefinitions(store).empty());
+   }
+
+   SECTION("Definitions are found by USR")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 10)));
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 10)));
+
+      CppDefinition def;
+      REQUIRE(store.findDefinition("c:@F@bar7", &def));
+      CHECK(def.name == "bar7");
+      CHECK(def.location.filePath.absolutePath() == barFile);
+      CHECK(def.location.line == 8);
+
+      // a prefix of an existing USR isn't a match
+      CHECK_FALSE(store.findDefinition("c:@F@bar", &def));
+      CHECK_FALSE(store.findDefinition("c:@F@baz1", &def));
+   }
+
+   SECTION("Files skipped by the filter aren't visited")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 2)));
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 3)));
+
+      std::vector<CppDefinition> defs;
+      store.visitDefinitions(boost::bind(collect, _1, &defs),
+                             boost::bind(nameIs, fooFile, _1));
+      CHECK(defs.size() == 3);
+   }
+
+   SECTION("A torn write at the end of the index is dropped")
+   {
+      {
+         DefinitionIndexStore store;
+         REQUIRE(!store.open(temp.indexPath()));
+         REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 3)));
+      }
+      uintmax_t intactSize = temp.indexPath().size();
+
+      // simulate a segment which was only partially written
+      std::string contents;
+      REQUIRE(!readStringFromFile(temp.indexPath(), &contents));
+      contents.append(contents.substr(8, 20));
+      REQUIRE(!writeStringToFile(temp.indexPath(), contents));
+
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      CHECK(allDefinitions(store).size() == 3);
+      CHECK(temp.indexPath().size() == intactSize);
+
+      // and segments written afterwards are readable
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 1)));
+      DefinitionIndexStore reopened;
+      REQUIRE(!reopened.open(temp.indexPath()));
+      CHECK(allDefinitions(reopened).size() == 4);
+   }
+
+   SECTION("A torn write by another session is dropped before appending")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 3)));
+      uintmax_t intactSize = temp.indexPath().size();
+
+      // a session which crashed part way through appending a segment
+      std::string contents;
+      REQUIRE(!readStringFromFile(temp.indexPath(), &contents));
+      REQUIRE(!appendToFile(temp.indexPath(), contents.substr(8, 20)));
+
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 1)));
+      CHECK(allDefinitions(store).size() == 4);
+
+      // the new segment directly follows the intact ones
+      DefinitionIndexStore reopened;
+      REQUIRE(!reopened.open(temp.indexPath()));
+      CHECK(allDefinitions(reopened).size() == 4);
+      REQUIRE(!reopened.writeFile(fooFile, 2, definitions(fooFile, "foo", 3)));
+      CHECK(allDefinitions(reopened).size() == 4);
+      CHECK(temp.indexPath().size() > intactSize);
+   }
+
+   SECTION("Sessions sharing the index see each other's writes")
+   {
+      DefinitionIndexStore first;
+      DefinitionIndexStore second;
+      REQUIRE(!first.open(temp.indexPath()));
+      REQUIRE(!second.open(temp.indexPath()));
+
+      REQUIRE(!first.writeFile(fooFile, 1, definitions(fooFile, "foo", 3)));
+      REQUIRE(!second.writeFile(barFile, 1, definitions(barFile, "bar", 2)));
+      CHECK(allDefinitions(second).size() == 5);
+
+      // a compaction by one replaces the file the other has mapped
+      REQUIRE(!second.compact());
+      REQUIRE(!first.writeFile(fooFile, 2, definitions(fooFile, "foo", 4)));
+      CHECK(allDefinitions(first).size() == 6);
+
+      std::time_t lastWriteTime = 0;
+      REQUIRE(first.hasFile(barFile, &lastWriteTime));
+      CHECK(lastWriteTime == 1);
+
+      // and a compaction keeps segments appended since it last mapped the file
+      REQUIRE(!second.compact());
+      DefinitionIndexStore reopened;
+      REQUIRE(!reopened.open(temp.indexPath()));
+      CHECK(allDefinitions(reopened).size() == 6);
+      REQUIRE(reopened.hasFile(fooFile, &lastWriteTime));
+      CHECK(lastWriteTime == 2);
+   }
+
+   SECTION("The index isn't written while another session holds its lock")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 3)));
+      uintmax_t size = temp.indexPath().size();
+
+      FilePath lockPath(temp.indexPath().absolutePath() + ".lock");
+      boost::shared_ptr<FileLock> pLock = FileLock::createDefault();
+      REQUIRE(!pLock->acquire(lockPath));
+      CHECK(store.writeFile(barFile, 1, definitions(barFile, "bar", 1)));
+      CHECK(temp.indexPath().size() == size);
+      REQUIRE(!pLock->release());
+
+      REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 1)));
+      CHECK(allDefinitions(store).size() == 4);
+   }
+
+   SECTION("Files deleted while the index was closed are dropped")
+   {
+      {
+         DefinitionIndexStore store;
+         REQUIRE(!store.open(temp.indexPath()));
+         REQUIRE(!store.writeFile(fooFile, 1, definitions(fooFile, "foo", 3)));
+         REQUIRE(!store.writeFile(barFile, 1, definitions(barFile, "bar", 3)));
+      }
+      REQUIRE(!FilePath(barFile).remove());
+
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      CHECK(allDefinitions(store).size() == 3);
+   }
+
+   SECTION("Compaction keeps only live segments")
+   {
+      DefinitionIndexStore store;
+      REQUIRE(!store.open(temp.indexPath()));
+      for (int i = 0; i < 5; i++)
+      {
+         REQUIRE(!store.writeFile(fooFile, i, definitions(fooFile, "foo", 100)));
+      }
+      uintmax_t size = temp.indexPath().size();
+
+      REQUIRE(!store.compact());
+      CHECK(temp.indexPath().size() < size / 4);
+      CHECK(allDefinitions(store).size() == 100);
+
+      std::time_t lastWriteTime = 0;
+      REQUIRE(store.hasFile(fooFile, &lastWriteTime));
+      CHECK(lastWriteTime == 4);
+   }
+}
+
+} // namespace tests
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -15,12 +15,16 @@
 
 #include "RSourceIndex.hpp"
 
+#include <algorithm>
+
 #include <boost/bind.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <core/FileInfo.hpp>
 #include <core/FilePath.hpp>
 
+#include <r/ROptions.hpp>
+
 #include <session/SessionUserSettings.hpp>
 
 #include <core/libclang/LibClang.hpp>
@@ -43,6 +47,23 @@ public:
    RSourceIndex()
       : SourceIndex(rCompilationDatabase(), userSettings().clangVerbose())
    {
+      // parse new translation units in the background so that opening large
+      // C++ files doesn't block the main thread
+      int workers = r::options::getOption<int>("rstudio.indexCppWorkers",
+                                               2, false);
+      if (workers > 0)
+         startWorkers(workers);
+
+      int timeoutMs = r::options::getOption<int>("rstudio.indexCppTimeoutMs",
+                                                 2000, false);
+      setParseTimeout(boost::posix_time::milliseconds(std::max(timeoutMs, 0)));
+
+      // evict the least recently used translation units beyond this limit
+      int memoryLimitMb = r::options::getOption<int>(
+                                       "rstudio.indexCppMemoryLimitMb",
+                                       2048, false);
+      if (memoryLimitMb > 0)
+         setMemoryBudget(static_cast<std::size_t>(memoryLimitMb) * 1024 * 1024);
    }
 };
 
@@ -145,12 +145,16 @@ void onSourceDocRemoved(const std::string& id, const std::string& path)
 
    // remove the translation unit
    rSourceIndex().removeTranslationUnit(resolvedPath);
+
+   // discard any cached completions
+   clearCompletionSession(id);
 }
 
 void onAllSourceDocsRemoved()
 {
    rSourceIndex().unsavedFiles().removeAll();
    rSourceIndex().removeAllTranslationUnits();
+   clearAllCompletionSessions();
 }
 
 bool cppIndexingDisabled()
@@ -59,6 +59,15 @@ json::Value descriptionOfVar(SEXP var)
    }
 }
 
+double promiseSizeOfVar(SEXP var)
+{
+   double size = 0;
+   Error error = r::exec::RFunction(".rs.promiseSize", var).call(&size);
+   if (error)
+      LOG_ERROR(error);
+   return size;
+}
+
 } // anonymous namespace
 
 // a variable is an unevaluated promise if its promise value is still unbound
@@ -207,7 +216,8 @@ json::Value varToJson(SEXP env, const r::sexp::Variable& var)
       varJson["description"] = std::string("");
       varJson["contents"] = json::Array();
       varJson["length"] = 0;
-      varJson["size"] = 0;
+      varJson["size"] = isUnevaluatedPromise(varSEXP) ?
+                              promiseSizeOfVar(varSEXP) : 0;
       varJson["contents_deferred"] = false;
    }
    // For all other value types, construct the definition normally.
@@ -24,6 +24,8 @@
 
 #include <r/RExec.hpp>
 
+#include "JobOutputJournal.hpp"
+
 #define kJobId          "id"
 #define kJobName        "name"
 #define kJobStatus      "status"
@@ -302,6 +304,11 @@ void Job::setState(JobState state)
    // if we don't already have it
    if (complete() && completed_ == 0)
       completed_ = ::time(0);
+
+   // no more output is coming; write out what's buffered and release the
+   // journal's files
+   if (complete() && pOutputJournal_)
+      pOutputJournal_->close();
 }
 
 void Job::setListening(bool listening)
@@ -385,93 +392,60 @@ void Job::addOutput(const std::string& output, bool asError)
    if (!saveOutput_)
       return;
 
-   // look up output file
-   Error error;
-   FilePath outputFile = outputCacheFile();
-
-   // create parent folder if necessary
-   if (!outputFile.parent().exists())
-   {
-      error = outputFile.parent().ensureDirectory();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-   }
-
-   // open output file for writing
-   boost::shared_ptr<std::ostream> file;
-   error = outputFile.open_w(&file, false /* don't truncate */);
-   if (error)
-   {
-      LOG_ERROR(error);
-      return;
-   }
-
-   // create json array with output and write it to the file
+   // append a json array with the output to the journal (it's newline-delimited JSON)
    json::Array contents;
    contents.push_back(type);
    contents.push_back(output);
-   json::write(contents, *file);
-
-   // append a newline (the file is newline-delimited JSON)
-   *file << std::endl;
+   Error error = outputJournal().append(json::write(contents));
+   if (error)
+      LOG_ERROR(error);
 }
 
 json::Array Job::output(int position)
 {
-   // read the lines from the file
-   json::Array output;
-   FilePath outputFile = outputCacheFile();
-   boost::shared_ptr<std::istream> pIfs;
-   Error error = outputFile.open_r(&pIfs);
+   // read the lines from the journal, starting at the requested position
+   std::vector<std::string> lines;
+   Error error = outputJournal().read(position, &lines);
    if (error)
    {
-      // path not found is expected if the job hasn't produced any output yet
-      if (!isPathNotFoundError(error))
-         LOG_ERROR(error);
+      LOG_ERROR(error);
       return json::Array();
    }
 
-   try
-   {
-      int line = 0;
-      std::string content;
-      json::Value val;
-
-      // reading eof can trigger a failbit
-      pIfs->exceptions(std::istream::badbit);
-
-      // read each line; parse it as JSON and add it to the output array if it's past the sought
-      // position
-      while (!pIfs->eof())
-      {
-         std::getline(*pIfs, content);
-         if (++line > position)
-         {
-            if (json::parse(content, &val))
-            {
-               output.push_back(val);
-            }
-         }
-      }
-   }
-   catch(const std::exception& e)
+   // parse each line as JSON and add it to the output array
+   json::Array output;
+   json::Value val;
+   for (std::vector<std::string>::const_iterator it = lines.begin(); it != lines.end(); ++it)
    {
-      error = systemError(boost::system::errc::io_error, 
-                                ERROR_LOCATION);
-      error.addProperty("what", e.what());
-      error.addProperty("path", outputFile.absolutePath());
-      LOG_ERROR(error);
+      if (json::parse(*it, &val))
+         output.push_back(val);
    }
 
    return output;
 }
 
+void Job::flushOutput()
+{
+   if (!pOutputJournal_)
+      return;
+
+   // (output added after the job completed doesn't keep the files open)
+   if (complete())
+      pOutputJournal_->close();
+   else
+      pOutputJournal_->flush();
+}
+
+JobOutputJournal& Job::outputJournal()
+{
+   if (!pOutputJournal_)
+      pOutputJournal_.reset(new JobOutputJournal(outputCacheFile()));
+   return *pOutputJournal_;
+}
+
 void Job::cleanup()
 {
-   outputCacheFile().removeIfExists();
+   outputJournal().remove();
 }
 
 std::string Job::stateAsString(JobState state)
@@ -0,0 +1,546 @@
+/*
+ * JobOutputJournal.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "JobOutputJournal.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+
+namespace {
+
+const char kIndexMagic[4] = { 'R', 'S', 'J', 'I' };
+const boost::uint32_t kIndexVersion = 1;
+
+// when the journal outgrows its limit, the oldest lines are dropped until
+// it's this fraction of the limit (so truncation isn't needed again soon)
+const std::size_t kRetainNumerator = 3;
+const std::size_t kRetainDenominator = 4;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+template <typename T>
+void writeValue(std::ostream& os, T value)
+{
+   os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::istream& is, T* pValue)
+{
+   is.read(reinterpret_cast<char*>(pValue), sizeof(T));
+   return is.gcount() == static_cast<std::streamsize>(sizeof(T));
+}
+
+Error ioError(const FilePath& path, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("path", path);
+   return error;
+}
+
+// flush what's been written to the file to disk
+Error syncPath(const FilePath& path)
+{
+#ifndef _WIN32
+   int fd = ::open(path.absolutePath().c_str(), O_RDONLY);
+   if (fd == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", path);
+      return error;
+   }
+
+   int result;
+   do
+   {
+      result = ::fsync(fd);
+   } while (result == -1 && errno == EINTR);
+
+   Error error;
+   if (result == -1)
+   {
+      error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", path);
+   }
+
+   ::close(fd);
+   return error;
+#else
+   return Success();
+#endif
+}
+
+} // anonymous namespace
+
+const std::size_t JobOutputJournal::kDefaultMaxBytes = 32 * 1024 * 1024;
+const boost::posix_time::time_duration JobOutputJournal::kFlushInterval =
+      boost::posix_time::seconds(1);
+const boost::posix_time::time_duration JobOutputJournal::kSyncInterval =
+      boost::posix_time::seconds(10);
+
+JobOutputJournal::JobOutputJournal(const FilePath& path, std::size_t maxBytes)
+   : path_(path),
+     indexPath_(path.parent().complete(path.stem() + ".idx")),
+     maxBytes_(maxBytes),
+     open_(false),
+     pending_(false),
+     unsynced_(false),
+     lastFlush_(now()),
+     lastSync_(now()),
+     size_(0),
+     firstLine_(0)
+{
+}
+
+JobOutputJournal::~JobOutputJournal()
+{
+   try
+   {
+      closeWriters();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error JobOutputJournal::append(const std::string& line)
+{
+   Error error = open(true);
+   if (error)
+      return error;
+
+   if (!pData_ || !pIndex_)
+   {
+      error = openWriters();
+      if (error)
+         return error;
+   }
+
+   offsets_.push_back(size_);
+   writeValue(*pIndex_, size_);
+   pData_->write(line.data(), line.size());
+   pData_->put('\n');
+   size_ += line.size() + 1;
+   pending_ = true;
+
+   if (!*pData_)
+   {
+      closeWriters();
+      return ioError(path_, ERROR_LOCATION);
+   }
+
+   if (now() - lastFlush_ >= kFlushInterval)
+      flush();
+
+   if (size_ > maxBytes_)
+      return truncateHead();
+
+   return Success();
+}
+
+Error JobOutputJournal::read(int position, std::vector<std::string>* pLines)
+{
+   // no output yet
+   if (!open_ && !path_.exists())
+      return Success();
+
+   Error error = open(false);
+   if (error)
+      return error;
+
+   // (the writers are reopened by the next append; on Windows they hold the
+   // files exclusively)
+   closeWriters();
+
+   std::size_t index = 0;
+   if (position > 0 && static_cast<boost::uint64_t>(position) > firstLine_)
+      index = static_cast<std::size_t>(position - firstLine_);
+   if (index >= offsets_.size())
+      return Success();
+
+   boost::shared_ptr<std::istream> pIfs;
+   error = path_.open_r(&pIfs);
+   if (error)
+      return error;
+
+   try
+   {
+      pIfs->exceptions(std::istream::badbit);
+      pIfs->seekg(static_cast<std::streamoff>(offsets_[index]));
+
+      std::string line;
+      for (std::size_t i = index; i < offsets_.size() && std::getline(*pIfs, line); i++)
+         pLines->push_back(line);
+   }
+   catch(const std::exception& e)
+   {
+      error = ioError(path_, ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+
+   return Success();
+}
+
+void JobOutputJournal::flush()
+{
+   if (pending_)
+   {
+      if (pData_)
+         pData_->flush();
+      if (pIndex_)
+         pIndex_->flush();
+      pending_ = false;
+      unsynced_ = true;
+   }
+   lastFlush_ = now();
+
+   if (unsynced_ && lastFlush_ - lastSync_ >= kSyncInterval)
+      sync();
+}
+
+void JobOutputJournal::close()
+{
+   closeWriters();
+   if (unsynced_)
+      sync();
+}
+
+void JobOutputJournal::remove()
+{
+   closeWriters();
+
+   Error error = path_.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+   error = indexPath_.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+
+   open_ = false;
+   unsynced_ = false;
+   offsets_.clear();
+   size_ = 0;
+   firstLine_ = 0;
+}
+
+int JobOutputJournal::lineCount()
+{
+   if (path_.exists())
+   {
+      Error error = open(false);
+      if (error)
+         LOG_ERROR(error);
+   }
+   return static_cast<int>(firstLine_ + offsets_.size());
+}
+
+int JobOutputJournal::firstLine()
+{
+   if (path_.exists())
+   {
+      Error error = open(false);
+      if (error)
+         LOG_ERROR(error);
+   }
+   return static_cast<int>(firstLine_);
+}
+
+Error JobOutputJournal::open(bool create)
+{
+   if (open_)
+      return Success();
+
+   offsets_.clear();
+   size_ = 0;
+   firstLine_ = 0;
+
+   if (!path_.exists())
+   {
+      if (!create)
+         return Success();
+
+      Error error = path_.parent().ensureDirectory();
+      if (error)
+         return error;
+
+      open_ = true;
+      return writeIndex();
+   }
+
+   // load what we can of the index
+   size_ = path_.size();
+   bool rewriteIndex = false;
+   Error error = loadIndex(&rewriteIndex);
+   if (error)
+      return error;
+
+   // index any lines the index doesn't cover (e.g. lines written after the
+   // index was last flushed); the last indexed line is rescanned in case it
+   // was only partially written
+   boost::uint64_t position = 0;
+   if (!offsets_.empty())
+   {
+      position = offsets_.back();
+      offsets_.pop_back();
+   }
+   std::size_t indexed = offsets_.size();
+
+   boost::shared_ptr<std::istream> pIfs;
+   error = path_.open_r(&pIfs);
+   if (error)
+      return error;
+
+   bool atLineStart = true;
+   try
+   {
+      pIfs->exceptions(std::istream::badbit);
+      pIfs->seekg(static_cast<std::streamoff>(position));
+
+      char buffer[8192];
+      while (*pIfs)
+      {
+         pIfs->read(buffer, sizeof(buffer));
+         std::streamsize count = pIfs->gcount();
+         for (std::streamsize i = 0; i < count; i++, position++)
+         {
+            if (atLineStart)
+               offsets_.push_back(position);
+            atLineStart = buffer[i] == '\n';
+         }
+      }
+   }
+   catch(const std::exception& e)
+   {
+      error = ioError(path_, ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+   pIfs.reset();
+
+   // the index didn't have exactly these lines
+   if (offsets_.size() != indexed + 1)
+      rewriteIndex = true;
+
+   open_ = true;
+
+   // terminate a partially written line so the next line starts afresh
+   if (!atLineStart)
+   {
+      boost::shared_ptr<std::ostream> pOfs;
+      error = path_.open_w(&pOfs, false);
+      if (error)
+         return error;
+      pOfs->put('\n');
+      size_++;
+   }
+
+   if (rewriteIndex)
+      return writeIndex();
+
+   return Success();
+}
+
+Error JobOutputJournal::openWriters()
+{
+   if (!pData_)
+   {
+      Error error = path_.open_w(&pData_, false);
+      if (error)
+         return error;
+   }
+
+   if (!pIndex_)
+   {
+      Error error = indexPath_.exists() ?
+               indexPath_.open_w(&pIndex_, false) :
+               writeIndex();
+      if (error)
+         return error;
+   }
+
+   return Success();
+}
+
+void JobOutputJournal::closeWriters()
+{
+   flush();
+   pData_.reset();
+   pIndex_.reset();
+}
+
+void JobOutputJournal::sync()
+{
+   Error error = syncPath(path_);
+   if (error)
+      LOG_ERROR(error);
+   error = syncPath(indexPath_);
+   if (error)
+      LOG_ERROR(error);
+
+   unsynced_ = false;
+   lastSync_ = now();
+}
+
+Error JobOutputJournal::loadIndex(bool* pNeedsRewrite)
+{
+   if (!indexPath_.exists())
+   {
+      *pNeedsRewrite = true;
+      return Success();
+   }
+
+   boost::shared_ptr<std::istream> pIfs;
+   Error error = indexPath_.open_r(&pIfs);
+   if (error)
+      return error;
+
+   char magic[sizeof(kIndexMagic)];
+   boost::uint32_t version = 0;
+   pIfs->read(magic, sizeof(magic));
+   if (pIfs->gcount() != static_cast<std::streamsize>(sizeof(magic)) ||
+       std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+       !readValue(*pIfs, &version) || version != kIndexVersion ||
+       !readValue(*pIfs, &firstLine_))
+   {
+      firstLine_ = 0;
+      *pNeedsRewrite = true;
+      return Success();
+   }
+
+   // keep offsets up to the first one which doesn't make sense (the data
+   // is rescanned from there)
+   boost::uint64_t offset;
+   while (readValue(*pIfs, &offset))
+   {
+      bool valid = offsets_.empty() ? offset == 0 :
+                                      offset > offsets_.back() && offset < size_;
+      if (!valid)
+      {
+         *pNeedsRewrite = true;
+         break;
+      }
+      offsets_.push_back(offset);
+   }
+
+   return Success();
+}
+
+Error JobOutputJournal::writeIndex()
+{
+   pIndex_.reset();
+   Error error = indexPath_.open_w(&pIndex_, true);
+   if (error)
+      return error;
+
+   pIndex_->write(kIndexMagic, sizeof(kIndexMagic));
+   writeValue(*pIndex_, kIndexVersion);
+   writeValue(*pIndex_, firstLine_);
+   for (std::size_t i = 0; i < offsets_.size(); i++)
+      writeValue(*pIndex_, offsets_[i]);
+   pending_ = true;
+
+   if (!*pIndex_)
+   {
+      pIndex_.reset();
+      return ioError(indexPath_, ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
+Error JobOutputJournal::truncateHead()
+{
+   // find the first line to keep (always keeping the last line)
+   boost::uint64_t retain = maxBytes_ / kRetainDenominator * kRetainNumerator;
+   std::vector<boost::uint64_t>::iterator it =
+         std::lower_bound(offsets_.begin(), offsets_.end(), size_ - std::min(size_, retain));
+   std::size_t drop = std::min(static_cast<std::size_t>(it - offsets_.begin()),
+                               offsets_.size() - 1);
+   if (drop == 0)
+      return Success();
+
+   closeWriters();
+
+   // copy the retained lines to a new file and move it into place
+   boost::uint64_t base = offsets_[drop];
+   FilePath tempPath = path_.parent().complete(path_.filename() + ".tmp");
+   {
+      boost::shared_ptr<std::istream> pIfs;
+      Error error = path_.open_r(&pIfs);
+      if (error)
+         return error;
+
+      boost::shared_ptr<std::ostream> pOfs;
+      error = tempPath.open_w(&pOfs);
+      if (error)
+         return error;
+
+      try
+      {
+         pIfs->exceptions(std::istream::badbit);
+         pIfs->seekg(static_cast<std::streamoff>(base));
+         *pOfs << pIfs->rdbuf();
+         pOfs->flush();
+      }
+      catch(const std::exception& e)
+      {
+         error = ioError(path_, ERROR_LOCATION);
+         error.addProperty("what", e.what());
+         return error;
+      }
+
+      if (!*pOfs)
+         return ioError(tempPath, ERROR_LOCATION);
+   }
+
+   Error error = tempPath.move(path_);
+   if (error)
+      return error;
+
+   offsets_.erase(offsets_.begin(), offsets_.begin() + drop);
+   for (std::size_t i = 0; i < offsets_.size(); i++)
+      offsets_[i] -= base;
+   size_ -= base;
+   firstLine_ += drop;
+
+   return writeIndex();
+}
+
+} // namespace jobs
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,122 @@
+/*
+ * JobOutputJournal.hpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_JOBS_JOB_OUTPUT_JOURNAL_HPP
+#define SESSION_JOBS_JOB_OUTPUT_JOURNAL_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+
+// An append-only journal of a job's output lines.
+//
+// Lines are written to a file (one line per entry) which is kept open while
+// the job runs, with writes buffered and flushed periodically (and synced to
+// disk less often). A sidecar index records where
+// each line starts, so reading the output from a given line seeks straight
+// to it. Lines are numbered from the start of the job; when the journal
+// grows past its size limit the oldest lines are dropped, and reads of
+// dropped lines start from the oldest line retained.
+//
+// Journals left behind by an earlier session are reopened, and their index
+// is repaired if the session didn't exit cleanly.
+class JobOutputJournal : boost::noncopyable
+{
+public:
+   static const std::size_t kDefaultMaxBytes;
+   static const boost::posix_time::time_duration kFlushInterval;
+   static const boost::posix_time::time_duration kSyncInterval;
+
+   explicit JobOutputJournal(const core::FilePath& path,
+                             std::size_t maxBytes = kDefaultMaxBytes);
+   ~JobOutputJournal();
+
+   // append a line (which must not contain newlines)
+   core::Error append(const std::string& line);
+
+   // read the lines from the given line number onwards
+   core::Error read(int position, std::vector<std::string>* pLines);
+
+   // write out any buffered output (syncing it to disk if it's been
+   // longer than the sync interval)
+   void flush();
+
+   // write out and sync any buffered output and close the files (they're
+   // reopened by the next append)
+   void close();
+
+   // close and delete the journal
+   void remove();
+
+   // number of lines appended (including any which have been dropped)
+   int lineCount();
+
+   // number of the oldest line retained
+   int firstLine();
+
+private:
+   core::Error open(bool create);
+   core::Error openWriters();
+   void closeWriters();
+   void sync();
+   core::Error loadIndex(bool* pNeedsRewrite);
+   core::Error writeIndex();
+   core::Error truncateHead();
+
+private:
+   core::FilePath path_;
+   core::FilePath indexPath_;
+   std::size_t maxBytes_;
+
+   bool open_;
+   boost::shared_ptr<std::ostream> pData_;
+   boost::shared_ptr<std::ostream> pIndex_;
+   bool pending_;
+   bool unsynced_;
+   boost::posix_time::ptime lastFlush_;
+   boost::posix_time::ptime lastSync_;
+
+   // where each retained line starts, and the data size
+   std::vector<boost::uint64_t> offsets_;
+   boost::uint64_t size_;
+
+   // number of lines dropped from the head of the journal
+   boost::uint64_t firstLine_;
+};
+
+} // namespace jobs
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_JOBS_JOB_OUTPUT_JOURNAL_HPP
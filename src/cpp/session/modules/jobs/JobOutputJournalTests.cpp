@@ -0,0 +1,267 @@
+/*
+ * JobOutputJournalTests.cpp
+ *
+ * Copyright (C) 2009-19 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "JobOutputJournal.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace jobs {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempJournalPath
+{
+public:
+   TempJournalPath()
+   {
+      FilePath::tempFilePath(&dir_);
+      dir_.ensureDirectory();
+   }
+
+   ~TempJournalPath()
+   {
+      dir_.removeIfExists();
+   }
+
+   FilePath path() const { return dir_.complete("job-output.json"); }
+   FilePath indexPath() const { return dir_.complete("job-output.idx"); }
+
+private:
+   FilePath dir_;
+};
+
+std::string lineText(int i)
+{
+   return "line " + boost::lexical_cast<std::string>(i);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Job Output Journal")
+{
+   TempJournalPath temp;
+
+   SECTION("Jobs without output have an empty journal")
+   {
+      JobOutputJournal journal(temp.path());
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(0, &lines));
+      CHECK(lines.empty());
+      CHECK(journal.lineCount() == 0);
+      CHECK_FALSE(temp.path().exists());
+   }
+
+   SECTION("Read from a position")
+   {
+      JobOutputJournal journal(temp.path());
+      for (int i = 0; i < 100; i++)
+         REQUIRE(!journal.append(lineText(i)));
+      CHECK(journal.lineCount() == 100);
+
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(0, &lines));
+      REQUIRE(lines.size() == 100);
+      CHECK(lines[0] == "line 0");
+      CHECK(lines[99] == "line 99");
+
+      lines.clear();
+      REQUIRE(!journal.read(95, &lines));
+      REQUIRE(lines.size() == 5);
+      CHECK(lines[0] == "line 95");
+
+      lines.clear();
+      REQUIRE(!journal.read(100, &lines));
+      CHECK(lines.empty());
+
+      // appending after reading continues the journal
+      REQUIRE(!journal.append(lineText(100)));
+      lines.clear();
+      REQUIRE(!journal.read(99, &lines));
+      REQUIRE(lines.size() == 2);
+      CHECK(lines[1] == "line 100");
+   }
+
+   SECTION("The journal file is newline-delimited")
+   {
+      {
+         JobOutputJournal journal(temp.path());
+         REQUIRE(!journal.append("[1,\"a\"]"));
+         REQUIRE(!journal.append("[2,\"b\"]"));
+      }
+
+      std::string contents;
+      REQUIRE(!readStringFromFile(temp.path(), &contents));
+      CHECK(contents == "[1,\"a\"]\n[2,\"b\"]\n");
+   }
+
+   SECTION("Reopen a journal")
+   {
+      {
+         JobOutputJournal journal(temp.path());
+         for (int i = 0; i < 50; i++)
+            REQUIRE(!journal.append(lineText(i)));
+      }
+
+      JobOutputJournal journal(temp.path());
+      CHECK(journal.lineCount() == 50);
+      REQUIRE(!journal.append(lineText(50)));
+
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(48, &lines));
+      REQUIRE(lines.size() == 3);
+      CHECK(lines[0] == "line 48");
+      CHECK(lines[2] == "line 50");
+   }
+
+   SECTION("Repair a journal whose index is missing or stale")
+   {
+      {
+         JobOutputJournal journal(temp.path());
+         for (int i = 0; i < 10; i++)
+            REQUIRE(!journal.append(lineText(i)));
+      }
+
+      // output written without indexing, ending in a partial line
+      REQUIRE(!appendToFile(temp.path(), "line 10\nline 11\nparti"));
+
+      {
+         JobOutputJournal journal(temp.path());
+         CHECK(journal.lineCount() == 13);
+
+         std::vector<std::string> lines;
+         REQUIRE(!journal.read(9, &lines));
+         REQUIRE(lines.size() == 4);
+         CHECK(lines[1] == "line 10");
+         CHECK(lines[3] == "parti");
+
+         // new output starts on a line of its own
+         REQUIRE(!journal.append(lineText(13)));
+         lines.clear();
+         REQUIRE(!journal.read(13, &lines));
+         REQUIRE(lines.size() == 1);
+         CHECK(lines[0] == "line 13");
+      }
+
+      REQUIRE(!temp.indexPath().remove());
+      JobOutputJournal journal(temp.path());
+      CHECK(journal.lineCount() == 14);
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(12, &lines));
+      REQUIRE(lines.size() == 2);
+      CHECK(lines[0] == "parti");
+   }
+
+   SECTION("Runaway output is truncated from the head")
+   {
+      const std::size_t maxBytes = 1000;
+      JobOutputJournal journal(temp.path(), maxBytes);
+      for (int i = 0; i < 1000; i++)
+         REQUIRE(!journal.append(lineText(i)));
+
+      CHECK(journal.lineCount() == 1000);
+      CHECK(journal.firstLine() > 0);
+      CHECK(temp.path().size() <= maxBytes);
+
+      // lines keep their numbers, and reads of dropped lines start at the
+      // oldest line retained
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(990, &lines));
+      REQUIRE(lines.size() == 10);
+      CHECK(lines[0] == "line 990");
+
+      lines.clear();
+      REQUIRE(!journal.read(0, &lines));
+      CHECK(lines.size() == static_cast<std::size_t>(1000 - journal.firstLine()));
+      CHECK(lines[0] == lineText(journal.firstLine()));
+      CHECK(lines.back() == "line 999");
+
+      // and survive reopening
+      int firstLine = journal.firstLine();
+      JobOutputJournal reopened(temp.path(), maxBytes);
+      CHECK(reopened.firstLine() == firstLine);
+      CHECK(reopened.lineCount() == 1000);
+   }
+
+   SECTION("Buffered output is written out by a flush")
+   {
+      JobOutputJournal journal(temp.path());
+      REQUIRE(!journal.append("[1,\"a\"]"));
+      journal.flush();
+
+      std::string contents;
+      REQUIRE(!readStringFromFile(temp.path(), &contents));
+      CHECK(contents == "[1,\"a\"]\n");
+
+      // and so is its index
+      JobOutputJournal reader(temp.path());
+      CHECK(reader.lineCount() == 1);
+   }
+
+#ifdef __linux__
+   SECTION("Closing a journal releases its files")
+   {
+      FilePath fds("/proc/self/fd");
+      std::vector<FilePath> before;
+      REQUIRE(!fds.children(&before));
+
+      JobOutputJournal journal(temp.path());
+      REQUIRE(!journal.append(lineText(0)));
+      std::vector<FilePath> open;
+      REQUIRE(!fds.children(&open));
+      CHECK(open.size() == before.size() + 2);
+
+      journal.close();
+      std::vector<FilePath> closed;
+      REQUIRE(!fds.children(&closed));
+      CHECK(closed.size() == before.size());
+
+      // appending reopens them
+      REQUIRE(!journal.append(lineText(1)));
+      std::vector<std::string> lines;
+      REQUIRE(!journal.read(0, &lines));
+      REQUIRE(lines.size() == 2);
+      CHECK(lines[1] == "line 1");
+   }
+#endif
+
+   SECTION("Remove a journal")
+   {
+      JobOutputJournal journal(temp.path());
+      REQUIRE(!journal.append("output"));
+      journal.remove();
+      CHECK_FALSE(temp.path().exists());
+      CHECK_FALSE(temp.indexPath().exists());
+      CHECK(journal.lineCount() == 0);
+   }
+}
+
+} // end namespace tests
+} // end namespace jobs
+} // end namespace modules
+} // end namespace session
+} // end namespace rstudio
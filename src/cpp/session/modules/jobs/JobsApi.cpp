@@ -223,6 +223,16 @@ void endAllJobStreaming()
    }
 }
 
+bool flushJobOutput()
+{
+   // write out output from jobs which have gone quiet since it was added
+   for (auto& job: s_jobs)
+   {
+      job.second->flushOutput();
+   }
+   return true;
+}
+
 bool localJobsRunning()
 {
    for (auto& job: s_jobs)
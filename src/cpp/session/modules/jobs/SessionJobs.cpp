@@ -26,6 +26,7 @@
 #include <session/SessionModuleContext.hpp>
 #include <session/jobs/JobsApi.hpp>
 
+#include "JobOutputJournal.hpp"
 #include "ScriptJob.hpp"
 #include "SessionJobs.hpp"
 
@@ -457,6 +458,13 @@ core::Error initialize()
    module_context::events().onClientInit.connect(onClientInit);
    module_context::events().onShutdown.connect(onShutdown);
 
+   // output is buffered as it's added, so write it out periodically (the
+   // job may not add more for a while)
+   module_context::schedulePeriodicWork(JobOutputJournal::kFlushInterval,
+                                        flushJobOutput,
+                                        false,
+                                        false);
+
    using boost::bind;
    ExecBlock initBlock;
    initBlock.addFunctions()
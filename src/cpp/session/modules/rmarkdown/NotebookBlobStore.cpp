@@ -0,0 +1,209 @@
+/*
+ * NotebookBlobStore.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "NotebookBlobStore.hpp"
+#include "NotebookChunkDefs.hpp"
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <core/system/System.hpp>
+
+// suffix for a file being replaced in a cache folder
+#define kCacheTempSuffix ".tmp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace rmarkdown {
+namespace notebook {
+
+Error shareCacheFile(const FilePath& blobStore, const FilePath& file)
+{
+   // a file with other links is already shared
+   std::size_t links = 0;
+   Error error = core::system::linkCount(file, &links);
+   if (error)
+      return error;
+   if (links > 1)
+      return Success();
+
+   std::string contents;
+   error = core::readStringFromFile(file, &contents);
+   if (error)
+      return error;
+
+   error = blobStore.ensureDirectory();
+   if (error)
+      return error;
+   FilePath blob = blobStore.complete(hash::crc32HexHash(contents) + "-" +
+         safe_convert::numberToString(contents.size()));
+
+   // if there's no blob with this content yet, the file becomes the blob
+   if (!blob.exists())
+   {
+      error = core::system::linkFile(file, blob);
+
+      // if there's still no blob the filesystem probably can't link files;
+      // the file just keeps its own copy of its content
+      if (!error || !blob.exists())
+         return Success();
+   }
+
+   // the name of the blob doesn't guarantee its content, so compare before
+   // sharing it
+   std::string blobContents;
+   error = core::readStringFromFile(blob, &blobContents);
+   if (error)
+      return error;
+   if (blobContents != contents)
+      return Success();
+
+   // link the blob next to the file and then move the link over the file, so
+   // that the file is never missing
+   FilePath link(file.absolutePath() + kCacheTempSuffix);
+   error = link.removeIfExists();
+   if (error)
+      return error;
+   error = core::system::linkFile(blob, link);
+   if (error)
+      return error;
+   error = link.move(file, FilePath::MoveDirect);
+   if (error)
+      link.removeIfExists();
+   return error;
+}
+
+void shareCacheFiles(const FilePath& blobStore, const FilePath& folder)
+{
+   std::vector<FilePath> children;
+   Error error = folder.children(&children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      if (child.isDirectory())
+      {
+         shareCacheFiles(blobStore, child);
+      }
+      else if (child.filename() != kNotebookChunkDefFilename)
+      {
+         // (the chunk definitions are written in place, so aren't shared)
+         error = shareCacheFile(blobStore, child);
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+}
+
+Error linkCacheFolder(const FilePath& source, const FilePath& target)
+{
+   Error error = target.ensureDirectory();
+   if (error)
+      return error;
+
+   std::vector<FilePath> children;
+   error = source.children(&children);
+   if (error)
+      return error;
+
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      FilePath targetChild = target.complete(child.filename());
+      if (child.isDirectory())
+      {
+         error = linkCacheFolder(child, targetChild);
+      }
+      else if (child.filename() == kNotebookChunkDefFilename)
+      {
+         error = child.copy(targetChild);
+      }
+      else
+      {
+         error = core::system::linkFile(child, targetChild);
+         if (error)
+            error = child.copy(targetChild);
+      }
+
+      if (error)
+         return error;
+   }
+
+   return Success();
+}
+
+void removeUnusedBlobs(const FilePath& blobStore)
+{
+   if (!blobStore.exists())
+      return;
+
+   std::vector<FilePath> blobs;
+   Error error = blobStore.children(&blobs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   BOOST_FOREACH(const FilePath& blob, blobs)
+   {
+      std::size_t links = 0;
+      error = core::system::linkCount(blob, &links);
+      if (!error && links < 2)
+         error = blob.remove();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+Error unshareCacheFile(const FilePath& file)
+{
+   std::size_t links = 0;
+   Error error = core::system::linkCount(file, &links);
+   if (error)
+      return error;
+   if (links < 2)
+      return Success();
+
+   // copy the content next to the file and move the copy over the file
+   FilePath copy(file.absolutePath() + kCacheTempSuffix);
+   error = copy.removeIfExists();
+   if (error)
+      return error;
+   error = file.copy(copy);
+   if (!error)
+      error = copy.move(file, FilePath::MoveDirect);
+   if (error)
+      copy.removeIfExists();
+   return error;
+}
+
+} // namespace notebook
+} // namespace rmarkdown
+} // namespace modules
+} // namespace session
+} // namespace rstudio
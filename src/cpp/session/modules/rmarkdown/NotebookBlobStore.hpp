@@ -0,0 +1,63 @@
+/*
+ * NotebookBlobStore.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Sharing of notebook cache output files through a blob store (see
+// NotebookCache.hpp). A blob is named for the hash and size of its content,
+// and the filesystem's link count serves as its reference count.
+
+#ifndef SESSION_NOTEBOOK_BLOB_STORE_HPP
+#define SESSION_NOTEBOOK_BLOB_STORE_HPP
+
+namespace rstudio {
+namespace core {
+   class FilePath;
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace rmarkdown {
+namespace notebook {
+
+// replaces a cache file with a link to the blob holding its content, adding
+// the blob if there isn't one yet
+core::Error shareCacheFile(const core::FilePath& blobStore,
+                           const core::FilePath& file);
+
+// shares each of the output files in a cache folder
+void shareCacheFiles(const core::FilePath& blobStore,
+                     const core::FilePath& folder);
+
+// copies a cache folder, linking to the content of its output files rather
+// than copying it where possible
+core::Error linkCacheFolder(const core::FilePath& source,
+                            const core::FilePath& target);
+
+// removes blobs which are no longer linked from any cache
+void removeUnusedBlobs(const core::FilePath& blobStore);
+
+// gives a cache file its own copy of its content if it's shared with other
+// caches, so that it can be written in place
+core::Error unshareCacheFile(const core::FilePath& file);
+
+} // namespace notebook
+} // namespace rmarkdown
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif
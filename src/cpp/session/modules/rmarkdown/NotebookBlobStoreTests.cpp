@@ -0,0 +1,224 @@
+/*
+ * NotebookBlobStoreTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "NotebookBlobStore.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace rmarkdown {
+namespace notebook {
+namespace tests {
+
+using namespace rstudio::core;
+
+namespace {
+
+class TempCacheRoot
+{
+public:
+   TempCacheRoot()
+   {
+      FilePath::tempFilePath(&root_);
+      root_.ensureDirectory();
+   }
+
+   ~TempCacheRoot()
+   {
+      root_.removeIfExists();
+   }
+
+   FilePath blobStore() const { return root_.complete("blobs"); }
+
+   // a committed cache folder holding chunk definitions and an output file
+   FilePath cache(const std::string& name, const std::string& output) const
+   {
+      FilePath folder = root_.complete(name).complete("1").complete("s");
+      folder.complete("cwiaiw9i4f0").ensureDirectory();
+      writeStringToFile(folder.complete("chunks.json"), "{\"chunk_definitions\":[]}");
+      writeStringToFile(folder.complete("cwiaiw9i4f0").complete("00001.csv"),
+                        output);
+      return folder;
+   }
+
+   std::vector<FilePath> blobs() const
+   {
+      std::vector<FilePath> blobs;
+      if (blobStore().exists())
+         blobStore().children(&blobs);
+      return blobs;
+   }
+
+private:
+   FilePath root_;
+};
+
+FilePath outputFile(const FilePath& cache)
+{
+   return cache.complete("cwiaiw9i4f0").complete("00001.csv");
+}
+
+FilePath blobFor(const FilePath& blobStore, const std::string& contents)
+{
+   return blobStore.complete(hash::crc32HexHash(contents) + "-" +
+                             safe_convert::numberToString(contents.size()));
+}
+
+std::size_t links(const FilePath& file)
+{
+   std::size_t count = 0;
+   REQUIRE(!core::system::linkCount(file, &count));
+   return count;
+}
+
+std::string contents(const FilePath& file)
+{
+   std::string contents;
+   REQUIRE(!readStringFromFile(file, &contents));
+   return contents;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Notebook Blob Store")
+{
+   TempCacheRoot root;
+   const std::string output = "\"x\",\"y\"\n1,2\n";
+
+   SECTION("Identical outputs share a blob")
+   {
+      FilePath first = root.cache("first", output);
+      FilePath second = root.cache("second", output);
+      shareCacheFiles(root.blobStore(), first);
+      shareCacheFiles(root.blobStore(), second);
+
+      REQUIRE(root.blobs().size() == 1);
+      FilePath blob = blobFor(root.blobStore(), output);
+      CHECK(root.blobs()[0] == blob);
+      CHECK(links(blob) == 3);
+      CHECK(links(outputFile(first)) == 3);
+      CHECK(contents(outputFile(second)) == output);
+
+      // the chunk definitions are written in place, so aren't shared
+      CHECK(links(first.complete("chunks.json")) == 1);
+
+      // sharing again doesn't add links
+      shareCacheFiles(root.blobStore(), first);
+      CHECK(links(blob) == 3);
+   }
+
+   SECTION("Different outputs get their own blobs")
+   {
+      FilePath first = root.cache("first", output);
+      FilePath second = root.cache("second", output + "3,4\n");
+      shareCacheFiles(root.blobStore(), first);
+      shareCacheFiles(root.blobStore(), second);
+
+      CHECK(root.blobs().size() == 2);
+      CHECK(links(outputFile(first)) == 2);
+      CHECK(links(outputFile(second)) == 2);
+   }
+
+   SECTION("An output isn't shared with a blob whose content differs")
+   {
+      // a blob with the output's name but other content (as a hash
+      // collision would leave)
+      FilePath blob = blobFor(root.blobStore(), output);
+      REQUIRE(!root.blobStore().ensureDirectory());
+      REQUIRE(!writeStringToFile(blob, "other content"));
+
+      FilePath cache = root.cache("first", output);
+      REQUIRE(!shareCacheFile(root.blobStore(), outputFile(cache)));
+
+      CHECK(links(outputFile(cache)) == 1);
+      CHECK(contents(outputFile(cache)) == output);
+      CHECK(links(blob) == 1);
+      CHECK(contents(blob) == "other content");
+   }
+
+   SECTION("Unsharing an output lets it be written in place")
+   {
+      FilePath first = root.cache("first", output);
+      FilePath second = root.cache("second", output);
+      shareCacheFiles(root.blobStore(), first);
+      shareCacheFiles(root.blobStore(), second);
+
+      REQUIRE(!unshareCacheFile(outputFile(first)));
+      CHECK(links(outputFile(first)) == 1);
+      CHECK(contents(outputFile(first)) == output);
+
+      REQUIRE(!appendToFile(outputFile(first), "3,4\n"));
+      CHECK(contents(outputFile(first)) == output + "3,4\n");
+      CHECK(contents(outputFile(second)) == output);
+
+      FilePath blob = blobFor(root.blobStore(), output);
+      CHECK(contents(blob) == output);
+      CHECK(links(blob) == 2);
+
+      // unsharing a file which isn't shared leaves it alone
+      REQUIRE(!unshareCacheFile(outputFile(first)));
+      CHECK(contents(outputFile(first)) == output + "3,4\n");
+   }
+
+   SECTION("Blobs are removed once no cache links to them")
+   {
+      FilePath first = root.cache("first", output);
+      FilePath second = root.cache("second", output);
+      shareCacheFiles(root.blobStore(), first);
+      shareCacheFiles(root.blobStore(), second);
+
+      REQUIRE(!first.removeIfExists());
+      removeUnusedBlobs(root.blobStore());
+      REQUIRE(root.blobs().size() == 1);
+      CHECK(links(root.blobs()[0]) == 2);
+
+      REQUIRE(!second.removeIfExists());
+      removeUnusedBlobs(root.blobStore());
+      CHECK(root.blobs().empty());
+   }
+
+   SECTION("Copied caches link to the same outputs")
+   {
+      FilePath first = root.cache("first", output);
+      shareCacheFiles(root.blobStore(), first);
+
+      FilePath copy = first.parent().parent().parent().complete("copy");
+      REQUIRE(!linkCacheFolder(first, copy));
+
+      CHECK(contents(outputFile(copy)) == output);
+      CHECK(links(outputFile(copy)) == 3);
+      CHECK(links(copy.complete("chunks.json")) == 1);
+      CHECK(contents(copy.complete("chunks.json")) ==
+            contents(first.complete("chunks.json")));
+   }
+}
+
+} // namespace tests
+} // namespace notebook
+} // namespace rmarkdown
+} // namespace modules
+} // namespace session
+} // namespace rstudio
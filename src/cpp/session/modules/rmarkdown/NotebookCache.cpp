@@ -15,6 +15,7 @@
 
 #include "SessionRmdNotebook.hpp"
 #include "NotebookCache.hpp"
+#include "NotebookBlobStore.hpp"
 #include "NotebookChunkDefs.hpp"
 #include "NotebookPaths.hpp"
 #include "NotebookOutput.hpp"
@@ -42,6 +43,9 @@
 
 #define kCacheAgeThresholdMs 1000 * 60 * 60 * 24 * 2
 
+// folder (in the cache root) holding the content of committed output files
+#define kBlobStoreDir "blobs"
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -51,6 +55,11 @@ namespace rmarkdown {
 namespace notebook {
 namespace {
 
+FilePath blobStorePath()
+{
+   return notebookCacheRoot().childPath(kBlobStoreDir);
+}
+
 // it's much faster to load a notebook from its cache than it is to rehydrate
 // it from its .Rnb, so we keep it around even if the document is closed (as
 // it's somewhat common to open and close a document periodically over the 
@@ -145,6 +154,10 @@ void cleanUnusedCaches()
          }
       }
    }
+
+   // removing caches releases their links to blobs, which may leave some
+   // blobs unused
+   removeUnusedBlobs(blobStorePath());
 }
 
 Error notebookContentMatches(const FilePath& nbPath, const FilePath& rmdPath, 
@@ -292,7 +305,8 @@ void onDocRenamed(const std::string& oldPath,
          return;
    }
 
-   error = oldCacheDir.copyDirectoryRecursive(newCacheDir);
+   // the copy shares its output content with the old folder
+   error = linkCacheFolder(oldCacheDir, newCacheDir);
    if (error)
    {
       LOG_ERROR(error);
@@ -480,6 +494,10 @@ void onDocSaved(FilePath path)
       if (error)
          LOG_ERROR(error);
    }
+
+   // store the committed outputs in the blob store (outputs committed
+   // earlier are already there)
+   shareCacheFiles(blobStorePath(), saved);
 }
 
 FilePath unsavedNotebookCache()
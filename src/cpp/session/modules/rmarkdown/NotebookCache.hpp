@@ -44,6 +44,14 @@
 //   in the source .Rmd
 // - the special folder "lib" is used for shared libraries (e.g. scripts upon
 //   which several htmlwidget chunks depend)
+//
+// Output files in the committed folder are stored once per distinct content:
+// each is a hard link to a blob in the "blobs" folder of the cache root, which
+// is named for the hash and size of its content. Saving, renaming, or
+// copying a cache then links the same blobs rather than duplicating them, and
+// blobs which are no longer linked from any cache are removed along with
+// unused caches (see NotebookBlobStore.hpp). Shared files must not be
+// modified in place; use unshareCacheFile before doing so.
 
 
 #ifndef SESSION_NOTEBOOK_CACHE_HPP
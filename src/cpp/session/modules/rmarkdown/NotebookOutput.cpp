@@ -15,6 +15,7 @@
 
 #include "SessionRmdNotebook.hpp"
 #include "NotebookCache.hpp"
+#include "NotebookBlobStore.hpp"
 #include "NotebookOutput.hpp"
 #include "NotebookPlots.hpp"
 
@@ -583,6 +584,14 @@ core::Error writeConsoleOutput(int chunkConsoleType,
    error = targetPath.parent().ensureDirectory();
    if (error)
       return error;
+
+   // don't write through to output content shared with other caches
+   if (targetPath.exists())
+   {
+      error = unshareCacheFile(targetPath);
+      if (error)
+         return error;
+   }
    
    std::vector<std::string> data;
    data.push_back(safe_convert::numberToString(chunkConsoleType));
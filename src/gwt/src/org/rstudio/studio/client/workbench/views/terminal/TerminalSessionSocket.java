@@ -36,6 +36,7 @@ import org.rstudio.studio.client.workbench.views.terminal.events.TerminalDataInp
 import org.rstudio.studio.client.workbench.views.terminal.xterm.XTermWidget;
 
 import com.google.gwt.core.client.GWT;
+import com.google.gwt.core.client.Scheduler;
 import com.google.gwt.event.shared.HandlerRegistration;
 import com.sksamuel.gwt.websockets.CloseEvent;
 import com.sksamuel.gwt.websockets.Websocket;
@@ -309,6 +310,7 @@ public class TerminalSessionSocket
                else
                {
                   onConsoleOutput(new ConsoleOutputEvent(TerminalSocketPacket.getMessage(msg)));
+                  acknowledgeOutput();
                }
             }
 
@@ -527,6 +529,24 @@ public class TerminalSessionSocket
    public void receivedKeepAlive()
    {
    }
+
+   /**
+    * Let the server know output has been written to the terminal, so it can
+    * send more. Acknowledgements are sent once the browser has had a chance
+    * to process the output, batching those for output which arrived together.
+    */
+   private void acknowledgeOutput()
+   {
+      if (unackedPackets_++ > 0)
+         return;
+
+      Scheduler.get().scheduleDeferred(() ->
+      {
+         if (socket_ != null && unackedPackets_ > 0)
+            socket_.send(TerminalSocketPacket.ackPacket(unackedPackets_));
+         unackedPackets_ = 0;
+      });
+   }
  
    private HandlerRegistrations registrations_ = new HandlerRegistrations();
    private final Session session_;
@@ -538,6 +558,7 @@ public class TerminalSessionSocket
    private Websocket socket_;
    private TerminalLocalEcho localEcho_;
    private StringBuilder diagnostic_;
+   private int unackedPackets_;
    
    // RegEx to match common password prompts
    private static final String PASSWORD_REGEX = 
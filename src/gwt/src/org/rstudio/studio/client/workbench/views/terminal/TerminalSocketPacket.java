@@ -25,8 +25,12 @@ import org.rstudio.core.client.StringUtil;
  * First character is a method indicator, as follows:
  *    "a" = send text, e.g. "aHello"
  *    "b" = ping/pong, e.g. "b"
+ *    "c" = acknowledge output, e.g. "c2" (two "send text" packets have been
+ *          written to the terminal; the server uses this to avoid sending
+ *          output faster than we can display it)
  *    
- * Only the "send text" method has a payload (everything after the "a").
+ * Only the "send text" and "acknowledge" methods have a payload (everything
+ * after the method indicator).
  * 
  * See SessionConsoleProcessSocketPacket in session code for C++ side of this sophisticated
  * wire format.
@@ -47,6 +51,11 @@ public class TerminalSocketPacket
       return StringUtil.equals(text, keepAlivePrefix);
    }
    
+   public static String ackPacket(int packets)
+   {
+      return ackPrefix + packets;
+   }
+   
    public static String getMessage(String text)
    {
       if (text.startsWith(textPrefix))
@@ -58,4 +67,5 @@ public class TerminalSocketPacket
 
    private static final String keepAlivePrefix = "b";
    private static final String textPrefix = "a";
+   private static final String ackPrefix = "c";
 }